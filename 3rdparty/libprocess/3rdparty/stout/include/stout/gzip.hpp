@@ -23,7 +23,7 @@
 #include "try.hpp"
 
 // Compression utilities.
-// TODO(bmahler): Provide streaming compression / decompression as well.
+// TODO(bmahler): Provide streaming compression as well.
 namespace gzip {
 
 // We use a 16KB buffer with zlib compression / decompression.
@@ -144,6 +144,135 @@ inline Try<std::string> decompress(const std::string& compressed)
   return result;
 }
 
+
+// Decompresses a gzip stream one piece at a time, e.g., while it is
+// being downloaded, so that the whole stream never has to be held in
+// memory.
+class Decompressor
+{
+public:
+  Decompressor() : initialized(false), done(false), trailing(false)
+  {
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    // Zlib magic for gzip compression / decompression.
+    initialized = inflateInit2(&stream, MAX_WBITS + 16) == Z_OK;
+  }
+
+  ~Decompressor()
+  {
+    if (initialized) {
+      inflateEnd(&stream);
+    }
+  }
+
+  // Returns the data decompressed from the next piece of the stream,
+  // which may be empty if the piece did not complete any data. Like
+  // gunzip, this decompresses the concatenation of gzip streams
+  // (members) and ignores any data after the last member that is not
+  // the start of another one.
+  Try<std::string> decompress(const std::string& compressed)
+  {
+    if (!initialized) {
+      return Error("Failed to initialize zlib");
+    } else if (trailing) {
+      return std::string();
+    }
+
+    // Prepend what was held back from the previous piece, if any.
+    std::string input;
+    const char* data = compressed.data();
+    size_t length = compressed.length();
+
+    if (!pending.empty()) {
+      input = pending + compressed;
+      pending.clear();
+      data = input.data();
+      length = input.length();
+    }
+
+    std::string result = "";
+    while (length > 0) {
+      if (done) {
+        // Another member only follows if the gzip magic (0x1f 0x8b)
+        // does, which we can't tell yet if only its first byte is
+        // there.
+        if (length == 1 && data[0] == '\x1f') {
+          pending.assign(data, length);
+          break;
+        } else if (data[0] != '\x1f' || data[1] != '\x8b') {
+          trailing = true;
+          break;
+        }
+
+        if (inflateReset(&stream) != Z_OK) {
+          return Error("Failed to reset zlib");
+        }
+
+        done = false;
+      }
+
+      stream.next_in =
+        const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
+      stream.avail_in = length;
+
+      // Keep inflating while there is input left or the last inflate
+      // filled the buffer, since zlib might then have more output.
+      Bytef buffer[GZIP_BUFFER_SIZE];
+      do {
+        stream.next_out = buffer;
+        stream.avail_out = GZIP_BUFFER_SIZE;
+        int code = inflate(&stream, Z_NO_FLUSH);
+
+        // Z_BUF_ERROR only means that no progress could be made, i.e.,
+        // all of the input has been consumed.
+        if (code != Z_OK && code != Z_STREAM_END && code != Z_BUF_ERROR) {
+          return Error(stream.msg != NULL
+                       ? std::string(stream.msg)
+                       : "Failed to decompress: zlib error " + stringify(code));
+        }
+
+        // Consume output.
+        result.append(
+            reinterpret_cast<char*>(buffer),
+            GZIP_BUFFER_SIZE - stream.avail_out);
+
+        if (code == Z_STREAM_END) {
+          done = true;
+          break;
+        }
+      } while (stream.avail_in > 0 || stream.avail_out == 0);
+
+      data += length - stream.avail_in;
+      length = stream.avail_in;
+    }
+
+    return result;
+  }
+
+  // Returns true once the end of the (last) member has been
+  // decompressed, i.e., the stream is not truncated.
+  bool finished() const { return done; }
+
+private:
+  // Not copyable, since the zlib stream cannot be shared.
+  Decompressor(const Decompressor&);
+  Decompressor& operator = (const Decompressor&);
+
+  z_stream_s stream;
+  bool initialized;
+  bool done;     // The last member has ended.
+  bool trailing; // Ignoring the data after the last member.
+
+  // The start of the next piece, held back until we can tell whether
+  // it starts another member.
+  std::string pending;
+};
+
 } // namespace gzip {
 
 #endif // __STOUT_GZIP_HPP__
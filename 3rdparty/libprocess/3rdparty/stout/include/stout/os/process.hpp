@@ -112,6 +112,7 @@ public:
   const std::list<ProcessTree> children;
 
 private:
+  friend class ProcessTable;
   friend struct Fork;
   friend Try<ProcessTree> pstree(pid_t, const std::list<Process>&);
 
@@ -0,0 +1,537 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __STOUT_OS_PROCESS_TABLE_HPP__
+#define __STOUT_OS_PROCESS_TABLE_HPP__
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <sys/types.h> // For pid_t.
+
+#include <list>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+
+#include <stout/bytes.hpp>
+#include <stout/duration.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/none.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+#include <stout/try.hpp>
+
+#include <stout/os/process.hpp>
+
+namespace os {
+
+// A snapshot of the processes of the system that, unlike
+// os::processes(), can be brought up to date cheaply and queried many
+// times in between, e.g., for the process trees of many containers.
+// On Linux, refresh() keeps '/proc' open, reads the 'stat' of each
+// process into a fixed buffer and parses it in place, and only reads
+// the command line of the processes it has not seen before (or that
+// have since changed their executable name, i.e., exec'ed). On other
+// systems it falls back to os::processes().
+//
+// A ProcessTable is not thread safe.
+class ProcessTable
+{
+public:
+  ProcessTable()
+    : generation(0)
+#ifdef __linux__
+    , directory(NULL)
+#endif
+  {}
+
+  ~ProcessTable()
+  {
+#ifdef __linux__
+    if (directory != NULL) {
+      ::closedir(directory);
+    }
+#endif
+  }
+
+  // Brings the snapshot up to date: adds the processes that have
+  // been created, updates the usage of the others and drops those
+  // that have terminated since the last refresh.
+  Try<Nothing> refresh();
+
+  Option<Process> process(pid_t pid) const
+  {
+    std::map<pid_t, Entry>::const_iterator iterator = entries.find(pid);
+
+    if (iterator == entries.end()) {
+      return None();
+    }
+
+    return process(iterator->first, iterator->second);
+  }
+
+  std::list<Process> processes() const
+  {
+    std::list<Process> result;
+    for (std::map<pid_t, Entry>::const_iterator iterator = entries.begin();
+         iterator != entries.end();
+         ++iterator) {
+      result.push_back(process(iterator->first, iterator->second));
+    }
+    return result;
+  }
+
+  // See os::children().
+  std::set<pid_t> children(pid_t pid, bool recursive = true) const
+  {
+    // Perform a breadth first search for descendants.
+    std::set<pid_t> descendants;
+    std::queue<pid_t> parents;
+    parents.push(pid);
+
+    do {
+      pid_t parent = parents.front();
+      parents.pop();
+
+      std::map<pid_t, std::set<pid_t> >::const_iterator iterator =
+        offspring.find(parent);
+
+      if (iterator != offspring.end()) {
+        foreach (pid_t child, iterator->second) {
+          // Have we seen this child yet?
+          if (descendants.insert(child).second) {
+            parents.push(child);
+          }
+        }
+      }
+    } while (recursive && !parents.empty());
+
+    return descendants;
+  }
+
+  // See os::pstree().
+  Try<ProcessTree> pstree(pid_t pid) const
+  {
+    std::map<pid_t, Entry>::const_iterator iterator = entries.find(pid);
+
+    if (iterator == entries.end()) {
+      return Error("No process found at " + stringify(pid));
+    }
+
+    std::list<ProcessTree> children;
+
+    std::map<pid_t, std::set<pid_t> >::const_iterator parent =
+      offspring.find(pid);
+
+    if (parent != offspring.end()) {
+      foreach (pid_t child, parent->second) {
+        Try<ProcessTree> tree = pstree(child);
+        if (tree.isError()) {
+          return Error(tree.error());
+        }
+        children.push_back(tree.get());
+      }
+    }
+
+    return ProcessTree(process(iterator->first, iterator->second), children);
+  }
+
+  size_t size() const
+  {
+    return entries.size();
+  }
+
+private:
+  // What is known about a process. The 'start' time tells a process
+  // apart from an earlier one that had the same pid.
+  struct Entry
+  {
+    Entry() : start(0), parent(0), group(0), zombie(false), generation(0) {}
+
+    unsigned long long start;
+    pid_t parent;
+    pid_t group;
+    Option<pid_t> session;
+    Option<Bytes> rss;
+    Option<Duration> utime;
+    Option<Duration> stime;
+    std::string name;
+    std::string command;
+    bool zombie;
+
+    // The last refresh that found the process.
+    unsigned long generation;
+  };
+
+  static Process process(pid_t pid, const Entry& entry)
+  {
+    return Process(pid,
+                   entry.parent,
+                   entry.group,
+                   entry.session,
+                   entry.rss,
+                   entry.utime,
+                   entry.stime,
+                   entry.command,
+                   entry.zombie);
+  }
+
+  // Replaces (or adds) the process, keeping the children of each
+  // process up to date as it gets reparented.
+  std::map<pid_t, Entry>::iterator update(pid_t pid, const Entry& entry)
+  {
+    std::map<pid_t, Entry>::iterator iterator = entries.find(pid);
+
+    if (iterator != entries.end()) {
+      if (iterator->second.parent != entry.parent) {
+        unlink(pid, iterator->second.parent);
+        link(pid, entry.parent);
+      }
+      iterator->second = entry;
+    } else {
+      iterator = entries.insert(std::make_pair(pid, entry)).first;
+      link(pid, entry.parent);
+    }
+
+    return iterator;
+  }
+
+  // Drops the processes not found by the current refresh.
+  void expunge()
+  {
+    std::map<pid_t, Entry>::iterator iterator = entries.begin();
+    while (iterator != entries.end()) {
+      if (iterator->second.generation != generation) {
+        unlink(iterator->first, iterator->second.parent);
+        entries.erase(iterator++);
+      } else {
+        ++iterator;
+      }
+    }
+  }
+
+  void link(pid_t pid, pid_t parent)
+  {
+    offspring[parent].insert(pid);
+  }
+
+  void unlink(pid_t pid, pid_t parent)
+  {
+    std::map<pid_t, std::set<pid_t> >::iterator iterator =
+      offspring.find(parent);
+
+    if (iterator != offspring.end()) {
+      iterator->second.erase(pid);
+      if (iterator->second.empty()) {
+        offspring.erase(iterator);
+      }
+    }
+  }
+
+#ifdef __linux__
+  // The fields of '/proc/[pid]/stat' (see proc::status()) kept for a
+  // process, with its executable name left in the buffer read into.
+  struct Stat
+  {
+    char state;
+    pid_t parent;
+    pid_t group;
+    pid_t session;
+    long long utime;
+    long long stime;
+    unsigned long long start;
+    long long rss;
+    const char* name;
+    size_t length;
+  };
+
+  // Reads '/proc/[pid]/stat' relative to the open '/proc' directory.
+  // Returns false if the process could not be read or parsed, e.g.,
+  // because it has terminated meanwhile.
+  bool read(pid_t pid, Stat* stat);
+
+  // Returns the command line in '/proc/[pid]/cmdline', with its
+  // arguments separated by spaces, or None if it is empty (e.g., for
+  // kernel threads and zombies) or could not be read.
+  Option<std::string> cmdline(pid_t pid);
+#endif // __linux__
+
+  ProcessTable(const ProcessTable&); // Not copyable.
+  ProcessTable& operator = (const ProcessTable&); // Not assignable.
+
+  std::map<pid_t, Entry> entries;
+
+  // The children of each process.
+  std::map<pid_t, std::set<pid_t> > offspring;
+
+  unsigned long generation;
+
+#ifdef __linux__
+  DIR* directory;
+
+  // Large enough for any '/proc/[pid]/stat'.
+  char buffer[4096];
+#endif // __linux__
+};
+
+
+#ifdef __linux__
+inline Try<Nothing> ProcessTable::refresh()
+{
+  // Page size, used for memory accounting.
+  static const long pageSize = sysconf(_SC_PAGESIZE);
+
+  // Number of clock ticks per second, used for cpu accounting.
+  static const long ticks = sysconf(_SC_CLK_TCK);
+
+  if (directory == NULL) {
+    directory = ::opendir("/proc");
+    if (directory == NULL) {
+      return ErrnoError("Failed to open '/proc'");
+    }
+  } else {
+    ::rewinddir(directory);
+  }
+
+  generation++;
+
+  while (true) {
+    // Reset errno to tell the end of the directory from an error.
+    errno = 0;
+
+    struct dirent* dirent = ::readdir(directory);
+    if (dirent == NULL) {
+      break;
+    }
+
+    // Ignore the files that are not pids, without numify(), which
+    // allocates.
+    const char* name = dirent->d_name;
+    if (*name < '1' || *name > '9') {
+      continue;
+    }
+
+    char* end;
+    long pid = ::strtol(name, &end, 10);
+    if (*end != '\0') {
+      continue;
+    }
+
+    Stat stat;
+    if (!read(pid, &stat)) {
+      continue; // Ignore any processes that disappear.
+    }
+
+    std::map<pid_t, Entry>::iterator iterator = entries.find(pid);
+
+    // Only read the command line of new processes and of those that
+    // have exec'ed since, as told by a different executable name.
+    if (iterator == entries.end() ||
+        iterator->second.start != stat.start ||
+        iterator->second.name.compare(
+            0, std::string::npos, stat.name, stat.length) != 0) {
+      Entry entry;
+      entry.start = stat.start;
+      entry.parent = stat.parent;
+      entry.name.assign(stat.name, stat.length);
+
+      // NOTE: This overwrites the buffer 'stat.name' points into.
+      Option<std::string> command = cmdline(pid);
+      entry.command = command.isSome() ? command.get() : entry.name;
+
+      iterator = update(pid, entry);
+    } else if (iterator->second.parent != stat.parent) {
+      // Reparented, e.g., to init after its parent terminated.
+      unlink(pid, iterator->second.parent);
+      link(pid, stat.parent);
+      iterator->second.parent = stat.parent;
+    }
+
+    Entry& entry = iterator->second;
+    entry.group = stat.group;
+    entry.session = stat.session;
+    entry.zombie = stat.state == 'Z';
+
+    if (pageSize > 0) {
+      entry.rss = Bytes(stat.rss * pageSize);
+    }
+
+    // See os::process() for why the CPU times may be invalid.
+    if (ticks > 0) {
+      Try<Duration> utime = Duration::create(stat.utime / (double) ticks);
+      Try<Duration> stime = Duration::create(stat.stime / (double) ticks);
+
+      entry.utime = utime.isSome() ? utime.get() : Option<Duration>::none();
+      entry.stime = stime.isSome() ? stime.get() : Option<Duration>::none();
+    }
+
+    entry.generation = generation;
+  }
+
+  if (errno != 0) {
+    return ErrnoError("Failed to read '/proc'");
+  }
+
+  expunge();
+
+  if (entries.empty()) {
+    return Error("Failed to determine pids from /proc");
+  }
+
+  return Nothing();
+}
+
+
+inline bool ProcessTable::read(pid_t pid, Stat* stat)
+{
+  char path[32];
+  ::snprintf(path, sizeof(path), "%d/stat", pid);
+
+  int fd = ::openat(::dirfd(directory), path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+
+  ssize_t length = ::read(fd, buffer, sizeof(buffer) - 1);
+  ::close(fd);
+
+  if (length <= 0) {
+    return false;
+  }
+
+  buffer[length] = '\0';
+
+  // The executable name is wrapped in parentheses and may itself
+  // contain spaces and parentheses, hence look for the last ')'.
+  const char* open = ::strchr(buffer, '(');
+  const char* close = ::strrchr(buffer, ')');
+  if (open == NULL || close == NULL || close < open || close[1] != ' ') {
+    return false;
+  }
+
+  const char* cursor = close + 2;
+
+  stat->state = *cursor++;
+
+  // The fields following the state, from 'ppid' up to 'rss'.
+  enum
+  {
+    PPID, PGRP, SESSION, TTY_NR, TPGID, FLAGS, MINFLT, CMINFLT, MAJFLT,
+    CMAJFLT, UTIME, STIME, CUTIME, CSTIME, PRIORITY, NICE, NUM_THREADS,
+    ITREALVALUE, STARTTIME, VSIZE, RSS, FIELDS
+  };
+
+  long long fields[FIELDS];
+  for (int i = 0; i < FIELDS; i++) {
+    char* end;
+    fields[i] = ::strtoll(cursor, &end, 10);
+    if (end == cursor) {
+      return false;
+    }
+    cursor = end;
+  }
+
+  stat->parent = fields[PPID];
+  stat->group = fields[PGRP];
+  stat->session = fields[SESSION];
+  stat->utime = fields[UTIME];
+  stat->stime = fields[STIME];
+  stat->start = fields[STARTTIME];
+  stat->rss = fields[RSS];
+  stat->name = open + 1;
+  stat->length = close - open - 1;
+
+  return true;
+}
+
+
+inline Option<std::string> ProcessTable::cmdline(pid_t pid)
+{
+  char path[32];
+  ::snprintf(path, sizeof(path), "%d/cmdline", pid);
+
+  int fd = ::openat(::dirfd(directory), path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return None();
+  }
+
+  std::string command;
+
+  ssize_t length;
+  while ((length = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    command.append(buffer, length);
+  }
+
+  ::close(fd);
+
+  if (length == -1 || command.empty()) {
+    return None();
+  }
+
+  // Put a space between each command line argument.
+  for (size_t i = 0; i < command.size(); i++) {
+    if (command[i] == '\0') {
+      command[i] = ' ';
+    }
+  }
+
+  return strings::trim(command);
+}
+#else
+inline Try<Nothing> ProcessTable::refresh()
+{
+  const Try<std::list<Process> >& processes = os::processes();
+
+  if (processes.isError()) {
+    return Error(processes.error());
+  }
+
+  generation++;
+
+  foreach (const Process& process, processes.get()) {
+    Entry entry;
+    entry.parent = process.parent;
+    entry.group = process.group;
+    entry.session = process.session;
+    entry.rss = process.rss;
+    entry.utime = process.utime;
+    entry.stime = process.stime;
+    entry.command = process.command;
+    entry.zombie = process.zombie;
+    entry.generation = generation;
+
+    update(process.pid, entry);
+  }
+
+  expunge();
+
+  return Nothing();
+}
+#endif // __linux__
+
+} // namespace os {
+
+#endif // __STOUT_OS_PROCESS_TABLE_HPP__
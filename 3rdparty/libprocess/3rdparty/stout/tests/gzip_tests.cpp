@@ -50,4 +50,72 @@ TEST(GzipTest, CompressDecompressString)
   ASSERT_SOME(decompressed);
   ASSERT_EQ(s, decompressed.get());
 }
+
+
+TEST(GzipTest, Decompressor)
+{
+  // Test with a 1MB random string, decompressed in small pieces.
+  string s = "";
+  while (s.length() < (1024 * 1024)) {
+    s.append(1, ' ' + (rand() % ('~' - ' ')));
+  }
+
+  Try<string> compressed = gzip::compress(s);
+  ASSERT_SOME(compressed);
+
+  gzip::Decompressor decompressor;
+  string decompressed = "";
+  for (size_t i = 0; i < compressed.get().length(); i += 1000) {
+    EXPECT_FALSE(decompressor.finished());
+
+    Try<string> piece = decompressor.decompress(
+        compressed.get().substr(i, 1000));
+    ASSERT_SOME(piece);
+    decompressed += piece.get();
+  }
+
+  EXPECT_TRUE(decompressor.finished());
+  ASSERT_EQ(s, decompressed);
+
+  // Data past the end of the stream that does not start another
+  // stream gets ignored, like gunzip does.
+  EXPECT_SOME_EQ("", decompressor.decompress("garbage"));
+  EXPECT_TRUE(decompressor.finished());
+
+  // A corrupt stream is rejected.
+  gzip::Decompressor corrupt;
+  EXPECT_ERROR(corrupt.decompress("garbage"));
+}
+
+
+TEST(GzipTest, DecompressorMultipleMembers)
+{
+  Try<string> compressed1 = gzip::compress("hello ");
+  ASSERT_SOME(compressed1);
+
+  Try<string> compressed2 = gzip::compress("world");
+  ASSERT_SOME(compressed2);
+
+  const string compressed =
+    compressed1.get() + compressed2.get() + string(512, '\0');
+
+  // Decompress one byte at a time so that the second member starts
+  // in a piece of its own, and its magic is split across pieces.
+  gzip::Decompressor decompressor;
+  string decompressed = "";
+  for (size_t i = 0; i < compressed.length(); i++) {
+    Try<string> piece = decompressor.decompress(compressed.substr(i, 1));
+    ASSERT_SOME(piece);
+    decompressed += piece.get();
+  }
+
+  EXPECT_TRUE(decompressor.finished());
+  EXPECT_EQ("hello world", decompressed);
+
+  // A truncated second member is not finished.
+  gzip::Decompressor truncated;
+  EXPECT_SOME_EQ("hello ", truncated.decompress(
+      compressed1.get() + compressed2.get().substr(0, 10)));
+  EXPECT_FALSE(truncated.finished());
+}
 #endif // HAVE_LIBZ
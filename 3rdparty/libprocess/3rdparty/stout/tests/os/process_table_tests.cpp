@@ -0,0 +1,151 @@
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <gmock/gmock.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include <stout/gtest.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
+
+#include <stout/os/process_table.hpp>
+
+using os::Exec;
+using os::Fork;
+using os::Process;
+using os::ProcessTable;
+using os::ProcessTree;
+
+using std::set;
+
+
+TEST(ProcessTableTest, refresh)
+{
+  ProcessTable table;
+
+  EXPECT_EQ(0u, table.size());
+  EXPECT_NONE(table.process(getpid()));
+
+  ASSERT_SOME(table.refresh());
+  EXPECT_LT(2u, table.size());
+
+  Option<Process> process = table.process(getpid());
+
+  ASSERT_SOME(process);
+  EXPECT_EQ(getpid(), process.get().pid);
+  EXPECT_EQ(getppid(), process.get().parent);
+  EXPECT_EQ(getpgid(0), process.get().group);
+  ASSERT_SOME(process.get().session);
+  EXPECT_EQ(getsid(getpid()), process.get().session.get());
+
+  ASSERT_SOME(process.get().rss);
+  EXPECT_GT(process.get().rss.get(), 0);
+
+  // NOTE: On Linux /proc is a bit slow to update the CPU times,
+  // hence we allow 0 in this test.
+  ASSERT_SOME(process.get().utime);
+  EXPECT_GE(process.get().utime.get(), Nanoseconds(0));
+  ASSERT_SOME(process.get().stime);
+  EXPECT_GE(process.get().stime.get(), Nanoseconds(0));
+
+  EXPECT_FALSE(process.get().command.empty());
+  EXPECT_FALSE(process.get().zombie);
+
+  // The table agrees with os::process().
+  const Result<Process>& expected = os::process(getpid());
+
+  ASSERT_SOME(expected);
+  EXPECT_EQ(expected.get().parent, process.get().parent);
+  EXPECT_EQ(expected.get().group, process.get().group);
+  EXPECT_EQ(expected.get().session, process.get().session);
+
+  // Refreshing again keeps the processes that are still running.
+  ASSERT_SOME(table.refresh());
+  EXPECT_SOME(table.process(getpid()));
+  EXPECT_SOME(table.process(1));
+}
+
+
+TEST(ProcessTableTest, pstree)
+{
+  ProcessTable table;
+
+  ASSERT_SOME(table.refresh());
+
+  Try<ProcessTree> tree = table.pstree(getpid());
+
+  ASSERT_SOME(tree);
+  EXPECT_EQ(0u, tree.get().children.size()) << stringify(tree.get());
+  EXPECT_EQ(0u, table.children(getpid()).size());
+
+  tree =
+    Fork(None(),                   // Child.
+         Fork(Exec("sleep 10")),   // Grandchild.
+         Exec("sleep 10"))();
+
+  ASSERT_SOME(tree);
+  ASSERT_EQ(1u, tree.get().children.size());
+
+  pid_t child = tree.get().process.pid;
+  pid_t grandchild = tree.get().children.front().process.pid;
+
+  // The table only learns about the new processes when refreshed.
+  EXPECT_NONE(table.process(child));
+
+  ASSERT_SOME(table.refresh());
+
+  EXPECT_SOME(table.process(child));
+  EXPECT_SOME(table.process(grandchild));
+
+  set<pid_t> children = table.children(getpid(), false);
+
+  EXPECT_EQ(1u, children.size());
+  EXPECT_EQ(1u, children.count(child));
+
+  // Depending on whether or not the shell has fork/exec'ed in each
+  // above 'Exec', we could have 2 or 4 children (see OsTest.children).
+  children = table.children(getpid());
+
+  EXPECT_LE(2u, children.size());
+  EXPECT_GE(4u, children.size());
+  EXPECT_EQ(1u, children.count(child));
+  EXPECT_EQ(1u, children.count(grandchild));
+
+  tree = table.pstree(child);
+
+  ASSERT_SOME(tree);
+  EXPECT_EQ(child, tree.get().process.pid);
+  ASSERT_LE(1u, tree.get().children.size());
+  ASSERT_GE(2u, tree.get().children.size());
+  EXPECT_TRUE(tree.get().contains(grandchild));
+
+  // Cleanup by killing the descendant processes.
+  EXPECT_EQ(0, kill(grandchild, SIGKILL));
+  EXPECT_EQ(0, kill(child, SIGKILL));
+
+  // We have to reap the child for running the tests in repetition.
+  ASSERT_EQ(child, waitpid(child, NULL, 0));
+
+  // The processes that terminated get dropped. The grandchild may
+  // linger a little while as a zombie (of init).
+  Duration waited = Duration::zero();
+  do {
+    ASSERT_SOME(table.refresh());
+    if (table.process(grandchild).isNone()) {
+      break;
+    }
+    os::sleep(Milliseconds(10));
+    waited += Milliseconds(10);
+  } while (waited < Seconds(5));
+
+  EXPECT_NONE(table.process(child));
+  EXPECT_NONE(table.process(grandchild));
+  EXPECT_EQ(0u, table.children(getpid()).size());
+  EXPECT_ERROR(table.pstree(child));
+}
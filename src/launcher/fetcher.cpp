@@ -16,31 +16,96 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdio.h>
+
+#include <curl/curl.h>
+
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <mesos/mesos.hpp>
 
+#include <stout/bytes.hpp>
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
 #include <stout/net.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
 #include <stout/strings.hpp>
 
 #include "hdfs/hdfs.hpp"
 
+#include "slave/extractor.hpp"
+#include "slave/fetcher_cache.hpp"
+
 using namespace mesos;
 
+using mesos::internal::slave::Extractor;
+using mesos::internal::slave::FetcherCache;
+
 using std::string;
+using std::vector;
+
+// Downloads are logged each time this much more has arrived.
+static const Bytes PROGRESS_INTERVAL = Megabytes(64);
+
+// Maximum number of URIs fetched concurrently.
+static const size_t MAX_FETCH_THREADS = 8;
 
 // Try to extract filename into directory. If filename is recognized as an
 // archive it will be extracted and true returned; if not recognized then false
 // will be returned. An Error is returned if the extraction command fails.
 Try<bool> extract(const string& filename, const string& directory)
 {
+  // Extract tar and gzip'ed tar archives in process.
+  bool compressed;
+  if (Extractor::extractable(filename, &compressed)) {
+    Try<int> fd = os::open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd.isError()) {
+      return Error("Failed to open: " + fd.error());
+    }
+
+    Extractor extractor(directory, compressed);
+
+    char buffer[BUFSIZ];
+    ssize_t length;
+    while ((length = ::read(fd.get(), buffer, sizeof(buffer))) != 0) {
+      if (length < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ErrnoError error("Failed to read");
+        os::close(fd.get());
+        return error;
+      }
+
+      Try<Nothing> write = extractor.write(buffer, length);
+      if (write.isError()) {
+        os::close(fd.get());
+        return Error(write.error());
+      }
+    }
+
+    os::close(fd.get());
+
+    Try<Nothing> finish = extractor.finish();
+    if (finish.isError()) {
+      return Error(finish.error());
+    }
+
+    LOG(INFO) << "Extracted resource '" << filename
+              << "' into '" << directory << "'";
+
+    return true;
+  }
+
   string command;
-  // Extract any .tgz, tar.gz, tar.bz2 or zip files.
-  if (strings::endsWith(filename, ".tgz") ||
-      strings::endsWith(filename, ".tar.gz") ||
-      strings::endsWith(filename, ".tbz2") ||
+  // Extract any .tar.bz2, .tar.xz or zip files.
+  if (strings::endsWith(filename, ".tbz2") ||
       strings::endsWith(filename, ".tar.bz2") ||
       strings::endsWith(filename, ".txz") ||
       strings::endsWith(filename, ".tar.xz")) {
@@ -65,11 +130,135 @@ Try<bool> extract(const string& filename, const string& directory)
 }
 
 
-// Fetch URI into directory.
+// Where a download goes: the file and, possibly, an extractor.
+struct Sink
+{
+  CURL* curl;
+  string url;
+  FILE* file;
+  Extractor* extractor;
+  Option<Error> error;
+  Bytes downloaded;
+  Stopwatch stopwatch;
+};
+
+
+size_t receive(char* data, size_t size, size_t nmemb, void* userdata)
+{
+  Sink* sink = static_cast<Sink*>(userdata);
+  const size_t length = size * nmemb;
+
+  if (fwrite(data, 1, length, sink->file) != length) {
+    sink->error = ErrnoError("Failed to write");
+    return 0; // Aborts the transfer.
+  }
+
+  // Only extract successful responses, not error pages or the
+  // bodies of redirects.
+  long code;
+  curl_easy_getinfo(sink->curl, CURLINFO_RESPONSE_CODE, &code);
+
+  if (sink->extractor != NULL && code >= 200 && code < 300) {
+    Try<Nothing> write = sink->extractor->write(data, length);
+    if (write.isError()) {
+      sink->error = Error("Failed to extract: " + write.error());
+      return 0;
+    }
+  }
+
+  const Bytes before = sink->downloaded;
+  sink->downloaded += Bytes(length);
+
+  if (before.bytes() / PROGRESS_INTERVAL.bytes() !=
+      sink->downloaded.bytes() / PROGRESS_INTERVAL.bytes()) {
+    LOG(INFO) << "Downloaded " << sink->downloaded << " of '" << sink->url
+              << "' in " << sink->stopwatch.elapsed();
+  }
+
+  return length;
+}
+
+
+// Downloads the HTTP or FTP URL to path like net::download, logging
+// the progress. If an extractor is given the archive is also
+// extracted as it arrives, rather than once it has been written out.
+Try<int> download(const string& url, const string& path, Extractor* extractor)
+{
+  Sink sink;
+  sink.url = url;
+  sink.extractor = extractor;
+  sink.file = fopen(path.c_str(), "w");
+
+  if (sink.file == NULL) {
+    return ErrnoError("Failed to open '" + path + "'");
+  }
+
+  sink.curl = curl_easy_init();
+  if (sink.curl == NULL) {
+    fclose(sink.file);
+    return Error("Failed to initialize libcurl");
+  }
+
+  curl_easy_setopt(sink.curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(sink.curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(sink.curl, CURLOPT_WRITEFUNCTION, &receive);
+  curl_easy_setopt(sink.curl, CURLOPT_WRITEDATA, &sink);
+
+  sink.stopwatch.start();
+
+  CURLcode curlErrorCode = curl_easy_perform(sink.curl);
+
+  long code;
+  curl_easy_getinfo(sink.curl, CURLINFO_RESPONSE_CODE, &code);
+  curl_easy_cleanup(sink.curl);
+
+  if (fclose(sink.file) != 0 && sink.error.isNone()) {
+    sink.error = ErrnoError("Failed to close '" + path + "'");
+  }
+
+  if (sink.error.isSome()) {
+    return sink.error.get();
+  } else if (curlErrorCode != 0) {
+    return Error(curl_easy_strerror(curlErrorCode));
+  }
+
+  return Try<int>::some(code);
+}
+
+
+// Fetch URI to path through the cache. Returns false if the URI
+// should be fetched without the cache instead.
+bool cached(FetcherCache* cache, const string& uri, const string& path)
+{
+  if (cache == NULL || !FetcherCache::cacheable(uri)) {
+    return false;
+  }
+
+  Try<Nothing> fetch = cache->fetch(uri, path);
+  if (fetch.isError()) {
+    LOG(WARNING) << "Failed to fetch '" << uri << "' through the cache, "
+                 << "fetching it directly instead: " << fetch.error();
+    os::rm(path);
+    return false;
+  }
+
+  return true;
+}
+
+
+// Fetch URI into directory, through the cache if there is one. If
+// 'extract' is true and the URI is an archive that gets downloaded
+// directly, it is extracted into the directory while it downloads,
+// in which case 'extracted' is set.
 Try<string> fetch(
     const string& uri,
-    const string& directory)
+    const string& directory,
+    FetcherCache* cache,
+    bool extract,
+    bool* extracted)
 {
+  *extracted = false;
+
   LOG(INFO) << "Fetching URI '" << uri << "'";
 
   // Some checks to make sure using the URI value in shell commands
@@ -117,8 +306,33 @@ Try<string> fetch(
     }
 
     path =  path::join(directory, path.substr(path.find_last_of("/") + 1));
+
+    if (cached(cache, uri, path)) {
+      return path;
+    }
+
+    bool compressed;
+    Extractor* extractor = NULL;
+    if (extract && Extractor::extractable(path, &compressed)) {
+      extractor = new Extractor(directory, compressed);
+    }
+
     LOG(INFO) << "Downloading '" << uri << "' to '" << path << "'";
-    Try<int> code = net::download(uri, path);
+    Try<int> code = download(uri, path, extractor);
+
+    if (code.isSome() && code.get() == 200 && extractor != NULL) {
+      Try<Nothing> finish = extractor->finish();
+      if (finish.isError()) {
+        code = Error("Failed to extract: " + finish.error());
+      } else {
+        LOG(INFO) << "Extracted '" << uri << "' into '" << directory
+                  << "' while downloading";
+        *extracted = true;
+      }
+    }
+
+    delete extractor;
+
     if (code.isError()) {
       LOG(ERROR) << "Error downloading resource: " << code.error().c_str();
       return Error("Fetch of URI failed (" + code.error() + ")");
@@ -155,6 +369,11 @@ Try<string> fetch(
 
     // Copy the resource to the directory.
     string path = path::join(directory, base.get());
+
+    if (cached(cache, local, path)) {
+      return path;
+    }
+
     std::ostringstream command;
     command << "cp '" << local << "' '" << path << "'";
     LOG(INFO) << "Copying resource from '" << local
@@ -172,6 +391,128 @@ Try<string> fetch(
 }
 
 
+// Fetching a URI in a thread of its own.
+struct Fetch
+{
+  CommandInfo::URI uri;
+  string directory;
+  Option<string> cacheDirectory;
+  Bytes cacheSize;
+
+  Option<Error> error;
+  Bytes size;
+  Duration elapsed;
+};
+
+
+// Returns the throughput, in bytes per second.
+double throughput(const Bytes& size, const Duration& elapsed)
+{
+  return elapsed > Duration::zero() ? size.bytes() / elapsed.secs() : 0.0;
+}
+
+
+// Fetch the URI to a local file, then chmod it if it's executable,
+// else assume it's an archive that should be extracted.
+void run(Fetch* fetch_)
+{
+  const CommandInfo::URI& uri = fetch_->uri;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // Each fetch gets its own handle on the cache, whose state is all
+  // on disk (see FetcherCache).
+  FetcherCache* cache = NULL;
+  if (fetch_->cacheDirectory.isSome()) {
+    cache = new FetcherCache(fetch_->cacheDirectory.get(), fetch_->cacheSize);
+  }
+
+  bool extracted;
+  Try<string> fetched = fetch(
+      uri.value(),
+      fetch_->directory,
+      cache,
+      !uri.executable(),
+      &extracted);
+
+  delete cache;
+
+  if (fetched.isError()) {
+    fetch_->error = Error("Failed to fetch: " + uri.value());
+    return;
+  }
+
+  if (uri.executable()) {
+    bool chmodded = os::chmod(
+        fetched.get(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    if (!chmodded) {
+      fetch_->error = Error("Failed to chmod: " + fetched.get());
+      return;
+    }
+  } else if (!extracted) {
+    //TODO(idownes): Consider removing the archive once extracted.
+    // Try to extract the file if it's recognized as an archive.
+    Try<bool> extracted = extract(fetched.get(), fetch_->directory);
+    if (extracted.isError()) {
+      fetch_->error = Error(
+          "Failed to extract " + fetched.get() + ":" + extracted.error());
+      return;
+    }
+  }
+
+  struct stat s;
+  if (::stat(fetched.get().c_str(), &s) == 0) {
+    fetch_->size = Bytes(s.st_size);
+  }
+
+  fetch_->elapsed = stopwatch.elapsed();
+
+  LOG(INFO) << "Fetched '" << uri.value() << "' (" << fetch_->size
+            << ") in " << fetch_->elapsed << " at "
+            << throughput(fetch_->size, fetch_->elapsed) / Megabytes(1).bytes()
+            << " MB/s";
+}
+
+
+// The fetches that a few threads take turns on. The fetches of URIs
+// with the same basename are fetched to the same path, so they are
+// grouped and fetched one after another, in order, the later
+// overwriting the earlier.
+struct Fetches
+{
+  vector<vector<Fetch*> >* groups;
+  size_t next; // The next group to start.
+  pthread_mutex_t mutex;
+};
+
+
+// Runs the groups of fetches that have not been started yet, one at
+// a time.
+void* work(void* arg)
+{
+  Fetches* fetches = static_cast<Fetches*>(arg);
+
+  while (true) {
+    pthread_mutex_lock(&fetches->mutex);
+    const size_t index = fetches->next++;
+    pthread_mutex_unlock(&fetches->mutex);
+
+    if (index >= fetches->groups->size()) {
+      return NULL;
+    }
+
+    foreach (Fetch* fetch, (*fetches->groups)[index]) {
+      run(fetch);
+
+      if (fetch->error.isSome()) {
+        break; // We exit on the first error anyway.
+      }
+    }
+  }
+}
+
+
 int main(int argc, char* argv[])
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
@@ -203,38 +544,110 @@ int main(int argc, char* argv[])
     ? Option<std::string>(os::getenv("MESOS_USER")) // Explicit so it compiles.
     : None();
 
-  // Fetch each URI to a local file, chmod, then chown if a user is provided.
-  foreach (const CommandInfo::URI& uri, commandInfo.uris()) {
-    // Fetch the URI to a local file.
-    Try<string> fetched = fetch(uri.value(), directory);
-    if (fetched.isError()) {
-      EXIT(1) << "Failed to fetch: " << uri.value();
-    }
-
-    // Chmod the fetched URI if it's executable, else assume it's an archive
-    // that should be extracted.
-    if (uri.executable()) {
-      bool chmodded = os::chmod(
-          fetched.get(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
-      if (!chmodded) {
-        EXIT(1) << "Failed to chmod: " << fetched.get();
-      }
-    } else {
-      //TODO(idownes): Consider removing the archive once extracted.
-      // Try to extract the file if it's recognized as an archive.
-      Try<bool> extracted = extract(fetched.get(), directory);
-      if (extracted.isError()) {
-        EXIT(1) << "Failed to extract "
-                << fetched.get() << ":" << extracted.error();
-      }
+  Option<std::string> cacheDirectory = None();
+  Bytes cacheSize;
+  if (os::hasenv("MESOS_FETCHER_CACHE_DIR")) {
+    Try<Bytes> size = Bytes::parse(os::getenv("MESOS_FETCHER_CACHE_SIZE"));
+    if (size.isError()) {
+      EXIT(1) << "Invalid MESOS_FETCHER_CACHE_SIZE: " << size.error();
     }
 
-    // Recursively chown the directory if a user is provided.
-    if (user.isSome()) {
-      Try<Nothing> chowned = os::chown(user.get(), directory);
-      if (chowned.isError()) {
-        EXIT(1) << "Failed to chown " << directory << ": " << chowned.error();
-      }
+    cacheDirectory = os::getenv("MESOS_FETCHER_CACHE_DIR");
+    cacheSize = size.get();
+  }
+
+  // libcurl must be initialized before any threads use it.
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // Fetch the URIs concurrently, using up to MAX_FETCH_THREADS threads.
+  vector<Fetch> fetches(commandInfo.uris_size());
+
+  for (int i = 0; i < commandInfo.uris_size(); i++) {
+    fetches[i].uri = commandInfo.uris(i);
+    fetches[i].directory = directory;
+    fetches[i].cacheDirectory = cacheDirectory;
+    fetches[i].cacheSize = cacheSize;
+  }
+
+  // Each URI is fetched into the directory under its basename.
+  vector<vector<Fetch*> > groups;
+  hashmap<string, size_t> basenames; // Group of each basename.
+
+  foreach (Fetch& fetch, fetches) {
+    Try<string> base = os::basename(fetch.uri.value());
+
+    if (base.isSome() && basenames.contains(base.get())) {
+      LOG(WARNING) << "Fetching '" << fetch.uri.value() << "' after the"
+                   << " other URIs that are also fetched to '"
+                   << base.get() << "'";
+
+      groups[basenames[base.get()]].push_back(&fetch);
+      continue;
+    }
+
+    if (base.isSome()) {
+      basenames[base.get()] = groups.size();
+    }
+
+    groups.push_back(vector<Fetch*>(1, &fetch));
+  }
+
+  Fetches queue;
+  queue.groups = &groups;
+  queue.next = 0;
+  pthread_mutex_init(&queue.mutex, NULL);
+
+  vector<pthread_t> threads(std::min(groups.size(), MAX_FETCH_THREADS));
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    if (pthread_create(&threads[i], NULL, &work, &queue) != 0) {
+      EXIT(1) << "Failed to create a thread to fetch";
+    }
+  }
+
+  foreach (pthread_t thread, threads) {
+    pthread_join(thread, NULL);
+  }
+
+  pthread_mutex_destroy(&queue.mutex);
+
+  Bytes size;
+  foreach (const Fetch& fetch, fetches) {
+    size += fetch.size;
+  }
+
+  stopwatch.stop();
+
+  foreach (const Fetch& fetch, fetches) {
+    if (fetch.error.isSome()) {
+      EXIT(1) << fetch.error.get().message;
+    }
+  }
+
+  // Recursively chown the directory if a user is provided.
+  if (user.isSome()) {
+    Try<Nothing> chowned = os::chown(user.get(), directory);
+    if (chowned.isError()) {
+      EXIT(1) << "Failed to chown " << directory << ": " << chowned.error();
+    }
+  }
+
+  // Report how much was fetched, and how fast, to the slave.
+  if (os::hasenv("MESOS_FETCHER_STATISTICS")) {
+    const Duration elapsed = stopwatch.elapsed();
+
+    Try<Nothing> write = os::write(
+        os::getenv("MESOS_FETCHER_STATISTICS"),
+        "bytes=" + stringify(size.bytes()) + "\n" +
+        "secs=" + stringify(elapsed.secs()) + "\n" +
+        "bytes_per_sec=" + stringify(throughput(size, elapsed)) + "\n");
+
+    if (write.isError()) {
+      LOG(WARNING) << "Failed to write the fetcher statistics: "
+                   << write.error();
     }
   }
 
@@ -0,0 +1,380 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include <stout/abort.hpp>
+#include <stout/exit.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/protobuf.hpp>
+#include <stout/result.hpp>
+#include <stout/try.hpp>
+#include <stout/unreachable.hpp>
+
+#include "messages/messages.hpp"
+
+using namespace mesos;
+using namespace mesos::internal;
+
+using std::string;
+
+// The launcher helper forks the processes of containers on behalf of
+// the slave (see slave/containerizer/launcher_helper.hpp), which is
+// much cheaper from this small process than from the slave. It reads
+// LauncherHelperRequests from the socket passed as its only argument
+// and writes LauncherHelperResponses to it, until the slave closes
+// the socket. The processes still waiting to run their command then
+// exit as well, the others keep running.
+
+
+// The self-pipe that SIGCHLD gets turned into, so that terminated
+// processes can be reaped in between requests.
+static int sigchld[2];
+
+
+static void handler(int signal)
+{
+  int saved = errno;
+  char c = 0;
+  while (::write(sigchld[1], &c, sizeof(c)) == -1 && errno == EINTR);
+  errno = saved;
+}
+
+
+// Runs the command of the request in the forked child. This process
+// has a single thread, unlike the slave, so the child is free to do
+// more than async-signal-safe calls before exec'ing.
+static void run(const LauncherHelperRequest& request, int pipeRead)
+{
+  // Put the child in a new session (and process group) of its own,
+  // like PosixLauncher::fork() does, so that the launcher can track
+  // and kill its processes.
+  if (setsid() == -1) {
+    ABORT("Failed to put child in a new session");
+  }
+
+  if (request.wait()) {
+    // Do a blocking read on the pipe until we are told to continue.
+    int buf;
+    ssize_t len;
+    while ((len = read(pipeRead, &buf, sizeof(buf))) == -1 && errno == EINTR);
+
+    if (len != sizeof(buf)) {
+      _exit(1); // Not let run, e.g., the slave or the helper exited.
+    }
+    os::close(pipeRead);
+  }
+
+  // Chown the work directory if a user is provided.
+  if (request.has_user()) {
+    Try<Nothing> chown = os::chown(request.user(), request.directory());
+    if (chown.isError()) {
+      ABORT("Failed to chown work directory");
+    }
+  }
+
+  // Change user if provided.
+  if (request.has_user() && !os::su(request.user())) {
+    ABORT("Failed to change user");
+  }
+
+  // Enter working directory.
+  if (request.has_directory() && os::chdir(request.directory()) < 0) {
+    ABORT("Failed to chdir into work directory");
+  }
+
+  foreach (const Environment::Variable& variable,
+           request.environment().variables()) {
+    os::setenv(variable.name(), variable.value());
+  }
+
+  // Redirect output to files in working dir if required. We append
+  // because others (e.g., mesos-fetcher) may have already logged to
+  // the files.
+  if (request.redirect()) {
+    if (freopen("stdout", "a", stdout) == NULL) {
+      ABORT("freopen failed");
+    }
+    if (freopen("stderr", "a", stderr) == NULL) {
+      ABORT("freopen failed");
+    }
+  }
+
+  // Execute the command (via '/bin/sh -c command').
+  execl("/bin/sh", "sh", "-c", request.command().c_str(), (char*) NULL);
+
+  ABORT("Failed to execute command");
+}
+
+
+// Forks a process for the request and returns its pid. The write end
+// of the pipe that the process waits on, if any, is stored in
+// 'waiting'.
+static Try<pid_t> fork(
+    const LauncherHelperRequest& request,
+    int fd,
+    hashmap<pid_t, int>* waiting)
+{
+  if (!request.has_command()) {
+    return Error("Missing command");
+  }
+
+  int pipes[2];
+  if (request.wait() && ::pipe(pipes) == -1) {
+    return ErrnoError("Failed to create pipe");
+  }
+
+  pid_t pid = ::fork();
+
+  if (pid == -1) {
+    if (request.wait()) {
+      os::close(pipes[0]);
+      os::close(pipes[1]);
+    }
+    return ErrnoError("Failed to fork");
+  }
+
+  if (pid == 0) {
+    // In child. Stop sharing the helper's file descriptors and signal
+    // handling. In particular, the pipes of the other waiting
+    // processes must not be held open, or they would keep waiting
+    // should the helper exit.
+    os::close(fd);
+    os::close(sigchld[0]);
+    os::close(sigchld[1]);
+    foreachvalue (int pipeWrite, *waiting) {
+      os::close(pipeWrite);
+    }
+    signal(SIGCHLD, SIG_DFL);
+
+    if (request.wait()) {
+      os::close(pipes[1]);
+    }
+
+    run(request, request.wait() ? pipes[0] : -1);
+
+    UNREACHABLE();
+  }
+
+  if (request.wait()) {
+    os::close(pipes[0]);
+    os::cloexec(pipes[1]);
+    waiting->put(pid, pipes[1]);
+  }
+
+  return pid;
+}
+
+
+// Lets the process run its command.
+static void exec(pid_t pid, hashmap<pid_t, int>* waiting)
+{
+  Option<int> pipeWrite = waiting->get(pid);
+  if (pipeWrite.isNone()) {
+    return; // Terminated already, an EXITED response is on its way.
+  }
+
+  int buf = 0;
+  while (::write(pipeWrite.get(), &buf, sizeof(buf)) == -1 && errno == EINTR);
+
+  os::close(pipeWrite.get());
+  waiting->erase(pid);
+}
+
+
+// Reads exactly 'size' bytes, or returns None on end-of-file.
+// NOTE: We can't use os::read() (nor protobuf::read()) since it
+// seeks, which sockets don't support.
+static Result<string> read(int fd, size_t size)
+{
+  string data(size, '\0');
+  size_t offset = 0;
+
+  while (offset < size) {
+    ssize_t length = ::read(fd, &data[offset], size - offset);
+
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ErrnoError();
+    } else if (length == 0) {
+      return None();
+    }
+
+    offset += length;
+  }
+
+  return data;
+}
+
+
+// Reads the next request, or returns None on end-of-file.
+static Result<LauncherHelperRequest> receive(int fd)
+{
+  uint32_t size;
+  Result<string> result = read(fd, sizeof(size));
+
+  if (result.isNone()) {
+    return None();
+  } else if (result.isError()) {
+    return Error("Failed to read size: " + result.error());
+  }
+
+  memcpy((void*) &size, (void*) result.get().data(), sizeof(size));
+
+  result = read(fd, size);
+
+  if (!result.isSome()) {
+    return Error("Failed to read request");
+  }
+
+  LauncherHelperRequest request;
+  if (!request.ParseFromString(result.get())) {
+    return Error("Failed to deserialize request");
+  }
+
+  return request;
+}
+
+
+static void send(int fd, const LauncherHelperResponse& response)
+{
+  Try<Nothing> write = ::protobuf::write(fd, response);
+  if (write.isError()) {
+    EXIT(1) << "Failed to send response: " << write.error();
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  if (argc != 2) {
+    EXIT(1) << "Usage: " << argv[0] << " <socket>";
+  }
+
+  Try<int> fd = numify<int>(argv[1]);
+  if (fd.isError()) {
+    EXIT(1) << "Invalid socket '" << argv[1] << "': " << fd.error();
+  }
+
+  os::cloexec(fd.get());
+
+  if (::pipe(sigchld) == -1) {
+    EXIT(1) << "Failed to create pipe: " << strerror(errno);
+  }
+
+  os::cloexec(sigchld[0]);
+  os::cloexec(sigchld[1]);
+  os::nonblock(sigchld[0]);
+  os::nonblock(sigchld[1]);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handler;
+  action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigemptyset(&action.sa_mask);
+
+  if (sigaction(SIGCHLD, &action, NULL) == -1) {
+    EXIT(1) << "Failed to handle SIGCHLD: " << strerror(errno);
+  }
+
+  // The write ends of the pipes that forked processes wait on.
+  hashmap<pid_t, int> waiting;
+
+  while (true) {
+    struct pollfd fds[2];
+    fds[0].fd = fd.get();
+    fds[0].events = POLLIN;
+    fds[1].fd = sigchld[0];
+    fds[1].events = POLLIN;
+
+    if (::poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      EXIT(1) << "Failed to poll: " << strerror(errno);
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char buf[64];
+      while (::read(sigchld[0], buf, sizeof(buf)) > 0);
+
+      pid_t pid;
+      int status;
+      while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+        if (waiting.contains(pid)) {
+          os::close(waiting[pid]);
+          waiting.erase(pid);
+        }
+
+        LauncherHelperResponse response;
+        response.set_type(LauncherHelperResponse::EXITED);
+        response.set_pid(pid);
+        response.set_status(status);
+        send(fd.get(), response);
+      }
+    }
+
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      Result<LauncherHelperRequest> request = receive(fd.get());
+
+      if (request.isNone()) {
+        break; // The slave is gone.
+      } else if (request.isError()) {
+        EXIT(1) << request.error();
+      }
+
+      if (request.get().type() == LauncherHelperRequest::FORK) {
+        LauncherHelperResponse response;
+        response.set_type(LauncherHelperResponse::FORKED);
+
+        Try<pid_t> pid = fork(request.get(), fd.get(), &waiting);
+        if (pid.isError()) {
+          response.set_error(pid.error());
+        } else {
+          response.set_pid(pid.get());
+        }
+
+        send(fd.get(), response);
+      } else if (request.get().type() == LauncherHelperRequest::EXEC) {
+        exec(request.get().pid(), &waiting);
+      }
+    }
+  }
+
+  // Processes still waiting to run their command exit once they see
+  // their pipe closed, along with the helper.
+  return 0;
+}
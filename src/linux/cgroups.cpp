@@ -1862,6 +1862,130 @@ Future<bool> destroy(
 }
 
 
+namespace internal {
+
+// The process used to destroy a number of cgroups, a bounded number
+// of them at a time.
+class BatchDestroyer : public Process<BatchDestroyer>
+{
+public:
+  BatchDestroyer(const string& _hierarchy,
+                 const vector<string>& _cgroups,
+                 size_t _parallelism,
+                 const Duration& _interval)
+    : hierarchy(_hierarchy),
+      pending(_cgroups.begin(), _cgroups.end()),
+      parallelism(_parallelism),
+      interval(_interval) {}
+
+  virtual ~BatchDestroyer() {}
+
+  // Return a future indicating the state of the destroyer.
+  Future<Nothing> future() { return promise.future(); }
+
+protected:
+  virtual void initialize()
+  {
+    // Stop when no one cares.
+    promise.future().onDiscard(lambda::bind(
+          static_cast<void(*)(const UPID&, bool)>(terminate), self(), true));
+
+    CHECK(parallelism > 0);
+
+    while (destroying.size() < parallelism && !pending.empty()) {
+      next();
+    }
+
+    if (destroying.empty()) {
+      promise.set(Nothing());
+      terminate(self());
+    }
+  }
+
+  virtual void finalize()
+  {
+    // Cancel the operation if the user discards the future.
+    if (promise.future().hasDiscard()) {
+      foreachvalue (Future<bool> future, destroying) {
+        future.discard();
+      }
+
+      promise.discard();
+    }
+  }
+
+private:
+  void next()
+  {
+    const string cgroup = pending.front();
+    pending.pop_front();
+
+    Future<bool> future = destroy(hierarchy, cgroup, interval);
+    destroying[cgroup] = future;
+
+    future.onAny(defer(self(), &BatchDestroyer::destroyed, cgroup, lambda::_1));
+  }
+
+  void destroyed(const string& cgroup, const Future<bool>& future)
+  {
+    destroying.erase(cgroup);
+
+    if (!future.isReady()) {
+      errors.push_back(
+          "'" + cgroup + "': " +
+          (future.isFailed() ? future.failure() : "discarded"));
+    }
+
+    if (!pending.empty()) {
+      next();
+    } else if (destroying.empty()) {
+      if (errors.empty()) {
+        promise.set(Nothing());
+      } else {
+        promise.fail(
+            "Failed to destroy cgroups " + strings::join(", ", errors));
+      }
+      terminate(self());
+    }
+  }
+
+  const string hierarchy;
+  list<string> pending;
+  const size_t parallelism;
+  const Duration interval;
+  Promise<Nothing> promise;
+
+  // The cgroups being destroyed.
+  map<string, Future<bool> > destroying;
+
+  vector<string> errors;
+};
+
+} // namespace internal {
+
+
+Future<Nothing> destroy(
+    const string& hierarchy,
+    const vector<string>& cgroups,
+    size_t parallelism,
+    const Duration& interval)
+{
+  if (interval < Seconds(0)) {
+    return Failure("Interval should be non-negative");
+  }
+
+  if (parallelism == 0) {
+    return Failure("Parallelism should be positive");
+  }
+
+  internal::BatchDestroyer* destroyer =
+    new internal::BatchDestroyer(hierarchy, cgroups, parallelism, interval);
+  Future<Nothing> future = destroyer->future();
+  spawn(destroyer, true);
+  return future;
+}
+
+
 // Forward declaration.
 Future<bool> _cleanup(const string& hierarchy);
 
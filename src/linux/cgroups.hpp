@@ -373,6 +373,26 @@ process::Future<bool> destroy(
     const Duration& interval = Milliseconds(100));
 
 
+// Destroy each of the given cgroups under a given hierarchy (see
+// above), with at most 'parallelism' of them being destroyed at a
+// time, e.g., to clean up many orphaned cgroups without freezing and
+// killing the tasks of all of them at once.
+// @param   hierarchy   Path to the hierarchy root.
+// @param   cgroups     Paths to the cgroups relative to the hierarchy root.
+// @param   parallelism The maximum number of cgroups being destroyed at
+//                      a time.
+// @param   interval    The time interval between two state check
+//                      requests (default: 0.1 seconds).
+// @return  A future which will become ready when all the cgroups have
+//          been destroyed. Error if any of them could not be destroyed
+//          (after attempting to destroy all of them).
+process::Future<Nothing> destroy(
+    const std::string& hierarchy,
+    const std::vector<std::string>& cgroups,
+    size_t parallelism,
+    const Duration& interval = Milliseconds(100));
+
+
 // Cleanup the hierarchy, by first destroying all the underlying
 // cgroups, unmounting the hierarchy and deleting the mount point.
 // @param   hierarchy Path to the hierarchy root.
@@ -27,7 +27,11 @@
 
 #include <stout/check.hpp>
 #include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/interval.hpp>
+#include <stout/none.hpp>
 #include <stout/numify.hpp>
+#include <stout/option.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/strings.hpp>
 
@@ -126,8 +130,170 @@ static string encode(uint64_t position, bool adjust = true)
 // }
 
 
+// Key of the checkpoint record (see Checkpoint), which sorts after
+// the key of every position.
+static const string CHECKPOINT = "checkpoint";
+
+// Number of actions persisted between checkpoints, i.e., (roughly)
+// the maximum number of actions that need to be read when restoring.
+static const size_t CHECKPOINT_INTERVAL = 1000;
+
+
+// Updates the state to reflect the action.
+static void apply(Storage::State* state, const Action& action)
+{
+  if (action.has_learned() && action.learned()) {
+    state->learned.insert(action.position());
+    state->unlearned.erase(action.position());
+    if (action.has_type() && action.type() == Action::TRUNCATE) {
+      state->begin = std::max(state->begin, action.truncate().to());
+
+      // Positions before the beginning of the log are not used (see
+      // ReplicaProcess::restore), so there is no need to keep track
+      // of them (nor to store them in a checkpoint).
+      state->learned -= (Bound<uint64_t>::closed(0),
+                         Bound<uint64_t>::open(state->begin));
+      state->unlearned -= (Bound<uint64_t>::closed(0),
+                           Bound<uint64_t>::open(state->begin));
+    }
+  } else {
+    state->learned.erase(action.position());
+    state->unlearned.insert(action.position());
+  }
+  state->end = std::max(state->end, action.position());
+}
+
+
+// Returns true if applying the action would change the state.
+static bool changes(const Storage::State& state, const Action& action)
+{
+  if (action.has_learned() && action.learned()) {
+    return !state.learned.contains(action.position()) ||
+      state.unlearned.contains(action.position()) ||
+      (action.has_type() && action.type() == Action::TRUNCATE &&
+       action.truncate().to() > state.begin) ||
+      action.position() > state.end;
+  }
+
+  return state.learned.contains(action.position()) ||
+    !state.unlearned.contains(action.position()) ||
+    action.position() > state.end;
+}
+
+
+// Adds a checkpoint of the state to the batch, returning the
+// position before which all positions are reflected in it.
+static Try<uint64_t> checkpoint(
+    const Storage::State& state,
+    const Option<uint64_t>& first,
+    leveldb::WriteBatch* batch)
+{
+  Record record;
+  record.set_type(Record::CHECKPOINT);
+
+  Checkpoint* checkpoint = record.mutable_checkpoint();
+
+  // Note that nothing has been written to position 0 of a new log.
+  const bool empty = state.end == 0 &&
+    state.learned.empty() &&
+    state.unlearned.empty();
+
+  checkpoint->set_position(empty ? 0 : state.end + 1);
+  checkpoint->set_begin(state.begin);
+  checkpoint->set_end(state.end);
+
+  if (first.isSome()) {
+    checkpoint->set_first(first.get());
+  }
+
+  foreach (const Interval<uint64_t>& interval, state.learned) {
+    Checkpoint::Interval* learned = checkpoint->add_learned();
+    learned->set_lower(interval.lower());
+    learned->set_upper(interval.upper());
+  }
+
+  foreach (const Interval<uint64_t>& interval, state.unlearned) {
+    Checkpoint::Interval* unlearned = checkpoint->add_unlearned();
+    unlearned->set_lower(interval.lower());
+    unlearned->set_upper(interval.upper());
+  }
+
+  string value;
+
+  if (!record.SerializeToString(&value)) {
+    return Error("Failed to serialize record");
+  }
+
+  batch->Put(CHECKPOINT, value);
+
+  return checkpoint->position();
+}
+
+
+// Updates the state (and the first position) to reflect the record.
+static Try<Nothing> update(
+    Storage::State* state,
+    Option<uint64_t>* first,
+    const leveldb::Slice& slice)
+{
+  google::protobuf::io::ArrayInputStream stream(slice.data(), slice.size());
+
+  Record record;
+
+  if (!record.ParseFromZeroCopyStream(&stream)) {
+    return Error("Failed to deserialize record");
+  }
+
+  switch (record.type()) {
+    case Record::METADATA: {
+      CHECK(record.has_metadata());
+      state->metadata.CopyFrom(record.metadata());
+      break;
+    }
+
+    // DEPRECATED!
+    case Record::PROMISE: {
+      CHECK(record.has_promise());
+      // This replica is in old format. Set its status to VOTING
+      // since there is no catch-up logic in the old code and this
+      // replica is obviously not empty.
+      state->metadata.set_status(Metadata::VOTING);
+      state->metadata.set_promised(record.promise().proposal());
+      break;
+    }
+
+    case Record::ACTION: {
+      CHECK(record.has_action());
+      const Action& action = record.action();
+      apply(state, action);
+
+      // Cache the first position in this replica so during a
+      // truncation, we can attempt to delete all positions from the
+      // first position up to the truncate position. Note that this
+      // is not the beginning position of the log, but rather the
+      // first position that remains (i.e., hasn't been deleted) in
+      // leveldb.
+      *first = min(*first, action.position());
+      break;
+    }
+
+    case Record::CHECKPOINT: {
+      // The checkpoint only gets read explicitly (before any other
+      // record), see LevelDBStorage::restore.
+      break;
+    }
+
+    default: {
+      return Error("Bad record");
+    }
+  }
+
+  return Nothing();
+}
+
+
 LevelDBStorage::LevelDBStorage()
-  : db(NULL), first(None())
+  : db(NULL), first(None()), checkpointed(None()), actions(0)
 {
   // Nothing to see here.
 }
@@ -160,6 +326,7 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
   CHECK(leveldb::BytewiseComparator()->Compare(one, ten) < 0);
   CHECK(leveldb::BytewiseComparator()->Compare(ten, two) > 0);
   CHECK(leveldb::BytewiseComparator()->Compare(ten, ten) == 0);
+  CHECK(leveldb::BytewiseComparator()->Compare(ten, CHECKPOINT) < 0);
 
   Stopwatch stopwatch;
   stopwatch.start();
@@ -173,17 +340,151 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
 
   LOG(INFO) << "Opened db in " << stopwatch.elapsed();
 
-  stopwatch.start(); // Restart the stopwatch.
+  state.begin = 0;
+  state.end = 0;
+
+  string value;
+
+  status = db->Get(leveldb::ReadOptions(), CHECKPOINT, &value);
+
+  if (status.ok()) {
+    Record record;
+
+    if (!record.ParseFromString(value) ||
+        record.type() != Record::CHECKPOINT ||
+        !record.has_checkpoint()) {
+      return Error("Failed to deserialize checkpoint");
+    }
+
+    Try<Nothing> recovered = recover(record.checkpoint());
+
+    if (recovered.isError()) {
+      return Error(recovered.error());
+    }
+
+    checkpointed = record.checkpoint().position();
+
+    return state;
+  } else if (!status.IsNotFound()) {
+    return Error(status.ToString());
+  }
+
+  // Without a checkpoint (e.g., the replica was written by an older
+  // version or crashed while catching up) we read every record.
+  Try<Nothing> scanned = scan();
+
+  if (scanned.isError()) {
+    return Error(scanned.error());
+  }
+
+  // Checkpoint right away so that we don't need to read every record
+  // the next time around.
+  leveldb::WriteBatch batch;
+
+  Try<uint64_t> position = checkpoint(state, first, &batch);
+
+  if (position.isError()) {
+    return Error(position.error());
+  }
+
+  leveldb::WriteOptions _options;
+  _options.sync = true;
+
+  status = db->Write(_options, &batch);
+
+  if (!status.ok()) {
+    return Error(status.ToString());
+  }
+
+  checkpointed = position.get();
+
+  return state;
+}
+
+
+Try<Nothing> LevelDBStorage::recover(const Checkpoint& checkpoint)
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  state.begin = checkpoint.begin();
+  state.end = checkpoint.end();
+
+  foreach (const Checkpoint::Interval& interval, checkpoint.learned()) {
+    state.learned += (Bound<uint64_t>::closed(interval.lower()),
+                      Bound<uint64_t>::open(interval.upper()));
+  }
+
+  foreach (const Checkpoint::Interval& interval, checkpoint.unlearned()) {
+    state.unlearned += (Bound<uint64_t>::closed(interval.lower()),
+                        Bound<uint64_t>::open(interval.upper()));
+  }
+
+  if (checkpoint.has_first()) {
+    first = checkpoint.first();
+  }
+
+  // The metadata (or promise) is always stored at position 0.
+  string value;
+
+  leveldb::Status status =
+    db->Get(leveldb::ReadOptions(), encode(0, false), &value);
+
+  if (status.ok()) {
+    Try<Nothing> updated = update(&state, &first, value);
+
+    if (updated.isError()) {
+      return updated;
+    }
+  } else if (!status.IsNotFound()) {
+    return Error(status.ToString());
+  }
+
+  // Now read the actions at positions not reflected in the
+  // checkpoint (all of which sort before the checkpoint itself).
+  leveldb::Iterator* iterator = db->NewIterator(leveldb::ReadOptions());
+
+  iterator->Seek(encode(checkpoint.position()));
+
+  uint64_t keys = 0;
+
+  while (iterator->Valid() && iterator->key() != CHECKPOINT) {
+    keys++;
+
+    Try<Nothing> updated = update(&state, &first, iterator->value());
+
+    if (updated.isError()) {
+      delete iterator;
+      return updated;
+    }
+
+    iterator->Next();
+  }
+
+  delete iterator;
+
+  // Checkpoint again once the actions we've read add up to an
+  // interval's worth.
+  actions = keys;
+
+  LOG(INFO) << "Restored checkpoint up to position " << checkpoint.position()
+            << " and read " << keys << " keys from the db in "
+            << stopwatch.elapsed();
+
+  return Nothing();
+}
+
+
+Try<Nothing> LevelDBStorage::scan()
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
 
   // TODO(benh): Conditionally compact to avoid long recovery times?
   db->CompactRange(NULL, NULL);
 
   LOG(INFO) << "Compacted db in " << stopwatch.elapsed();
 
-  State state;
-  state.begin = 0;
-  state.end = 0;
-
   // TODO(benh): Consider just reading the "promise" record (e.g.,
   // 'encode(0, false)') and then iterating over the rest of the
   // records and confirming that they are all indeed of type
@@ -207,62 +508,12 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
 
   while (iterator->Valid()) {
     keys++;
-    const leveldb::Slice& slice = iterator->value();
 
-    google::protobuf::io::ArrayInputStream stream(slice.data(), slice.size());
+    Try<Nothing> updated = update(&state, &first, iterator->value());
 
-    Record record;
-
-    if (!record.ParseFromZeroCopyStream(&stream)) {
-      return Error("Failed to deserialize record");
-    }
-
-    switch (record.type()) {
-      case Record::METADATA: {
-        CHECK(record.has_metadata());
-        state.metadata.CopyFrom(record.metadata());
-        break;
-      }
-
-      // DEPRECATED!
-      case Record::PROMISE: {
-        CHECK(record.has_promise());
-        // This replica is in old format. Set its status to VOTING
-        // since there is no catch-up logic in the old code and this
-        // replica is obviously not empty.
-        state.metadata.set_status(Metadata::VOTING);
-        state.metadata.set_promised(record.promise().proposal());
-        break;
-      }
-
-      case Record::ACTION: {
-        CHECK(record.has_action());
-        const Action& action = record.action();
-        if (action.has_learned() && action.learned()) {
-          state.learned.insert(action.position());
-          state.unlearned.erase(action.position());
-          if (action.has_type() && action.type() == Action::TRUNCATE) {
-            state.begin = std::max(state.begin, action.truncate().to());
-          }
-        } else {
-          state.learned.erase(action.position());
-          state.unlearned.insert(action.position());
-        }
-        state.end = std::max(state.end, action.position());
-
-        // Cache the first position in this replica so during a
-        // truncation, we can attempt to delete all positions from the
-        // first position up to the truncate position. Note that this
-        // is not the beginning position of the log, but rather the
-        // first position that remains (i.e., hasn't been deleted) in
-        // leveldb.
-        first = min(first, action.position());
-        break;
-      }
-
-      default: {
-        return Error("Bad record");
-      }
+    if (updated.isError()) {
+      delete iterator;
+      return updated;
     }
 
     iterator->Next();
@@ -273,7 +524,7 @@ Try<Storage::State> LevelDBStorage::restore(const string& path)
 
   delete iterator;
 
-  return state;
+  return Nothing();
 }
 
 
@@ -323,15 +574,59 @@ Try<Nothing> LevelDBStorage::persist(const Action& action)
     return Error("Failed to serialize record");
   }
 
+  leveldb::WriteBatch batch;
+  batch.Put(encode(action.position()), value);
+
+  // Every so often we also write a checkpoint (in the same batch so
+  // that the checkpoint reflects exactly what is stored).
+  Option<uint64_t> checkpointing = None();
+  bool invalidating = false;
+
+  if (actions + 1 >= CHECKPOINT_INTERVAL) {
+    State updated = state;
+    apply(&updated, action);
+
+    Try<uint64_t> position =
+      checkpoint(updated, min(first, action.position()), &batch);
+
+    if (position.isError()) {
+      return Error(position.error());
+    }
+
+    checkpointing = position.get();
+  } else if (checkpointed.isSome() &&
+             action.position() < checkpointed.get() &&
+             changes(state, action)) {
+    // The action changes a position reflected in the checkpoint (it
+    // got filled or learned out of order). Rather than rewriting the
+    // checkpoint, which takes time proportional to the number of
+    // holes (e.g., while catching up in random order), we remove it
+    // until the next one gets written.
+    batch.Delete(CHECKPOINT);
+    invalidating = true;
+  }
+
   leveldb::WriteOptions options;
   options.sync = true;
 
-  leveldb::Status status = db->Put(options, encode(action.position()), value);
+  leveldb::Status status = db->Write(options, &batch);
 
   if (!status.ok()) {
     return Error(status.ToString());
   }
 
+  apply(&state, action);
+
+  if (checkpointing.isSome()) {
+    checkpointed = checkpointing;
+    actions = 0;
+  } else {
+    if (invalidating) {
+      checkpointed = None();
+    }
+    actions++;
+  }
+
   // Updated the first position. Notice that we use 'min' here instead
   // of checking 'isNone()' because it's likely that log entries are
   // written out of order during catch-up (e.g. if a random bulk
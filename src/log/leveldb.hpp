@@ -23,10 +23,14 @@
 
 #include <stdint.h>
 
+#include <stout/nothing.hpp>
 #include <stout/option.hpp>
+#include <stout/try.hpp>
 
 #include "log/storage.hpp"
 
+#include "messages/log.hpp"
+
 namespace mesos {
 namespace internal {
 namespace log {
@@ -44,10 +48,27 @@ public:
   virtual Try<Action> read(uint64_t position);
 
 private:
+  // Restores the state from the checkpoint, reading only the actions
+  // at positions not reflected in it.
+  Try<Nothing> recover(const Checkpoint& checkpoint);
+
+  // Restores the state by reading every record.
+  Try<Nothing> scan();
+
   leveldb::DB* db;
 
   // First position still in leveldb, used during truncation.
   Option<uint64_t> first;
+
+  // The current state, as it would be restored.
+  State state;
+
+  // Positions before this one are reflected in the checkpoint stored
+  // in leveldb (none if there is no checkpoint).
+  Option<uint64_t> checkpointed;
+
+  // Number of actions persisted since the last checkpoint.
+  size_t actions;
 };
 
 } // namespace log {
@@ -35,6 +35,9 @@ const Duration SLAVE_PING_TIMEOUT = Seconds(15);
 const uint32_t MAX_SLAVE_PING_TIMEOUTS = 5;
 const uint32_t MAX_COMPLETED_FRAMEWORKS = 50;
 const uint32_t MAX_COMPLETED_TASKS_PER_FRAMEWORK = 1000;
+const Bytes MAX_COMPLETED_TASKS_SIZE_PER_FRAMEWORK = Megabytes(1);
+const uint32_t MAX_INCREMENTAL_ALLOCATIONS = 60;
+const uint32_t MAX_RECONCILIATIONS_PER_BATCH = 1000;
 const Duration WHITELIST_WATCH_INTERVAL = Seconds(5);
 const uint32_t TASK_LIMIT = 100;
 const std::string MASTER_INFO_LABEL = "info";
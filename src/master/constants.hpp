@@ -23,6 +23,7 @@
 
 #include <string>
 
+#include <stout/bytes.hpp>
 #include <stout/duration.hpp>
 
 namespace mesos {
@@ -61,6 +62,18 @@ extern const uint32_t MAX_COMPLETED_FRAMEWORKS;
 // cache.  TODO(thomasm): Make configurable.
 extern const uint32_t MAX_COMPLETED_TASKS_PER_FRAMEWORK;
 
+// Maximum (serialized) size of the completed tasks per framework to
+// store in the cache.
+extern const Bytes MAX_COMPLETED_TASKS_SIZE_PER_FRAMEWORK;
+
+// Maximum number of consecutive batch allocations that only allocate
+// the slaves whose resources changed (before allocating all slaves).
+extern const uint32_t MAX_INCREMENTAL_ALLOCATIONS;
+
+// Maximum number of task statuses of a framework that get reconciled
+// at once (before handling any other messages).
+extern const uint32_t MAX_RECONCILIATIONS_PER_BATCH;
+
 // Time interval to check for updated watchers list.
 extern const Duration WHITELIST_WATCH_INTERVAL;
 
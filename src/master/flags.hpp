@@ -72,6 +72,14 @@ public:
         "bootstrap the persistent state on a running cluster.",
         false);
 
+    add(&Flags::registry_journal_entries,
+        "registry_journal_entries",
+        "Number of journal entries the Registrar appends to the registry\n"
+        "before storing a new snapshot of it. Each registry update only\n"
+        "persists its own mutations as a journal entry, while a snapshot\n"
+        "persists the entire registry (which is replayed on recovery).",
+        100);
+
     add(&Flags::webui_dir,
         "webui_dir",
         "Location of the webui files/assets",
@@ -104,6 +112,29 @@ public:
         " (batch) allocations (e.g., 500ms, 1sec, etc)",
         Seconds(1));
 
+    add(&Flags::allocation_latency,
+        "allocation_latency",
+        "Amount of time to wait before allocating resources after an\n"
+        "event that warrants it (e.g., a framework registering), so that\n"
+        "bursts of events get coalesced into a single allocation\n"
+        "(e.g., 10ms, 100ms, etc)",
+        Seconds(0));
+
+    add(&Flags::allocation_parallelism,
+        "allocation_parallelism",
+        "Number of partitions of the slaves to allocate in parallel\n"
+        "(the resulting offers are the same as when allocating serially)",
+        1);
+
+    add(&Flags::max_offers_per_framework,
+        "max_offers_per_framework",
+        "Maximum number of outstanding offers a framework can have\n"
+        "(i.e., offers it has neither accepted nor declined yet).\n"
+        "Resources that would be offered beyond this limit are\n"
+        "declined on behalf of the framework for two allocation\n"
+        "intervals, so they get offered to the other frameworks.\n"
+        "If not set, there is no limit.");
+
     add(&Flags::cluster,
         "cluster",
         "Human readable name for the cluster,\n"
@@ -121,6 +152,28 @@ public:
         "of the form 'role=weight,role=weight'. Weights\n"
         "are used to indicate forms of priority.");
 
+    add(&Flags::message_rates,
+        "message_rates",
+        "A comma seperated list of message/rate pairs of the form\n"
+        "'message=rate,message=rate', where 'message' is the full name\n"
+        "of a message type (e.g., mesos.internal.RegisterSlaveMessage)\n"
+        "and 'rate' is the number of such messages per second the master\n"
+        "handles. Messages beyond the rate are queued in order.");
+
+    add(&Flags::framework_message_rate,
+        "framework_message_rate",
+        "Number of messages per second the master handles from each\n"
+        "scheduler. Messages beyond the rate are queued in order.\n"
+        "Launching and killing tasks are not subject to this rate but\n"
+        "are still handled after the scheduler's queued messages.\n"
+        "If not set, there is no limit.");
+
+    add(&Flags::state_request_rate,
+        "state_request_rate",
+        "Number of /master/state.json requests per second the master\n"
+        "handles. Requests beyond the rate are queued in order.\n"
+        "If not set, there is no limit.");
+
     add(&Flags::authenticate,
         "authenticate",
         "If authenticate is 'true' only authenticated frameworks are allowed\n"
@@ -141,14 +194,21 @@ public:
   std::string work_dir;
   std::string registry;
   bool registry_strict;
+  size_t registry_journal_entries;
   std::string webui_dir;
   std::string whitelist;
   std::string user_sorter;
   std::string framework_sorter;
   Duration allocation_interval;
+  Duration allocation_latency;
+  size_t allocation_parallelism;
+  Option<size_t> max_offers_per_framework;
   Option<std::string> cluster;
   Option<std::string> roles;
   Option<std::string> weights;
+  Option<std::string> message_rates;
+  Option<double> framework_message_rate;
+  Option<double> state_request_rate;
   bool authenticate;
   Option<std::string> credentials;
 };
@@ -19,19 +19,33 @@
 #ifndef __HIERARCHICAL_ALLOCATOR_PROCESS_HPP__
 #define __HIERARCHICAL_ALLOCATOR_PROCESS_HPP__
 
+#include <algorithm>
+#include <list>
+#include <map>
+
 #include <mesos/resources.hpp>
 
+#include <process/async.hpp>
+#include <process/clock.hpp>
+#include <process/collect.hpp>
+#include <process/defer.hpp>
 #include <process/delay.hpp>
+#include <process/future.hpp>
 #include <process/id.hpp>
+#include <process/statistics.hpp>
 #include <process/timeout.hpp>
 
 #include <stout/check.hpp>
 #include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+#include <stout/memory.hpp>
+#include <stout/option.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
 
 #include "master/allocator.hpp"
+#include "master/constants.hpp"
 #include "master/drf_sorter.hpp"
 #include "master/master.hpp"
 #include "master/sorter.hpp"
@@ -96,8 +110,9 @@ struct Framework
 
   std::string role() const { return info.role(); }
 
-  // Filters that have been added by this framework.
-  hashset<Filter*> filters;
+  // Filters that have been added by this framework, indexed by the
+  // slave they apply to.
+  hashmap<SlaveID, hashset<Filter*> > filters;
 
   bool checkpoint;
 private:
@@ -183,26 +198,91 @@ protected:
   // Allocate any allocatable resources.
   void allocate();
 
-  // Allocate resources just from the specified slave.
-  void allocate(const SlaveID& slaveId);
-
   // Allocate resources from the specified slaves.
   void allocate(const hashset<SlaveID>& slaveIds);
 
-  // Remove a filter for the specified framework.
-  void expire(const FrameworkID& frameworkId, Filter* filter);
+  // A copy of the state needed to allocate (some of) the slaves, so
+  // that they can get allocated off this process while it keeps
+  // handling events.
+  struct Snapshot
+  {
+    // The frameworks in the order in which they get to pick resources.
+    std::vector<FrameworkID> frameworkIds;
+
+    hashmap<FrameworkID, Framework> frameworks;
+
+    // The (connected and whitelisted) slaves to allocate.
+    hashmap<SlaveID, Slave> slaves;
+  };
+
+  // The result of allocating (some of) the slaves.
+  struct Allocation
+  {
+    // Resources to offer to each framework.
+    hashmap<FrameworkID, hashmap<SlaveID, Resources> > offerable;
+  };
+
+  // Allocates the specified slaves to the frameworks, in order, so
+  // that disjoint sets of slaves can be allocated in parallel. This
+  // is possible because what a framework gets offered on one slave
+  // does not depend on what it gets offered on any other slave.
+  static Allocation allocate(
+      const std::vector<FrameworkID>& frameworkIds,
+      const hashmap<FrameworkID, Framework>& frameworks,
+      const hashmap<SlaveID, Slave>& slaves,
+      const std::vector<SlaveID>& slaveIds);
+
+  // Allocates the specified slaves of the snapshot (off this
+  // process, which is why it is static).
+  static Allocation allocate(
+      const memory::shared_ptr<const Snapshot>& snapshot,
+      const std::vector<SlaveID>& slaveIds);
+
+  // Makes the offers of the allocations of a snapshot, except for
+  // those made invalid by changes since the snapshot (e.g., a slave
+  // got removed).
+  void allocated(
+      const std::vector<FrameworkID>& frameworkIds,
+      const process::Future<std::list<Allocation> >& allocations);
+
+  // Offers the allocated resources to the framework (via the master).
+  virtual void offer(
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& offerable);
+
+  // Marks the slave as dirty, i.e., it will be considered in the next
+  // (incremental) allocation.
+  void touch(const SlaveID& slaveId);
+
+  // Marks all slaves with allocatable resources as dirty (e.g., after
+  // a framework is added, it might want resources that every other
+  // framework filtered).
+  void touch();
+
+  // Schedules an allocation of the dirty slaves (unless one is
+  // already scheduled) after 'flags.allocation_latency', so that a
+  // burst of events results in a single allocation.
+  void schedule();
+
+  // Callback for doing scheduled allocations.
+  void _allocate();
+
+  // Remove (and delete) all filters that have expired.
+  void expire();
 
   // Checks whether the slave is whitelisted.
   bool isWhitelisted(const SlaveID& slave);
 
   // Returns true if there is a filter for this framework
   // on this slave.
-  bool isFiltered(
+  static bool isFiltered(
       const FrameworkID& frameworkId,
+      const Framework& framework,
       const SlaveID& slaveId,
+      const Slave& slave,
       const Resources& resources);
 
-  bool allocatable(const Resources& resources);
+  static bool allocatable(const Resources& resources);
 
   bool initialized;
 
@@ -226,6 +306,53 @@ protected:
 
   // Sorter containing all active roles.
   RoleSorter* roleSorter;
+
+  // Slaves whose resources might be allocatable since they were last
+  // allocated (e.g., because resources were recovered). Resources on
+  // other slaves that remain unallocated were not allocatable for any
+  // framework, so allocating them again would be a waste of time.
+  hashset<SlaveID> dirty;
+
+  // Whether an allocation has been scheduled (see 'schedule').
+  bool scheduled;
+
+  // Number of batch allocations since the last one of all slaves.
+  uint32_t batches;
+
+  // The partitions being allocated in parallel, if any. No other
+  // allocation starts (and no filter expires) until they are done.
+  Option<process::Future<std::list<Allocation> > > allocating;
+
+  // Whether a scheduled allocation was postponed until the one in
+  // flight is done.
+  bool postponed;
+
+  struct Expiration
+  {
+    Expiration(
+        const FrameworkID& _frameworkId,
+        const SlaveID& _slaveId,
+        Filter* _filter,
+        const process::Timeout& _timeout)
+      : frameworkId(_frameworkId),
+        slaveId(_slaveId),
+        filter(_filter),
+        timeout(_timeout) {}
+
+    FrameworkID frameworkId;
+    SlaveID slaveId;
+    Filter* filter;
+    process::Timeout timeout;
+  };
+
+  // Returns the bucket in 'expirations' for the specified time.
+  int64_t bucket(const process::Time& time) const;
+
+  // All filters (including those already removed from their
+  // framework) keyed by the bucket they expire in, where buckets are
+  // 'flags.allocation_interval' wide. Rather than having a timer per
+  // filter, the expired buckets are processed in each allocation.
+  std::map<int64_t, std::list<Expiration> > expirations;
 };
 
 
@@ -264,12 +391,44 @@ public:
 template <class RoleSorter, class FrameworkSorter>
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::HierarchicalAllocatorProcess()
   : ProcessBase(process::ID::generate("hierarchical-allocator")),
-    initialized(false) {}
+    initialized(false),
+    scheduled(false),
+    batches(0),
+    postponed(false) {}
+
+
+// Deletes the filters (see ~HierarchicalAllocatorProcess).
+inline void deleteFilters(std::list<Filter*>* filters)
+{
+  foreach (Filter* filter, *filters) {
+    delete filter;
+  }
+
+  delete filters;
+}
 
 
 template <class RoleSorter, class FrameworkSorter>
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::~HierarchicalAllocatorProcess()
-{}
+{
+  std::list<Filter*>* filters = new std::list<Filter*>();
+
+  typedef std::list<Expiration> Expirations;
+  foreachvalue (const Expirations& entries, expirations) {
+    foreach (const Expiration& expiration, entries) {
+      filters->push_back(expiration.filter);
+    }
+  }
+
+  // The partitions still being allocated use the filters (but only
+  // the snapshot otherwise), so rather than waiting for them, we
+  // delete the filters once they are done.
+  if (allocating.isSome()) {
+    allocating.get().onAny(lambda::bind(&deleteFilters, filters));
+  } else {
+    deleteFilters(filters);
+  }
+}
 
 
 template <class RoleSorter, class FrameworkSorter>
@@ -331,7 +490,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::frameworkAdded(
 
   LOG(INFO) << "Added framework " << frameworkId;
 
-  allocate();
+  touch();
+  schedule();
 }
 
 
@@ -377,7 +537,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::frameworkActivated(
 
   LOG(INFO) << "Activated framework " << frameworkId;
 
-  allocate();
+  touch();
+  schedule();
 }
 
 
@@ -446,7 +607,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::slaveAdded(
             << ") with " << slaveInfo.resources() << " (and " << unused
             << " available)";
 
-  allocate(slaveId);
+  touch(slaveId);
+  schedule();
 }
 
 
@@ -461,6 +623,7 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::slaveRemoved(
   roleSorter->remove(slaves[slaveId].resources());
 
   slaves.erase(slaveId);
+  dirty.erase(slaveId);
 
   // Note that we DO NOT actually delete any filters associated with
   // this slave, that will occur when the delayed
@@ -495,6 +658,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::slaveReconnected(
 
   slaves[slaveId].connected = true;
 
+  touch(slaveId);
+
   LOG(INFO)<< "Slave " << slaveId << " reconnected";
 }
 
@@ -515,6 +680,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateWhitelist(
       slaves[slaveId].whitelisted = isWhitelisted(slaveId);
     }
   }
+
+  touch();
 }
 
 
@@ -563,6 +730,7 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::resourcesUnused(
   // Update resources allocatable on slave.
   CHECK(slaves.contains(slaveId));
   slaves[slaveId].available += resources;
+  touch(slaveId);
 
   // Create a refused resources filter.
   Try<Duration> seconds_ = Duration::create(Filters().refuse_seconds());
@@ -591,13 +759,15 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::resourcesUnused(
               << " filtered slave " << slaveId
               << " for " << seconds;
 
-    // Create a new filter and delay it's expiration.
-    Filter* filter =
-      new RefusedFilter(slaveId, resources, process::Timeout::in(seconds));
+    // Create a new filter and record when it expires.
+    const process::Timeout timeout = process::Timeout::in(seconds);
+
+    Filter* filter = new RefusedFilter(slaveId, resources, timeout);
 
-    frameworks[frameworkId].filters.insert(filter);
+    frameworks[frameworkId].filters[slaveId].insert(filter);
 
-    delay(seconds, self(), &Self::expire, frameworkId, filter);
+    expirations[bucket(timeout.time())].push_back(
+        Expiration(frameworkId, slaveId, filter, timeout));
   }
 }
 
@@ -633,6 +803,7 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::resourcesRecovered(
   // before we received Allocator::slaveRemoved).
   if (slaves.contains(slaveId)) {
     slaves[slaveId].available += resources;
+    touch(slaveId);
 
     LOG(INFO) << "Recovered " << resources.allocatable()
               << " (total allocatable: " << slaves[slaveId].available
@@ -651,16 +822,15 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::offersRevived(
 
   frameworks[frameworkId].filters.clear();
 
-  // We delete each actual Filter when
-  // HierarchicalAllocatorProcess::expire gets invoked. If we delete the
-  // Filter here it's possible that the same Filter (i.e., same
-  // address) could get reused and HierarchicalAllocatorProcess::expire
-  // would expire that filter too soon. Note that this only works
-  // right now because ALL Filter types "expire".
+  // We delete each actual Filter when HierarchicalAllocatorProcess::expire
+  // finds it expired, since it is still referenced by 'expirations'.
+  // Note that this only works right now because ALL Filter types
+  // "expire".
 
   LOG(INFO) << "Removed filters for framework " << frameworkId;
 
-  allocate();
+  touch();
+  schedule();
 }
 
 
@@ -669,7 +839,32 @@ void
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::batch()
 {
   CHECK(initialized);
-  allocate();
+
+  // The dirty slaves get allocated in the next batch instead.
+  if (allocating.isSome()) {
+    delay(flags.allocation_interval, self(), &Self::batch);
+    return;
+  }
+
+  expire();
+
+  // Only allocate the dirty slaves, except for every so often when
+  // we allocate all slaves just in case (e.g., a filter stopped
+  // filtering before it got expired).
+  if (++batches >= MAX_INCREMENTAL_ALLOCATIONS) {
+    allocate();
+  } else {
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    const size_t count = dirty.size();
+
+    allocate(dirty);
+
+    VLOG(1) << "Performed allocation for " << count << " dirty slaves in "
+            << stopwatch.elapsed();
+  }
+
   delay(flags.allocation_interval, self(), &Self::batch);
 }
 
@@ -685,6 +880,10 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate()
 
   allocate(slaves.keys());
 
+  batches = 0;
+
+  process::statistics->increment("allocator", "full_allocations");
+
   VLOG(1) << "Performed allocation for " << slaves.size() << " slaves in "
             << stopwatch.elapsed();
 }
@@ -693,29 +892,23 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate()
 template <class RoleSorter, class FrameworkSorter>
 void
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
-    const SlaveID& slaveId)
+    const hashset<SlaveID>& _slaveIds)
 {
   CHECK(initialized);
 
-  hashset<SlaveID> slaveIds;
-  slaveIds.insert(slaveId);
-
-  Stopwatch stopwatch;
-  stopwatch.start();
+  CHECK(allocating.isNone());
 
-  allocate(slaveIds);
+  // NOTE: We copy the slaves since they might be the dirty slaves.
+  const hashset<SlaveID> slaveIds = _slaveIds;
 
-  VLOG(1) << "Performed allocation for slave " << slaveId << " in "
-          << stopwatch.elapsed();
-}
+  // The slaves are no longer dirty once allocated, even if there are
+  // no roles (in which case frameworkAdded will touch them again).
+  foreach (const SlaveID& slaveId, slaveIds) {
+    dirty.erase(slaveId);
+  }
 
-
-template <class RoleSorter, class FrameworkSorter>
-void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
-    const hashset<SlaveID>& slaveIds)
-{
-  CHECK(initialized);
+  process::statistics->set(
+      "allocator", "allocated_slaves", static_cast<double>(slaveIds.size()));
 
   if (roleSorter->count() == 0) {
     VLOG(1) << "No roles to allocate resources!";
@@ -727,72 +920,366 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
     return;
   }
 
+  // Determine the order in which frameworks get to pick resources.
+  std::vector<FrameworkID> frameworkIds;
   foreach (const std::string& role, roleSorter->sort()) {
     foreach (const std::string& frameworkIdValue, sorters[role]->sort()) {
       FrameworkID frameworkId;
       frameworkId.set_value(frameworkIdValue);
+      frameworkIds.push_back(frameworkId);
+
+      CHECK(frameworks.contains(frameworkId));
+    }
+  }
 
-      Resources allocatedResources;
-      hashmap<SlaveID, Resources> offerable;
-      foreach (const SlaveID& slaveId, slaveIds) {
-        Resources unreserved = slaves[slaveId].available.extract("*");
-        Resources resources = unreserved;
+  // Partition the slaves and allocate each partition in parallel
+  // off this process (unless there is only one partition). Note that
+  // no filter gets deleted while the partitions are being allocated
+  // (see 'expire'), and that any filter still around has not expired,
+  // so it doesn't matter that the (paused) clock of another process
+  // might be behind.
+  const size_t count = std::max(
+      std::min(flags.allocation_parallelism, slaveIds.size()), (size_t) 1);
 
-        if (role != "*") {
-          resources += slaves[slaveId].available.extract(role);
-        }
+  std::vector<std::vector<SlaveID> > partitions(count);
 
-        // Check whether or not this framework filters this slave.
-        bool filtered = isFiltered(frameworkId, slaveId, resources);
+  size_t index = 0;
+  foreach (const SlaveID& slaveId, slaveIds) {
+    CHECK(slaves.contains(slaveId));
+    const Slave& slave = slaves[slaveId];
 
-        if (!filtered &&
-            slaves[slaveId].connected &&
-            slaves[slaveId].whitelisted &&
-            allocatable(resources)) {
-          VLOG(1)
-            << "Offering " << resources << " on slave " << slaveId
-            << " to framework " << frameworkId;
+    if (!slave.connected || !slave.whitelisted) {
+      continue;
+    }
 
-          offerable[slaveId] = resources;
+    partitions[index++ % count].push_back(slaveId);
+  }
 
-          // Update framework and slave resources.
-          slaves[slaveId].available -= resources;
+  // Nothing changes while allocating serially, so there is no need
+  // for a snapshot.
+  if (count == 1) {
+    std::list<Allocation> allocations;
+    allocations.push_back(
+        allocate(frameworkIds, frameworks, slaves, partitions[0]));
+    allocated(frameworkIds, allocations);
+    return;
+  }
 
-          // We only count resources not reserved for this role
-          // in the share the sorter considers.
-          allocatedResources += unreserved;
-        }
+  Snapshot* snapshot = new Snapshot();
+  snapshot->frameworkIds = frameworkIds;
+
+  foreach (const FrameworkID& frameworkId, frameworkIds) {
+    snapshot->frameworks[frameworkId] = frameworks[frameworkId];
+  }
+
+  foreach (const std::vector<SlaveID>& partition, partitions) {
+    foreach (const SlaveID& slaveId, partition) {
+      snapshot->slaves[slaveId] = slaves[slaveId];
+    }
+  }
+
+  const memory::shared_ptr<const Snapshot> shared(snapshot);
+
+  std::list<process::Future<Allocation> > futures;
+  foreach (const std::vector<SlaveID>& partition, partitions) {
+    lambda::function<Allocation(void)> f = lambda::bind(
+        static_cast<Allocation(*)(
+            const memory::shared_ptr<const Snapshot>&,
+            const std::vector<SlaveID>&)>(&Self::allocate),
+        shared,
+        partition);
+
+    futures.push_back(process::async(f));
+  }
+
+  allocating = process::collect(futures);
+
+  allocating.get()
+    .onAny(defer(self(), &Self::allocated, shared->frameworkIds, lambda::_1));
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+typename HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::Allocation
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
+    const memory::shared_ptr<const Snapshot>& snapshot,
+    const std::vector<SlaveID>& slaveIds)
+{
+  return allocate(
+      snapshot->frameworkIds,
+      snapshot->frameworks,
+      snapshot->slaves,
+      slaveIds);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+typename HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::Allocation
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
+    const std::vector<FrameworkID>& frameworkIds,
+    const hashmap<FrameworkID, Framework>& frameworks,
+    const hashmap<SlaveID, Slave>& slaves,
+    const std::vector<SlaveID>& slaveIds)
+{
+  Allocation allocation;
+
+  foreach (const SlaveID& slaveId, slaveIds) {
+    CHECK(slaves.contains(slaveId));
+    const Slave& slave = slaves.find(slaveId)->second;
+
+    Resources available = slave.available;
+
+    foreach (const FrameworkID& frameworkId, frameworkIds) {
+      CHECK(frameworks.contains(frameworkId));
+      const Framework& framework = frameworks.find(frameworkId)->second;
+
+      const std::string& role = framework.role();
+
+      Resources unreserved = available.extract("*");
+      Resources resources = unreserved;
+
+      if (role != "*") {
+        resources += available.extract(role);
       }
 
-      if (!offerable.empty()) {
-        sorters[role]->add(allocatedResources);
-        sorters[role]->allocated(frameworkIdValue, allocatedResources);
-        roleSorter->allocated(role, allocatedResources);
+      // Check whether or not this framework filters this slave.
+      bool filtered =
+        isFiltered(frameworkId, framework, slaveId, slave, resources);
+
+      if (!filtered && allocatable(resources)) {
+        VLOG(1)
+          << "Offering " << resources << " on slave " << slaveId
+          << " to framework " << frameworkId;
+
+        allocation.offerable[frameworkId][slaveId] = resources;
 
-        dispatch(master, &Master::offer, frameworkId, offerable);
+        // Update slave resources.
+        available -= resources;
       }
     }
   }
+
+  return allocation;
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::expire(
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocated(
+    const std::vector<FrameworkID>& frameworkIds,
+    const process::Future<std::list<Allocation> >& allocations)
+{
+  allocating = None();
+
+  CHECK(allocations.isReady())
+    << "Failed to allocate: "
+    << (allocations.isFailed() ? allocations.failure() : "discarded");
+
+  // Make the offers in the same order as when allocating the slaves
+  // serially. Note that while the partitions were being allocated
+  // (i.e., only if they were allocated in parallel), frameworks and
+  // slaves might have been removed or deactivated, but resources
+  // only got added to the slaves.
+  hashset<FrameworkID> active;
+  foreach (const std::string& role, roleSorter->sort()) {
+    foreach (const std::string& frameworkIdValue, sorters[role]->sort()) {
+      FrameworkID frameworkId;
+      frameworkId.set_value(frameworkIdValue);
+      active.insert(frameworkId);
+    }
+  }
+
+  foreach (const FrameworkID& frameworkId, frameworkIds) {
+    Resources allocatedResources;
+    hashmap<SlaveID, Resources> offerable;
+    foreach (const Allocation& allocation, allocations.get()) {
+      if (!allocation.offerable.contains(frameworkId)) {
+        continue;
+      }
+
+      foreachpair (const SlaveID& slaveId,
+                   const Resources& resources,
+                   allocation.offerable.find(frameworkId)->second) {
+        if (!slaves.contains(slaveId)) {
+          continue;
+        }
+
+        Slave& slave = slaves[slaveId];
+
+        if (!active.contains(frameworkId) ||
+            !slave.connected ||
+            !slave.whitelisted ||
+            !(resources <= slave.available)) {
+          touch(slaveId);
+          continue;
+        }
+
+        slave.available -= resources;
+        offerable[slaveId] = resources;
+
+        // We only count resources not reserved for this role
+        // in the share the sorter considers.
+        allocatedResources += resources.extract("*");
+      }
+    }
+
+    if (!offerable.empty()) {
+      const std::string& role = frameworks[frameworkId].role();
+
+      sorters[role]->add(allocatedResources);
+      sorters[role]->allocated(frameworkId.value(), allocatedResources);
+      roleSorter->allocated(role, allocatedResources);
+
+      offer(frameworkId, offerable);
+    }
+  }
+
+  if (postponed) {
+    postponed = false;
+    schedule();
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::offer(
     const FrameworkID& frameworkId,
-    Filter* filter)
+    const hashmap<SlaveID, Resources>& offerable)
 {
-  // The filter might have already been removed (e.g., if the
-  // framework no longer exists or in
-  // HierarchicalAllocatorProcess::offersRevived) but not yet deleted (to
-  // keep the address from getting reused possibly causing premature
-  // expiration).
-  if (frameworks.contains(frameworkId) &&
-      frameworks[frameworkId].filters.contains(filter)) {
-    frameworks[frameworkId].filters.erase(filter);
+  dispatch(master, &Master::offer, frameworkId, offerable);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::touch(
+    const SlaveID& slaveId)
+{
+  CHECK(slaves.contains(slaveId));
+  dirty.insert(slaveId);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::touch()
+{
+  foreachpair (const SlaveID& slaveId, const Slave& slave, slaves) {
+    if (allocatable(slave.available)) {
+      dirty.insert(slaveId);
+    }
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::schedule()
+{
+  if (scheduled) {
+    return;
+  }
+
+  scheduled = true;
+
+  // NOTE: Even without a latency, dispatching (rather than allocating
+  // right away) coalesces the events that are already queued up.
+  if (flags.allocation_latency > Duration::zero()) {
+    delay(flags.allocation_latency, self(), &Self::_allocate);
+  } else {
+    dispatch(self(), &Self::_allocate);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::_allocate()
+{
+  CHECK(initialized);
+  CHECK(scheduled);
+
+  scheduled = false;
+
+  if (allocating.isSome()) {
+    postponed = true; // See 'allocated'.
+    return;
   }
 
-  delete filter;
+  expire();
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  const size_t count = dirty.size();
+
+  allocate(dirty);
+
+  VLOG(1) << "Performed allocation for " << count << " dirty slaves in "
+          << stopwatch.elapsed();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+int64_t
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::bucket(
+    const process::Time& time) const
+{
+  const int64_t width = std::max(flags.allocation_interval.ns(), (int64_t) 1);
+  return time.duration().ns() / width;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::expire()
+{
+  const int64_t now = bucket(process::Clock::now());
+
+  // Every bucket before the current one has expired completely, the
+  // current one might only have expired partially.
+  while (!expirations.empty() && expirations.begin()->first <= now) {
+    std::list<Expiration>& entries = expirations.begin()->second;
+
+    typename std::list<Expiration>::iterator iterator = entries.begin();
+    while (iterator != entries.end()) {
+      if (iterator->timeout.remaining() > Seconds(0)) {
+        ++iterator;
+        continue;
+      }
+
+      const FrameworkID& frameworkId = iterator->frameworkId;
+      const SlaveID& slaveId = iterator->slaveId;
+
+      // The filter might have already been removed (e.g., if the
+      // framework no longer exists or in
+      // HierarchicalAllocatorProcess::offersRevived).
+      if (frameworks.contains(frameworkId) &&
+          frameworks[frameworkId].filters.contains(slaveId) &&
+          frameworks[frameworkId].filters[slaveId].contains(iterator->filter)) {
+        frameworks[frameworkId].filters[slaveId].erase(iterator->filter);
+
+        if (frameworks[frameworkId].filters[slaveId].empty()) {
+          frameworks[frameworkId].filters.erase(slaveId);
+        }
+
+        // The filtered resources can be allocated to the framework again.
+        if (slaves.contains(slaveId)) {
+          touch(slaveId);
+        }
+      }
+
+      delete iterator->filter;
+      iterator = entries.erase(iterator);
+    }
+
+    if (!entries.empty()) {
+      break; // The current bucket has not yet expired completely.
+    }
+
+    expirations.erase(expirations.begin());
+  }
 }
 
 
@@ -814,23 +1301,26 @@ template <class RoleSorter, class FrameworkSorter>
 bool
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isFiltered(
     const FrameworkID& frameworkId,
+    const Framework& framework,
     const SlaveID& slaveId,
+    const Slave& slave,
     const Resources& resources)
 {
-  CHECK(frameworks.contains(frameworkId));
-  CHECK(slaves.contains(slaveId));
-
   // Do not offer a non-checkpointing slave's resources to a checkpointing
   // framework. This is a short term fix until the following is resolved:
   // https://issues.apache.org/jira/browse/MESOS-444.
-  if (frameworks[frameworkId].checkpoint && !slaves[slaveId].checkpoint) {
+  if (framework.checkpoint && !slave.checkpoint) {
     VLOG(1) << "Filtered " << resources
             << " on non-checkpointing slave " << slaveId
             << " for checkpointing framework " << frameworkId;
     return true;
   }
 
-  foreach (Filter* filter, frameworks[frameworkId].filters) {
+  if (!framework.filters.contains(slaveId)) {
+    return false;
+  }
+
+  foreach (Filter* filter, framework.filters.find(slaveId)->second) {
     if (filter->filter(slaveId, resources)) {
       VLOG(1) << "Filtered " << resources
               << " on slave " << slaveId
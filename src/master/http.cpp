@@ -17,6 +17,7 @@
  */
 
 #include <iomanip>
+#include <list>
 #include <map>
 #include <sstream>
 #include <string>
@@ -52,6 +53,7 @@ using process::Clock;
 using process::DESCRIPTION;
 using process::Future;
 using process::HELP;
+using process::Owned;
 using process::TLDR;
 using process::USAGE;
 
@@ -61,6 +63,7 @@ using process::http::NotFound;
 using process::http::OK;
 using process::http::TemporaryRedirect;
 
+using std::list;
 using std::map;
 using std::string;
 using std::vector;
@@ -128,8 +131,8 @@ JSON::Object model(const Framework& framework)
   // Model all of the completed tasks of a framework.
   {
     JSON::Array array;
-    foreach (const memory::shared_ptr<Task>& task, framework.completedTasks) {
-      array.values.push_back(model(*task));
+    foreach (const Task& task, framework.completedTasks.tasks()) {
+      array.values.push_back(model(task));
     }
 
     object.values["completed_tasks"] = array;
@@ -358,13 +361,35 @@ Future<Response> Master::Http::stats(const Request& request)
   // Get a count of all active tasks in the cluster i.e., the tasks
   // that are launched (TASK_STAGING, TASK_STARTING, TASK_RUNNING) but
   // haven't reached terminal state yet.
-  // NOTE: This is a gauge representing an instantaneous value.
+  // NOTE: These are gauges representing instantaneous values. Unlike
+  // 'active_tasks', the 'active_tasks_gauge' only counts the tasks of
+  // the registered frameworks, including the tasks in a terminal
+  // state that they still hold.
+  object.values["active_tasks"] =
+    master.stats.activeTasks[TASK_STAGING] +
+    master.stats.activeTasks[TASK_STARTING] +
+    master.stats.activeTasks[TASK_RUNNING];
+
   int active_tasks = 0;
   foreachvalue (Framework* framework, master.frameworks.activated) {
     active_tasks += framework->tasks.size();
   }
   object.values["active_tasks_gauge"] = active_tasks;
 
+  // NOTE: These are gauges of the number of messages queued in each
+  // lane (see '--message_rates' and '--framework_message_rate') and
+  // of the /master/state.json requests (see '--state_request_rate').
+  JSON::Object queues;
+  foreachpair (const string& name,
+               const Owned<Master::Lane>& lane,
+               master.lanes) {
+    queues.values[name] = lane->messages.size();
+  }
+  if (master.stateLimiter.isSome()) {
+    queues.values["/master/state.json"] = master.stateRequests;
+  }
+  object.values["message_queues"] = queues;
+
   // Get total and used (note, not offered) resources in order to
   // compute capacity of scalar resources.
   Resources totalResources;
@@ -601,14 +626,19 @@ Future<Response> Master::Http::tasks(const Request& request)
   }
 
   // Construct task list with both running and finished tasks.
+  // NOTE: The completed tasks are stored serialized, so we need to
+  // keep the deserialized tasks around until we're done.
   vector<const Task*> tasks;
+  list<vector<Task> > completedTasks;
   foreach (const Framework* framework, frameworks) {
     foreachvalue (Task* task, framework->tasks) {
       CHECK_NOTNULL(task);
       tasks.push_back(task);
     }
-    foreach (const memory::shared_ptr<Task>& task, framework->completedTasks) {
-      tasks.push_back(task.get());
+
+    completedTasks.push_back(framework->completedTasks.tasks());
+    foreach (const Task& task, completedTasks.back()) {
+      tasks.push_back(&task);
     }
   }
 
@@ -25,6 +25,7 @@
 #include <list>
 #include <sstream>
 
+#include <process/async.hpp>
 #include <process/defer.hpp>
 #include <process/delay.hpp>
 #include <process/id.hpp>
@@ -61,13 +62,19 @@ using std::vector;
 using process::wait; // Necessary on some OS's to disambiguate.
 using process::Clock;
 using process::Future;
+using process::Message;
+using process::MessageEvent;
 using process::Owned;
 using process::PID;
+using process::RateLimiter;
 using process::Process;
 using process::Promise;
 using process::Time;
+using process::Timeout;
 using process::UPID;
 
+using process::http::Response;
+
 using memory::shared_ptr;
 
 namespace mesos {
@@ -366,6 +373,66 @@ void Master::initialize()
     roles[role] = new Role(roleInfo);
   }
 
+  // Add message rates.
+  if (flags.message_rates.isSome()) {
+    vector<string> tokens =
+      strings::tokenize(flags.message_rates.get(), ",");
+
+    foreach (const std::string& token, tokens) {
+      vector<string> pair = strings::tokenize(token, "=");
+      if (pair.size() != 2) {
+        EXIT(1) << "Invalid message rate: '" << token << "'. --message_rates"
+          " should be of the form 'message=rate,message=rate'\n";
+      }
+
+      double rate = atof(pair[1].c_str());
+      if (rate <= 0) {
+        EXIT(1) << "Invalid message rate: '" << token
+                << "'. Message rates must be positive.";
+      }
+
+      messageRates[pair[0]] = rate;
+    }
+  }
+
+  if (flags.framework_message_rate.isSome()) {
+    if (flags.framework_message_rate.get() <= 0) {
+      EXIT(1) << "Invalid framework message rate: "
+              << flags.framework_message_rate.get()
+              << ". --framework_message_rate must be positive.";
+    }
+
+    // NOTE: LaunchTasksMessage and KillTaskMessage don't wait for a
+    // permit of their own, so they go through right away unless
+    // earlier messages of the scheduler are still queued, in which
+    // case they are handled right after those (see 'Master::visit').
+    unlimitedFrameworkMessages.insert(LaunchTasksMessage().GetTypeName());
+    unlimitedFrameworkMessages.insert(KillTaskMessage().GetTypeName());
+
+    frameworkMessages.insert(SubmitSchedulerRequest().GetTypeName());
+    frameworkMessages.insert(RegisterFrameworkMessage().GetTypeName());
+    frameworkMessages.insert(ReregisterFrameworkMessage().GetTypeName());
+    frameworkMessages.insert(UnregisterFrameworkMessage().GetTypeName());
+    frameworkMessages.insert(DeactivateFrameworkMessage().GetTypeName());
+    frameworkMessages.insert(ResourceRequestMessage().GetTypeName());
+    frameworkMessages.insert(ReviveOffersMessage().GetTypeName());
+    frameworkMessages.insert(FrameworkToExecutorMessage().GetTypeName());
+    frameworkMessages.insert(ReconcileTasksMessage().GetTypeName());
+  }
+
+  if (flags.state_request_rate.isSome()) {
+    if (flags.state_request_rate.get() <= 0) {
+      EXIT(1) << "Invalid state request rate: "
+              << flags.state_request_rate.get()
+              << ". --state_request_rate must be positive.";
+    }
+
+    stateLimiter = Owned<RateLimiter>(
+        new RateLimiter(1, Seconds(1) / flags.state_request_rate.get()));
+  }
+
+  stateRequests = 0;
+
   // Initialize the allocator.
   allocator->initialize(flags, self(), roleInfos);
 
@@ -385,6 +452,9 @@ void Master::initialize()
   stats.tasks[TASK_FAILED] = 0;
   stats.tasks[TASK_KILLED] = 0;
   stats.tasks[TASK_LOST] = 0;
+  for (int i = 0; i < TaskState_ARRAYSIZE; i++) {
+    stats.activeTasks[i] = 0;
+  }
   stats.validStatusUpdates = 0;
   stats.invalidStatusUpdates = 0;
   stats.validFrameworkMessages = 0;
@@ -399,12 +469,14 @@ void Master::initialize()
 
   install<RegisterFrameworkMessage>(
       &Master::registerFramework,
-      &RegisterFrameworkMessage::framework);
+      &RegisterFrameworkMessage::framework,
+      &RegisterFrameworkMessage::batched_status_updates);
 
   install<ReregisterFrameworkMessage>(
       &Master::reregisterFramework,
       &ReregisterFrameworkMessage::framework,
-      &ReregisterFrameworkMessage::failover);
+      &ReregisterFrameworkMessage::failover,
+      &ReregisterFrameworkMessage::batched_status_updates);
 
   install<UnregisterFrameworkMessage>(
       &Master::unregisterFramework,
@@ -447,13 +519,7 @@ void Master::initialize()
       &Master::registerSlave,
       &RegisterSlaveMessage::slave);
 
-  install<ReregisterSlaveMessage>(
-      &Master::reregisterSlave,
-      &ReregisterSlaveMessage::slave_id,
-      &ReregisterSlaveMessage::slave,
-      &ReregisterSlaveMessage::executor_infos,
-      &ReregisterSlaveMessage::tasks,
-      &ReregisterSlaveMessage::completed_frameworks);
+  // NOTE: ReregisterSlaveMessage is handled in 'Master::handle'.
 
   install<UnregisterSlaveMessage>(
       &Master::unregisterSlave,
@@ -464,6 +530,11 @@ void Master::initialize()
       &StatusUpdateMessage::update,
       &StatusUpdateMessage::pid);
 
+  install<StatusUpdatesMessage>(
+      &Master::statusUpdates,
+      &StatusUpdatesMessage::updates,
+      &StatusUpdatesMessage::pids);
+
   install<ReconcileTasksMessage>(
       &Master::reconcileTasks,
       &ReconcileTasksMessage::framework_id,
@@ -495,7 +566,7 @@ void Master::initialize()
         lambda::bind(&Http::roles, http, lambda::_1));
   route("/state.json",
         None(),
-        lambda::bind(&Http::state, http, lambda::_1));
+        lambda::bind(&Master::state, this, lambda::_1));
   route("/stats.json",
         None(),
         lambda::bind(&Http::roles, http, lambda::_1));
@@ -564,6 +635,16 @@ void Master::finalize()
 
   CHECK_EQ(offers.size(), 0UL);
 
+  // Drop the messages that have not been admitted yet.
+  lanes.clear();
+
+  foreachvalue (const std::deque<Message*>& messages, held) {
+    foreach (Message* message, messages) {
+      delete message;
+    }
+  }
+  held.clear();
+
   foreachvalue (Slave* slave, slaves.activated) {
     // Remove tasks that are in the slave but not in any framework.
     // This could happen when the framework has yet to re-register
@@ -608,6 +689,182 @@ void Master::finalize()
 }
 
 
+void Master::visit(const MessageEvent& event)
+{
+  Option<string> name = lane(*event.message);
+
+  if (name.isNone()) {
+    handle(event);
+    return;
+  }
+
+  if (!lanes.contains(name.get())) {
+    double rate = messageRates.contains(event.message->name)
+      ? messageRates[event.message->name]
+      : flags.framework_message_rate.get();
+
+    lanes[name.get()] = Owned<Lane>(new Lane(rate));
+  }
+
+  Owned<Lane> queue = lanes[name.get()];
+
+  // Messages that are not rate limited only wait for the messages
+  // queued ahead of them in the lane.
+  if (queue->messages.empty() &&
+      unlimitedFrameworkMessages.contains(event.message->name)) {
+    handle(event);
+    return;
+  }
+
+  // NOTE: The event owns (and deletes) its message, hence we queue a
+  // copy of it.
+  queue->messages.push_back(new Message(*event.message));
+
+  // Only the message at the head of the lane waits for a permit so
+  // that the messages in a lane are handled in order.
+  if (queue->messages.size() == 1) {
+    queue->limiter->acquire()
+      .onReady(defer(self(), &Master::_visit, name.get()));
+  }
+}
+
+
+void Master::_visit(const string& name)
+{
+  if (!lanes.contains(name)) {
+    return; // The lane has been dropped (e.g., in 'finalize').
+  }
+
+  Owned<Lane> queue = lanes[name];
+
+  CHECK(!queue->messages.empty());
+
+  // NOTE: The event takes ownership of the message.
+  MessageEvent event(queue->messages.front());
+  queue->messages.pop_front();
+
+  handle(event);
+
+  // The messages that are not rate limited and were queued behind
+  // this one are handled right away.
+  while (!queue->messages.empty() &&
+         unlimitedFrameworkMessages.contains(queue->messages.front()->name)) {
+    MessageEvent next(queue->messages.front());
+    queue->messages.pop_front();
+
+    handle(next);
+  }
+
+  if (!queue->messages.empty()) {
+    queue->limiter->acquire()
+      .onReady(defer(self(), &Master::_visit, name));
+  } else {
+    queue->idle = Timeout::in(queue->interval);
+    delay(queue->interval, self(), &Master::drop, name);
+  }
+}
+
+
+Future<Response> Master::state(const process::http::Request& request)
+{
+  if (stateLimiter.isNone()) {
+    return http.state(request);
+  }
+
+  stateRequests++;
+
+  return stateLimiter.get()->acquire()
+    .then(defer(self(), &Master::_state, request));
+}
+
+
+Future<Response> Master::_state(const process::http::Request& request)
+{
+  stateRequests--;
+
+  return http.state(request);
+}
+
+
+void Master::drop(const string& name)
+{
+  if (lanes.contains(name) &&
+      lanes[name]->messages.empty() &&
+      lanes[name]->idle.expired()) {
+    lanes.erase(name);
+  }
+}
+
+
+void Master::handle(const MessageEvent& event)
+{
+  static const string REREGISTER_SLAVE = ReregisterSlaveMessage().GetTypeName();
+
+  const UPID& from = event.message->from;
+
+  // The re-registrations get parsed concurrently, so the messages a
+  // slave sends after its re-registration are held back until the
+  // re-registration has been handled, to keep them in order.
+  if (held.contains(from)) {
+    // NOTE: The event owns (and deletes) its message, hence we hold
+    // a copy of it.
+    held[from].push_back(new Message(*event.message));
+    return;
+  }
+
+  if (event.message->name == REREGISTER_SLAVE) {
+    held.put(from, std::deque<Message*>());
+
+    process::async(&Master::parse, from, event.message->body)
+      .onAny(defer(self(), &Master::parsed, from, lambda::_1));
+    return;
+  }
+
+  ProtobufProcess<Master>::visit(event);
+}
+
+
+void Master::release(const UPID& from)
+{
+  if (!held.contains(from)) {
+    return;
+  }
+
+  std::deque<Message*> messages;
+  std::swap(messages, held[from]);
+  held.erase(from);
+
+  while (!messages.empty()) {
+    // NOTE: The event takes ownership of the message.
+    MessageEvent event(messages.front());
+    messages.pop_front();
+
+    handle(event);
+
+    // Another re-registration holds back the rest of the messages.
+    if (held.contains(from)) {
+      foreach (Message* message, messages) {
+        held[from].push_back(message);
+      }
+      return;
+    }
+  }
+}
+
+
+Option<string> Master::lane(const Message& message) const
+{
+  if (messageRates.contains(message.name)) {
+    return message.name;
+  } else if (frameworkMessages.contains(message.name) ||
+             unlimitedFrameworkMessages.contains(message.name)) {
+    return stringify(message.from);
+  }
+
+  return None();
+}
+
+
 void Master::exited(const UPID& pid)
 {
   foreachvalue (Framework* framework, frameworks.activated) {
@@ -798,14 +1055,19 @@ void Master::detected(const Future<Option<MasterInfo> >& _leader)
 
 void Master::registerFramework(
     const UPID& from,
-    const FrameworkInfo& frameworkInfo)
+    const FrameworkInfo& frameworkInfo,
+    bool batchedStatusUpdates)
 {
   if (authenticating.contains(from)) {
     LOG(INFO) << "Queuing up registration request from " << from
               << " because authentication is still in progress";
 
     authenticating[from]
-      .onReady(defer(self(), &Self::registerFramework, from, frameworkInfo));
+      .onReady(defer(self(),
+                     &Self::registerFramework,
+                     from,
+                     frameworkInfo,
+                     batchedStatusUpdates));
     return;
   }
 
@@ -853,6 +1115,8 @@ void Master::registerFramework(
   Framework* framework =
     new Framework(frameworkInfo, newFrameworkId(), from, Clock::now());
 
+  framework->batchedStatusUpdates = batchedStatusUpdates;
+
   LOG(INFO) << "Registering framework " << framework->id << " at " << from;
 
   bool rootSubmissions = flags.root_submissions;
@@ -874,7 +1138,8 @@ void Master::registerFramework(
 void Master::reregisterFramework(
     const UPID& from,
     const FrameworkInfo& frameworkInfo,
-    bool failover)
+    bool failover,
+    bool batchedStatusUpdates)
 {
   if (authenticating.contains(from)) {
     LOG(INFO) << "Queuing up re-registration request from " << from
@@ -885,7 +1150,8 @@ void Master::reregisterFramework(
                      &Self::reregisterFramework,
                      from,
                      frameworkInfo,
-                     failover));
+                     failover,
+                     batchedStatusUpdates));
     return;
   }
 
@@ -950,6 +1216,7 @@ void Master::reregisterFramework(
       // TODO: Should we check whether the new scheduler has given
       // us a different framework name, user name or executor info?
       LOG(INFO) << "Framework " << frameworkInfo.id() << " failed over";
+      framework->batchedStatusUpdates = batchedStatusUpdates;
       failoverFramework(framework, from);
     } else if (from != framework->pid) {
       LOG(ERROR)
@@ -988,27 +1255,27 @@ void Master::reregisterFramework(
     Framework* framework =
       new Framework(frameworkInfo, frameworkInfo.id(), from, Clock::now());
     framework->reregisteredTime = Clock::now();
+    framework->batchedStatusUpdates = batchedStatusUpdates;
 
     // TODO(benh): Check for root submissions like above!
 
     // Add any running tasks reported by slaves for this framework.
-    foreachvalue (Slave* slave, slaves.activated) {
-      foreachkey (const FrameworkID& frameworkId, slave->tasks) {
-        foreachvalue (Task* task, slave->tasks[frameworkId]) {
-          if (framework->id == task->framework_id()) {
-            framework->addTask(task);
-
-            // Also add the task's executor for resource accounting
-            // if it's still alive on the slave and we've not yet
-            // added it to the framework.
-            if (task->has_executor_id() &&
-                slave->hasExecutor(framework->id, task->executor_id()) &&
-                !framework->hasExecutor(slave->id, task->executor_id())) {
-              const ExecutorInfo& executorInfo =
-                slave->executors[framework->id][task->executor_id()];
-              framework->addExecutor(slave->id, executorInfo);
-            }
-          }
+    if (taskIndex.contains(framework->id)) {
+      foreachvalue (Task* task, taskIndex[framework->id]) {
+        Slave* slave = getSlave(task->slave_id());
+        CHECK_NOTNULL(slave);
+
+        framework->addTask(task);
+
+        // Also add the task's executor for resource accounting
+        // if it's still alive on the slave and we've not yet
+        // added it to the framework.
+        if (task->has_executor_id() &&
+            slave->hasExecutor(framework->id, task->executor_id()) &&
+            !framework->hasExecutor(slave->id, task->executor_id())) {
+          const ExecutorInfo& executorInfo =
+            slave->executors[framework->id][task->executor_id()];
+          framework->addExecutor(slave->id, executorInfo);
         }
       }
     }
@@ -1231,9 +1498,17 @@ struct UniqueTaskIDChecker : TaskInfoVisitor
 
 // Checks that the used resources by a task (and executor if
 // necessary) on each slave does not exceed the total resources
-// offered on that slave
+// offered on that slave. To keep this cheap for many tasks, the
+// scalar resources are accounted for as plain numbers (keyed by name
+// and role) rather than via Resources arithmetic.
 struct ResourceUsageChecker : TaskInfoVisitor
 {
+  ResourceUsageChecker(const Resources& _offered)
+    : offered(_offered)
+  {
+    add(offered, &offeredScalars, &offeredOthers);
+  }
+
   virtual TaskInfoError operator () (
       const TaskInfo& task,
       const Resources& resources,
@@ -1251,13 +1526,15 @@ struct ResourceUsageChecker : TaskInfoVisitor
     }
 
     // Check if this task uses more resources than offered.
-    Resources taskResources = task.resources();
+    hashmap<string, double> scalars;
+    Resources others;
+    add(task.resources(), &scalars, &others);
 
-    if (!((usedResources + taskResources) <= resources)) {
+    if (!fits(scalars, others)) {
       return "Task " + stringify(task.task_id()) + " attempted to use " +
-          stringify(taskResources) + " combined with already used " +
-          stringify(usedResources) + " is greater than offered " +
-          stringify(resources);
+          stringify(Resources(task.resources())) + " combined with already" +
+          " used " + stringify(used()) + " is greater than offered " +
+          stringify(offered);
     }
 
     // Check this task's executor's resources.
@@ -1276,24 +1553,94 @@ struct ResourceUsageChecker : TaskInfoVisitor
       // the task + the executor use more resources than offered.
       if (!executors.contains(task.executor().executor_id())) {
         if (!slave.hasExecutor(framework.id, task.executor().executor_id())) {
-          taskResources += task.executor().resources();
-          if (!((usedResources + taskResources) <= resources)) {
+          add(task.executor().resources(), &scalars, &others);
+          if (!fits(scalars, others)) {
             return "Task " + stringify(task.task_id()) + " + executor attempted" +
-                " to use " + stringify(taskResources) + " combined with" +
-                " already used " + stringify(usedResources) + " is greater" +
-                " than offered " + stringify(resources);
+                " to use " + stringify(Resources(task.resources()) +
+                                       task.executor().resources()) +
+                " combined with already used " + stringify(used()) +
+                " is greater than offered " + stringify(offered);
           }
         }
         executors.insert(task.executor().executor_id());
       }
     }
 
-    usedResources += taskResources;
+    foreachpair (const string& key, double value, scalars) {
+      usedScalars[key] += value;
+    }
+
+    usedOthers += others;
 
     return None();
   }
 
-  Resources usedResources;
+  // Accumulates the specified resources, i.e., each scalar resource
+  // into 'scalars' and all other resources into 'others'.
+  static void add(
+      const Resources& resources,
+      hashmap<string, double>* scalars,
+      Resources* others)
+  {
+    foreach (const Resource& resource, resources) {
+      if (resource.type() == Value::SCALAR) {
+        (*scalars)[key(resource)] += resource.scalar().value();
+      } else {
+        (*others) += resource;
+      }
+    }
+  }
+
+  static string key(const Resource& resource)
+  {
+    return resource.name() + "(" + resource.role() + ")";
+  }
+
+  // Returns true if the specified resources fit into the offered
+  // resources in addition to the resources used so far.
+  bool fits(const hashmap<string, double>& scalars, const Resources& others)
+  {
+    foreachpair (const string& key, double value, scalars) {
+      if (!offeredScalars.contains(key)) {
+        return false;
+      }
+
+      // NOTE: We add up the resources the same way Resources does
+      // so that the outcome is identical to using Resources.
+      const double used = usedScalars.contains(key) ? usedScalars[key] : 0;
+      if (!(used + value <= offeredScalars[key])) {
+        return false;
+      }
+    }
+
+    return others.size() == 0 || (usedOthers + others) <= offeredOthers;
+  }
+
+  // Returns the resources used so far (only used for error messages).
+  Resources used() const
+  {
+    Resources result = usedOthers;
+
+    foreach (const Resource& resource, offered) {
+      if (resource.type() == Value::SCALAR &&
+          usedScalars.contains(key(resource))) {
+        Resource used = resource;
+        used.mutable_scalar()->set_value(usedScalars.get(key(resource)).get());
+        result += used;
+      }
+    }
+
+    return result;
+  }
+
+  const Resources offered;
+
+  hashmap<string, double> offeredScalars;
+  Resources offeredOthers;
+
+  hashmap<string, double> usedScalars;
+  Resources usedOthers;
+
   hashset<ExecutorID> executors;
 };
 
@@ -1315,10 +1662,22 @@ struct ExecutorInfoChecker : TaskInfoVisitor
     }
 
     if (task.has_executor()) {
-      if (slave.hasExecutor(framework.id, task.executor().executor_id())) {
-        const Option<ExecutorInfo> executorInfo =
-          slave.executors.get(framework.id).get().get(task.executor().executor_id());
+      const ExecutorID& executorId = task.executor().executor_id();
+
+      // NOTE: Since all tasks get validated before any of them get
+      // launched we also need to consider the executors of the tasks
+      // validated so far.
+      Option<ExecutorInfo> executorInfo = executors.get(executorId);
 
+      if (executorInfo.isNone() &&
+          slave.hasExecutor(framework.id, executorId)) {
+        executorInfo =
+          slave.executors.get(framework.id).get().get(executorId);
+      }
+
+      if (executorInfo.isNone()) {
+        executors[executorId] = task.executor();
+      } else {
         if (!(task.executor() == executorInfo.get())) {
           return "Task has invalid ExecutorInfo (existing ExecutorInfo"
               " with same ExecutorID is not compatible).\n"
@@ -1335,6 +1694,8 @@ struct ExecutorInfoChecker : TaskInfoVisitor
 
     return None();
   }
+
+  hashmap<ExecutorID, ExecutorInfo> executors;
 };
 
 
@@ -1538,11 +1899,17 @@ void Master::launchTasks(
   Option<SlaveID> slaveId;
 
   // Create offer visitors.
-  list<OfferVisitor*> offerVisitors;
-  offerVisitors.push_back(new ValidOfferChecker());
-  offerVisitors.push_back(new FrameworkChecker());
-  offerVisitors.push_back(new SlaveChecker());
-  offerVisitors.push_back(new UniqueOfferIDChecker());
+  ValidOfferChecker validOfferChecker;
+  FrameworkChecker frameworkChecker;
+  SlaveChecker slaveChecker;
+  UniqueOfferIDChecker uniqueOfferIDChecker;
+
+  OfferVisitor* offerVisitors[] = {
+    &validOfferChecker,
+    &frameworkChecker,
+    &slaveChecker,
+    &uniqueOfferIDChecker
+  };
 
   // Verify and aggregate all offers.
   // Abort offer and task processing if any offer validation failed.
@@ -1572,13 +1939,6 @@ void Master::launchTasks(
     totalResources += getOffer(offerId)->resources();
   }
 
-  // Cleanup visitors.
-  while (!offerVisitors.empty()) {
-    OfferVisitor* visitor = offerVisitors.front();
-    offerVisitors.pop_front();
-    delete visitor;
-  };
-
   // Remove offers.
   foreach (const OfferID& offerId, offerIds) {
     Offer* offer = getOffer(offerId);
@@ -1621,18 +1981,27 @@ void Master::launchTasks(
             << " (" << slave->info.hostname() << ")"
             << " for framework " << framework->id;
 
-  Resources usedResources; // Accumulated resources used.
-
   // Create task visitors.
-  list<TaskInfoVisitor*> taskVisitors;
-  taskVisitors.push_back(new TaskIDChecker());
-  taskVisitors.push_back(new SlaveIDChecker());
-  taskVisitors.push_back(new UniqueTaskIDChecker());
-  taskVisitors.push_back(new ResourceUsageChecker());
-  taskVisitors.push_back(new ExecutorInfoChecker());
-  taskVisitors.push_back(new CheckpointChecker());
-
-  // Loop through each task and check it's validity.
+  TaskIDChecker taskIDChecker;
+  SlaveIDChecker slaveIDChecker;
+  UniqueTaskIDChecker uniqueTaskIDChecker;
+  ResourceUsageChecker resourceUsageChecker(totalResources);
+  ExecutorInfoChecker executorInfoChecker;
+  CheckpointChecker checkpointChecker;
+
+  TaskInfoVisitor* taskVisitors[] = {
+    &taskIDChecker,
+    &slaveIDChecker,
+    &uniqueTaskIDChecker,
+    &resourceUsageChecker,
+    &executorInfoChecker,
+    &checkpointChecker
+  };
+
+  // Validate all of the tasks before launching any of them.
+  vector<const TaskInfo*> validTasks;
+  validTasks.reserve(tasks.size());
+
   foreach (const TaskInfo& task, tasks) {
     // Possible error found while checking task's validity.
     TaskInfoError error = None();
@@ -1646,8 +2015,7 @@ void Master::launchTasks(
     }
 
     if (error.isNone()) {
-      // Task looks good, get it running!
-      usedResources += launchTask(task, framework, slave);
+      validTasks.push_back(&task);
     } else {
       // Error validating task, send a failed status update.
       LOG(WARNING) << "Failed to validate task " << task.task_id()
@@ -1668,6 +2036,13 @@ void Master::launchTasks(
     }
   }
 
+  Resources usedResources; // Accumulated resources used.
+
+  // Tasks look good, get them running!
+  foreach (const TaskInfo* task, validTasks) {
+    usedResources += launchTask(*task, framework, slave);
+  }
+
   // All used resources should be allocatable, enforced by our validators.
   CHECK_EQ(usedResources, usedResources.allocatable());
 
@@ -1682,13 +2057,6 @@ void Master::launchTasks(
         unusedResources,
         filters);
   }
-
-  // Cleanup visitors.
-  while (!taskVisitors.empty()) {
-    TaskInfoVisitor* visitor = taskVisitors.front();
-    taskVisitors.pop_front();
-    delete visitor;
-  };
 }
 
 
@@ -1896,14 +2264,104 @@ void Master::registerSlave(const UPID& from, const SlaveInfo& slaveInfo)
 }
 
 
-void Master::reregisterSlave(
+Try<shared_ptr<const Master::Reregistration> > Master::parse(
     const UPID& from,
-    const SlaveID& slaveId,
-    const SlaveInfo& slaveInfo,
+    const string& body)
+{
+  ReregisterSlaveMessage message;
+  if (!message.ParseFromString(body)) {
+    return Error("Failed to parse re-register slave message from " +
+                 stringify(from));
+  }
+
+  Reregistration* reregistration = new Reregistration();
+  reregistration->from = from;
+  reregistration->slaveId = message.slave_id();
+  reregistration->slaveInfo = message.slave();
+  reregistration->executorInfos =
+    google::protobuf::convert(message.executor_infos());
+  reregistration->tasks = google::protobuf::convert(message.tasks());
+  reregistration->completedFrameworks =
+    google::protobuf::convert(message.completed_frameworks());
+  reregistration->resources =
+    used(reregistration->executorInfos, reregistration->tasks);
+
+  return shared_ptr<const Reregistration>(reregistration);
+}
+
+
+hashmap<FrameworkID, Resources> Master::used(
     const vector<ExecutorInfo>& executorInfos,
-    const vector<Task>& tasks,
-    const vector<Archive::Framework>& completedFrameworks)
+    const vector<Task>& tasks)
+{
+  hashmap<FrameworkID, Resources> resources;
+
+  foreach (const ExecutorInfo& executorInfo, executorInfos) {
+    resources[executorInfo.framework_id()] += executorInfo.resources();
+  }
+
+  foreach (const Task& task, tasks) {
+    // Ignore tasks that have reached terminal state.
+    if (!protobuf::isTerminalState(task.state())) {
+      resources[task.framework_id()] += task.resources();
+    }
+  }
+
+  return resources;
+}
+
+
+void Master::parsed(
+    const UPID& from,
+    const Future<Try<shared_ptr<const Reregistration> > >& reregistration)
+{
+  CHECK(!reregistration.isDiscarded());
+
+  if (reregistration.isFailed()) {
+    LOG(WARNING) << "Ignoring re-register slave message: "
+                 << reregistration.failure();
+    release(from);
+    return;
+  } else if (reregistration.get().isError()) {
+    LOG(WARNING) << "Ignoring re-register slave message: "
+                 << reregistration.get().error();
+    release(from);
+    return;
+  }
+
+  reregistrations.push_back(reregistration.get().get());
+
+  // Re-registrations that get parsed before the batch is handled
+  // join it.
+  if (reregistrations.size() == 1) {
+    dispatch(self(), &Master::reregisterSlaves);
+  }
+}
+
+
+void Master::reregisterSlaves()
+{
+  std::deque<shared_ptr<const Reregistration> > batch;
+  std::swap(batch, reregistrations);
+
+  LOG(INFO) << "Handling a batch of " << batch.size()
+            << " slave re-registrations";
+
+  foreach (const shared_ptr<const Reregistration>& reregistration, batch) {
+    _reregisterSlave(*reregistration);
+    release(reregistration->from);
+  }
+}
+
+
+void Master::_reregisterSlave(const Reregistration& reregistration)
 {
+  const UPID& from = reregistration.from;
+  const SlaveID& slaveId = reregistration.slaveId;
+  const SlaveInfo& slaveInfo = reregistration.slaveInfo;
+  const vector<ExecutorInfo>& executorInfos = reregistration.executorInfos;
+  const vector<Task>& tasks = reregistration.tasks;
+
   if (!elected()) {
     LOG(WARNING) << "Ignoring re-register slave message from "
                  << slaveInfo.hostname() << " since not elected yet";
@@ -1913,7 +2371,7 @@ void Master::reregisterSlave(
   if (slaveId == "") {
     LOG(ERROR) << "Shutting down slave " << from << " that re-registered "
                << "without an id!";
-    reply(ShutdownMessage());
+    send(from, ShutdownMessage());
     return;
   }
 
@@ -1924,7 +2382,7 @@ void Master::reregisterSlave(
     // already informed frameworks that the tasks were lost.
     LOG(ERROR) << "Shutting down slave " << slaveId << " at " << from
                << " that attempted to re-register after deactivation";
-    reply(ShutdownMessage());
+    send(from, ShutdownMessage());
     return;
   }
 
@@ -1953,7 +2411,7 @@ void Master::reregisterSlave(
 
     SlaveReregisteredMessage message;
     message.mutable_slave_id()->MergeFrom(slave->id);
-    reply(message);
+    send(from, message);
 
     // Update the slave pid and relink to it.
     // NOTE: Re-linking the slave here always rather than only when
@@ -1987,7 +2445,11 @@ void Master::reregisterSlave(
     LOG(INFO) << "Attempting to re-register slave " << slave->id << " at "
         << slave->pid << " (" << slave->info.hostname() << ")";
 
-    readdSlave(slave, executorInfos, tasks, completedFrameworks);
+    readdSlave(slave,
+               executorInfos,
+               tasks,
+               reregistration.completedFrameworks,
+               reregistration.resources);
   }
 
   // Send the latest framework pids to the slave.
@@ -2026,6 +2488,33 @@ void Master::unregisterSlave(const SlaveID& slaveId)
 // it generates TASK_LOST messages. Only 'pid' can be used to identify
 // the slave.
 void Master::statusUpdate(const StatusUpdate& update, const UPID& pid)
+{
+  _statusUpdate(update, pid, false);
+}
+
+
+void Master::statusUpdates(
+    const vector<StatusUpdate>& updates,
+    const vector<string>& pids)
+{
+  if (updates.size() != pids.size()) {
+    LOG(WARNING) << "Ignoring " << updates.size() << " status updates"
+                 << " because they don't match the " << pids.size()
+                 << " pids they were sent with";
+    stats.invalidStatusUpdates += updates.size();
+    return;
+  }
+
+  for (size_t i = 0; i < updates.size(); i++) {
+    _statusUpdate(updates[i], UPID(pids[i]), true);
+  }
+}
+
+
+void Master::_statusUpdate(
+    const StatusUpdate& update,
+    const UPID& pid,
+    bool batch)
 {
   const TaskStatus& status = update.status();
 
@@ -2055,7 +2544,7 @@ void Master::statusUpdate(const StatusUpdate& update, const UPID& pid)
     << "(" << slave->info.hostname() << ")";
 
   // Forward the update to the framework.
-  Try<Nothing> _forward = forward(update, pid);
+  Try<Nothing> _forward = forward(update, pid, batch);
   if (_forward.isError()) {
     LOG(WARNING) << "Ignoring status update " << update << " from " << pid
                  << " (" << slave->info.hostname() << "): " << _forward.error();
@@ -2081,7 +2570,10 @@ void Master::statusUpdate(const StatusUpdate& update, const UPID& pid)
     task->mutable_statuses()->RemoveLast();
   }
   task->add_statuses()->CopyFrom(status);
+
+  stats.activeTasks[task->state()]--;
   task->set_state(status.state());
+  stats.activeTasks[task->state()]++;
 
   // Handle the task appropriately if it's terminated.
   if (protobuf::isTerminalState(status.state())) {
@@ -2093,13 +2585,33 @@ void Master::statusUpdate(const StatusUpdate& update, const UPID& pid)
 }
 
 
-Try<Nothing> Master::forward(const StatusUpdate& update, const UPID& pid)
+Try<Nothing> Master::forward(
+    const StatusUpdate& update,
+    const UPID& pid,
+    bool batch)
 {
   Framework* framework = getFramework(update.framework_id());
   if (framework == NULL) {
     return Error("Unknown framework " + stringify(update.framework_id()));
   }
 
+  if (batch && framework->batchedStatusUpdates) {
+    // Batch all the updates (from any slave) for the framework that
+    // get handled before the dispatch below, i.e., those that are
+    // already queued up, so batching doesn't delay any update.
+    if (framework->updates.updates_size() == 0) {
+      dispatch(self(), &Master::_forward, framework->id);
+    }
+
+    framework->updates.add_updates()->MergeFrom(update);
+    framework->updates.add_pids(pid);
+    return Nothing();
+  }
+
+  // Send the batched updates first so that the framework receives
+  // the updates in the order they were handled.
+  _forward(framework->id);
+
   // Pass on the (transformed) status update to the framework.
   StatusUpdateMessage message;
   message.mutable_update()->MergeFrom(update);
@@ -2109,6 +2621,33 @@ Try<Nothing> Master::forward(const StatusUpdate& update, const UPID& pid)
 }
 
 
+void Master::_forward(const FrameworkID& frameworkId)
+{
+  Framework* framework = getFramework(frameworkId);
+
+  // NOTE: Any batched updates of a removed framework are dropped,
+  // just like individual updates would have been.
+  if (framework == NULL || framework->updates.updates_size() == 0) {
+    return;
+  }
+
+  if (framework->batchedStatusUpdates) {
+    send(framework->pid, framework->updates);
+  } else {
+    // The framework failed over to a scheduler (driver) that doesn't
+    // support batching while the updates were batched.
+    for (int i = 0; i < framework->updates.updates_size(); i++) {
+      StatusUpdateMessage message;
+      message.mutable_update()->MergeFrom(framework->updates.updates(i));
+      message.set_pid(framework->updates.pids(i));
+      send(framework->pid, message);
+    }
+  }
+
+  framework->updates.Clear();
+}
+
+
 void Master::exitedExecutor(
     const UPID& from,
     const SlaveID& slaveId,
@@ -2213,6 +2752,29 @@ void Master::reconcileTasks(
   LOG(INFO) << "Performing task state reconciliation for framework "
             << frameworkId;
 
+  _reconcileTasks(
+      frameworkId,
+      memory::shared_ptr<const vector<TaskStatus> >(
+          new vector<TaskStatus>(statuses)),
+      0);
+}
+
+
+void Master::_reconcileTasks(
+    const FrameworkID& frameworkId,
+    const memory::shared_ptr<const vector<TaskStatus> >& statuses,
+    size_t offset)
+{
+  Framework* framework = getFramework(frameworkId);
+  if (framework == NULL) {
+    LOG(WARNING) << "Stopping task state reconciliation for framework "
+                 << frameworkId << " because the framework cannot be found";
+    return;
+  }
+
+  const size_t end = std::min(
+      statuses->size(), offset + MAX_RECONCILIATIONS_PER_BATCH);
+
   // Verify expected task states and send status updates whenever expectations
   // are not met. When:
   //   1) Slave is unknown.*
@@ -2223,28 +2785,35 @@ void Master::reconcileTasks(
   //                    i.e. nothing is sent. To give accurate responses in
   //                    these cases during master fail-over, we need to leverage
   //                    the registrar.
-  foreach (const TaskStatus& status, statuses) {
+  for (size_t i = offset; i < end; i++) {
+    const TaskStatus& status = statuses->at(i);
+
     if (!status.has_slave_id()) {
       LOG(WARNING) << "Status from task " << status.task_id()
                    << " does not include slave id";
       continue;
     }
 
-    Slave* slave = getSlave(status.slave_id());
-    if (slave != NULL) {
-      Task* task = slave->getTask(frameworkId, status.task_id());
-      if (task != NULL && task->state() != status.state()) {
-        const StatusUpdate& update = protobuf::createStatusUpdate(
-          frameworkId,
-          task->slave_id(),
-          task->task_id(),
-          task->state(),
-          "Task state changed");
+    Task* task = getTask(frameworkId, status.task_id());
+    if (task != NULL &&
+        task->slave_id() == status.slave_id() &&
+        task->state() != status.state()) {
+      const StatusUpdate& update = protobuf::createStatusUpdate(
+        frameworkId,
+        task->slave_id(),
+        task->task_id(),
+        task->state(),
+        "Task state changed");
 
-        statusUpdate(update, UPID());
-      }
+      // NOTE: The updates get batched (if the framework supports it),
+      // so each batch of statuses results in a single message.
+      _statusUpdate(update, UPID(), true);
     }
   }
+
+  if (end < statuses->size()) {
+    dispatch(self(), &Master::_reconcileTasks, frameworkId, statuses, end);
+  }
 }
 
 
@@ -2268,6 +2837,29 @@ void Master::frameworkFailoverTimeout(const FrameworkID& frameworkId,
 void Master::offer(const FrameworkID& frameworkId,
                    const hashmap<SlaveID, Resources>& resources)
 {
+  // Rather than sending an offers message for each allocation, we
+  // merge all the allocations for the framework that are handled
+  // before the dispatch below (i.e., those already queued up, for
+  // example when many tasks terminate at once), so there is at most
+  // one offer per slave and one message.
+  if (!offerable.contains(frameworkId)) {
+    dispatch(self(), &Master::_offer, frameworkId);
+  }
+
+  hashmap<SlaveID, Resources>& allocated = offerable[frameworkId];
+  foreachpair (const SlaveID& slaveId, const Resources& offered, resources) {
+    allocated[slaveId] += offered;
+  }
+}
+
+
+void Master::_offer(const FrameworkID& frameworkId)
+{
+  CHECK(offerable.contains(frameworkId));
+
+  const hashmap<SlaveID, Resources> resources = offerable[frameworkId];
+  offerable.erase(frameworkId);
+
   if (!frameworks.activated.contains(frameworkId) ||
       !frameworks.activated[frameworkId]->active) {
     LOG(WARNING) << "Master returning resources offered to framework "
@@ -2311,6 +2903,23 @@ void Master::offer(const FrameworkID& frameworkId,
       continue;
     }
 
+    if (flags.max_offers_per_framework.isSome() &&
+        framework->offers.size() >= flags.max_offers_per_framework.get()) {
+      VLOG(1) << "Master returning resources offered to framework "
+              << frameworkId << " on slave " << slaveId << " because the"
+              << " framework already has " << framework->offers.size()
+              << " outstanding offers";
+
+      // Filter the resources for a couple of allocation intervals so
+      // that the allocator offers them to the other frameworks rather
+      // than (re)allocating them to this framework in every cycle.
+      Filters filters;
+      filters.set_refuse_seconds((flags.allocation_interval * 2).secs());
+
+      allocator->resourcesUnused(frameworkId, slaveId, offered, filters);
+      continue;
+    }
+
     Offer* offer = new Offer();
     offer->mutable_id()->MergeFrom(newOfferId());
     offer->mutable_framework_id()->MergeFrom(framework->id);
@@ -2506,7 +3115,7 @@ Resources Master::launchTask(const TaskInfo& task,
 
   framework->addTask(t);
 
-  slave->addTask(t);
+  addTask(t, slave);
 
   resources += task.resources();
 
@@ -2915,16 +3524,14 @@ void Master::addSlave(Slave* slave, bool reregister)
 void Master::readdSlave(Slave* slave,
     const vector<ExecutorInfo>& executorInfos,
     const vector<Task>& tasks,
-    const vector<Archive::Framework>& completedFrameworks)
+    const vector<Archive::Framework>& completedFrameworks,
+    const hashmap<FrameworkID, Resources>& resources)
 {
   CHECK_NOTNULL(slave);
 
   addSlave(slave, true);
 
-  // Add the executors and tasks to the slave and framework state and
-  // determine the resources that have been allocated to frameworks.
-  hashmap<FrameworkID, Resources> resources;
-
+  // Add the executors and tasks to the slave and framework state.
   foreach (const ExecutorInfo& executorInfo, executorInfos) {
     // TODO(bmahler): ExecutorInfo.framework_id is set by the Scheduler
     // Driver in 0.14.0. Therefore, in 0.15.0, the slave no longer needs
@@ -2944,8 +3551,6 @@ void Master::readdSlave(Slave* slave,
         framework->addExecutor(slave->id, executorInfo);
       }
     }
-
-    resources[executorInfo.framework_id()] += executorInfo.resources();
   }
 
   foreach (const Task& task, tasks) {
@@ -2954,10 +3559,25 @@ void Master::readdSlave(Slave* slave,
       continue;
     }
 
+    // A framework that re-registered before this slave may have
+    // reused the ID of one of the slave's tasks for a task elsewhere
+    // (the master could not tell the ID was taken). The task that
+    // the master knows about already wins.
+    Task* existing = getTask(task.framework_id(), task.task_id());
+    if (existing != NULL) {
+      LOG(WARNING) << "Ignoring task " << task.task_id()
+                   << " of framework " << task.framework_id()
+                   << " reported by re-registering slave " << slave->id
+                   << " (" << slave->info.hostname() << ") because a task"
+                   << " with the same ID is known on slave "
+                   << existing->slave_id();
+      continue;
+    }
+
     Task* t = new Task(task);
 
     // Add the task to the slave.
-    slave->addTask(t);
+    addTask(t, slave);
 
     // Try and add the task to the framework too, but since the
     // framework might not yet be connected we won't be able to
@@ -2976,8 +3596,6 @@ void Master::readdSlave(Slave* slave,
                    << " running on slave " << slave->id << " ("
                    << slave->info.hostname() << ")";
     }
-
-    resources[task.framework_id()] += task.resources();
   }
 
   foreach (const Archive::Framework& completedFramework, completedFrameworks) {
@@ -3045,7 +3663,7 @@ void Master::removeSlave(Slave* slave)
       // status update about this task.  Perhaps in the future what we
       // want to do is create a local Framework object to represent that
       // framework until it fails over. See the TODO above in
-      // Master::reregisterSlave.
+      // Master::_reregisterSlave.
       const StatusUpdate& update = protobuf::createStatusUpdate(
           task->framework_id(),
           task->slave_id(),
@@ -3114,10 +3732,49 @@ void Master::removeSlave(Slave* slave)
 }
 
 
+void Master::addTask(Task* task, Slave* slave)
+{
+  CHECK_NOTNULL(task);
+  CHECK_NOTNULL(slave);
+
+  slave->addTask(task);
+
+  CHECK(!taskIndex[task->framework_id()].contains(task->task_id()))
+    << "Duplicate task " << task->task_id()
+    << " of framework " << task->framework_id();
+
+  taskIndex[task->framework_id()][task->task_id()] = task;
+  stats.activeTasks[task->state()]++;
+}
+
+
+Task* Master::getTask(const FrameworkID& frameworkId, const TaskID& taskId)
+{
+  if (taskIndex.contains(frameworkId) &&
+      taskIndex[frameworkId].contains(taskId)) {
+    return taskIndex[frameworkId][taskId];
+  }
+
+  return NULL;
+}
+
+
 void Master::removeTask(Task* task)
 {
   CHECK_NOTNULL(task);
 
+  // Remove from the index.
+  CHECK(taskIndex[task->framework_id()].contains(task->task_id()))
+    << "Unknown task " << task->task_id()
+    << " of framework " << task->framework_id();
+
+  taskIndex[task->framework_id()].erase(task->task_id());
+  if (taskIndex[task->framework_id()].empty()) {
+    taskIndex.erase(task->framework_id());
+  }
+
+  stats.activeTasks[task->state()]--;
+
   // Remove from framework.
   Framework* framework = getFramework(task->framework_id());
   if (framework != NULL) { // A framework might not be re-connected yet.
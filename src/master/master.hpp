@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <list>
 #include <string>
 #include <vector>
@@ -30,16 +31,21 @@
 #include <mesos/resources.hpp>
 
 #include <process/http.hpp>
+#include <process/limiter.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
+#include <process/timeout.hpp>
 
+#include <stout/bytes.hpp>
+#include <stout/duration.hpp>
 #include <stout/foreach.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
 #include <stout/memory.hpp>
 #include <stout/multihashmap.hpp>
 #include <stout/option.hpp>
+#include <stout/try.hpp>
 
 #include "common/type_utils.hpp"
 
@@ -100,11 +106,13 @@ public:
       const std::string& name);
   void registerFramework(
       const process::UPID& from,
-      const FrameworkInfo& frameworkInfo);
+      const FrameworkInfo& frameworkInfo,
+      bool batchedStatusUpdates);
   void reregisterFramework(
       const process::UPID& from,
       const FrameworkInfo& frameworkInfo,
-      bool failover);
+      bool failover,
+      bool batchedStatusUpdates);
   void unregisterFramework(
       const process::UPID& from,
       const FrameworkID& frameworkId);
@@ -138,19 +146,15 @@ public:
   void registerSlave(
       const process::UPID& from,
       const SlaveInfo& slaveInfo);
-  void reregisterSlave(
-      const process::UPID& from,
-      const SlaveID& slaveId,
-      const SlaveInfo& slaveInfo,
-      const std::vector<ExecutorInfo>& executorInfos,
-      const std::vector<Task>& tasks,
-      const std::vector<Archive::Framework>& completedFrameworks);
 
   void unregisterSlave(
       const SlaveID& slaveId);
   void statusUpdate(
       const StatusUpdate& update,
       const process::UPID& pid);
+  void statusUpdates(
+      const std::vector<StatusUpdate>& updates,
+      const std::vector<std::string>& pids);
   void exitedExecutor(
       const process::UPID& from,
       const SlaveID& slaveId,
@@ -198,6 +202,40 @@ protected:
   virtual void finalize();
   virtual void exited(const process::UPID& pid);
 
+  using ProtobufProcess<Master>::visit;
+
+  // Queues the messages that are subject to admission control (see
+  // '--message_rates' and '--framework_message_rate') in a lane that
+  // releases them at the lane's rate, and handles all other messages
+  // right away.
+  virtual void visit(const process::MessageEvent& event);
+
+  // Handles the next message queued in the lane.
+  void _visit(const std::string& name);
+
+  // Handles a /master/state.json request once it gets admitted (see
+  // '--state_request_rate').
+  process::Future<process::http::Response> state(
+      const process::http::Request& request);
+
+  process::Future<process::http::Response> _state(
+      const process::http::Request& request);
+
+  // Drops the lane if it has stayed drained until it would have
+  // admitted its next message anyway, so that dropping it does not
+  // let a sender exceed the rate.
+  void drop(const std::string& name);
+
+  // Returns the lane the message is queued in, if any.
+  Option<std::string> lane(const process::Message& message) const;
+
+  // Handles an admitted message.
+  void handle(const process::MessageEvent& event);
+
+  // Handles the messages held back while the re-registration of the
+  // slave at 'from' was parsed.
+  void release(const process::UPID& from);
+
   void deactivate(Framework* framework);
 
   // 'promise' is used to signal finish of authentication.
@@ -244,10 +282,51 @@ protected:
   // Add a slave.
   void addSlave(Slave* slave, bool reregister = false);
 
+  // A slave's re-registration. After a failover every slave
+  // re-registers with its full state at once, so the message is
+  // parsed, and the resources in use computed, off the master's thread
+  // (see 'Master::handle') and the re-registrations are then handled
+  // in batches (see 'Master::reregisterSlaves').
+  struct Reregistration
+  {
+    process::UPID from;
+    SlaveID slaveId;
+    SlaveInfo slaveInfo;
+    std::vector<ExecutorInfo> executorInfos;
+    std::vector<Task> tasks;
+    std::vector<Archive::Framework> completedFrameworks;
+
+    // Resources used by the executors and the non-terminal tasks.
+    hashmap<FrameworkID, Resources> resources;
+  };
+
+  // Parses a ReregisterSlaveMessage. Invoked asynchronously.
+  static Try<memory::shared_ptr<const Reregistration> > parse(
+      const process::UPID& from,
+      const std::string& body);
+
+  // Returns the resources used by the executors and the non-terminal
+  // tasks of a re-registering slave.
+  static hashmap<FrameworkID, Resources> used(
+      const std::vector<ExecutorInfo>& executorInfos,
+      const std::vector<Task>& tasks);
+
+  // Queues a parsed re-registration and schedules a batch.
+  void parsed(
+      const process::UPID& from,
+      const process::Future<
+          Try<memory::shared_ptr<const Reregistration> > >& reregistration);
+
+  // Handles all queued re-registrations.
+  void reregisterSlaves();
+
+  void _reregisterSlave(const Reregistration& reregistration);
+
   void readdSlave(Slave* slave,
       const std::vector<ExecutorInfo>& executorInfos,
       const std::vector<Task>& tasks,
-      const std::vector<Archive::Framework>& completedFrameworks);
+      const std::vector<Archive::Framework>& completedFrameworks,
+      const hashmap<FrameworkID, Resources>& resources);
 
   void readdCompletedFramework(const Archive::Framework& completedFramework);
 
@@ -260,11 +339,47 @@ protected:
                        Framework* framework,
                        Slave* slave);
 
+  // Add a task to the slave (and the task index).
+  void addTask(Task* task, Slave* slave);
+
   // Remove a task.
   void removeTask(Task* task);
 
-  // Forwards the update to the framework.
-  Try<Nothing> forward(const StatusUpdate& update, const process::UPID& pid);
+  // Returns the task (on any slave) if it is known.
+  Task* getTask(const FrameworkID& frameworkId, const TaskID& taskId);
+
+  // Reconciles the statuses starting at 'offset', at most
+  // MAX_RECONCILIATIONS_PER_BATCH at a time, dispatching itself for
+  // the remaining ones so other messages get handled in between.
+  void _reconcileTasks(
+      const FrameworkID& frameworkId,
+      const memory::shared_ptr<const std::vector<TaskStatus> >& statuses,
+      size_t offset);
+
+  // Handles the status update, batching it when forwarding to the
+  // framework if 'batch' is true (see 'forward').
+  void _statusUpdate(
+      const StatusUpdate& update,
+      const process::UPID& pid,
+      bool batch);
+
+  // Forwards the update to the framework. If 'batch' is true and the
+  // framework's scheduler driver supports it, the update is batched
+  // with the other updates for the framework that are handled before
+  // the batch is sent (see below).
+  Try<Nothing> forward(
+      const StatusUpdate& update,
+      const process::UPID& pid,
+      bool batch = false);
+
+  // Sends the batched status updates, if any, to the framework.
+  void _forward(const FrameworkID& frameworkId);
+
+  // Offers the resources allocated to the framework (see 'offer')
+  // since the last call, merging the resources of each slave into a
+  // single offer and returning any resources that would exceed the
+  // framework's maximum number of outstanding offers.
+  void _offer(const FrameworkID& frameworkId);
 
   // Remove an offer and optionally rescind the offer as well.
   void removeOffer(Offer* offer, bool rescind = false);
@@ -371,6 +486,15 @@ private:
 
   hashmap<OfferID, Offer*> offers;
 
+  // All tasks on any slave (including the tasks of frameworks that
+  // have not re-registered yet) indexed by framework, so that the
+  // tasks of a framework can be looked up without visiting each slave.
+  hashmap<FrameworkID, hashmap<TaskID, Task*> > taskIndex;
+
+  // Resources allocated to each framework that are waiting to be
+  // offered (see 'Master::_offer').
+  hashmap<FrameworkID, hashmap<SlaveID, Resources> > offerable;
+
   hashmap<std::string, Role*> roles;
 
   // Frameworks that are currently in the process of authentication.
@@ -383,6 +507,57 @@ private:
   // Authenticated frameworks keyed by framework's PID.
   hashset<process::UPID> authenticated;
 
+  // Messages that are admitted at a limited rate, in order.
+  struct Lane
+  {
+    explicit Lane(double rate)
+      : interval(Seconds(1) / rate),
+        limiter(new process::RateLimiter(1, interval)) {}
+
+    ~Lane()
+    {
+      foreach (process::Message* message, messages) {
+        delete message;
+      }
+    }
+
+    const Duration interval;
+    process::Owned<process::RateLimiter> limiter;
+    std::deque<process::Message*> messages;
+
+    // When the lane can be dropped if no more messages got queued
+    // (see 'Master::drop').
+    process::Timeout idle;
+  };
+
+  // Lanes keyed by message name (see '--message_rates') or, for
+  // messages from schedulers, by the scheduler's PID.
+  hashmap<std::string, process::Owned<Lane> > lanes;
+
+  // Messages per second, keyed by message name (see '--message_rates').
+  hashmap<std::string, double> messageRates;
+
+  // Names of the messages that are subject to
+  // '--framework_message_rate'.
+  hashset<std::string> frameworkMessages;
+
+  // Names of the messages from schedulers that skip the rate but
+  // stay in order behind the scheduler's queued messages.
+  hashset<std::string> unlimitedFrameworkMessages;
+
+  // Admits /master/state.json requests (see '--state_request_rate').
+  Option<process::Owned<process::RateLimiter> > stateLimiter;
+
+  // Number of /master/state.json requests waiting to be admitted.
+  size_t stateRequests;
+
+  // Parsed re-registrations waiting for the next batch.
+  std::deque<memory::shared_ptr<const Reregistration> > reregistrations;
+
+  // The messages from the slaves whose re-registration is being
+  // parsed (see 'Master::handle').
+  hashmap<process::UPID, std::deque<process::Message*> > held;
+
   int64_t nextFrameworkId; // Used to give each framework a unique ID.
   int64_t nextOfferId;     // Used to give each slot offer a unique ID.
   int64_t nextSlaveId;     // Used to give each slave a unique ID.
@@ -390,6 +565,7 @@ private:
   // Statistics (initialized in Master::initialize).
   struct {
     uint64_t tasks[TaskState_ARRAYSIZE];
+    uint64_t activeTasks[TaskState_ARRAYSIZE]; // Tasks currently in a state.
     uint64_t validStatusUpdates;
     uint64_t invalidStatusUpdates;
     uint64_t validFrameworkMessages;
@@ -548,6 +724,84 @@ private:
 };
 
 
+// Stores completed tasks compactly, i.e., serialized back to back in
+// a single buffer, keeping at most 'capacity' tasks and 'limit' bytes
+// (evicting the oldest tasks first). The tasks only get deserialized
+// when they are queried.
+class CompletedTasks
+{
+public:
+  CompletedTasks(size_t _capacity, const Bytes& _limit)
+    : capacity(_capacity), limit(_limit), start(0) {}
+
+  void add(const Task& _task)
+  {
+    // Only keep what is needed to model the task (see
+    // 'model(const Task&)'), e.g., the status update data can be large.
+    Task task = _task;
+    for (int i = 0; i < task.statuses_size(); i++) {
+      TaskStatus* status = task.mutable_statuses(i);
+      status->clear_message();
+      status->clear_data();
+      status->clear_slave_id();
+    }
+
+    std::string data;
+    if (!task.SerializeToString(&data)) {
+      LOG(WARNING) << "Failed to store completed task " << task.task_id()
+                   << " of framework " << task.framework_id();
+      return;
+    }
+
+    arena.append(data);
+    sizes.push_back(data.size());
+
+    while (!sizes.empty() &&
+           (sizes.size() > capacity || bytes() > limit)) {
+      start += sizes.front();
+      sizes.pop_front();
+    }
+
+    // Reclaim the space of the evicted tasks once it makes up more
+    // than half of the buffer.
+    if (start > arena.size() / 2) {
+      arena.erase(0, start);
+      start = 0;
+    }
+  }
+
+  // Returns the completed tasks, oldest first.
+  std::vector<Task> tasks() const
+  {
+    std::vector<Task> result;
+    result.reserve(sizes.size());
+
+    size_t offset = start;
+    foreach (size_t size, sizes) {
+      Task task;
+      CHECK(task.ParseFromArray(arena.data() + offset, size))
+        << "Failed to parse completed task";
+      result.push_back(task);
+      offset += size;
+    }
+
+    return result;
+  }
+
+  size_t size() const { return sizes.size(); }
+
+  Bytes bytes() const { return Bytes(arena.size() - start); }
+
+private:
+  const size_t capacity;
+  const Bytes limit;
+
+  std::string arena; // The serialized tasks, oldest first.
+  size_t start; // Offset of the oldest (non-evicted) task in 'arena'.
+  std::deque<size_t> sizes; // The size of each serialized task.
+};
+
+
 // Information about a connected or completed framework.
 struct Framework
 {
@@ -559,9 +813,12 @@ struct Framework
       info(_info),
       pid(_pid),
       active(true),
+      batchedStatusUpdates(false),
       registeredTime(time),
       reregisteredTime(time),
-      completedTasks(MAX_COMPLETED_TASKS_PER_FRAMEWORK) {}
+      completedTasks(
+          MAX_COMPLETED_TASKS_PER_FRAMEWORK,
+          MAX_COMPLETED_TASKS_SIZE_PER_FRAMEWORK) {}
 
   ~Framework() {}
 
@@ -590,7 +847,7 @@ struct Framework
       << "Unknown task " << task->task_id()
       << " of framework " << task->framework_id();
 
-    completedTasks.push_back(memory::shared_ptr<Task>(new Task(*task)));
+    completedTasks.add(*task);
     tasks.erase(task->task_id());
     resources -= task->resources();
   }
@@ -598,7 +855,7 @@ struct Framework
   void addCompletedTask(const Task& task)
   {
     // TODO(adam-mesos): Check if completed task already exists.
-    completedTasks.push_back(memory::shared_ptr<Task>(new Task(task)));
+    completedTasks.add(task);
   }
 
   void addOffer(Offer* offer)
@@ -658,16 +915,20 @@ struct Framework
   process::UPID pid;
 
   bool active; // Turns false when framework is being removed.
+
+  // Whether the scheduler driver understands StatusUpdatesMessage.
+  bool batchedStatusUpdates;
+
+  // Status updates waiting to be sent to the framework as a batch.
+  StatusUpdatesMessage updates;
+
   process::Time registeredTime;
   process::Time reregisteredTime;
   process::Time unregisteredTime;
 
   hashmap<TaskID, Task*> tasks;
 
-  // NOTE: We use a shared pointer for Task because clang doesn't like
-  // Boost's implementation of circular_buffer with Task (Boost
-  // attempts to do some memset's which are unsafe).
-  boost::circular_buffer<memory::shared_ptr<Task> > completedTasks;
+  CompletedTasks completedTasks;
 
   hashset<Offer*> offers; // Active offers for framework.
 
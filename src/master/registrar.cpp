@@ -18,6 +18,7 @@
 
 #include <deque>
 #include <string>
+#include <vector>
 
 #include <process/defer.hpp>
 #include <process/dispatch.hpp>
@@ -28,7 +29,10 @@
 #include <stout/lambda.hpp>
 #include <stout/none.hpp>
 #include <stout/nothing.hpp>
+#include <stout/numify.hpp>
 #include <stout/option.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
 
 #include "common/type_utils.hpp"
 
@@ -52,11 +56,21 @@ using process::wait; // Necessary on some OS's to disambiguate.
 
 using std::deque;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
 namespace master {
 
+// Journal entries are stored as variables named by this prefix
+// followed by their position.
+static const string JOURNAL_PREFIX = "registry.journal.";
+
+// The head of the journal (see Registry::Journal) is stored as this
+// variable.
+static const string JOURNAL_HEAD = "registry.head";
+
+
 // TODO(bmahler): Consider an implementation that pushes the
 // operations to the caller to simplify the interface:
 //
@@ -83,6 +97,7 @@ public:
   RegistrarProcess(const Flags& _flags, State* _state)
     : ProcessBase("registrar"),
       updating(false),
+      entries(0),
       flags(_flags),
       state(_state) {}
 
@@ -115,6 +130,10 @@ private:
     // Sets the promise based on whether the operation was successful.
     bool set() { return Promise<bool>::set(success); }
 
+    // Returns the mutation to record in the journal when this
+    // operation mutates 't'.
+    virtual typename T::Mutation mutation() const = 0;
+
   protected:
     virtual Try<bool> perform(T* t, bool strict) = 0;
 
@@ -134,6 +153,14 @@ private:
       return true;
     }
 
+    virtual Registry::Mutation mutation() const
+    {
+      Registry::Mutation mutation;
+      mutation.set_type(Registry::Mutation::RECOVER);
+      mutation.mutable_master_info()->CopyFrom(info);
+      return mutation;
+    }
+
     const MasterInfo info;
   };
 
@@ -161,6 +188,14 @@ private:
       return true; // Mutation.
     }
 
+    virtual Registry::Mutation mutation() const
+    {
+      Registry::Mutation mutation;
+      mutation.set_type(Registry::Mutation::ADMIT);
+      mutation.mutable_slave_info()->CopyFrom(info);
+      return mutation;
+    }
+
     const SlaveInfo info;
   };
 
@@ -187,6 +222,14 @@ private:
       }
     }
 
+    virtual Registry::Mutation mutation() const
+    {
+      Registry::Mutation mutation;
+      mutation.set_type(Registry::Mutation::READMIT);
+      mutation.mutable_slave_info()->CopyFrom(info);
+      return mutation;
+    }
+
     const SlaveInfo info;
   };
 
@@ -217,13 +260,59 @@ private:
       }
     }
 
+    virtual Registry::Mutation mutation() const
+    {
+      Registry::Mutation mutation;
+      mutation.set_type(Registry::Mutation::REMOVE);
+      mutation.mutable_slave_info()->CopyFrom(info);
+      return mutation;
+    }
+
     const SlaveInfo info;
   };
 
+  // Applies a mutation replayed from the journal to 'registry'.
+  static Try<bool> apply(Registry* registry, const Registry::Mutation& mutation)
+  {
+    // Journaled mutations were already permitted when they were
+    // first performed, so they are always replayed non-strictly.
+    switch (mutation.type()) {
+      case Registry::Mutation::RECOVER:
+        return Recover(mutation.master_info())(registry, false);
+      case Registry::Mutation::ADMIT:
+        return Admit(mutation.slave_info())(registry, false);
+      case Registry::Mutation::READMIT:
+        return Readmit(mutation.slave_info())(registry, false);
+      case Registry::Mutation::REMOVE:
+        return Remove(mutation.slave_info())(registry, false);
+      default:
+        return Error("Unknown mutation type " + stringify(mutation.type()));
+    }
+  }
+
+  // Returns the name of the variable storing the journal entry at
+  // the specified position.
+  static string journal(uint64_t position)
+  {
+    return JOURNAL_PREFIX + stringify(position);
+  }
+
+  // The latest Registry, versioned against the latest snapshot. Note
+  // that the Registry contains the journal entries that have been
+  // appended since that snapshot was stored.
   Option<Variable<Registry> > variable;
+
+  // The head of the journal. Its version changes with every journal
+  // entry appended and snapshot taken, so that a registrar that is
+  // not up to date (e.g., after losing leadership) cannot append.
+  Option<Variable<Registry::Journal> > head;
+
   deque<Operation<Registry>*> operations;
   bool updating; // Used to signify fetching (recovering) or storing.
 
+  // Number of journal entries appended since the latest snapshot.
+  size_t entries;
+
   // Continuations.
   void _recover(
       const MasterInfo& info,
@@ -233,12 +322,33 @@ private:
   Future<bool> _readmit(const SlaveInfo& info);
   Future<bool> _remove(const SlaveInfo& info);
 
-  // Helper for updating state (performing store).
+  // Helpers for replaying the journal on top of the snapshot.
+  void replay(const MasterInfo& info);
+  void _replay(
+      const MasterInfo& info,
+      const Future<Variable<Registry::Journal> >& journal);
+  void __replay(
+      const MasterInfo& info,
+      const Future<Variable<Registry::Journal> >& head);
+
+  // Helper for updating state (appending a journal entry).
   void update();
+  Future<Option<vector<Variable<Registry::Journal> > > > append(
+      const Registry::Journal& entry,
+      const Variable<Registry::Journal>& variable);
   void _update(
-      const Future<Option<Variable<Registry> > >& store,
+      const Registry& registry,
+      const Future<Option<vector<Variable<Registry::Journal> > > >& store,
       deque<Operation<Registry>*> operations);
 
+  // Helpers for storing a snapshot of the Registry and expunging
+  // the journal entries it subsumes.
+  void snapshot();
+  void _snapshot(const Future<Option<Variable<Registry> > >& store);
+  void __snapshot(const Future<Option<Variable<Registry::Journal> > >& store);
+  void compact(uint64_t position, const Future<vector<string> >& names);
+  Future<bool> expunge(const Variable<Registry::Journal>& variable);
+
   const Flags flags;
   State* state;
 
@@ -267,27 +377,123 @@ void RegistrarProcess::_recover(
     const MasterInfo& info,
     const Future<Variable<Registry> >& recovery)
 {
-  updating = false;
-
   CHECK(!recovery.isPending());
 
   if (!recovery.isReady()) {
+    updating = false;
     recovered.get()->fail("Failed to recover registrar: " +
         (recovery.isFailed() ? recovery.failure() : "discarded"));
   } else {
-    LOG(INFO) << "Successfully recovered registrar";
-
-    // Save the registry.
+    // Save the snapshot and replay the journal on top of it.
     variable = recovery.get();
+    entries = 0;
 
-    // Perform the Recover operation to add the new MasterInfo.
-    Operation<Registry>* operation = new Recover(info);
-    operations.push_back(operation);
-    operation->future()
-      .onAny(defer(self(), &Self::__recover, lambda::_1));
+    replay(info);
+  }
+}
 
-    update();
+
+void RegistrarProcess::replay(const MasterInfo& info)
+{
+  CHECK_SOME(variable);
+
+  state->fetch<Registry::Journal>(journal(variable.get().get().position() + 1))
+    .onAny(defer(self(), &Self::_replay, info, lambda::_1));
+}
+
+
+void RegistrarProcess::_replay(
+    const MasterInfo& info,
+    const Future<Variable<Registry::Journal> >& journal)
+{
+  CHECK(!journal.isPending());
+  CHECK_SOME(variable);
+
+  if (!journal.isReady()) {
+    updating = false;
+    recovered.get()->fail("Failed to recover registrar: "
+        "Failed to replay journal: " +
+        (journal.isFailed() ? journal.failure() : "discarded"));
+    return;
+  }
+
+  Registry registry = variable.get().get();
+  const Registry::Journal& entry = journal.get().get();
+
+  // An entry without a position has not been written, i.e., we have
+  // reached the end of the journal.
+  if (entry.has_position()) {
+    if (entry.position() != registry.position() + 1) {
+      updating = false;
+      recovered.get()->fail("Failed to recover registrar: "
+          "Failed to replay journal: Expecting position " +
+          stringify(registry.position() + 1) + " but found " +
+          stringify(entry.position()));
+      return;
+    }
+
+    foreach (const Registry::Mutation& mutation, entry.mutations()) {
+      Try<bool> result = apply(&registry, mutation);
+      if (result.isError()) {
+        updating = false;
+        recovered.get()->fail("Failed to recover registrar: "
+            "Failed to replay journal: " + result.error());
+        return;
+      }
+    }
+
+    registry.set_position(entry.position());
+    variable = variable.get().mutate(registry);
+    entries++;
+
+    replay(info);
+    return;
+  }
+
+  state->fetch<Registry::Journal>(JOURNAL_HEAD)
+    .onAny(defer(self(), &Self::__replay, info, lambda::_1));
+}
+
+
+void RegistrarProcess::__replay(
+    const MasterInfo& info,
+    const Future<Variable<Registry::Journal> >& head)
+{
+  CHECK(!head.isPending());
+  CHECK_SOME(variable);
+
+  if (!head.isReady()) {
+    updating = false;
+    recovered.get()->fail("Failed to recover registrar: "
+        "Failed to fetch the head of the journal: " +
+        (head.isFailed() ? head.failure() : "discarded"));
+    return;
   }
+
+  // The journal entries up to the head must all have been replayed.
+  if (head.get().get().position() > variable.get().get().position()) {
+    updating = false;
+    recovered.get()->fail("Failed to recover registrar: "
+        "Failed to replay journal: Expecting entries up to position " +
+        stringify(head.get().get().position()) + " but found " +
+        stringify(variable.get().get().position()));
+    return;
+  }
+
+  this->head = head.get();
+
+  LOG(INFO) << "Successfully recovered registrar (replayed " << entries
+            << " journal entries)";
+
+  updating = false;
+
+  // Perform the Recover operation to add the new MasterInfo.
+  Operation<Registry>* operation = new Recover(info);
+  operations.push_back(operation);
+  operation->future()
+    .onAny(defer(self(), &Self::__recover, lambda::_1));
+
+  update();
 }
 
 
@@ -415,24 +621,65 @@ void RegistrarProcess::update()
 
   Registry registry = variable.get().get();
 
+  // Only the mutations are persisted, as the next journal entry.
+  Registry::Journal entry;
+  entry.set_position(registry.position() + 1);
+
   foreach (Operation<Registry>* operation, operations) {
-    // No need to process the result of the operation.
-    (*operation)(&registry, flags.registry_strict);
+    Try<bool> result = (*operation)(&registry, flags.registry_strict);
+    if (result.isSome() && result.get()) {
+      entry.add_mutations()->CopyFrom(operation->mutation());
+    }
   }
 
+  registry.set_position(entry.position());
+
   // TODO(benh): Add a timeout so we don't wait forever.
 
   // Perform the store!
-  state->store(variable.get().mutate(registry))
-    .onAny(defer(self(), &Self::_update, lambda::_1, operations));
+  state->fetch<Registry::Journal>(journal(entry.position()))
+    .then(defer(self(), &Self::append, entry, lambda::_1))
+    .onAny(defer(self(), &Self::_update, registry, lambda::_1, operations));
 
   // Clear the operations, _update will transition the Promises!
   operations.clear();
 }
 
 
+Future<Option<vector<Variable<Registry::Journal> > > >
+RegistrarProcess::append(
+    const Registry::Journal& entry,
+    const Variable<Registry::Journal>& variable)
+{
+  CHECK_SOME(head);
+
+  // A journal entry is written exactly once, so if one already exists
+  // at this position another registrar must have appended it. Nor is
+  // one ever written at or below the position of the latest snapshot
+  // as it may have been expunged already (in which case it appears
+  // to not have been written).
+  if (variable.get().has_position() ||
+      entry.position() <= head.get().get().snapshot()) {
+    return Option<vector<Variable<Registry::Journal> > >::none();
+  }
+
+  Registry::Journal marker = head.get().get();
+  marker.set_position(entry.position());
+
+  // Store the entry along with the head of the journal, so that the
+  // entry is only stored if no other registrar has appended or taken
+  // a snapshot since we last did.
+  vector<Variable<Registry::Journal> > variables;
+  variables.push_back(variable.mutate(entry));
+  variables.push_back(head.get().mutate(marker));
+
+  return state->store(variables);
+}
+
+
 void RegistrarProcess::_update(
-    const Future<Option<Variable<Registry> > >& store,
+    const Registry& registry,
+    const Future<Option<vector<Variable<Registry::Journal> > > >& store,
     deque<Operation<Registry>*> operations)
 {
   updating = false;
@@ -445,7 +692,10 @@ void RegistrarProcess::_update(
     LOG(WARNING) << "Failed to update 'registry': version mismatch";
   } else {
     LOG(INFO) << "Successfully updated 'registry'";
-    variable = store.get().get();
+    CHECK_SOME(variable);
+    variable = variable.get().mutate(registry);
+    head = store.get().get().back();
+    entries++;
   }
 
   // Remove the operations.
@@ -469,12 +719,134 @@ void RegistrarProcess::_update(
 
   operations.clear();
 
+  // Snapshot once enough journal entries have accumulated, which
+  // gates any further updates until the snapshot has been stored.
+  if (store.isReady() &&
+      store.get().isSome() &&
+      entries >= flags.registry_journal_entries) {
+    snapshot();
+    return;
+  }
+
   if (!this->operations.empty()) {
     update();
   }
 }
 
 
+void RegistrarProcess::snapshot()
+{
+  CHECK(!updating);
+
+  updating = true;
+
+  CHECK_SOME(variable);
+
+  LOG(INFO) << "Attempting to snapshot the 'registry' at journal position "
+            << variable.get().get().position();
+
+  state->store(variable.get())
+    .onAny(defer(self(), &Self::_snapshot, lambda::_1));
+}
+
+
+void RegistrarProcess::_snapshot(
+    const Future<Option<Variable<Registry> > >& store)
+{
+  // The journal entries remain the source of truth until a snapshot
+  // has been stored, so a failure here only delays compaction.
+  if (!store.isReady()) {
+    LOG(ERROR) << "Failed to snapshot 'registry': "
+               << (store.isFailed() ? store.failure() : "discarded");
+  } else if (store.get().isNone()) {
+    LOG(WARNING) << "Failed to snapshot 'registry': version mismatch";
+  } else {
+    LOG(INFO) << "Successfully snapshotted 'registry'";
+    variable = store.get().get();
+    entries = 0;
+
+    // Record the snapshot in the head of the journal before expunging
+    // any journal entries, so that no registrar can append at their
+    // positions anymore. This keeps gating updates as appending would
+    // change the head concurrently.
+    CHECK_SOME(head);
+    Registry::Journal marker = head.get().get();
+    marker.set_snapshot(variable.get().get().position());
+
+    state->store(head.get().mutate(marker))
+      .onAny(defer(self(), &Self::__snapshot, lambda::_1));
+    return;
+  }
+
+  updating = false;
+
+  if (!operations.empty()) {
+    update();
+  }
+}
+
+
+void RegistrarProcess::__snapshot(
+    const Future<Option<Variable<Registry::Journal> > >& store)
+{
+  updating = false;
+
+  if (!store.isReady()) {
+    LOG(ERROR) << "Failed to update the head of the 'registry' journal: "
+               << (store.isFailed() ? store.failure() : "discarded");
+  } else if (store.get().isNone()) {
+    LOG(WARNING) << "Failed to update the head of the 'registry' journal: "
+                 << "version mismatch";
+  } else {
+    head = store.get().get();
+
+    // Expunge the journal entries subsumed by the snapshot in the
+    // background, including any left behind by a previous master.
+    state->names()
+      .onAny(defer(self(),
+                   &Self::compact,
+                   head.get().get().snapshot(),
+                   lambda::_1));
+  }
+
+  if (!operations.empty()) {
+    update();
+  }
+}
+
+
+void RegistrarProcess::compact(
+    uint64_t position,
+    const Future<vector<string> >& names)
+{
+  if (!names.isReady()) {
+    LOG(WARNING) << "Failed to compact the 'registry' journal: "
+                 << (names.isFailed() ? names.failure() : "discarded");
+    return;
+  }
+
+  foreach (const string& name, names.get()) {
+    if (!strings::startsWith(name, JOURNAL_PREFIX)) {
+      continue;
+    }
+
+    Try<uint64_t> entry =
+      numify<uint64_t>(name.substr(JOURNAL_PREFIX.size()));
+    if (entry.isSome() && entry.get() <= position) {
+      state->fetch<Registry::Journal>(name)
+        .then(defer(self(), &Self::expunge, lambda::_1));
+    }
+  }
+}
+
+
+Future<bool> RegistrarProcess::expunge(
+    const Variable<Registry::Journal>& variable)
+{
+  return state->expunge(variable);
+}
+
+
 Registrar::Registrar(const Flags& flags, State* state)
 {
   process = new RegistrarProcess(flags, state);
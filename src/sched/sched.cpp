@@ -155,6 +155,11 @@ protected:
         &StatusUpdateMessage::update,
         &StatusUpdateMessage::pid);
 
+    install<StatusUpdatesMessage>(
+        &SchedulerProcess::statusUpdates,
+        &StatusUpdatesMessage::updates,
+        &StatusUpdatesMessage::pids);
+
     install<LostSlaveMessage>(
         &SchedulerProcess::lostSlave,
         &LostSlaveMessage::slave_id);
@@ -464,12 +469,14 @@ protected:
       // Touched for the very first time.
       RegisterFrameworkMessage message;
       message.mutable_framework()->MergeFrom(framework);
+      message.set_batched_status_updates(true);
       send(master.get(), message);
     } else {
       // Not the first time, or failing over.
       ReregisterFrameworkMessage message;
       message.mutable_framework()->MergeFrom(framework);
       message.set_failover(failover);
+      message.set_batched_status_updates(true);
       send(master.get(), message);
     }
 
@@ -647,6 +654,119 @@ protected:
     send(pid, message);
   }
 
+  void statusUpdates(
+      const UPID& from,
+      const vector<StatusUpdate>& updates,
+      const vector<string>& pids)
+  {
+    if (aborted) {
+      VLOG(1) << "Ignoring task status updates message because "
+              << "the driver is aborted!";
+      return;
+    }
+
+    if (!connected) {
+      VLOG(1) << "Ignoring status updates message because the driver is "
+              << "disconnected!";
+      return;
+    }
+
+    CHECK_SOME(master);
+
+    if (from != master.get()) {
+      VLOG(1) << "Ignoring status updates message because it was sent "
+              << "from '" << from << "' instead of the leading master '"
+              << master.get() << "'";
+      return;
+    }
+
+    VLOG(2) << "Received " << updates.size() << " status updates";
+
+    CHECK(updates.size() == pids.size());
+
+    // The updates that need to be acknowledged (and where to).
+    vector<StatusUpdate> acknowledgeable;
+    vector<UPID> acknowledgees;
+
+    for (size_t i = 0; i < updates.size(); i++) {
+      // The scheduler might abort the driver in one of the callbacks
+      // below, in which case we don't deliver the rest of the updates
+      // (just like when receiving them one at a time).
+      if (aborted) {
+        VLOG(1) << "Ignoring the remaining " << updates.size() - i
+                << " status updates because the driver is aborted!";
+        break;
+      }
+
+      const StatusUpdate& update = updates[i];
+
+      VLOG(2) << "Received status update " << update << " from " << pids[i];
+
+      CHECK(framework.id() == update.framework_id());
+
+      Stopwatch stopwatch;
+      if (FLAGS_v >= 1) {
+        stopwatch.start();
+      }
+
+      scheduler->statusUpdate(driver, update.status());
+
+      VLOG(1) << "Scheduler::statusUpdate took " << stopwatch.elapsed();
+
+      UPID pid(pids[i]);
+      if (pid != UPID()) {
+        acknowledgeable.push_back(update);
+        acknowledgees.push_back(pid);
+      }
+    }
+
+    // Acknowledge the status updates (see 'statusUpdate' above for
+    // why we dispatch instead of sending the ACKs directly).
+    if (!acknowledgeable.empty()) {
+      dispatch(self(),
+               &Self::statusUpdateAcknowledgements,
+               acknowledgeable,
+               acknowledgees);
+    }
+  }
+
+  void statusUpdateAcknowledgements(
+      const vector<StatusUpdate>& updates,
+      const vector<UPID>& pids)
+  {
+    if (aborted) {
+      VLOG(1) << "Not sending status update acknowledgments message because "
+              << "the driver is aborted!";
+      return;
+    }
+
+    CHECK(updates.size() == pids.size());
+
+    // Send one message with all the ACKs for each pid.
+    hashmap<UPID, StatusUpdateAcknowledgementsMessage> messages;
+
+    for (size_t i = 0; i < updates.size(); i++) {
+      const StatusUpdate& update = updates[i];
+
+      VLOG(2) << "Sending ACK for status update " << update
+              << " to " << pids[i];
+
+      StatusUpdateAcknowledgementMessage* message =
+        messages[pids[i]].add_acknowledgements();
+
+      message->mutable_framework_id()->MergeFrom(framework.id());
+      message->mutable_slave_id()->MergeFrom(update.slave_id());
+      message->mutable_task_id()->MergeFrom(update.status().task_id());
+      message->set_uuid(update.uuid());
+    }
+
+    foreachpair (const UPID& pid,
+                 const StatusUpdateAcknowledgementsMessage& message,
+                 messages) {
+      send(pid, message);
+    }
+  }
+
   void lostSlave(const UPID& from, const SlaveID& slaveId)
   {
     if (aborted) {
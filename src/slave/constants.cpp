@@ -31,9 +31,15 @@ const Duration STATUS_UPDATE_RETRY_INTERVAL_MIN = Seconds(10);
 const Duration STATUS_UPDATE_RETRY_INTERVAL_MAX = Minutes(10);
 const Duration GC_DELAY = Weeks(1);
 const double GC_DISK_HEADROOM = 0.1;
+const uint32_t GC_WORKERS = 4;
+const uint32_t ORPHAN_CLEANUP_PARALLELISM = 8;
 const Duration DISK_WATCH_INTERVAL = Minutes(1);
+const Duration CONTAINER_DISK_WATCH_INTERVAL = Seconds(15);
+const uint32_t DISK_SCAN_BATCH_SIZE = 1000;
+const Duration DISK_SCAN_BATCH_INTERVAL = Milliseconds(100);
 const Duration RECOVERY_TIMEOUT = Minutes(15);
 const Duration RESOURCE_MONITORING_INTERVAL = Seconds(1);
+const uint32_t MAX_STATUS_UPDATES_PER_BATCH = 1000;
 const uint32_t MAX_COMPLETED_FRAMEWORKS = 50;
 const uint32_t MAX_COMPLETED_EXECUTORS_PER_FRAMEWORK = 150;
 const uint32_t MAX_COMPLETED_TASKS_PER_EXECUTOR = 200;
@@ -41,6 +47,7 @@ const double DEFAULT_CPUS = 1;
 const Bytes DEFAULT_MEM = Gigabytes(1);
 const Bytes DEFAULT_DISK = Gigabytes(10);
 const std::string DEFAULT_PORTS = "[31000-32000]";
+const Bytes FETCHER_CACHE_SIZE = Bytes(0);
 
 } // namespace slave {
 } // namespace internal {
@@ -42,11 +42,29 @@ extern const Duration STATUS_UPDATE_RETRY_INTERVAL_MIN;
 extern const Duration STATUS_UPDATE_RETRY_INTERVAL_MAX;
 extern const Duration GC_DELAY;
 extern const Duration DISK_WATCH_INTERVAL;
+extern const Duration CONTAINER_DISK_WATCH_INTERVAL;
 extern const Duration RESOURCE_MONITORING_INTERVAL;
 
 // Minimum free disk capacity enforced by the garbage collector.
 extern const double GC_DISK_HEADROOM;
 
+// Maximum number of paths the garbage collector removes at once,
+// each in a thread of its own.
+extern const uint32_t GC_WORKERS;
+
+// Maximum number of orphaned containers cleaned up at once after
+// recovery.
+extern const uint32_t ORPHAN_CLEANUP_PARALLELISM;
+
+// Maximum number of directory entries examined at once when scanning
+// the disk usage of sandboxes, and the minimum time between two such
+// batches. Together they bound the IO spent on disk usage accounting.
+extern const uint32_t DISK_SCAN_BATCH_SIZE;
+extern const Duration DISK_SCAN_BATCH_INTERVAL;
+
+// Maximum number of status updates sent to the master in one batch.
+extern const uint32_t MAX_STATUS_UPDATES_PER_BATCH;
+
 // Maximum number of completed frameworks to store in memory.
 extern const uint32_t MAX_COMPLETED_FRAMEWORKS;
 
@@ -68,6 +86,10 @@ extern const Bytes DEFAULT_DISK;
 // Default ports range offered by the slave.
 extern const std::string DEFAULT_PORTS;
 
+// Default size of the cache of fetched executor URIs. The cache is
+// off by default since its disk use is not accounted for.
+extern const Bytes FETCHER_CACHE_SIZE;
+
 } // namespace slave {
 } // namespace internal {
 } // namespace mesos {
@@ -27,6 +27,8 @@
 
 #include "mesos/resources.hpp"
 
+#include "slave/constants.hpp"
+
 #include "slave/containerizer/cgroups_launcher.hpp"
 
 using namespace process;
@@ -112,9 +114,7 @@ Try<Nothing> CgroupsLauncher::recover(const std::list<state::RunState>& states)
 
   foreach (const string& orphan, orphans.get()) {
     if (!cgroups.contains(orphan)) {
-      LOG(INFO) << "Removing orphaned cgroup"
-                << " '" << path::join("freezer", orphan) << "'";
-      cgroups::destroy(hierarchy, orphan);
+      this->orphans.push_back(orphan);
     }
   }
 
@@ -122,19 +122,38 @@ Try<Nothing> CgroupsLauncher::recover(const std::list<state::RunState>& states)
 }
 
 
-Try<pid_t> CgroupsLauncher::fork(
-    const ContainerID& containerId,
-    const lambda::function<int()>& inChild)
+Future<Nothing> CgroupsLauncher::cleanupOrphans()
 {
-  // Create a freezer cgroup for this container if necessary.
-  Try<bool> exists = cgroups::exists(hierarchy, cgroup(containerId));
+  foreach (const string& orphan, orphans) {
+    LOG(INFO) << "Removing orphaned cgroup"
+              << " '" << path::join("freezer", orphan) << "'";
+  }
+
+  // Kill and remove the orphans a few at a time rather than freezing
+  // all of them at once.
+  Future<Nothing> future =
+    cgroups::destroy(hierarchy, orphans, ORPHAN_CLEANUP_PARALLELISM);
+
+  orphans.clear();
+
+  return future;
+}
+
+
+// Creates the freezer cgroup of a container if necessary.
+static Try<Nothing> createCgroup(
+    const string& hierarchy,
+    const string& cgroup,
+    const ContainerID& containerId)
+{
+  Try<bool> exists = cgroups::exists(hierarchy, cgroup);
 
   if (exists.isError()) {
     return Error("Failed to create freezer cgroup: " + exists.error());
   }
 
   if (!exists.get()) {
-    Try<Nothing> created = cgroups::create(hierarchy, cgroup(containerId));
+    Try<Nothing> created = cgroups::create(hierarchy, cgroup);
 
     if (created.isError()) {
       LOG(ERROR) << "Failed to create freezer cgroup for container '"
@@ -143,6 +162,21 @@ Try<pid_t> CgroupsLauncher::fork(
     }
   }
 
+  return Nothing();
+}
+
+
+Try<pid_t> CgroupsLauncher::fork(
+    const ContainerID& containerId,
+    const lambda::function<int()>& inChild)
+{
+  // Create a freezer cgroup for this container if necessary.
+  Try<Nothing> created =
+    createCgroup(hierarchy, cgroup(containerId), containerId);
+  if (created.isError()) {
+    return Error(created.error());
+  }
+
   // Additional processes forked will be put into the same process group and
   // session.
   Option<pid_t> pgid = pids.get(containerId);
@@ -237,6 +271,36 @@ Try<pid_t> CgroupsLauncher::fork(
 }
 
 
+Try<Nothing> CgroupsLauncher::adopt(const ContainerID& containerId, pid_t pid)
+{
+  if (pids.contains(containerId)) {
+    return Error("Process has already been forked for container " +
+                 stringify(containerId));
+  }
+
+  Try<Nothing> created =
+    createCgroup(hierarchy, cgroup(containerId), containerId);
+  if (created.isError()) {
+    return created;
+  }
+
+  // Move the process into the freezer cgroup. Any children it forks
+  // once let run will also be contained in the cgroup.
+  Try<Nothing> assign = cgroups::assign(hierarchy, cgroup(containerId), pid);
+
+  if (assign.isError()) {
+    LOG(ERROR) << "Failed to assign process " << pid
+                << " of container '" << containerId << "'"
+                << " to its freezer cgroup: " << assign.error();
+    return Error("Failed to contain process");
+  }
+
+  pids.put(containerId, pid);
+
+  return Nothing();
+}
+
+
 Future<Nothing> _destroy(
     const ContainerID& containerId,
     process::Future<bool> destroyed)
@@ -19,6 +19,9 @@
 #ifndef __CGROUPS_LAUNCHER_HPP__
 #define __CGROUPS_LAUNCHER_HPP__
 
+#include <string>
+#include <vector>
+
 #include "slave/containerizer/launcher.hpp"
 
 namespace mesos {
@@ -36,10 +39,14 @@ public:
 
   virtual Try<Nothing> recover(const std::list<state::RunState>& states);
 
+  virtual process::Future<Nothing> cleanupOrphans();
+
   virtual Try<pid_t> fork(
       const ContainerID& containerId,
       const lambda::function<int()>& inChild);
 
+  virtual Try<Nothing> adopt(const ContainerID& containerId, pid_t pid);
+
   virtual process::Future<Nothing> destroy(const ContainerID& containerId);
 
 private:
@@ -54,6 +61,9 @@ private:
   // The 'pid' is the process id of the first process and also the process
   // group id and session id.
   hashmap<ContainerID, pid_t> pids;
+
+  // The freezer cgroups of orphaned containers found by recover().
+  std::vector<std::string> orphans;
 };
 
 
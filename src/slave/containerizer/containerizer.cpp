@@ -37,8 +37,10 @@
 #include "slave/containerizer/containerizer.hpp"
 #include "slave/containerizer/isolator.hpp"
 #include "slave/containerizer/launcher.hpp"
+#include "slave/containerizer/launcher_helper.hpp"
 #include "slave/containerizer/mesos_containerizer.hpp"
 
+#include "slave/containerizer/isolators/disk.hpp"
 #include "slave/containerizer/isolators/posix.hpp"
 #ifdef __linux__
 #include "slave/containerizer/isolators/cgroups/cpushare.hpp"
@@ -184,6 +186,7 @@ Try<Containerizer*> Containerizer::create(
 
   creators["posix/cpu"]   = &PosixCpuIsolatorProcess::create;
   creators["posix/mem"]   = &PosixMemIsolatorProcess::create;
+  creators["posix/disk"]  = &PosixDiskIsolatorProcess::create;
 #ifdef __linux__
   creators["cgroups/cpu"] = &CgroupsCpushareIsolatorProcess::create;
   creators["cgroups/mem"] = &CgroupsMemIsolatorProcess::create;
@@ -216,8 +219,17 @@ Try<Containerizer*> Containerizer::create(
     return Error("Failed to create launcher: " + launcher.error());
   }
 
+  Option<Owned<LauncherHelper> > helper;
+  if (flags.launcher_helper) {
+    Try<LauncherHelper*> create = LauncherHelper::create(flags);
+    if (create.isError()) {
+      return Error("Failed to create launcher helper: " + create.error());
+    }
+    helper = Owned<LauncherHelper>(create.get());
+  }
+
   return new MesosContainerizer(
-      flags, local, Owned<Launcher>(launcher.get()), isolators);
+      flags, local, Owned<Launcher>(launcher.get()), isolators, helper);
 }
 
 
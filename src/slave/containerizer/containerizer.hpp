@@ -107,6 +107,15 @@ public:
   virtual process::Future<ResourceStatistics> usage(
       const ContainerID& containerId) = 0;
 
+  // Returns a future that becomes ready the next time the container
+  // comes under resource (e.g., memory) pressure, so that its usage
+  // can be looked at right away. Fails if the containerizer cannot
+  // tell.
+  virtual process::Future<Nothing> pressure(const ContainerID& containerId)
+  {
+    return process::Failure("Not supported");
+  }
+
   // Wait on the container's 'Termination'. If the executor terminates, the
   // containerizer should also destroy the containerized context. The future
   // may be failed if an error occurs during termination of the executor or
@@ -50,14 +50,22 @@ Future<Nothing> Isolator::recover(const list<state::RunState>& state)
 }
 
 
+Future<Nothing> Isolator::cleanupOrphans()
+{
+  return dispatch(process.get(), &IsolatorProcess::cleanupOrphans);
+}
+
+
 Future<Nothing> Isolator::prepare(
     const ContainerID& containerId,
-    const ExecutorInfo& executorInfo)
+    const ExecutorInfo& executorInfo,
+    const string& directory)
 {
   return dispatch(process.get(),
                   &IsolatorProcess::prepare,
                   containerId,
-                  executorInfo);
+                  executorInfo,
+                  directory);
 }
 
 
@@ -94,6 +102,12 @@ Future<ResourceStatistics> Isolator::usage(
 }
 
 
+Future<Nothing> Isolator::pressure(const ContainerID& containerId)
+{
+  return dispatch(process.get(), &IsolatorProcess::pressure, containerId);
+}
+
+
 Future<Nothing> Isolator::cleanup(const ContainerID& containerId)
 {
   return dispatch(process.get(), &IsolatorProcess::cleanup, containerId);
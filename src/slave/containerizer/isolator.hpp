@@ -68,10 +68,18 @@ public:
   process::Future<Nothing> recover(
       const std::list<state::RunState>& states);
 
-  // Prepare for isolation of the executor.
+  // Clean up the orphaned containers found by recover(), i.e., those
+  // not in the run states. This is done in the background once
+  // recovery has completed and the launcher has cleaned up the
+  // orphans' processes.
+  process::Future<Nothing> cleanupOrphans();
+
+  // Prepare for isolation of the executor, whose sandbox is
+  // 'directory'.
   process::Future<Nothing> prepare(
       const ContainerID& containerId,
-      const ExecutorInfo& executorInfo);
+      const ExecutorInfo& executorInfo,
+      const std::string& directory);
 
   // Isolate the executor. Any steps that require execution in the
   // containerized context (e.g. inside a network namespace) can be returned in
@@ -95,6 +103,11 @@ public:
   process::Future<ResourceStatistics> usage(
       const ContainerID& containerId) const;
 
+  // Returns a future that becomes ready the next time the container
+  // comes under resource pressure, e.g., the kernel reclaiming its
+  // memory, or fails if the isolator cannot tell.
+  process::Future<Nothing> pressure(const ContainerID& containerId);
+
   // Clean up a terminated container. This is called after the executor and all
   // processes in the container have terminated.
   process::Future<Nothing> cleanup(const ContainerID& containerId);
@@ -115,9 +128,12 @@ public:
   virtual process::Future<Nothing> recover(
       const std::list<state::RunState>& state) = 0;
 
+  virtual process::Future<Nothing> cleanupOrphans() = 0;
+
   virtual process::Future<Nothing> prepare(
       const ContainerID& containerId,
-      const ExecutorInfo& executorInfo) = 0;
+      const ExecutorInfo& executorInfo,
+      const std::string& directory) = 0;
 
   virtual process::Future<Option<CommandInfo> > isolate(
       const ContainerID& containerId,
@@ -133,6 +149,11 @@ public:
   virtual process::Future<ResourceStatistics> usage(
       const ContainerID& containerId) = 0;
 
+  virtual process::Future<Nothing> pressure(const ContainerID& containerId)
+  {
+    return process::Failure("Not supported");
+  }
+
   virtual process::Future<Nothing> cleanup(const ContainerID& containerId) = 0;
 };
 
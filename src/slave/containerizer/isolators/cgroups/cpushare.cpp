@@ -41,6 +41,7 @@
 
 #include "linux/cgroups.hpp"
 
+#include "slave/constants.hpp"
 #include "slave/flags.hpp"
 
 #include "slave/containerizer/isolators/cgroups/cpushare.hpp"
@@ -62,6 +63,10 @@ const Duration CPU_CFS_PERIOD = Milliseconds(100); // Linux default.
 const Duration MIN_CPU_CFS_QUOTA = Milliseconds(1);
 
 
+// Local function definition.
+static Future<Nothing> _nothing() { return Nothing(); }
+
+
 CgroupsCpushareIsolatorProcess::CgroupsCpushareIsolatorProcess(
     const Flags& _flags,
     const hashmap<string, string>& _hierarchies)
@@ -165,9 +170,7 @@ Future<Nothing> CgroupsCpushareIsolatorProcess::recover(
 
   foreach (const string& orphan, orphans.get()) {
     if (!cgroups.contains(orphan)) {
-      LOG(INFO) << "Removing orphaned cgroup"
-                << " '" << path::join("cpu", orphan) << "'";
-      cgroups::destroy(hierarchies["cpu"], orphan);
+      this->orphans["cpu"].push_back(orphan);
     }
   }
 
@@ -183,9 +186,7 @@ Future<Nothing> CgroupsCpushareIsolatorProcess::recover(
 
   foreach (const string& orphan, orphans.get()) {
     if (!cgroups.contains(orphan)) {
-      LOG(INFO) << "Removing orphaned cgroup"
-                << " '" << path::join("cpuacct", orphan) << "'";
-      cgroups::destroy(hierarchies["cpuacct"], orphan);
+      this->orphans["cpuacct"].push_back(orphan);
     }
   }
 
@@ -193,9 +194,33 @@ Future<Nothing> CgroupsCpushareIsolatorProcess::recover(
 }
 
 
+Future<Nothing> CgroupsCpushareIsolatorProcess::cleanupOrphans()
+{
+  list<Future<Nothing> > futures;
+
+  foreachpair (const string& subsystem,
+               const vector<string>& orphans,
+               this->orphans) {
+    foreach (const string& orphan, orphans) {
+      LOG(INFO) << "Removing orphaned cgroup"
+                << " '" << path::join(subsystem, orphan) << "'";
+    }
+
+    futures.push_back(cgroups::destroy(
+        hierarchies[subsystem], orphans, ORPHAN_CLEANUP_PARALLELISM));
+  }
+
+  orphans.clear();
+
+  return collect(futures)
+    .then(lambda::bind(_nothing));
+}
+
+
 Future<Nothing> CgroupsCpushareIsolatorProcess::prepare(
     const ContainerID& containerId,
-    const ExecutorInfo& executorInfo)
+    const ExecutorInfo& executorInfo,
+    const string& directory)
 {
   if (infos.contains(containerId)) {
     return Failure("Container has already been prepared");
@@ -49,9 +49,12 @@ public:
   virtual process::Future<Nothing> recover(
       const std::list<state::RunState>& states);
 
+  virtual process::Future<Nothing> cleanupOrphans();
+
   virtual process::Future<Nothing> prepare(
       const ContainerID& containerId,
-      const ExecutorInfo& executorInfo);
+      const ExecutorInfo& executorInfo,
+      const std::string& directory);
 
   virtual process::Future<Option<CommandInfo> > isolate(
       const ContainerID& containerId,
@@ -94,6 +97,10 @@ private:
   // Map from subsystem to hierarchy.
   hashmap<std::string, std::string> hierarchies;
 
+  // Map from subsystem to the cgroups of orphaned containers found by
+  // recover().
+  hashmap<std::string, std::vector<std::string> > orphans;
+
   hashmap<ContainerID, Info*> infos;
 };
 
@@ -42,6 +42,8 @@
 
 #include "linux/cgroups.hpp"
 
+#include "slave/constants.hpp"
+
 #include "slave/containerizer/isolators/cgroups/mem.hpp"
 
 using namespace process;
@@ -59,6 +61,10 @@ namespace slave {
 const Bytes MIN_MEMORY = Megabytes(32);
 
 
+// Local function definition.
+static Future<Nothing> _nothing() { return Nothing(); }
+
+
 CgroupsMemIsolatorProcess::CgroupsMemIsolatorProcess(
     const Flags& _flags,
     const string& _hierarchy)
@@ -159,8 +165,7 @@ Future<Nothing> CgroupsMemIsolatorProcess::recover(
 
   foreach (const string& orphan, orphans.get()) {
     if (!cgroups.contains(orphan)) {
-      LOG(INFO) << "Removing orphaned cgroup '" << orphan << "'";
-      cgroups::destroy(hierarchy, orphan);
+      this->orphans.push_back(orphan);
     }
   }
 
@@ -168,9 +173,25 @@ Future<Nothing> CgroupsMemIsolatorProcess::recover(
 }
 
 
+Future<Nothing> CgroupsMemIsolatorProcess::cleanupOrphans()
+{
+  foreach (const string& orphan, orphans) {
+    LOG(INFO) << "Removing orphaned cgroup '" << orphan << "'";
+  }
+
+  Future<Nothing> future =
+    cgroups::destroy(hierarchy, orphans, ORPHAN_CLEANUP_PARALLELISM);
+
+  orphans.clear();
+
+  return future;
+}
+
+
 Future<Nothing> CgroupsMemIsolatorProcess::prepare(
     const ContainerID& containerId,
-    const ExecutorInfo& executorInfo)
+    const ExecutorInfo& executorInfo,
+    const string& directory)
 {
   if (infos.contains(containerId)) {
     return Failure("Container has already been prepared");
@@ -357,6 +378,28 @@ Future<ResourceStatistics> CgroupsMemIsolatorProcess::usage(
 }
 
 
+Future<Nothing> CgroupsMemIsolatorProcess::pressure(
+    const ContainerID& containerId)
+{
+  if (!infos.contains(containerId)) {
+    return Failure("Unknown container");
+  }
+
+  Info* info = CHECK_NOTNULL(infos[containerId]);
+
+  // Listen for the kernel reclaiming memory of the cgroup at a
+  // 'medium' level (or above), i.e., the cgroup is near its limit.
+  // This fails on kernels without memory pressure notifications.
+  if (!info->pressureNotifier.isPending()) {
+    info->pressureNotifier = cgroups::listen(
+        hierarchy, info->cgroup, "memory.pressure_level", string("medium"));
+  }
+
+  return info->pressureNotifier
+    .then(lambda::bind(_nothing));
+}
+
+
 Future<Nothing> CgroupsMemIsolatorProcess::cleanup(
     const ContainerID& containerId)
 {
@@ -370,6 +413,10 @@ Future<Nothing> CgroupsMemIsolatorProcess::cleanup(
     info->oomNotifier.discard();
   }
 
+  if (info->pressureNotifier.isPending()) {
+    info->pressureNotifier.discard();
+  }
+
   return cgroups::destroy(hierarchy, info->cgroup)
     .then(defer(PID<CgroupsMemIsolatorProcess>(this),
                 &CgroupsMemIsolatorProcess::_cleanup,
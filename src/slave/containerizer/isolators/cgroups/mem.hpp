@@ -49,9 +49,12 @@ public:
   virtual process::Future<Nothing> recover(
       const std::list<state::RunState>& states);
 
+  virtual process::Future<Nothing> cleanupOrphans();
+
   virtual process::Future<Nothing> prepare(
       const ContainerID& containerId,
-      const ExecutorInfo& executorInfo);
+      const ExecutorInfo& executorInfo,
+      const std::string& directory);
 
   virtual process::Future<Option<CommandInfo> > isolate(
       const ContainerID& containerId,
@@ -67,6 +70,9 @@ public:
   virtual process::Future<ResourceStatistics> usage(
       const ContainerID& containerId);
 
+  virtual process::Future<Nothing> pressure(
+      const ContainerID& containerId);
+
   virtual process::Future<Nothing> cleanup(
       const ContainerID& containerId);
 
@@ -88,6 +94,9 @@ private:
 
     // Used to cancel the OOM listening.
     process::Future<uint64_t> oomNotifier;
+
+    // Used to cancel the memory pressure listening.
+    process::Future<uint64_t> pressureNotifier;
   };
 
   // Start listening on OOM events. This function will create an
@@ -108,6 +117,9 @@ private:
   // The path to the cgroups subsystem hierarchy root.
   const std::string hierarchy;
 
+  // The cgroups of orphaned containers found by recover().
+  std::vector<std::string> orphans;
+
   hashmap<ContainerID, Info*> infos;
 };
 
@@ -0,0 +1,697 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif // __linux__
+
+#include <list>
+#include <sstream>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <process/delay.hpp>
+#include <process/pid.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+
+#include "common/type_utils.hpp"
+
+#include "slave/constants.hpp"
+
+#include "slave/containerizer/isolators/disk.hpp"
+
+using namespace process;
+
+using std::list;
+using std::ostringstream;
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+#ifdef __linux__
+// The inotify events that change the entries of a directory, as
+// opposed to the space used by one of its files (IN_MODIFY).
+static const uint32_t IN_ENTRIES =
+  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+  IN_DELETE_SELF | IN_MOVE_SELF;
+#endif // __linux__
+
+
+// Returns the space used by the file, like 'du' would count it.
+static Bytes space(const struct stat& s)
+{
+  return Bytes(s.st_blocks * 512);
+}
+
+
+DiskUsageWatcher::DiskUsageWatcher()
+{
+#ifdef __linux__
+  int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    LOG(WARNING) << "Failed to initialize inotify, the sandboxes will be "
+                 << "listed on every scan: " << strerror(errno);
+  } else {
+    inotify = fd;
+  }
+#endif // __linux__
+}
+
+
+DiskUsageWatcher::~DiskUsageWatcher()
+{
+  if (inotify.isSome()) {
+    os::close(inotify.get());
+  }
+}
+
+
+Option<int> DiskUsageWatcher::add(
+    const string& path,
+    DiskUsageScanner* scanner)
+{
+#ifdef __linux__
+  if (inotify.isNone()) {
+    return None();
+  }
+
+  int wd = ::inotify_add_watch(
+      inotify.get(),
+      path.c_str(),
+      IN_MODIFY | IN_ENTRIES | IN_ONLYDIR | IN_DONT_FOLLOW);
+
+  if (wd < 0) {
+    // Most likely the watch limit was reached (ENOSPC) or the
+    // directory is gone; the directory gets listed on every scan.
+    VLOG(1) << "Failed to watch '" << path << "': " << strerror(errno);
+    return None();
+  }
+
+  scanners[wd] = scanner;
+
+  return wd;
+#else
+  return None();
+#endif // __linux__
+}
+
+
+void DiskUsageWatcher::remove(int wd)
+{
+#ifdef __linux__
+  if (inotify.isSome()) {
+    ::inotify_rm_watch(inotify.get(), wd);
+  }
+#endif // __linux__
+
+  scanners.erase(wd);
+}
+
+
+void DiskUsageWatcher::read()
+{
+#ifdef __linux__
+  if (inotify.isNone()) {
+    return;
+  }
+
+  // Large enough for many events, suitably aligned.
+  struct inotify_event buffer[4096 / sizeof(struct inotify_event) + 1];
+
+  while (true) {
+    ssize_t length = ::read(inotify.get(), buffer, sizeof(buffer));
+
+    if (length < 0 && errno == EINTR) {
+      continue;
+    } else if (length <= 0) {
+      if (length < 0 && errno != EAGAIN) {
+        // Assume we missed events rather than let the usage drift.
+        PLOG(WARNING) << "Failed to read inotify events";
+        foreachvalue (DiskUsageScanner* scanner, scanners) {
+          scanner->overflow();
+        }
+      }
+      break;
+    }
+
+    const char* data = (const char*) buffer;
+
+    while (data < (const char*) buffer + length) {
+      const struct inotify_event* event = (const struct inotify_event*) data;
+      data += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        foreachvalue (DiskUsageScanner* scanner, scanners) {
+          scanner->overflow();
+        }
+        continue;
+      }
+
+      Option<DiskUsageScanner*> scanner = scanners.get(event->wd);
+      if (scanner.isNone()) {
+        continue; // Removed in the meantime.
+      }
+
+      if (event->mask & IN_IGNORED) {
+        // The watch is gone, e.g., the directory was removed.
+        scanners.erase(event->wd);
+      }
+
+      // NOTE: The name is padded with null bytes.
+      scanner.get()->notify(
+          event->wd,
+          event->mask,
+          event->len > 0 ? string(event->name) : string());
+    }
+  }
+#endif // __linux__
+}
+
+
+DiskUsageScanner::DiskUsageScanner(
+    const string& _root,
+    DiskUsageWatcher* _watcher)
+  : root(_root),
+    watcher(_watcher),
+    scanning(false),
+    overflowed(false) {}
+
+
+DiskUsageScanner::~DiskUsageScanner()
+{
+  foreachkey (int wd, watches) {
+    watcher->remove(wd);
+  }
+}
+
+
+bool DiskUsageScanner::scan(size_t* budget)
+{
+  if (!scanning) {
+    changed();
+
+    foreachpair (const string& path, const Directory& directory, directories) {
+      if (directory.stale || !directory.dirty.empty()) {
+        pending.push_back(path);
+      }
+    }
+
+    scanning = true;
+  }
+
+  while (!pending.empty() && *budget > 0) {
+    const string path = pending.front();
+    pending.pop_front();
+
+    rescan(path, budget);
+  }
+
+  if (!pending.empty()) {
+    return false;
+  }
+
+  scanning = false;
+  used = total;
+
+  return true;
+}
+
+
+Bytes DiskUsageScanner::usage() const
+{
+  return used;
+}
+
+
+void DiskUsageScanner::changed()
+{
+  // The first scan lists the whole tree, starting at the root.
+  if (!directories.contains("")) {
+    directories[""] = Directory();
+    return;
+  }
+
+  if (watcher != NULL) {
+    watcher->read();
+  }
+
+  foreachvalue (Directory& directory, directories) {
+    if (overflowed || directory.watch.isNone()) {
+      directory.stale = true;
+    }
+  }
+
+  overflowed = false;
+}
+
+
+void DiskUsageScanner::notify(int wd, uint32_t mask, const string& name)
+{
+#ifdef __linux__
+  Option<string> path = watches.get(wd);
+  if (path.isNone()) {
+    return;
+  }
+
+  if (mask & IN_IGNORED) {
+    watches.erase(wd);
+    if (directories.contains(path.get())) {
+      directories[path.get()].watch = None();
+      directories[path.get()].stale = true;
+    }
+    return;
+  }
+
+  if (!directories.contains(path.get())) {
+    return;
+  }
+
+  Directory& directory = directories[path.get()];
+
+  if (mask & IN_ENTRIES) {
+    directory.stale = true;
+  } else if (!name.empty()) {
+    directory.dirty.insert(name);
+  }
+#endif // __linux__
+}
+
+
+void DiskUsageScanner::overflow()
+{
+  overflowed = true;
+}
+
+
+void DiskUsageScanner::rescan(const string& path, size_t* budget)
+{
+  if (!directories.contains(path)) {
+    return; // Forgotten since it was queued.
+  }
+
+  // NOTE: References to the directories stay valid as others get
+  // added, only forget() invalidates those it erases.
+  Directory& directory = directories[path];
+
+  const string absolute = path.empty() ? root : path::join(root, path);
+
+  if (!directory.listing && !directory.stale) {
+    while (!directory.dirty.empty() && *budget > 0) {
+      const string name = *directory.dirty.begin();
+      directory.dirty.erase(name);
+
+      --(*budget);
+
+      struct stat s;
+      if (::lstat(path::join(absolute, name).c_str(), &s) < 0) {
+        update(&directory, name, None());
+      } else if (S_ISDIR(s.st_mode)) {
+        // Replaced by a directory, in which case the entries changed
+        // as well and the directory gets listed.
+        directory.stale = true;
+        break;
+      } else {
+        update(&directory, name, space(s));
+      }
+    }
+
+    if (!directory.stale) {
+      if (!directory.dirty.empty()) {
+        pending.push_front(path); // Out of budget.
+      }
+      return;
+    }
+  }
+
+  if (!directory.listing) {
+    directory.stale = false;
+    directory.dirty.clear();
+
+    // The directory itself. If it is gone, so are its entries (and
+    // its parent's entries changed, so it will be forgotten).
+    struct stat s;
+    Bytes self;
+    if (::lstat(absolute.c_str(), &s) == 0) {
+      self = space(s);
+
+      // Watch the directory before listing it, so that no change made
+      // in between goes unnoticed.
+      if (directory.watch.isNone()) {
+        watch(path, &directory);
+      }
+    }
+
+    total -= directory.self;
+    directory.size -= directory.self;
+    directory.self = self;
+    total += directory.self;
+    directory.size += directory.self;
+
+    // NOTE: A directory that cannot be listed (e.g., that was
+    // removed) is considered empty.
+    directory.listing = true;
+    directory.remaining = os::ls(absolute);
+    directory.listed.clear();
+  }
+
+  // Only the entries within the budget are examined, the rest of them
+  // are examined in the batches to come.
+  while (!directory.remaining.empty() && *budget > 0) {
+    const string name = directory.remaining.front();
+    directory.remaining.pop_front();
+
+    --(*budget);
+
+    struct stat s;
+    if (::lstat(path::join(absolute, name).c_str(), &s) < 0) {
+      continue; // Removed since it was listed.
+    }
+
+    directory.listed.insert(name);
+
+    const string child = path.empty() ? name : path::join(path, name);
+
+    if (S_ISDIR(s.st_mode)) {
+      update(&directory, name, None());
+
+      if (!directory.subdirectories.contains(name)) {
+        directory.subdirectories.insert(name);
+        directories[child] = Directory();
+        pending.push_back(child);
+      }
+    } else {
+      if (directory.subdirectories.contains(name)) {
+        directory.subdirectories.erase(name);
+        forget(child);
+      }
+
+      update(&directory, name, space(s));
+    }
+  }
+
+  if (!directory.remaining.empty()) {
+    pending.push_front(path); // Out of budget.
+    return;
+  }
+
+  // Done listing, the entries that were not found are gone.
+  directory.listing = false;
+
+  foreach (const string& name, directory.files.keys()) {
+    if (!directory.listed.contains(name)) {
+      update(&directory, name, None());
+    }
+  }
+
+  list<string> removed;
+  foreach (const string& name, directory.subdirectories) {
+    if (!directory.listed.contains(name)) {
+      removed.push_back(name);
+    }
+  }
+
+  directory.listed.clear();
+
+  foreach (const string& name, removed) {
+    directory.subdirectories.erase(name);
+    forget(path.empty() ? name : path::join(path, name));
+  }
+}
+
+
+void DiskUsageScanner::update(
+    Directory* directory,
+    const string& name,
+    const Option<Bytes>& size)
+{
+  Option<Bytes> previous = directory->files.get(name);
+  if (previous.isSome()) {
+    total -= previous.get();
+    directory->size -= previous.get();
+    directory->files.erase(name);
+  }
+
+  if (size.isSome()) {
+    total += size.get();
+    directory->size += size.get();
+    directory->files[name] = size.get();
+  }
+}
+
+
+void DiskUsageScanner::forget(const string& path)
+{
+  if (!directories.contains(path)) {
+    return;
+  }
+
+  const Directory& directory = directories[path];
+
+  foreach (const string& name, directory.subdirectories) {
+    forget(path.empty() ? name : path::join(path, name));
+  }
+
+  total -= directory.size;
+
+  if (directory.watch.isSome()) {
+    watcher->remove(directory.watch.get());
+    watches.erase(directory.watch.get());
+  }
+
+  directories.erase(path);
+}
+
+
+void DiskUsageScanner::watch(const string& path, Directory* directory)
+{
+  if (watcher == NULL) {
+    return;
+  }
+
+  const string absolute = path.empty() ? root : path::join(root, path);
+
+  Option<int> wd = watcher->add(absolute, this);
+  if (wd.isSome()) {
+    directory->watch = wd.get();
+    watches[wd.get()] = path;
+  }
+}
+
+
+PosixDiskIsolatorProcess::PosixDiskIsolatorProcess(const Flags& _flags)
+  : flags(_flags) {}
+
+
+PosixDiskIsolatorProcess::~PosixDiskIsolatorProcess() {}
+
+
+Try<Isolator*> PosixDiskIsolatorProcess::create(const Flags& flags)
+{
+  Owned<IsolatorProcess> process(new PosixDiskIsolatorProcess(flags));
+
+  return new Isolator(process);
+}
+
+
+void PosixDiskIsolatorProcess::initialize()
+{
+  check();
+}
+
+
+Future<Nothing> PosixDiskIsolatorProcess::recover(
+    const list<state::RunState>& states)
+{
+  Future<Nothing> recover = PosixIsolatorProcess::recover(states);
+  if (!recover.isReady()) {
+    return recover;
+  }
+
+  foreach (const state::RunState& run, states) {
+    if (run.directory.isNone()) {
+      LOG(WARNING) << "Not accounting for the disk usage of container '"
+                   << run.id.get() << "' because its sandbox is unknown";
+      continue;
+    }
+
+    infos.put(
+        run.id.get(),
+        Owned<Info>(new Info(run.directory.get(), &watcher)));
+  }
+
+  return Nothing();
+}
+
+
+Future<Nothing> PosixDiskIsolatorProcess::prepare(
+    const ContainerID& containerId,
+    const ExecutorInfo& executorInfo,
+    const string& directory)
+{
+  Future<Nothing> prepare =
+    PosixIsolatorProcess::prepare(containerId, executorInfo, directory);
+
+  if (!prepare.isReady()) {
+    return prepare;
+  }
+
+  infos.put(containerId, Owned<Info>(new Info(directory, &watcher)));
+
+  return Nothing();
+}
+
+
+Future<Nothing> PosixDiskIsolatorProcess::update(
+    const ContainerID& containerId,
+    const Resources& resources)
+{
+  Future<Nothing> update =
+    PosixIsolatorProcess::update(containerId, resources);
+
+  if (!update.isReady()) {
+    return update;
+  }
+
+  if (infos.contains(containerId)) {
+    infos[containerId]->limit = resources.disk();
+    enforce(containerId);
+  }
+
+  return Nothing();
+}
+
+
+Future<ResourceStatistics> PosixDiskIsolatorProcess::usage(
+    const ContainerID& containerId)
+{
+  ResourceStatistics result;
+
+  // NOTE: The usage is only known once the sandbox has been scanned,
+  // we don't scan it here since that could take arbitrarily long.
+  if (infos.contains(containerId) && infos[containerId]->usage.isSome()) {
+    result.set_disk_used_bytes(infos[containerId]->usage.get().bytes());
+  }
+
+  return result;
+}
+
+
+Future<Nothing> PosixDiskIsolatorProcess::cleanup(
+    const ContainerID& containerId)
+{
+  infos.erase(containerId);
+
+  return PosixIsolatorProcess::cleanup(containerId);
+}
+
+
+void PosixDiskIsolatorProcess::check()
+{
+  foreachkey (const ContainerID& containerId, infos) {
+    queue.push_back(containerId);
+  }
+
+  scan();
+}
+
+
+void PosixDiskIsolatorProcess::scan()
+{
+  size_t budget = DISK_SCAN_BATCH_SIZE;
+
+  while (!queue.empty() && budget > 0) {
+    const ContainerID containerId = queue.front();
+
+    if (!infos.contains(containerId)) {
+      queue.pop_front(); // Cleaned up in the meantime.
+      continue;
+    }
+
+    Owned<Info> info = infos[containerId];
+
+    if (info->scanner.scan(&budget)) {
+      info->usage = info->scanner.usage();
+
+      VLOG(2) << "Container '" << containerId << "' uses "
+              << info->usage.get() << " in '" << info->scanner.root << "'";
+
+      enforce(containerId);
+
+      queue.pop_front();
+    }
+  }
+
+  if (queue.empty()) {
+    delay(flags.container_disk_watch_interval,
+          PID<PosixDiskIsolatorProcess>(this),
+          &PosixDiskIsolatorProcess::check);
+  } else {
+    delay(DISK_SCAN_BATCH_INTERVAL,
+          PID<PosixDiskIsolatorProcess>(this),
+          &PosixDiskIsolatorProcess::scan);
+  }
+}
+
+
+void PosixDiskIsolatorProcess::enforce(const ContainerID& containerId)
+{
+  if (!flags.enforce_container_disk_quota) {
+    return;
+  }
+
+  CHECK(infos.contains(containerId));
+  const Owned<Info>& info = infos[containerId];
+
+  if (info->usage.isNone() ||
+      info->limit.isNone() ||
+      info->usage.get() <= info->limit.get() ||
+      !promises.contains(containerId)) {
+    return;
+  }
+
+  ostringstream message;
+  message << "Disk usage of " << info->usage.get()
+          << " exceeds the allocated " << info->limit.get()
+          << " in sandbox '" << info->scanner.root << "'";
+
+  LOG(INFO) << "Container " << containerId << ": " << message.str();
+
+  Resource disk = Resources::parse(
+      "disk",
+      stringify(info->usage.get().megabytes()),
+      "*").get();
+
+  promises[containerId]->set(Limitation(disk, message.str()));
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,276 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DISK_ISOLATOR_HPP__
+#define __DISK_ISOLATOR_HPP__
+
+#include <stdint.h>
+
+#include <deque>
+#include <list>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <process/future.hpp>
+#include <process/owned.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "slave/flags.hpp"
+
+#include "slave/containerizer/isolator.hpp"
+
+#include "slave/containerizer/isolators/posix.hpp"
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Forward declaration.
+class DiskUsageScanner;
+
+
+// An inotify instance shared by the DiskUsageScanners of an isolator,
+// since the number of inotify instances per user is limited (see
+// fs.inotify.max_user_instances) while a single instance can hold
+// many watches. The events are routed to the scanners by watch
+// descriptor. Without inotify (e.g., not on Linux) nothing is
+// watched.
+class DiskUsageWatcher
+{
+public:
+  DiskUsageWatcher();
+  ~DiskUsageWatcher();
+
+  // Watches the directory at 'path' on behalf of the scanner. Returns
+  // the watch descriptor, or None if the directory cannot be watched.
+  Option<int> add(const std::string& path, DiskUsageScanner* scanner);
+
+  // Stops watching, and routing the events of, the watch descriptor.
+  void remove(int wd);
+
+  // Hands the pending events to the scanners.
+  void read();
+
+private:
+  DiskUsageWatcher(const DiskUsageWatcher&);
+  DiskUsageWatcher& operator = (const DiskUsageWatcher&);
+
+  Option<int> inotify;
+  hashmap<int, DiskUsageScanner*> scanners;
+};
+
+
+// Keeps track of the disk space used by the files under a directory,
+// like 'du' would report it, without walking the whole tree each
+// time: the space used by every directory's entries is cached and
+// only the parts of the tree that changed get examined again.
+//
+// With a DiskUsageWatcher, each directory is watched so that a rescan
+// only lists the directories whose entries were created, removed or
+// renamed, and only stats the files that were written to. Without
+// one, or for the directories that cannot be watched (e.g., once the
+// inotify limits have been reached), every rescan lists and stats
+// their entries again.
+class DiskUsageScanner
+{
+public:
+  explicit DiskUsageScanner(
+      const std::string& root,
+      DiskUsageWatcher* watcher = NULL);
+
+  ~DiskUsageScanner();
+
+  // Continues the current scan of the tree, or starts a new one,
+  // examining about 'budget' entries at most, even within a large
+  // directory. The entries examined are deducted from 'budget'.
+  // Returns true once the scan has completed, at which point usage()
+  // is up to date.
+  bool scan(size_t* budget);
+
+  // Returns the disk space used as of the last completed scan.
+  Bytes usage() const;
+
+  const std::string root;
+
+private:
+  friend class DiskUsageWatcher;
+
+  DiskUsageScanner(const DiskUsageScanner&);
+  DiskUsageScanner& operator = (const DiskUsageScanner&);
+
+  struct Directory
+  {
+    Directory() : stale(true), listing(false) {}
+
+    // The space used by the directory itself, by each of its entries
+    // that is not a directory (by name) and by all of them together.
+    Bytes self;
+    hashmap<std::string, Bytes> files;
+    Bytes size;
+
+    hashset<std::string> subdirectories;
+
+    // Whether the entries need to be listed again, or else the names
+    // of the files that need to be stat'ed again.
+    bool stale;
+    hashset<std::string> dirty;
+
+    // Set while the entries are being examined, over as many batches
+    // as it takes: the entries left to examine, and those found.
+    bool listing;
+    std::list<std::string> remaining;
+    hashset<std::string> listed;
+
+    Option<int> watch;
+  };
+
+  // Marks the directories (and files) that changed since the last
+  // scan, based on the inotify events or, without them, all of them.
+  void changed();
+
+  // Invoked by the watcher for each event of one of our watches.
+  void notify(int wd, uint32_t mask, const std::string& name);
+
+  // Invoked by the watcher when events may have been missed.
+  void overflow();
+
+  // Continues rescanning the directory at 'path' (relative to
+  // 'root'), re-queueing it if the budget runs out first.
+  void rescan(const std::string& path, size_t* budget);
+
+  // Updates the space used by a file of the directory, removing the
+  // file if 'size' is None.
+  void update(
+      Directory* directory,
+      const std::string& name,
+      const Option<Bytes>& size);
+
+  // Forgets about the directory at 'path' and everything under it.
+  void forget(const std::string& path);
+
+  // Adds an inotify watch for the directory, if possible.
+  void watch(const std::string& path, Directory* directory);
+
+  DiskUsageWatcher* watcher;
+
+  hashmap<std::string, Directory> directories;
+
+  // The directories left to rescan in the current scan.
+  std::deque<std::string> pending;
+  bool scanning;
+
+  // The space used by all the directories in the cache, and as of
+  // the last completed scan.
+  Bytes total;
+  Bytes used;
+
+  // The directories by watch descriptor.
+  hashmap<int, std::string> watches;
+
+  // Set when the inotify queue overflowed, in which case changes may
+  // have gone unnoticed and every directory gets listed again.
+  bool overflowed;
+};
+
+
+// Accounts for the disk space used by each executor's sandbox and,
+// if --enforce_container_disk_quota is set, reports a limitation for
+// the executors that use more than their allocated disk resources.
+//
+// The sandboxes are scanned every --container_disk_watch_interval in
+// batches of DISK_SCAN_BATCH_SIZE entries, DISK_SCAN_BATCH_INTERVAL
+// apart, to bound the IO spent on the accounting.
+class PosixDiskIsolatorProcess : public PosixIsolatorProcess
+{
+public:
+  static Try<Isolator*> create(const Flags& flags);
+
+  virtual ~PosixDiskIsolatorProcess();
+
+  virtual process::Future<Nothing> recover(
+      const std::list<state::RunState>& states);
+
+  virtual process::Future<Nothing> prepare(
+      const ContainerID& containerId,
+      const ExecutorInfo& executorInfo,
+      const std::string& directory);
+
+  virtual process::Future<Nothing> update(
+      const ContainerID& containerId,
+      const Resources& resources);
+
+  virtual process::Future<ResourceStatistics> usage(
+      const ContainerID& containerId);
+
+  virtual process::Future<Nothing> cleanup(
+      const ContainerID& containerId);
+
+protected:
+  virtual void initialize();
+
+private:
+  explicit PosixDiskIsolatorProcess(const Flags& flags);
+
+  // Starts scanning all the sandboxes.
+  void check();
+
+  // Scans the next batch of entries.
+  void scan();
+
+  // Reports a limitation if the container uses more disk than it was
+  // allocated.
+  void enforce(const ContainerID& containerId);
+
+  struct Info
+  {
+    Info(const std::string& directory, DiskUsageWatcher* watcher)
+      : scanner(directory, watcher) {}
+
+    DiskUsageScanner scanner;
+
+    // Set once a scan of the sandbox has completed.
+    Option<Bytes> usage;
+
+    // The allocated disk resources, if known.
+    Option<Bytes> limit;
+  };
+
+  const Flags flags;
+
+  // Shared by the scanners of all the sandboxes, hence declared
+  // before (and destroyed after) them.
+  DiskUsageWatcher watcher;
+
+  hashmap<ContainerID, process::Owned<Info> > infos;
+
+  // The containers left to scan until the next check.
+  std::deque<ContainerID> queue;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __DISK_ISOLATOR_HPP__
@@ -19,8 +19,11 @@
 #ifndef __POSIX_ISOLATOR_HPP__
 #define __POSIX_ISOLATOR_HPP__
 
+#include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
-#include <stout/os/pstree.hpp>
+#include <stout/stopwatch.hpp>
+
+#include <stout/os/process_table.hpp>
 
 #include <process/future.hpp>
 
@@ -64,9 +67,16 @@ public:
     return Nothing();
   }
 
+  virtual process::Future<Nothing> cleanupOrphans()
+  {
+    // There is nothing isolated that orphans could have left behind.
+    return Nothing();
+  }
+
   virtual process::Future<Nothing> prepare(
       const ContainerID& containerId,
-      const ExecutorInfo& executorInfo)
+      const ExecutorInfo& executorInfo,
+      const std::string& directory)
   {
     if (promises.contains(containerId)) {
       return process::Failure("Container " + stringify(containerId) +
@@ -131,9 +141,38 @@ public:
   }
 
 protected:
+  // Returns the process tree of the container. The process table is
+  // only refreshed if it was not already just now, e.g., for another
+  // container sampled at the same time, so that the processes of the
+  // system are read once rather than once per container. A container
+  // launched since the last refresh is not in the table yet, so the
+  // table is then refreshed regardless.
+  Try<os::ProcessTree> pstree(const ContainerID& containerId)
+  {
+    const pid_t pid = pids.get(containerId).get();
+
+    if (table.size() == 0 ||
+        refreshed.elapsed() > Milliseconds(100) ||
+        table.process(pid).isNone()) {
+      Try<Nothing> refresh = table.refresh();
+      if (refresh.isError()) {
+        return Error(refresh.error());
+      }
+
+      refreshed.start();
+    }
+
+    return table.pstree(pid);
+  }
+
   hashmap<ContainerID, pid_t> pids;
   hashmap<ContainerID,
           process::Owned<process::Promise<Limitation> > > promises;
+
+  os::ProcessTable table;
+
+  // Measures the time since the process table was last refreshed.
+  Stopwatch refreshed;
 };
 
 
@@ -156,7 +195,7 @@ public:
       return ResourceStatistics();
     }
 
-    Try<os::ProcessTree> tree = os::pstree(pids.get(containerId).get());
+    Try<os::ProcessTree> tree = pstree(containerId);
 
     if (!tree.isSome()) {
       return ResourceStatistics();
@@ -212,7 +251,7 @@ public:
       return ResourceStatistics();
     }
 
-    Try<os::ProcessTree> tree = os::pstree(pids.get(containerId).get());
+    Try<os::ProcessTree> tree = pstree(containerId);
 
     if (!tree.isSome()) {
       return ResourceStatistics();
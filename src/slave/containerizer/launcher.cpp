@@ -79,6 +79,14 @@ Try<Nothing> PosixLauncher::recover(const list<RunState>& states)
 }
 
 
+Future<Nothing> PosixLauncher::cleanupOrphans()
+{
+  // Orphaned containers are not tracked, since their processes cannot
+  // be told apart from others.
+  return Nothing();
+}
+
+
 Try<pid_t> PosixLauncher::fork(
     const ContainerID& containerId,
     const lambda::function<int()>& inChild)
@@ -122,6 +130,23 @@ Try<pid_t> PosixLauncher::fork(
 }
 
 
+Try<Nothing> PosixLauncher::adopt(const ContainerID& containerId, pid_t pid)
+{
+  if (pids.contains(containerId)) {
+    return Error("Process has already been forked for container " +
+                 stringify(containerId));
+  }
+
+  LOG(INFO) << "Adopted child with pid '" << pid
+            << "' for container '" << containerId << "'";
+
+  // Store the pid (session id and process group id).
+  pids.put(containerId, pid);
+
+  return Nothing();
+}
+
+
 Future<Nothing> _destroy(const Future<Option<int> >& future)
 {
   if (future.isReady()) {
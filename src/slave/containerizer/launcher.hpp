@@ -41,6 +41,11 @@ public:
   // Recover the necessary state for each container listed in state.
   virtual Try<Nothing> recover(const std::list<state::RunState>& states) = 0;
 
+  // Clean up the orphaned containers found by recover(), i.e., those
+  // not listed in state. This is done in the background once recovery
+  // has completed.
+  virtual process::Future<Nothing> cleanupOrphans() = 0;
+
   // Fork a new process in the containerized context. The child will call the
   // specified function and the parent will return the child's pid.
   // NOTE: The function must be async-signal safe and should exec as soon as
@@ -49,6 +54,12 @@ public:
       const ContainerID& containerId,
       const lambda::function<int()>&) = 0;
 
+  // Take charge of a process forked elsewhere (e.g., by the launcher
+  // helper) as the first process of the container. The process must
+  // already be in a session of its own and must not run anything
+  // until this returns.
+  virtual Try<Nothing> adopt(const ContainerID& containerId, pid_t pid) = 0;
+
   // Kill all processes in the containerized context.
   virtual process::Future<Nothing> destroy(const ContainerID& containerId) = 0;
 };
@@ -67,10 +78,14 @@ public:
 
   virtual Try<Nothing> recover(const std::list<state::RunState>& states);
 
+  virtual process::Future<Nothing> cleanupOrphans();
+
   virtual Try<pid_t> fork(
       const ContainerID& containerId,
       const lambda::function<int()>& inChild);
 
+  virtual Try<Nothing> adopt(const ContainerID& containerId, pid_t pid);
+
   virtual process::Future<Nothing> destroy(const ContainerID& containerId);
 
 private:
@@ -0,0 +1,423 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <string>
+
+#include <process/defer.hpp>
+#include <process/delay.hpp>
+#include <process/dispatch.hpp>
+#include <process/io.hpp>
+#include <process/owned.hpp>
+#include <process/process.hpp>
+#include <process/reap.hpp>
+
+#include <stout/abort.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+
+#include "slave/containerizer/launcher_helper.hpp"
+
+using namespace process;
+
+using std::deque;
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+class LauncherHelperProcess : public Process<LauncherHelperProcess>
+{
+public:
+  explicit LauncherHelperProcess(const string& _path)
+    : path(_path), writing(Nothing()) {}
+
+  virtual ~LauncherHelperProcess() {}
+
+  Future<pid_t> fork(const LauncherHelperRequest& request)
+  {
+    if (socket.isNone()) {
+      return Failure("The launcher helper is not running");
+    }
+
+    Owned<Promise<pid_t> > promise(new Promise<pid_t>());
+    forks.push_back(promise);
+
+    // NOTE: Should the request not get through, the helper is gone
+    // and the promise gets failed by exited().
+    send(request);
+
+    return promise->future();
+  }
+
+  Future<Nothing> exec(pid_t pid)
+  {
+    if (socket.isNone()) {
+      return Failure("The launcher helper is not running");
+    }
+
+    LauncherHelperRequest request;
+    request.set_type(LauncherHelperRequest::EXEC);
+    request.set_pid(pid);
+
+    return send(request);
+  }
+
+  Future<Option<int> > status(pid_t pid)
+  {
+    if (!statuses.contains(pid)) {
+      return None();
+    }
+
+    Future<Option<int> > future = statuses[pid]->future();
+
+    if (future.isReady()) {
+      statuses.erase(pid);
+    } else {
+      waited.insert(pid);
+    }
+
+    return future;
+  }
+
+protected:
+  virtual void initialize()
+  {
+    restart();
+  }
+
+  virtual void finalize()
+  {
+    // Closing the socket makes the helper exit.
+    if (socket.isSome()) {
+      os::close(socket.get());
+      socket = None();
+    }
+
+    abandon("The launcher helper was stopped");
+
+    // We won't be around to learn when the forked processes exit.
+    foreachvalue (const Owned<Promise<Option<int> > >& promise, statuses) {
+      promise->set(Option<int>::none());
+    }
+    statuses.clear();
+    waited.clear();
+  }
+
+private:
+  // Starts the helper, retrying later if it cannot be started.
+  void restart()
+  {
+    Try<Nothing> start = this->start();
+    if (start.isError()) {
+      LOG(ERROR) << "Failed to start the launcher helper '" << path
+                 << "': " << start.error();
+
+      delay(Seconds(1), self(), &Self::restart);
+    }
+  }
+
+  Try<Nothing> start()
+  {
+    int sockets[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+      return ErrnoError("Failed to create socket pair");
+    }
+
+    // Only the helper's end of the socket is inherited.
+    os::cloexec(sockets[0]);
+
+    // Prepare the arguments before forking.
+    const string fd = stringify(sockets[1]);
+
+    pid_t pid = ::fork();
+
+    if (pid == -1) {
+      os::close(sockets[0]);
+      os::close(sockets[1]);
+      return ErrnoError("Failed to fork");
+    }
+
+    if (pid == 0) {
+      // In child.
+      execl(path.c_str(), path.c_str(), fd.c_str(), (char*) NULL);
+
+      ABORT("Failed to execute launcher helper");
+    }
+
+    os::close(sockets[1]);
+
+    Try<Nothing> nonblock = os::nonblock(sockets[0]);
+    if (nonblock.isError()) {
+      os::close(sockets[0]);
+      ::kill(pid, SIGKILL);
+      process::reap(pid);
+      return Error("Failed to make socket non-blocking: " + nonblock.error());
+    }
+
+    LOG(INFO) << "Started launcher helper with pid " << pid;
+
+    socket = sockets[0];
+    helper = pid;
+    data.clear();
+    writing = Nothing();
+
+    // The helper is our child, so make sure it gets reaped.
+    process::reap(pid);
+
+    receive();
+
+    return Nothing();
+  }
+
+  // Sends the request once the previous ones have been sent.
+  Future<Nothing> send(const LauncherHelperRequest& request)
+  {
+    CHECK_SOME(socket);
+
+    // Prefix the request with its size, like protobuf::write() does.
+    string message;
+    request.SerializeToString(&message);
+
+    uint32_t size = message.size();
+    message.insert(0, (const char*) &size, sizeof(size));
+
+    writing = writing
+      .then(lambda::bind(&LauncherHelperProcess::write, socket.get(), message));
+
+    return writing;
+  }
+
+  static Future<Nothing> write(int fd, const string& data)
+  {
+    return io::write(fd, data);
+  }
+
+  void receive()
+  {
+    CHECK_SOME(socket);
+
+    io::read(socket.get(), buffer, sizeof(buffer))
+      .onAny(defer(self(), &Self::_receive, lambda::_1));
+  }
+
+  void _receive(const Future<size_t>& length)
+  {
+    if (!length.isReady() || length.get() == 0) {
+      LOG(ERROR) << "The launcher helper exited"
+                 << (length.isFailed() ? ": " + length.failure() : "");
+      exited();
+      return;
+    }
+
+    data.append(buffer, length.get());
+
+    uint32_t size;
+    while (data.size() >= sizeof(size)) {
+      memcpy((void*) &size, (void*) data.data(), sizeof(size));
+
+      if (data.size() < sizeof(size) + size) {
+        break;
+      }
+
+      LauncherHelperResponse response;
+      if (!response.ParseFromArray(data.data() + sizeof(size), size)) {
+        LOG(ERROR) << "Failed to deserialize response from launcher helper";
+        exited();
+        return;
+      }
+
+      data.erase(0, sizeof(size) + size);
+
+      handle(response);
+    }
+
+    receive();
+  }
+
+  void handle(const LauncherHelperResponse& response)
+  {
+    if (response.type() == LauncherHelperResponse::FORKED) {
+      if (forks.empty()) {
+        LOG(ERROR) << "Ignoring unexpected response from launcher helper";
+        return;
+      }
+
+      Owned<Promise<pid_t> > promise = forks.front();
+      forks.pop_front();
+
+      if (response.has_error() || !response.has_pid()) {
+        promise->fail("Failed to fork: " + response.error());
+        return;
+      }
+
+      statuses[response.pid()] =
+        Owned<Promise<Option<int> > >(new Promise<Option<int> >());
+
+      promise->set(response.pid());
+    } else if (response.type() == LauncherHelperResponse::EXITED) {
+      terminated(response.pid(), response.status());
+    }
+  }
+
+  void terminated(pid_t pid, const Option<int>& status)
+  {
+    if (!statuses.contains(pid)) {
+      return;
+    }
+
+    statuses[pid]->set(status);
+
+    if (waited.contains(pid)) {
+      statuses.erase(pid);
+      waited.erase(pid);
+    }
+  }
+
+  void reaped(pid_t pid, const Future<Option<int> >& status)
+  {
+    terminated(pid, status.isReady() ? status.get() : None());
+  }
+
+  // Cleans up after the helper exited (or misbehaved) and restarts
+  // it. The processes it forked keep running.
+  void exited()
+  {
+    CHECK_SOME(socket);
+    CHECK_SOME(helper);
+
+    os::close(socket.get());
+    socket = None();
+
+    ::kill(helper.get(), SIGKILL);
+    helper = None();
+
+    abandon("The launcher helper exited");
+
+    // The exit statuses of the processes that are still running will
+    // never be known, but we can still tell when they terminate.
+    // NOTE: process::reap() polls the processes since they are not
+    // our children.
+    foreachpair (pid_t pid,
+                 const Owned<Promise<Option<int> > >& promise,
+                 statuses) {
+      if (promise->future().isPending()) {
+        process::reap(pid)
+          .onAny(defer(self(), &Self::reaped, pid, lambda::_1));
+      }
+    }
+
+    delay(Seconds(1), self(), &Self::restart);
+  }
+
+  // Fails the pending forks.
+  void abandon(const string& message)
+  {
+    foreach (const Owned<Promise<pid_t> >& promise, forks) {
+      promise->fail(message);
+    }
+    forks.clear();
+  }
+
+  const string path;
+
+  Option<int> socket;
+  Option<pid_t> helper;
+
+  // The responses read so far but not yet handled.
+  char buffer[4096];
+  string data;
+
+  // The requests being sent.
+  Future<Nothing> writing;
+
+  // The FORK requests awaiting a response, in order.
+  deque<Owned<Promise<pid_t> > > forks;
+
+  // The exit statuses of the forked processes and those of which
+  // status() has been called.
+  hashmap<pid_t, Owned<Promise<Option<int> > > > statuses;
+  hashset<pid_t> waited;
+};
+
+
+Try<LauncherHelper*> LauncherHelper::create(const Flags& flags)
+{
+  const string path = path::join(flags.launcher_dir, "mesos-launcher-helper");
+
+  Result<string> realpath = os::realpath(path);
+  if (!realpath.isSome()) {
+    return Error(
+        "Failed to determine the canonical path of '" + path + "': " +
+        (realpath.isError() ? realpath.error() : "No such file or directory"));
+  }
+
+  return new LauncherHelper(realpath.get());
+}
+
+
+LauncherHelper::LauncherHelper(const string& path)
+{
+  process = new LauncherHelperProcess(path);
+  spawn(process);
+}
+
+
+LauncherHelper::~LauncherHelper()
+{
+  terminate(process);
+  process::wait(process);
+  delete process;
+}
+
+
+Future<pid_t> LauncherHelper::fork(const LauncherHelperRequest& request)
+{
+  return dispatch(process, &LauncherHelperProcess::fork, request);
+}
+
+
+Future<Nothing> LauncherHelper::exec(pid_t pid)
+{
+  return dispatch(process, &LauncherHelperProcess::exec, pid);
+}
+
+
+Future<Option<int> > LauncherHelper::status(pid_t pid)
+{
+  return dispatch(process, &LauncherHelperProcess::status, pid);
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,86 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LAUNCHER_HELPER_HPP__
+#define __LAUNCHER_HELPER_HPP__
+
+#include <sys/types.h>
+
+#include <process/future.hpp>
+
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "messages/messages.hpp"
+
+#include "slave/flags.hpp"
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Forward declaration.
+class LauncherHelperProcess;
+
+// Forks the processes of containers (executors and fetchers) from
+// 'mesos-launcher-helper', a small process started along with the
+// slave, rather than from the slave itself: forking copies the page
+// tables of the forking process, which takes longer the more memory
+// the slave uses, and blocks the forking actor meanwhile. The helper
+// is sent requests (see LauncherHelperRequest) over a socket and
+// reports back the pids of the forked processes and, once they
+// terminate, their exit statuses. It is restarted should it exit.
+//
+// The forked processes are not children of the slave, so they must
+// be waited on with status() rather than process::reap().
+class LauncherHelper
+{
+public:
+  static Try<LauncherHelper*> create(const Flags& flags);
+
+  ~LauncherHelper();
+
+  // Forks a process for the FORK request. If the request has 'wait'
+  // set, the process is in a session of its own but will not run its
+  // command until exec() is called, so that it can be isolated first.
+  process::Future<pid_t> fork(const LauncherHelperRequest& request);
+
+  // Lets the forked process run its command.
+  process::Future<Nothing> exec(pid_t pid);
+
+  // Returns the exit status of the forked process once it terminates
+  // (as waitpid() would), or None if it is unknown, e.g., because the
+  // helper exited in the meantime (the process has still terminated).
+  // Must be called once for each forked process.
+  process::Future<Option<int> > status(pid_t pid);
+
+private:
+  explicit LauncherHelper(const std::string& path);
+
+  LauncherHelper(const LauncherHelper&); // Not copyable.
+  LauncherHelper& operator=(const LauncherHelper&); // Not assignable.
+
+  LauncherHelperProcess* process;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __LAUNCHER_HELPER_HPP__
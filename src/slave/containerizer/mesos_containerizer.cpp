@@ -22,10 +22,14 @@
 #include <process/defer.hpp>
 #include <process/io.hpp>
 #include <process/reap.hpp>
+#include <process/statistics.hpp>
 #include <process/subprocess.hpp>
 
 #include <stout/fatal.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
 #include <stout/os.hpp>
+#include <stout/strings.hpp>
 #include <stout/unreachable.hpp>
 
 #include "slave/paths.hpp"
@@ -85,6 +89,12 @@ std::string buildCommand(
   if (!flags.hadoop_home.empty()) {
     command += " HADOOP_HOME=" + flags.hadoop_home;
   }
+  if (flags.fetcher_cache_size > Bytes(0)) {
+    command += " MESOS_FETCHER_CACHE_DIR=" +
+               slave::paths::getFetcherCacheDir(flags.work_dir);
+    command += " MESOS_FETCHER_CACHE_SIZE=" +
+               stringify(flags.fetcher_cache_size);
+  }
 
   return command;
 }
@@ -94,10 +104,11 @@ MesosContainerizer::MesosContainerizer(
     const Flags& flags,
     bool local,
     const Owned<Launcher>& launcher,
-    const vector<Owned<Isolator> >& isolators)
+    const vector<Owned<Isolator> >& isolators,
+    const Option<Owned<LauncherHelper> >& helper)
 {
   process = new MesosContainerizerProcess(
-      flags, local, launcher, isolators);
+      flags, local, launcher, isolators, helper);
   spawn(process);
 }
 
@@ -155,6 +166,12 @@ Future<ResourceStatistics> MesosContainerizer::usage(
 }
 
 
+Future<Nothing> MesosContainerizer::pressure(const ContainerID& containerId)
+{
+  return dispatch(process, &MesosContainerizerProcess::pressure, containerId);
+}
+
+
 Future<Containerizer::Termination> MesosContainerizer::wait(
     const ContainerID& containerId)
 {
@@ -217,7 +234,15 @@ Future<Nothing> MesosContainerizerProcess::recover(
                   << "' for executor '" << executor.id
                   << "' of framework " << framework.id;
 
-        recoverable.push_back(run.get());
+        RunState recovered = run.get();
+        recovered.directory = paths::getExecutorRunPath(
+            flags.work_dir,
+            state.get().id,
+            framework.id,
+            executor.id,
+            containerId);
+
+        recoverable.push_back(recovered);
       }
     }
   }
@@ -262,10 +287,47 @@ Future<Nothing> MesosContainerizerProcess::_recover(
     }
   }
 
+  // Clean up the orphaned containers in the background rather than
+  // delaying the slave's re-registration, starting with the launcher
+  // since the isolators can only remove what an orphan leaves behind
+  // (e.g., its cgroups) once its processes have been killed.
+  launcher->cleanupOrphans()
+    .onAny(defer(self(), &Self::cleanupOrphans, lambda::_1));
+
   return Nothing();
 }
 
 
+void MesosContainerizerProcess::cleanupOrphans(const Future<Nothing>& future)
+{
+  if (!future.isReady()) {
+    LOG(WARNING) << "Failed to kill the processes of orphaned containers: "
+                 << (future.isFailed() ? future.failure() : "discarded");
+  }
+
+  list<Future<Nothing> > futures;
+  foreach (const Owned<Isolator>& isolator, isolators) {
+    futures.push_back(isolator->cleanupOrphans());
+  }
+
+  collect(futures)
+    .onAny(defer(self(), &Self::_cleanupOrphans, lambda::_1));
+}
+
+
+void MesosContainerizerProcess::_cleanupOrphans(
+    const Future<list<Nothing> >& future)
+{
+  if (!future.isReady()) {
+    LOG(WARNING) << "Failed to clean up orphaned containers: "
+                 << (future.isFailed() ? future.failure() : "discarded");
+    return;
+  }
+
+  VLOG(1) << "Cleaned up orphaned containers";
+}
+
+
 // This function is executed by the forked child and should be
 // async-signal-safe.
 // TODO(idownes): Several functions used here are not actually
@@ -363,6 +425,8 @@ int execute(
 // 3. Isolate the executor. Call isolate with the pid for each isolator.
 // 4. Exec the executor. The forked child is signalled to continue and exec the
 //    executor.
+// With a launcher helper, the executor is forked (and later signalled to exec)
+// by the helper rather than by the slave.
 Future<Nothing> MesosContainerizerProcess::launch(
     const ContainerID& containerId,
     const ExecutorInfo& executorInfo,
@@ -398,6 +462,46 @@ Future<Nothing> MesosContainerizerProcess::launch(
       checkpoint,
       flags.recovery_timeout);
 
+  if (helper.isSome()) {
+    LauncherHelperRequest request;
+    request.set_type(LauncherHelperRequest::FORK);
+    request.set_command(executorInfo.command().value());
+    request.set_directory(directory);
+    if (user.isSome()) {
+      request.set_user(user.get());
+    }
+
+    // The additional environment variables come first so that those
+    // of the CommandInfo take precedence.
+    foreachpair (const string& key, const string& value, env) {
+      Environment::Variable* variable =
+        request.mutable_environment()->add_variables();
+      variable->set_name(key);
+      variable->set_value(value);
+    }
+    request.mutable_environment()->MergeFrom(
+        executorInfo.command().environment());
+
+    request.set_redirect(!local);
+    request.set_wait(true);
+
+    return prepare(containerId, executorInfo, directory, user)
+      .then(defer(self(),
+                  &Self::spawn,
+                  containerId,
+                  executorInfo,
+                  request,
+                  slaveId,
+                  checkpoint))
+      .then(defer(self(),
+                  &Self::release,
+                  containerId,
+                  lambda::_1))
+      .onFailed(defer(self(),
+                      &Self::destroy,
+                      containerId));
+  }
+
   // Use a pipe to block the child until it's been isolated.
   // The parent will close its read end after the child is forked, and the
   // write end afer the child is signalled to exec.
@@ -452,7 +556,7 @@ Future<Nothing> MesosContainerizerProcess::prepare(
   // Start preparing all isolators (in parallel).
   list<Future<Nothing> > futures;
   foreach (const Owned<Isolator>& isolator, isolators) {
-    futures.push_back(isolator->prepare(containerId, executorInfo));
+    futures.push_back(isolator->prepare(containerId, executorInfo, directory));
   }
 
   // Wait for all isolators to complete preparations then fetch the executor.
@@ -469,14 +573,36 @@ Future<Nothing> MesosContainerizerProcess::prepare(
 
 Future<Nothing> _fetch(
     const ContainerID& containerId,
+    const string& statistics,
     const Option<int>& status)
 {
   if (status.isNone() || (status.get() != 0)) {
+    os::rm(statistics);
     return Failure("Failed to fetch URIs for container '" +
                    stringify(containerId) + "': exit status " +
                    (status.isNone() ? "none" : stringify(status.get())));
   }
 
+  // Record how much the fetcher fetched, and how fast, which it
+  // reports as "name=value" lines.
+  Try<string> read = os::read(statistics);
+  if (read.isSome()) {
+    foreach (const string& line, strings::tokenize(read.get(), "\n")) {
+      const vector<string> tokens = strings::tokenize(line, "=");
+      if (tokens.size() != 2) {
+        continue;
+      }
+
+      Try<double> value = numify<double>(tokens[1]);
+      if (value.isSome()) {
+        process::statistics->set("fetcher", tokens[0], value.get());
+      }
+    }
+  }
+
+  // The statistics must not be left in the executor's sandbox.
+  os::rm(statistics);
+
   return Nothing();
 }
 
@@ -503,12 +629,54 @@ Future<Nothing> MesosContainerizerProcess::fetch(
 
   string command = buildCommand(commandInfo, directory, user, flags);
 
+  const string statistics = path::join(directory, ".fetcher_statistics");
+  command += " MESOS_FETCHER_STATISTICS=" + statistics;
+
   // Now the actual mesos-fetcher command.
   command += " " + realpath.get();
 
   LOG(INFO) << "Fetching URIs for container '" << containerId
             << "' using command '" << command << "'";
 
+  if (helper.isSome()) {
+    // The helper redirects the fetcher's output to the log files in
+    // the executor work directory, which we create (or truncate) and
+    // chown here.
+    foreach (const string& name, strings::split("stdout,stderr", ",")) {
+      const string path = path::join(directory, name);
+
+      Try<int> fd = os::open(
+          path,
+          O_WRONLY | O_CREAT | O_TRUNC,
+          S_IRUSR | S_IWUSR | S_IRGRP | S_IRWXO);
+
+      if (fd.isError()) {
+        return Failure("Failed to redirect " + name + ": " + fd.error());
+      }
+
+      os::close(fd.get());
+
+      if (user.isSome()) {
+        Try<Nothing> chown = os::chown(user.get(), path);
+        if (chown.isError()) {
+          return Failure("Failed to redirect " + name + ": " + chown.error());
+        }
+      }
+    }
+
+    LauncherHelperRequest request;
+    request.set_type(LauncherHelperRequest::FORK);
+    request.set_command(command);
+    request.set_directory(directory);
+    request.set_redirect(true);
+    request.set_wait(false);
+
+    return helper.get()->fork(request)
+      .then(lambda::bind(
+          &LauncherHelper::status, helper.get().get(), lambda::_1))
+      .then(lambda::bind(&_fetch, containerId, statistics, lambda::_1));
+  }
+
   Try<Subprocess> fetcher = subprocess(command);
   if (fetcher.isError()) {
     return Failure("Failed to execute mesos-fetcher: " + fetcher.error());
@@ -573,7 +741,7 @@ Future<Nothing> MesosContainerizerProcess::fetch(
     .onAny(lambda::bind(&os::close, err.get()));
 
   return fetcher.get().status()
-    .then(lambda::bind(&_fetch, containerId, lambda::_1));
+    .then(lambda::bind(&_fetch, containerId, statistics, lambda::_1));
 }
 
 
@@ -590,8 +758,69 @@ Future<pid_t> MesosContainerizerProcess::fork(
   if (forked.isError()) {
     return Failure("Failed to fork executor: " + forked.error());
   }
-  pid_t pid = forked.get();
 
+  return this->forked(
+      containerId,
+      executorInfo,
+      slaveId,
+      checkpoint,
+      forked.get(),
+      process::reap(forked.get()));
+}
+
+
+Future<pid_t> MesosContainerizerProcess::spawn(
+    const ContainerID& containerId,
+    const ExecutorInfo& executorInfo,
+    const LauncherHelperRequest& request,
+    const SlaveID& slaveId,
+    bool checkpoint)
+{
+  CHECK_SOME(helper);
+
+  return helper.get()->fork(request)
+    .then(defer(self(),
+                &Self::adopt,
+                containerId,
+                executorInfo,
+                slaveId,
+                checkpoint,
+                lambda::_1));
+}
+
+
+Future<pid_t> MesosContainerizerProcess::adopt(
+    const ContainerID& containerId,
+    const ExecutorInfo& executorInfo,
+    const SlaveID& slaveId,
+    bool checkpoint,
+    pid_t pid)
+{
+  CHECK_SOME(helper);
+
+  // The executor is not our child so its exit status comes from the
+  // helper.
+  Future<Option<int> > status = helper.get()->status(pid);
+
+  Try<Nothing> adopt = launcher->adopt(containerId, pid);
+  if (adopt.isError()) {
+    // The executor is still blocked, waiting to exec.
+    ::kill(pid, SIGKILL);
+    return Failure("Failed to fork executor: " + adopt.error());
+  }
+
+  return forked(containerId, executorInfo, slaveId, checkpoint, pid, status);
+}
+
+
+Future<pid_t> MesosContainerizerProcess::forked(
+    const ContainerID& containerId,
+    const ExecutorInfo& executorInfo,
+    const SlaveID& slaveId,
+    bool checkpoint,
+    pid_t pid,
+    const Future<Option<int> >& status)
+{
   // Checkpoint the executor's pid if requested.
   if (checkpoint) {
     const string& path = slave::paths::getForkedPidPath(
@@ -617,7 +846,6 @@ Future<pid_t> MesosContainerizerProcess::fork(
 
   // Monitor the executor's pid. We keep the future because we'll refer to it
   // again during container destroy.
-  Future<Option<int> > status = process::reap(pid);
   statuses.put(containerId, status);
   status.onAny(defer(self(), &Self::reaped, containerId));
 
@@ -684,6 +912,17 @@ Future<Nothing> MesosContainerizerProcess::exec(
 }
 
 
+Future<Nothing> MesosContainerizerProcess::release(
+    const ContainerID& containerId,
+    pid_t pid)
+{
+  CHECK_SOME(helper);
+
+  return isolate(containerId, pid)
+    .then(lambda::bind(&LauncherHelper::exec, helper.get().get(), pid));
+}
+
+
 Future<Containerizer::Termination> MesosContainerizerProcess::wait(
     const ContainerID& containerId)
 {
@@ -753,6 +992,11 @@ Future<ResourceStatistics> _usage(
     if (cpus.isSome()) {
       result.set_cpus_limit(cpus.get());
     }
+
+    Option<Bytes> disk = resources.get().disk();
+    if (disk.isSome()) {
+      result.set_disk_limit_bytes(disk.get().bytes());
+    }
   }
 
   return result;
@@ -780,6 +1024,42 @@ Future<ResourceStatistics> MesosContainerizerProcess::usage(
 }
 
 
+static void _pressure(const Owned<Promise<Nothing> >& promise)
+{
+  promise->set(Nothing());
+}
+
+
+static void __pressure(const Owned<Promise<Nothing> >& promise)
+{
+  // A no-op if an isolator reported pressure already.
+  promise->fail("Not supported by any isolator");
+}
+
+
+Future<Nothing> MesosContainerizerProcess::pressure(
+    const ContainerID& containerId)
+{
+  if (!promises.contains(containerId)) {
+    return Failure("Unknown container: " + stringify(containerId));
+  }
+
+  // Report the first isolator to see pressure, if any can.
+  Owned<Promise<Nothing> > promise(new Promise<Nothing>());
+
+  list<Future<Nothing> > futures;
+  foreach (const Owned<Isolator>& isolator, isolators) {
+    futures.push_back(isolator->pressure(containerId));
+    futures.back().onReady(lambda::bind(&_pressure, promise));
+  }
+
+  await(futures)
+    .onAny(lambda::bind(&__pressure, promise));
+
+  return promise->future();
+}
+
+
 void MesosContainerizerProcess::destroy(const ContainerID& containerId)
 {
   if (!promises.contains(containerId)) {
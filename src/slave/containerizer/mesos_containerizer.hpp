@@ -29,6 +29,7 @@
 #include "slave/containerizer/containerizer.hpp"
 #include "slave/containerizer/isolator.hpp"
 #include "slave/containerizer/launcher.hpp"
+#include "slave/containerizer/launcher_helper.hpp"
 
 namespace mesos {
 namespace internal {
@@ -44,7 +45,8 @@ public:
       const Flags& flags,
       bool local,
       const process::Owned<Launcher>& launcher,
-      const std::vector<process::Owned<Isolator> >& isolators);
+      const std::vector<process::Owned<Isolator> >& isolators,
+      const Option<process::Owned<LauncherHelper> >& helper = None());
 
   virtual ~MesosContainerizer();
 
@@ -67,6 +69,8 @@ public:
   virtual process::Future<ResourceStatistics> usage(
       const ContainerID& containerId);
 
+  virtual process::Future<Nothing> pressure(const ContainerID& containerId);
+
   virtual process::Future<Containerizer::Termination> wait(
       const ContainerID& containerId);
 
@@ -84,11 +88,13 @@ public:
       const Flags& _flags,
       bool _local,
       const process::Owned<Launcher>& _launcher,
-      const std::vector<process::Owned<Isolator> >& _isolators)
+      const std::vector<process::Owned<Isolator> >& _isolators,
+      const Option<process::Owned<LauncherHelper> >& _helper)
     : flags(_flags),
       local(_local),
       launcher(_launcher),
-      isolators(_isolators) {}
+      isolators(_isolators),
+      helper(_helper) {}
 
   virtual ~MesosContainerizerProcess() {}
 
@@ -111,6 +117,8 @@ public:
   process::Future<ResourceStatistics> usage(
       const ContainerID& containerId);
 
+  process::Future<Nothing> pressure(const ContainerID& containerId);
+
   process::Future<Containerizer::Termination> wait(
       const ContainerID& containerId);
 
@@ -120,6 +128,14 @@ private:
   process::Future<Nothing> _recover(
       const std::list<state::RunState>& recovered);
 
+  // Continues the cleanup of orphaned containers started by
+  // '_recover()' once the launcher has killed their processes.
+  void cleanupOrphans(const process::Future<Nothing>& future);
+
+  // Completes the cleanup of orphaned containers once the isolators
+  // have cleaned up after them.
+  void _cleanupOrphans(const process::Future<std::list<Nothing> >& future);
+
   process::Future<Nothing> prepare(
       const ContainerID& containerId,
       const ExecutorInfo& executorInfo,
@@ -140,6 +156,33 @@ private:
       bool checkpoint,
       int pipeRead);
 
+  // Forks the executor with the launcher helper instead, see
+  // 'launch()'.
+  process::Future<pid_t> spawn(
+      const ContainerID& containerId,
+      const ExecutorInfo& executorInfo,
+      const LauncherHelperRequest& request,
+      const SlaveID& slaveId,
+      bool checkpoint);
+
+  // Continues 'spawn()' once the launcher helper forked the executor.
+  process::Future<pid_t> adopt(
+      const ContainerID& containerId,
+      const ExecutorInfo& executorInfo,
+      const SlaveID& slaveId,
+      bool checkpoint,
+      pid_t pid);
+
+  // Checkpoints the pid of the forked executor, if requested, and
+  // monitors its exit status.
+  process::Future<pid_t> forked(
+      const ContainerID& containerId,
+      const ExecutorInfo& executorInfo,
+      const SlaveID& slaveId,
+      bool checkpoint,
+      pid_t pid,
+      const process::Future<Option<int> >& status);
+
   process::Future<Nothing> isolate(
       const ContainerID& containerId,
       pid_t _pid);
@@ -152,6 +195,12 @@ private:
       const ContainerID& containerId,
       int pipeWrite);
 
+  // Isolates the executor forked by the launcher helper then lets it
+  // exec.
+  process::Future<Nothing> release(
+      const ContainerID& containerId,
+      pid_t pid);
+
   // Continues 'destroy()' once all processes have been killed by the launcher.
   void _destroy(
       const ContainerID& containerId,
@@ -177,6 +226,7 @@ private:
   const bool local;
   const process::Owned<Launcher> launcher;
   const std::vector<process::Owned<Isolator> > isolators;
+  const Option<process::Owned<LauncherHelper> > helper;
 
   // TODO(idownes): Consider putting these per-container variables into a
   // struct.
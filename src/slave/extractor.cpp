@@ -0,0 +1,549 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/none.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/strings.hpp>
+
+#include "slave/extractor.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Archives are made of blocks of this size: a header block for each
+// entry, followed by the entry's contents padded to a whole block.
+static const size_t BLOCK_SIZE = 512;
+
+// Offsets and sizes of the (ustar) header fields we use.
+static const size_t NAME = 0;
+static const size_t NAME_SIZE = 100;
+static const size_t MODE = 100;
+static const size_t MODE_SIZE = 8;
+static const size_t SIZE = 124;
+static const size_t SIZE_SIZE = 12;
+static const size_t MTIME = 136;
+static const size_t MTIME_SIZE = 12;
+static const size_t CHECKSUM = 148;
+static const size_t CHECKSUM_SIZE = 8;
+static const size_t TYPE = 156;
+static const size_t LINKNAME = 157;
+static const size_t LINKNAME_SIZE = 100;
+static const size_t MAGIC = 257;
+static const size_t PREFIX = 345;
+static const size_t PREFIX_SIZE = 155;
+
+// The longest GNU long name or pax header we accept.
+static const uint64_t MAX_EXTENSION_SIZE = 1024 * 1024;
+
+
+// Returns the (not necessarily NUL terminated) string in a field.
+static string field(const char* block, size_t offset, size_t size)
+{
+  const char* begin = block + offset;
+  return string(begin, std::find(begin, begin + size, '\0'));
+}
+
+
+// Parses a numeric field, which is octal unless its high bit is set,
+// in which case it is big-endian binary (a GNU extension used for
+// sizes of 8GB and above).
+static Try<uint64_t> number(const char* block, size_t offset, size_t size)
+{
+  const unsigned char* begin =
+    reinterpret_cast<const unsigned char*>(block + offset);
+  const unsigned char* end = begin + size;
+
+  uint64_t value = 0;
+
+  if (*begin & 0x80) {
+    value = *begin++ & 0x7f;
+    while (begin < end) {
+      if (value >> 56) {
+        return Error("Numeric field overflows");
+      }
+      value = (value << 8) | *begin++;
+    }
+    return value;
+  }
+
+  while (begin < end && (*begin == ' ' || *begin == '\0')) {
+    begin++;
+  }
+
+  while (begin < end && *begin >= '0' && *begin <= '7') {
+    if (value >> 61) {
+      return Error("Numeric field overflows");
+    }
+    value = (value << 3) | (*begin++ - '0');
+  }
+
+  if (begin < end && *begin != ' ' && *begin != '\0') {
+    return Error("Invalid numeric field");
+  }
+
+  return value;
+}
+
+
+Extractor::Extractor(const string& _directory, bool compressed)
+  : directory(_directory),
+    decompressor(compressed ? new gzip::Decompressor() : NULL),
+    type('\0'),
+    mode(0),
+    mtime(0),
+    remaining(0),
+    padding(0),
+    done(false) {}
+
+
+Extractor::~Extractor()
+{
+  if (fd.isSome()) {
+    os::close(fd.get());
+  }
+
+  delete decompressor;
+}
+
+
+bool Extractor::extractable(const string& filename, bool* compressed)
+{
+  if (strings::endsWith(filename, ".tgz") ||
+      strings::endsWith(filename, ".tar.gz")) {
+    *compressed = true;
+    return true;
+  }
+
+  return false;
+}
+
+
+Try<Nothing> Extractor::write(const char* data, size_t length)
+{
+  if (decompressor == NULL) {
+    return consume(data, length);
+  }
+
+  Try<string> decompressed =
+    decompressor->decompress(string(data, length));
+
+  if (decompressed.isError()) {
+    return Error("Failed to decompress: " + decompressed.error());
+  }
+
+  return consume(decompressed.get().data(), decompressed.get().size());
+}
+
+
+Try<Nothing> Extractor::finish()
+{
+  if (decompressor != NULL && !decompressor->finished()) {
+    return Error("Truncated archive: incomplete gzip stream");
+  }
+
+  // Some archivers omit the end of archive marker, which is fine as
+  // long as the archive ends on an entry boundary.
+  if (!done && (!block.empty() || remaining > 0 || padding > 0)) {
+    return Error("Truncated archive");
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> Extractor::consume(const char* data, size_t length)
+{
+  // Anything after the end of archive marker is padding.
+  while (length > 0 && !done) {
+    if (remaining > 0) {
+      size_t size = std::min<uint64_t>(length, remaining);
+
+      if (fd.isSome()) {
+        Try<Nothing> write = os::write(fd.get(), string(data, size));
+        if (write.isError()) {
+          return Error("Failed to write '" + name + "': " + write.error());
+        }
+      } else if (type == 'L' || type == 'K' || type == 'x') {
+        contents.append(data, size);
+      }
+
+      data += size;
+      length -= size;
+      remaining -= size;
+
+      if (remaining == 0) {
+        Try<Nothing> completed = entry();
+        if (completed.isError()) {
+          return completed;
+        }
+      }
+    } else if (padding > 0) {
+      size_t size = std::min<uint64_t>(length, padding);
+
+      data += size;
+      length -= size;
+      padding -= size;
+    } else {
+      size_t size = std::min(length, BLOCK_SIZE - block.size());
+
+      block.append(data, size);
+
+      data += size;
+      length -= size;
+
+      if (block.size() == BLOCK_SIZE) {
+        Try<Nothing> parsed = header(block.data());
+        block.clear();
+
+        if (parsed.isError()) {
+          return parsed;
+        }
+      }
+    }
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> Extractor::header(const char* data)
+{
+  // The end of the archive is marked by a data of zeros.
+  if (std::count(data, data + BLOCK_SIZE, '\0') == (long) BLOCK_SIZE) {
+    done = true;
+    return Nothing();
+  }
+
+  // The checksum is the sum of the header's bytes, with the checksum
+  // field itself taken as spaces.
+  Try<uint64_t> checksum = number(data, CHECKSUM, CHECKSUM_SIZE);
+  if (checksum.isError()) {
+    return Error("Invalid header checksum: " + checksum.error());
+  }
+
+  uint64_t sum = 0;
+  for (size_t i = 0; i < BLOCK_SIZE; i++) {
+    sum += (i >= CHECKSUM && i < CHECKSUM + CHECKSUM_SIZE)
+      ? ' '
+      : static_cast<unsigned char>(data[i]);
+  }
+
+  if (sum != checksum.get()) {
+    return Error("Invalid header checksum, is this a tar archive?");
+  }
+
+  Try<uint64_t> size = number(data, SIZE, SIZE_SIZE);
+  if (size.isError()) {
+    return Error("Invalid size: " + size.error());
+  }
+
+  Try<uint64_t> _mode = number(data, MODE, MODE_SIZE);
+  if (_mode.isError()) {
+    return Error("Invalid mode: " + _mode.error());
+  }
+
+  Try<uint64_t> _mtime = number(data, MTIME, MTIME_SIZE);
+  if (_mtime.isError()) {
+    return Error("Invalid modification time: " + _mtime.error());
+  }
+
+  type = data[TYPE];
+  mode = _mode.get() & 0777;
+  mtime = _mtime.get();
+  remaining = size.get();
+  padding = (BLOCK_SIZE - remaining % BLOCK_SIZE) % BLOCK_SIZE;
+
+  // GNU long names and pax headers describe the next entry.
+  if (type == 'L' || type == 'K' || type == 'x') {
+    if (remaining > MAX_EXTENSION_SIZE) {
+      return Error("Extended header too large");
+    }
+    contents.clear();
+    return remaining == 0 ? entry() : Nothing();
+  }
+
+  name = field(data, NAME, NAME_SIZE);
+  linkname = field(data, LINKNAME, LINKNAME_SIZE);
+
+  if (memcmp(data + MAGIC, "ustar", 5) == 0) {
+    const string prefix = field(data, PREFIX, PREFIX_SIZE);
+    if (!prefix.empty()) {
+      name = prefix + "/" + name;
+    }
+  }
+
+  if (longname.isSome()) {
+    name = longname.get();
+    longname = None();
+  }
+
+  if (longlinkname.isSome()) {
+    linkname = longlinkname.get();
+    longlinkname = None();
+  }
+
+  if (longsize.isSome()) {
+    remaining = longsize.get();
+    padding = (BLOCK_SIZE - remaining % BLOCK_SIZE) % BLOCK_SIZE;
+    longsize = None();
+  }
+
+  switch (type) {
+    case '0':
+    case '\0':
+    case '7': { // Contiguous files are regular files to everyone else.
+      Try<string> path = resolve(name);
+      if (path.isError()) {
+        return Error(path.error());
+      }
+
+      Try<Nothing> mkdir = os::mkdir(os::dirname(path.get()).get());
+      if (mkdir.isError()) {
+        return Error("Failed to create the directory for '" + name + "': " +
+                     mkdir.error());
+      }
+
+      // Replace any existing file, without following it if it is a
+      // symbolic link.
+      ::unlink(path.get().c_str());
+
+      Try<int> open = os::open(
+          path.get(),
+          O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+          S_IRUSR | S_IWUSR);
+
+      if (open.isError()) {
+        return Error("Failed to create '" + name + "': " + open.error());
+      }
+
+      fd = open.get();
+      break;
+    }
+    case '1': { // Hard link.
+      Try<string> path = resolve(name);
+      if (path.isError()) {
+        return Error(path.error());
+      }
+
+      Try<string> target = resolve(linkname);
+      if (target.isError()) {
+        return Error(target.error());
+      }
+
+      ::unlink(path.get().c_str());
+
+      if (::link(target.get().c_str(), path.get().c_str()) < 0) {
+        return ErrnoError("Failed to link '" + name + "' to '" + linkname + "'");
+      }
+      break;
+    }
+    case '2': { // Symbolic link.
+      Try<string> path = resolve(name);
+      if (path.isError()) {
+        return Error(path.error());
+      }
+
+      Try<Nothing> mkdir = os::mkdir(os::dirname(path.get()).get());
+      if (mkdir.isError()) {
+        return Error("Failed to create the directory for '" + name + "': " +
+                     mkdir.error());
+      }
+
+      ::unlink(path.get().c_str());
+
+      if (::symlink(linkname.c_str(), path.get().c_str()) < 0) {
+        return ErrnoError("Failed to symlink '" + name + "'");
+      }
+      break;
+    }
+    case '5': { // Directory.
+      Try<string> path = resolve(name);
+      if (path.isError()) {
+        return Error(path.error());
+      }
+
+      Try<Nothing> mkdir = os::mkdir(path.get());
+      if (mkdir.isError()) {
+        return Error("Failed to create '" + name + "': " + mkdir.error());
+      }
+
+      // Keep the directory writable so its entries can be extracted.
+      if (::chmod(path.get().c_str(), mode | S_IRWXU) < 0) {
+        return ErrnoError("Failed to chmod '" + name + "'");
+      }
+      break;
+    }
+    default:
+      // Devices, FIFOs and global pax headers have no business in a
+      // sandbox, so we skip their contents (if any).
+      LOG(WARNING) << "Skipping '" << name << "' of unsupported type '"
+                   << type << "'";
+      break;
+  }
+
+  return remaining == 0 ? entry() : Nothing();
+}
+
+
+Try<Nothing> Extractor::entry()
+{
+  switch (type) {
+    case 'L':
+      longname = string(contents.c_str());
+      break;
+    case 'K':
+      longlinkname = string(contents.c_str());
+      break;
+    case 'x':
+      pax();
+      break;
+    default:
+      if (fd.isSome()) {
+        int fd_ = fd.get();
+        fd = None();
+
+        struct timeval times[2];
+        times[0].tv_sec = times[1].tv_sec = mtime;
+        times[0].tv_usec = times[1].tv_usec = 0;
+
+        if (::fchmod(fd_, mode) < 0 || ::futimes(fd_, times) < 0) {
+          ErrnoError error("Failed to set the attributes of '" + name + "'");
+          os::close(fd_);
+          return error;
+        }
+
+        Try<Nothing> close = os::close(fd_);
+        if (close.isError()) {
+          return Error("Failed to close '" + name + "': " + close.error());
+        }
+      }
+      break;
+  }
+
+  return Nothing();
+}
+
+
+Try<string> Extractor::resolve(const string& name) const
+{
+  if (strings::startsWith(name, "/")) {
+    return Error("Refusing to extract '" + name + "' with an absolute path");
+  }
+
+  const vector<string> components = strings::tokenize(name, "/");
+
+  string path = directory;
+  for (size_t i = 0; i < components.size(); i++) {
+    if (components[i] == ".") {
+      continue;
+    } else if (components[i] == "..") {
+      return Error("Refusing to extract '" + name + "' outside of '" +
+                   directory + "'");
+    }
+
+    path = path::join(path, components[i]);
+
+    // Refuse to extract through a symbolic link (e.g., one extracted
+    // earlier from the archive), which could lead anywhere.
+    struct stat s;
+    if (i + 1 < components.size() &&
+        ::lstat(path.c_str(), &s) == 0 &&
+        S_ISLNK(s.st_mode)) {
+      return Error("Refusing to extract '" + name +
+                   "' through a symbolic link");
+    }
+  }
+
+  return path;
+}
+
+
+void Extractor::pax()
+{
+  // Each record is "<length> <key>=<value>\n", where the length
+  // covers the whole record.
+  size_t offset = 0;
+  while (offset < contents.size()) {
+    size_t space = contents.find(' ', offset);
+    if (space == string::npos) {
+      break;
+    }
+
+    Try<size_t> length = numify<size_t>(
+        contents.substr(offset, space - offset));
+
+    if (length.isError() ||
+        length.get() <= space - offset + 1 ||
+        offset + length.get() > contents.size()) {
+      LOG(WARNING) << "Ignoring malformed pax header";
+      break;
+    }
+
+    // Strip the trailing newline.
+    const string record =
+      contents.substr(space + 1, offset + length.get() - space - 2);
+
+    offset += length.get();
+
+    size_t equals = record.find('=');
+    if (equals == string::npos) {
+      continue;
+    }
+
+    const string key = record.substr(0, equals);
+    const string value = record.substr(equals + 1);
+
+    if (key == "path") {
+      longname = value;
+    } else if (key == "linkpath") {
+      longlinkname = value;
+    } else if (key == "size") {
+      Try<uint64_t> size = numify<uint64_t>(value);
+      if (size.isSome()) {
+        longsize = size.get();
+      }
+    }
+  }
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,123 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SLAVE_EXTRACTOR_HPP__
+#define __SLAVE_EXTRACTOR_HPP__
+
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#include <string>
+
+#include <stout/gzip.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Extracts a tar archive, optionally gzip compressed, into a
+// directory as the bytes of the archive arrive, e.g., while it is
+// being downloaded, rather than running 'tar' once the whole archive
+// has been written to disk.
+//
+// Supports the ustar format along with the GNU long name and pax path
+// extensions. Regular files, directories, symbolic links and hard
+// links are extracted; other entries (devices, FIFOs) are skipped.
+// Entries with absolute paths or paths leading outside of the
+// directory are rejected.
+class Extractor
+{
+public:
+  Extractor(const std::string& directory, bool compressed);
+  ~Extractor();
+
+  // Returns true if the file can be extracted by an Extractor and
+  // sets 'compressed' accordingly, based on its extension: .tgz or
+  // .tar.gz for compressed archives. Plain .tar files are not
+  // extracted when fetched, hence not extractable.
+  static bool extractable(const std::string& filename, bool* compressed);
+
+  // Extracts the next piece of the archive.
+  Try<Nothing> write(const char* data, size_t length);
+
+  // Completes the extraction, returning an error if the archive was
+  // truncated.
+  Try<Nothing> finish();
+
+private:
+  // Not copyable, since it owns the file being extracted.
+  Extractor(const Extractor&);
+  Extractor& operator = (const Extractor&);
+
+  // Consumes decompressed archive data.
+  Try<Nothing> consume(const char* data, size_t length);
+
+  // Handles a complete header block.
+  Try<Nothing> header(const char* data);
+
+  // Handles the complete contents of the current entry.
+  Try<Nothing> entry();
+
+  // Returns the path within the directory of an entry.
+  Try<std::string> resolve(const std::string& name) const;
+
+  // Parses the pax extended header records held in 'contents'.
+  void pax();
+
+  const std::string directory;
+
+  // Set if the archive is compressed.
+  gzip::Decompressor* decompressor;
+
+  // The partial header block, if the last piece of data ended in one.
+  std::string block;
+
+  // The current entry.
+  char type;
+  std::string name;
+  std::string linkname;
+  mode_t mode;
+  time_t mtime;
+
+  // The file being written for a regular file entry.
+  Option<int> fd;
+
+  // The contents of a GNU long name or pax header entry, which apply
+  // to the next entry.
+  std::string contents;
+  Option<std::string> longname;
+  Option<std::string> longlinkname;
+  Option<uint64_t> longsize;
+
+  // Bytes of the current entry (and its padding) left to consume.
+  uint64_t remaining;
+  uint64_t padding;
+
+  // Whether the end of archive marker was seen.
+  bool done;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __SLAVE_EXTRACTOR_HPP__
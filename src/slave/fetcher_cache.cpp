@@ -0,0 +1,506 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/format.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/none.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/result.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "slave/fetcher_cache.hpp"
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Locks the file at 'path', creating it if necessary, and returns
+// the file descriptor that holds the lock (closing it releases the
+// lock). Returns none if the lock is held elsewhere and 'block' is
+// false. The lock file may be removed while the lock is held (see
+// 'FetcherCache::evict'), in which case locking starts over with a
+// new lock file.
+static Result<int> lock(const string& path, bool block)
+{
+  while (true) {
+    Try<int> fd = os::open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd.isError()) {
+      return Error("Failed to open '" + path + "': " + fd.error());
+    }
+
+    if (::flock(fd.get(), LOCK_EX | (block ? 0 : LOCK_NB)) != 0) {
+      const bool locked = errno == EWOULDBLOCK;
+      const Error error = ErrnoError("Failed to lock '" + path + "'");
+      os::close(fd.get());
+
+      if (locked) {
+        return None();
+      }
+      return error;
+    }
+
+    // Check that the file we locked is still the lock file.
+    struct stat locked;
+    struct stat current;
+    if (::fstat(fd.get(), &locked) == 0 &&
+        ::stat(path.c_str(), &current) == 0 &&
+        locked.st_dev == current.st_dev &&
+        locked.st_ino == current.st_ino) {
+      return fd.get();
+    }
+
+    os::close(fd.get());
+  }
+}
+
+
+// Copies the file at 'from' to 'to', replacing 'to' if it exists.
+static Try<Nothing> copy(const string& from, const string& to)
+{
+  Try<int> in = os::open(from, O_RDONLY);
+  if (in.isError()) {
+    return Error("Failed to open '" + from + "': " + in.error());
+  }
+
+  Try<int> out = os::open(
+      to,
+      O_WRONLY | O_CREAT | O_TRUNC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (out.isError()) {
+    os::close(in.get());
+    return Error("Failed to open '" + to + "': " + out.error());
+  }
+
+  char buffer[64 * 1024];
+  ssize_t length;
+  while ((length = ::read(in.get(), buffer, sizeof(buffer))) != 0) {
+    if (length < 0 && errno == EINTR) {
+      continue;
+    } else if (length < 0) {
+      break;
+    }
+
+    Try<Nothing> write =
+      os::write(out.get(), string(buffer, static_cast<size_t>(length)));
+    if (write.isError()) {
+      os::close(in.get());
+      os::close(out.get());
+      return Error("Failed to write '" + to + "': " + write.error());
+    }
+  }
+
+  const Try<Nothing> error = length < 0
+    ? Try<Nothing>(ErrnoError("Failed to read '" + from + "'"))
+    : Try<Nothing>(Nothing());
+
+  os::close(in.get());
+  os::close(out.get());
+
+  return error;
+}
+
+
+static size_t header(char* buffer, size_t size, size_t count, void* etag)
+{
+  const string line(buffer, size * count);
+  if (strings::startsWith(strings::lower(line), "etag:")) {
+    *static_cast<string*>(etag) = strings::trim(line.substr(5));
+  }
+  return size * count;
+}
+
+
+// Downloads the URL to 'path' unless the resource has not changed
+// according to the 'validators' it was last downloaded with (in
+// which case 'path' is not written). Returns whether the resource was
+// downloaded, after updating 'validators'.
+static Try<bool> download(
+    const string& url,
+    const string& path,
+    map<string, string>* validators)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == NULL) {
+    return ErrnoError("Failed to open '" + path + "'");
+  }
+
+  // NOTE: libcurl has been initialized before any fetches started
+  // (see launcher/fetcher.cpp), since that is not thread-safe.
+  CURL* curl = curl_easy_init();
+
+  if (curl == NULL) {
+    fclose(file);
+    return Error("Failed to initialize libcurl");
+  }
+
+  string etag;
+
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &header);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &etag);
+  curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+
+  struct curl_slist* headers = NULL;
+  if (validators->count("etag") > 0) {
+    headers = curl_slist_append(
+        headers, ("If-None-Match: " + (*validators)["etag"]).c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  }
+
+  if (validators->count("mtime") > 0) {
+    Try<long> mtime = numify<long>((*validators)["mtime"]);
+    if (mtime.isSome()) {
+      curl_easy_setopt(curl, CURLOPT_TIMECONDITION, CURL_TIMECOND_IFMODSINCE);
+      curl_easy_setopt(curl, CURLOPT_TIMEVALUE, mtime.get());
+    }
+  }
+
+  CURLcode code = curl_easy_perform(curl);
+
+  long status = 0;
+  long unmet = 0;
+  long filetime = -1;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  curl_easy_getinfo(curl, CURLINFO_CONDITION_UNMET, &unmet);
+  curl_easy_getinfo(curl, CURLINFO_FILETIME, &filetime);
+
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+
+  if (fclose(file) != 0 && code == CURLE_OK) {
+    return ErrnoError("Failed to close '" + path + "'");
+  }
+
+  if (code != CURLE_OK) {
+    return Error(curl_easy_strerror(code));
+  } else if (status == 304 || unmet != 0) {
+    return false; // Not modified.
+  } else if (status != 200) {
+    return Error("HTTP/FTP error (" + stringify(status) + ")");
+  }
+
+  validators->clear();
+
+  if (!etag.empty()) {
+    (*validators)["etag"] = etag;
+  }
+
+  if (filetime >= 0) {
+    (*validators)["mtime"] = stringify(filetime);
+  }
+
+  return true;
+}
+
+
+// Copies the local file to 'path' unless it has not changed according
+// to the 'validators' it was last copied with. Returns whether the
+// file was copied, after updating 'validators'.
+static Try<bool> copy(
+    const string& local,
+    const string& path,
+    map<string, string>* validators)
+{
+  struct stat s;
+  if (::stat(local.c_str(), &s) < 0) {
+    return ErrnoError("Failed to stat '" + local + "'");
+  }
+
+  const string size = stringify(s.st_size);
+  const string mtime = stringify(s.st_mtime);
+
+  if (validators->count("size") > 0 &&
+      validators->count("mtime") > 0 &&
+      (*validators)["size"] == size &&
+      (*validators)["mtime"] == mtime) {
+    return false; // Not modified.
+  }
+
+  Try<Nothing> copy = slave::copy(local, path);
+  if (copy.isError()) {
+    return Error(copy.error());
+  }
+
+  validators->clear();
+  (*validators)["size"] = size;
+  (*validators)["mtime"] = mtime;
+
+  return true;
+}
+
+
+static bool remote(const string& uri)
+{
+  return strings::startsWith(uri, "http://") ||
+         strings::startsWith(uri, "https://") ||
+         strings::startsWith(uri, "ftp://") ||
+         strings::startsWith(uri, "ftps://");
+}
+
+
+FetcherCache::FetcherCache(const string& _directory, const Bytes& _size)
+  : directory(_directory),
+    size(_size),
+    hits_(0),
+    misses_(0) {}
+
+
+bool FetcherCache::cacheable(const string& uri)
+{
+  return remote(uri) || strings::startsWith(uri, "/");
+}
+
+
+Try<Nothing> FetcherCache::fetch(const string& uri, const string& path)
+{
+  if (!cacheable(uri)) {
+    return Error("URI is not cacheable");
+  }
+
+  Try<Nothing> mkdir = os::mkdir(directory);
+  if (mkdir.isError()) {
+    return Error("Failed to create the cache directory '" + directory +
+                 "': " + mkdir.error());
+  }
+
+  const string entry = path::join(
+      directory,
+      strings::format("%016zx", boost::hash<string>()(uri)).get());
+
+  // Fetches of the same URI wait for one another, so a URI is only
+  // transferred once. The lock is held until the URI has been placed
+  // at 'path', and throughout the eviction below, so that the entry
+  // does not get evicted in the meantime.
+  Result<int> fd = lock(entry + ".lock", true);
+  if (!fd.isSome()) {
+    return Error(fd.isError() ? fd.error() : "Failed to lock the entry");
+  }
+
+  Try<string> cached = _fetch(uri, entry);
+
+  const Try<Nothing> placed = cached.isError()
+    ? Try<Nothing>(Error(cached.error()))
+    : slave::copy(cached.get(), path);
+
+  if (placed.isSome()) {
+    Try<Nothing> evicted = evict();
+    if (evicted.isError()) {
+      LOG(WARNING) << "Failed to evict from the fetcher cache: "
+                   << evicted.error();
+    }
+  }
+
+  os::close(fd.get());
+
+  return placed;
+}
+
+
+Try<string> FetcherCache::_fetch(const string& uri, const string& entry)
+{
+  Try<Nothing> mkdir = os::mkdir(entry);
+  if (mkdir.isError()) {
+    return Error("Failed to create the cache entry '" + entry +
+                 "': " + mkdir.error());
+  }
+
+  // Each entry records its URI to tell hash collisions apart.
+  const string name = path::join(entry, "uri");
+  if (os::exists(name)) {
+    Try<string> read = os::read(name);
+    if (read.isError()) {
+      return Error("Failed to read '" + name + "': " + read.error());
+    } else if (read.get() != uri) {
+      return Error("The cache entry for '" + uri + "' is taken by '" +
+                   read.get() + "'");
+    }
+  } else {
+    Try<Nothing> write = os::write(name, uri);
+    if (write.isError()) {
+      return Error("Failed to write '" + name + "': " + write.error());
+    }
+  }
+
+  const string content = path::join(entry, "content");
+  const string validators_ = path::join(entry, "validators");
+
+  // The validators are only meaningful along with the content.
+  map<string, string> validators;
+  if (os::exists(content) && os::exists(validators_)) {
+    Try<string> read = os::read(validators_);
+    if (read.isError()) {
+      return Error("Failed to read '" + validators_ + "': " + read.error());
+    }
+
+    foreach (const string& line, strings::tokenize(read.get(), "\n")) {
+      const size_t index = line.find('=');
+      if (index != string::npos) {
+        validators[line.substr(0, index)] = line.substr(index + 1);
+      }
+    }
+  }
+
+  const string temporary = content + ".tmp";
+
+  Try<bool> changed = remote(uri)
+    ? download(uri, temporary, &validators)
+    : copy(uri, temporary, &validators);
+
+  if (changed.isError()) {
+    os::rm(temporary);
+    return Error(changed.error());
+  }
+
+  if (changed.get()) {
+    // The cached copy never changes once cached.
+    if (!os::chmod(temporary, S_IRUSR | S_IRGRP | S_IROTH)) {
+      return ErrnoError("Failed to chmod '" + temporary + "'");
+    }
+
+    if (::rename(temporary.c_str(), content.c_str()) != 0) {
+      return ErrnoError("Failed to rename '" + temporary + "'");
+    }
+
+    string lines;
+    foreachpair (const string& key, const string& value, validators) {
+      lines += key + "=" + value + "\n";
+    }
+
+    Try<Nothing> write = os::write(validators_, lines);
+    if (write.isError()) {
+      return Error("Failed to write '" + validators_ + "': " + write.error());
+    }
+
+    LOG(INFO) << "Cached '" << uri << "' in '" << entry << "'";
+    misses_++;
+  } else {
+    os::rm(temporary);
+
+    LOG(INFO) << "Using the cached copy of '" << uri << "' in '"
+              << entry << "'";
+    hits_++;
+  }
+
+  // The modification time of an entry tells when it was last used.
+  os::utime(entry);
+
+  return content;
+}
+
+
+Try<Nothing> FetcherCache::evict()
+{
+  // Only one fetcher evicts at a time, the others carry on.
+  Result<int> fd = lock(path::join(directory, "evict.lock"), false);
+  if (fd.isError()) {
+    return Error(fd.error());
+  } else if (fd.isNone()) {
+    return Nothing();
+  }
+
+  // Entries ordered by when they were last used.
+  vector<std::pair<time_t, string> > entries;
+  hashmap<string, off_t> sizes;
+  off_t total = 0;
+
+  foreach (const string& name, os::ls(directory)) {
+    const string entry = path::join(directory, name);
+    if (!os::isdir(entry)) {
+      continue; // Lock files.
+    }
+
+    struct stat s;
+    if (::stat(entry.c_str(), &s) < 0) {
+      continue;
+    }
+    entries.push_back(std::make_pair(s.st_mtime, entry));
+
+    const string content = path::join(entry, "content");
+    sizes[entry] = ::stat(content.c_str(), &s) == 0 ? s.st_size : 0;
+    total += sizes[entry];
+  }
+
+  std::sort(entries.begin(), entries.end());
+
+  for (size_t i = 0;
+       i < entries.size() && total > static_cast<off_t>(size.bytes());
+       i++) {
+    const string& entry = entries[i].second;
+
+    // Skip the entries that are being fetched (including the one this
+    // fetcher holds, as locks are per open file).
+    Result<int> locked = lock(entry + ".lock", false);
+    if (!locked.isSome()) {
+      continue;
+    }
+
+    Try<Nothing> rmdir = os::rmdir(entry);
+    if (rmdir.isError()) {
+      LOG(WARNING) << "Failed to evict '" << entry << "' from the fetcher"
+                   << " cache: " << rmdir.error();
+    } else {
+      LOG(INFO) << "Evicted '" << entry << "' from the fetcher cache";
+      total -= sizes[entry];
+
+      // Fetchers waiting for the lock start over once they get it
+      // (see 'lock').
+      os::rm(entry + ".lock");
+    }
+
+    os::close(locked.get());
+  }
+
+  os::close(fd.get());
+
+  return Nothing();
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,88 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SLAVE_FETCHER_CACHE_HPP__
+#define __SLAVE_FETCHER_CACHE_HPP__
+
+#include <string>
+
+#include <stout/bytes.hpp>
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// A cache of the URIs fetched into executor sandboxes, shared by all
+// the fetchers a slave runs (see launcher/fetcher.cpp), which are
+// separate processes. Hence all of the cache's state lives in its
+// directory: each URI is cached in a directory of its own, along with
+// the validators (ETag, size, modification time) that tell whether
+// the URI has changed since it was cached.
+//
+// Fetches of the same URI are serialized with a file lock so that a
+// URI launched by many executors at once is only downloaded once.
+// Once the cache grows beyond its size the least recently used URIs
+// that are not being fetched are evicted.
+class FetcherCache
+{
+public:
+  FetcherCache(const std::string& directory, const Bytes& size);
+
+  // Copies the URI to 'path' from the cache, after downloading (or
+  // copying) it into the cache if it is not cached yet or has changed
+  // since. The cached copy is never linked to 'path', since the
+  // executor (or the fetcher, when it makes the file executable)
+  // could then change the cached copy. Returns an error if the URI is
+  // not cacheable.
+  Try<Nothing> fetch(const std::string& uri, const std::string& path);
+
+  // Returns true if the URI can be cached, i.e., it refers to an
+  // HTTP(S) or FTP(S) resource or to an absolute local path. Resources
+  // in HDFS are not cached because there is no cheap way to validate
+  // them.
+  static bool cacheable(const std::string& uri);
+
+  // Number of fetches that were served from the cache without
+  // transferring the resource again, and the number that were not.
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+private:
+  // Fetches the URI into the cache entry, unless the entry is still
+  // valid, and returns the path of the cached copy. Expects the entry
+  // to be locked.
+  Try<std::string> _fetch(const std::string& uri, const std::string& entry);
+
+  // Evicts the least recently used entries until the cache fits its
+  // size, skipping the entries that are being fetched.
+  Try<Nothing> evict();
+
+  const std::string directory;
+  const Bytes size;
+
+  size_t hits_;
+  size_t misses_;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __SLAVE_FETCHER_CACHE_HPP__
@@ -21,6 +21,7 @@
 
 #include <string>
 
+#include <stout/bytes.hpp>
 #include <stout/duration.hpp>
 #include <stout/flags.hpp>
 #include <stout/option.hpp>
@@ -57,7 +58,8 @@ public:
     add(&Flags::isolation,
         "isolation",
         "Isolation mechanisms to use, e.g., 'posix/cpu,posix/mem'\n"
-        "or 'cgroups/cpu,cgroups/mem'.",
+        "or 'cgroups/cpu,cgroups/mem'. Add 'posix/disk' to account\n"
+        "for the disk usage of each executor's sandbox.",
         "posix/cpu,posix/mem");
 
     add(&Flags::default_role,
@@ -83,6 +85,14 @@ public:
         "Location of Mesos binaries",
         PKGLIBEXECDIR);
 
+    add(&Flags::launcher_helper,
+        "launcher_helper",
+        "Whether to fork executors (and the fetcher) from a small\n"
+        "helper process, 'mesos-launcher-helper' in the launcher_dir,\n"
+        "rather than from the slave, which gets slower the more\n"
+        "memory the slave uses",
+        false);
+
     add(&Flags::hadoop_home,
         "hadoop_home",
         "Where to find Hadoop installed (for\n"
@@ -103,6 +113,17 @@ public:
         "Directory prepended to relative executor URIs",
         "");
 
+    add(&Flags::fetcher_cache_size,
+        "fetcher_cache_size",
+        "Amount of disk space (e.g., 512MB, 2GB, etc) used to cache the\n"
+        "executor URIs fetched from HTTP/FTP servers or local paths,\n"
+        "so that URIs shared by executors are only transferred once.\n"
+        "The least recently used URIs are evicted beyond this size.\n"
+        "The cache lives in the work directory and is not accounted\n"
+        "for in the slave's disk resources, nor garbage collected.\n"
+        "A size of 0 (the default) disables the cache.",
+        FETCHER_CACHE_SIZE);
+
     add(&Flags::executor_registration_timeout,
         "executor_registration_timeout",
         "Amount of time to wait for an executor\n"
@@ -124,18 +145,46 @@ public:
         "the available disk usage.",
         GC_DELAY);
 
+    add(&Flags::gc_rate_limit,
+        "gc_rate_limit",
+        "Maximum amount of disk space (e.g., 50MB, 1GB, etc) to reclaim\n"
+        "per second when cleaning up executor directories, so that\n"
+        "large cleanups do not starve running executors of disk\n"
+        "bandwidth. If not set, cleanups are not throttled.");
+
     add(&Flags::disk_watch_interval,
         "disk_watch_interval",
         "Periodic time interval (e.g., 10secs, 2mins, etc)\n"
         "to check the disk usage",
         DISK_WATCH_INTERVAL);
 
+    add(&Flags::container_disk_watch_interval,
+        "container_disk_watch_interval",
+        "Periodic time interval (e.g., 10secs, 2mins, etc)\n"
+        "to check the disk usage of each executor's sandbox\n"
+        "when using the 'posix/disk' isolator",
+        CONTAINER_DISK_WATCH_INTERVAL);
+
+    add(&Flags::enforce_container_disk_quota,
+        "enforce_container_disk_quota",
+        "Whether to terminate executors whose sandboxes use more\n"
+        "disk than their allocated disk resources, when using the\n"
+        "'posix/disk' isolator",
+        false);
+
     add(&Flags::resource_monitoring_interval,
         "resource_monitoring_interval",
         "Periodic time interval for monitoring executor\n"
         "resource usage (e.g., 10secs, 1min, etc)",
         RESOURCE_MONITORING_INTERVAL);
 
+    add(&Flags::status_update_batch_interval,
+        "status_update_batch_interval",
+        "Amount of time (e.g., 10ms, 1secs, etc) to batch status updates\n"
+        "for before sending them to the master in a single message.\n"
+        "If not set, each status update is sent in its own message.\n"
+        "NOTE: Only set this flag once all masters support batching!");
+
     // TODO(vinod): Consider killing this flag and always checkpoint.
     add(&Flags::checkpoint,
         "checkpoint",
@@ -174,6 +223,16 @@ public:
         "state as possible is recovered.\n",
         true);
 
+    add(&Flags::checkpoint_journal,
+        "checkpoint_journal",
+        "Whether to also write the checkpoints to a single journal, which\n"
+        "the slave recovers from instead of reading the checkpointed files\n"
+        "one by one. The journal is created from the checkpointed files if\n"
+        "it does not exist (or is corrupt) and is removed when the slave is\n"
+        "restarted with checkpoint_journal=false.\n"
+        "NOTE: This flag is only applicable when checkpoint is enabled.\n",
+        false);
+
 #ifdef __linux__
     add(&Flags::cgroups_hierarchy,
         "cgroups_hierarchy",
@@ -206,18 +265,25 @@ public:
   Option<std::string> attributes;
   std::string work_dir;
   std::string launcher_dir;
+  bool launcher_helper;
   std::string hadoop_home; // TODO(benh): Make an Option.
   bool switch_user;
   std::string frameworks_home;  // TODO(benh): Make an Option.
+  Bytes fetcher_cache_size;
   Duration executor_registration_timeout;
   Duration executor_shutdown_grace_period;
   Duration gc_delay;
+  Option<Bytes> gc_rate_limit;
   Duration disk_watch_interval;
+  Duration container_disk_watch_interval;
+  bool enforce_container_disk_quota;
   Duration resource_monitoring_interval;
+  Option<Duration> status_update_batch_interval;
   bool checkpoint;
   std::string recover;
   Duration recovery_timeout;
   bool strict;
+  bool checkpoint_journal;
 #ifdef __linux__
   std::string cgroups_hierarchy;
   std::string cgroups_root;
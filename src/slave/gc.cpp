@@ -16,16 +16,32 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
 #include <list>
 
+#include <process/defer.hpp>
 #include <process/delay.hpp>
 #include <process/dispatch.hpp>
+#include <process/statistics.hpp>
 
 #include <stout/foreach.hpp>
+#include <stout/lambda.hpp>
 #include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+
+#include "common/thread.hpp"
 
 #include "logging/logging.hpp"
 
+#include "slave/constants.hpp"
 #include "slave/gc.hpp"
 
 using namespace process;
@@ -41,11 +57,222 @@ namespace internal {
 namespace slave {
 
 
+RemovalThrottle::RemovalThrottle(const Bytes& _rate)
+  : rate(_rate), next(0)
+{
+  pthread_mutex_init(&mutex, NULL);
+}
+
+
+RemovalThrottle::~RemovalThrottle()
+{
+  pthread_mutex_destroy(&mutex);
+}
+
+
+void RemovalThrottle::acquire(const Bytes& size)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  const double now = tv.tv_sec + tv.tv_usec / 1000000.0;
+
+  // Each caller waits out the bytes acquired before it, which keeps
+  // the workers together to the rate (idle time does not accumulate
+  // into a burst).
+  pthread_mutex_lock(&mutex);
+  next = std::max(next, now);
+  const double wait = next - now;
+  next += (double) size.bytes() / rate.bytes();
+  pthread_mutex_unlock(&mutex);
+
+  if (wait > 0) {
+    os::sleep(Seconds(wait));
+  }
+}
+
+
+// Empties the directory open at 'fd' (which gets closed), unlinking
+// entries relative to the directory with unlinkat(2) rather than by
+// path, so that deep trees are not resolved over and over and
+// symbolic links are never followed. Returns the bytes reclaimed.
+static Try<Bytes> empty(int fd, const string& path, RemovalThrottle* throttle)
+{
+  DIR* dir = fdopendir(fd);
+  if (dir == NULL) {
+    ErrnoError error("Failed to open directory '" + path + "'");
+    os::close(fd);
+    return error;
+  }
+
+  Bytes reclaimed;
+
+  // NOTE: Removing the entries that were already read does not affect
+  // the rest of the readdir(3) stream.
+  struct dirent* entry;
+  while ((errno = 0, entry = readdir(dir)) != NULL) {
+    const string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+
+    struct stat s;
+    if (fstatat(fd, name.c_str(), &s, AT_SYMLINK_NOFOLLOW) < 0) {
+      if (errno == ENOENT) {
+        continue;
+      }
+      ErrnoError error("Failed to stat '" + path::join(path, name) + "'");
+      closedir(dir);
+      return error;
+    }
+
+    const Bytes size(s.st_blocks * 512);
+
+    if (S_ISDIR(s.st_mode)) {
+      int child = openat(
+          fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+      if (child < 0) {
+        ErrnoError error("Failed to open '" + path::join(path, name) + "'");
+        closedir(dir);
+        return error;
+      }
+
+      Try<Bytes> emptied = empty(child, path::join(path, name), throttle);
+      if (emptied.isError()) {
+        closedir(dir);
+        return emptied;
+      }
+
+      reclaimed += emptied.get();
+    } else if (throttle != NULL) {
+      throttle->acquire(size);
+    }
+
+    if (unlinkat(fd, name.c_str(), S_ISDIR(s.st_mode) ? AT_REMOVEDIR : 0) < 0 &&
+        errno != ENOENT) {
+      ErrnoError error("Failed to remove '" + path::join(path, name) + "'");
+      closedir(dir);
+      return error;
+    }
+
+    reclaimed += size;
+  }
+
+  if (errno != 0) {
+    ErrnoError error("Failed to read directory '" + path + "'");
+    closedir(dir);
+    return error;
+  }
+
+  closedir(dir);
+
+  return reclaimed;
+}
+
+
+// Removes the file or directory tree at 'path'. Returns the bytes
+// reclaimed.
+static Try<Bytes> remove(const string& path, RemovalThrottle* throttle)
+{
+  struct stat s;
+  if (::lstat(path.c_str(), &s) < 0) {
+    return ErrnoError("Failed to stat '" + path + "'");
+  }
+
+  Bytes reclaimed(s.st_blocks * 512);
+
+  if (S_ISDIR(s.st_mode)) {
+    int fd = ::open(
+        path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd < 0) {
+      return ErrnoError("Failed to open '" + path + "'");
+    }
+
+    Try<Bytes> emptied = empty(fd, path, throttle);
+    if (emptied.isError()) {
+      return emptied;
+    }
+
+    reclaimed += emptied.get();
+
+    if (::rmdir(path.c_str()) < 0) {
+      return ErrnoError("Failed to remove '" + path + "'");
+    }
+  } else {
+    if (throttle != NULL) {
+      throttle->acquire(reclaimed);
+    }
+
+    if (::unlink(path.c_str()) < 0) {
+      return ErrnoError("Failed to remove '" + path + "'");
+    }
+  }
+
+  return reclaimed;
+}
+
+
+// Removes 'path' in a thread of its own (see
+// GarbageCollectorProcess::dequeue) and completes 'promise'.
+static void _remove(
+    const string& path,
+    const memory::shared_ptr<RemovalThrottle>& throttle,
+    const Owned<Promise<Bytes> >& promise)
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  Try<Bytes> removed = remove(path, throttle.get());
+
+  if (removed.isError()) {
+    promise->fail(removed.error());
+    return;
+  }
+
+  const Duration elapsed = stopwatch.elapsed();
+  const double rate = elapsed > Duration::zero()
+    ? removed.get().bytes() / elapsed.secs()
+    : 0.0;
+
+  LOG(INFO) << "Deleted '" << path << "', reclaiming " << removed.get()
+            << " in " << elapsed << " ("
+            << rate / Megabytes(1).bytes() << " MB/s)";
+
+  process::statistics->set("gc", "bytes_reclaimed_per_sec", rate);
+
+  promise->set(removed.get());
+}
+
+
+GarbageCollectorProcess::GarbageCollectorProcess(
+    const Option<Bytes>& rateLimit)
+{
+  if (rateLimit.isSome() && rateLimit.get() > Bytes(0)) {
+    throttle.reset(new RemovalThrottle(rateLimit.get()));
+  }
+}
+
+
 GarbageCollectorProcess::~GarbageCollectorProcess()
 {
   foreachvalue (const PathInfo& info, paths) {
     info.promise->discard();
   }
+
+  foreach (const PathInfo& info, queued) {
+    info.promise->discard();
+  }
+
+  // The workers finish removing their paths regardless, but we won't
+  // be around to learn about it.
+  foreachvalue (const Removal& removal, removing) {
+    removal.promise->discard();
+
+    foreach (const Owned<Promise<bool> >& promise, removal.unschedules) {
+      promise->discard();
+    }
+  }
 }
 
 
@@ -56,10 +283,10 @@ Future<Nothing> GarbageCollectorProcess::schedule(
   LOG(INFO) << "Scheduling '" << path << "' for gc " << d << " in the future";
 
   // If there's an existing schedule for this path, we must remove
-  // it here in order to reschedule.
-  if (timeouts.contains(path)) {
-    CHECK(unschedule(path));
-  }
+  // it here in order to reschedule. This includes a path that is
+  // queued for removal. A removal in flight is left alone, and the
+  // new one waits for it (see dequeue).
+  cancel(path);
 
   Owned<Promise<Nothing> > promise(new Promise<Nothing>());
 
@@ -79,10 +306,40 @@ Future<Nothing> GarbageCollectorProcess::schedule(
 }
 
 
-bool GarbageCollectorProcess::unschedule(const string& path)
+Future<bool> GarbageCollectorProcess::unschedule(const string& path)
 {
   LOG(INFO) << "Unscheduling '" << path << "' from gc";
 
+  if (cancel(path)) {
+    return true;
+  }
+
+  // The path can't be unscheduled once a worker is removing it, but
+  // we hold off the caller until the worker is done, so that it does
+  // not recreate the path only to have it removed.
+  if (removing.contains(path)) {
+    Owned<Promise<bool> > promise(new Promise<bool>());
+    removing[path].unschedules.push_back(promise);
+    return promise->future();
+  }
+
+  return false;
+}
+
+
+bool GarbageCollectorProcess::cancel(const string& path)
+{
+  // A path that is due can be unscheduled until a worker picks it up.
+  for (list<PathInfo>::iterator it = queued.begin();
+       it != queued.end();
+       ++it) {
+    if (it->path == path) {
+      it->promise->discard();
+      queued.erase(it);
+      return true;
+    }
+  }
+
   if (!timeouts.contains(path)) {
     return false;
   }
@@ -126,28 +383,18 @@ void GarbageCollectorProcess::reset()
 
 void GarbageCollectorProcess::remove(const Timeout& removalTime)
 {
-  // TODO(bmahler): Other dispatches can block waiting for a removal
-  // operation. To fix this, the removal operation can be done
-  // asynchronously in another thread.
+  // The paths are removed by workers so that removing them, which can
+  // take a while for large sandboxes, does not hold up the other
+  // dispatches to this process.
   if (paths.count(removalTime) > 0) {
     foreach (const PathInfo& info, paths.get(removalTime)) {
-      LOG(INFO) << "Deleting " << info.path;
-
-      Try<Nothing> rmdir = os::rmdir(info.path);
-
-      if (rmdir.isError()) {
-        LOG(WARNING) << "Failed to delete '" << info.path << "': "
-                     << rmdir.error();
-        info.promise->fail(rmdir.error());
-      } else {
-        LOG(INFO) << "Deleted '" << info.path << "'";
-        info.promise->set(rmdir.get());
-      }
-
+      queued.push_back(info);
       timeouts.erase(info.path);
     }
 
     paths.remove(removalTime);
+
+    dequeue();
   } else {
     // This occurs when either:
     //   1. The path(s) has already been removed (e.g. by prune()).
@@ -160,6 +407,70 @@ void GarbageCollectorProcess::remove(const Timeout& removalTime)
 }
 
 
+void GarbageCollectorProcess::dequeue()
+{
+  list<PathInfo>::iterator it = queued.begin();
+
+  while (it != queued.end() && removing.size() < GC_WORKERS) {
+    if (removing.contains(it->path)) {
+      ++it;
+      continue;
+    }
+
+    const PathInfo info = *it;
+    it = queued.erase(it);
+
+    LOG(INFO) << "Deleting " << info.path;
+
+    removing[info.path].promise = info.promise;
+
+    Owned<Promise<Bytes> > promise(new Promise<Bytes>());
+
+    promise->future()
+      .onAny(defer(self(), &Self::removed, info.path, lambda::_1));
+
+    // The worker threads are detached: we learn that they are done
+    // through the promise.
+    if (!thread::start(lambda::bind(&_remove, info.path, throttle, promise),
+                       true)) {
+      promise->fail("Failed to start a thread");
+    }
+  }
+}
+
+
+void GarbageCollectorProcess::removed(
+    const string& path,
+    const Future<Bytes>& future)
+{
+  CHECK(removing.contains(path));
+
+  const Removal removal = removing[path];
+  removing.erase(path);
+
+  Owned<Promise<Nothing> > promise = removal.promise;
+
+  if (!future.isReady()) {
+    const string message =
+      future.isFailed() ? future.failure() : "discarded";
+
+    LOG(WARNING) << "Failed to delete '" << path << "': " << message;
+    promise->fail(message);
+  } else {
+    reclaimed += future.get();
+    process::statistics->set("gc", "bytes_reclaimed", reclaimed.bytes());
+
+    promise->set(Nothing());
+  }
+
+  foreach (const Owned<Promise<bool> >& unschedule, removal.unschedules) {
+    unschedule->set(false);
+  }
+
+  dequeue();
+}
+
+
 void GarbageCollectorProcess::prune(const Duration& d)
 {
   foreach (const Timeout& removalTime, paths.keys()) {
@@ -172,9 +483,9 @@ void GarbageCollectorProcess::prune(const Duration& d)
 }
 
 
-GarbageCollector::GarbageCollector()
+GarbageCollector::GarbageCollector(const Option<Bytes>& rateLimit)
 {
-  process = new GarbageCollectorProcess();
+  process = new GarbageCollectorProcess(rateLimit);
   spawn(process);
 }
 
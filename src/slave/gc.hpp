@@ -19,6 +19,9 @@
 #ifndef __SLAVE_GC_HPP__
 #define __SLAVE_GC_HPP__
 
+#include <pthread.h>
+
+#include <list>
 #include <string>
 #include <vector>
 
@@ -28,10 +31,14 @@
 #include <process/timeout.hpp>
 #include <process/timer.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
+#include <stout/memory.hpp>
 #include <stout/multimap.hpp>
+#include <stout/none.hpp>
 #include <stout/nothing.hpp>
+#include <stout/option.hpp>
 #include <stout/try.hpp>
 
 namespace mesos {
@@ -51,7 +58,9 @@ class GarbageCollectorProcess;
 class GarbageCollector
 {
 public:
-  GarbageCollector();
+  // Paths are deleted in the background by up to GC_WORKERS threads,
+  // at no more than 'rateLimit' bytes per second if it is set.
+  explicit GarbageCollector(const Option<Bytes>& rateLimit = None());
   ~GarbageCollector();
 
   // Schedules the specified path for removal after the specified
@@ -67,9 +76,12 @@ public:
   process::Future<Nothing> schedule(const Duration& d, const std::string& path);
 
   // Unschedules the specified path for removal.
-  // The future will be true if the path has been unscheduled.
+  // The future will be true if the path has been unscheduled, which
+  // includes a path that is due but still waiting for a worker.
   // The future will be false if the path is not scheduled for
-  // removal, or the path has already being removed.
+  // removal, or the path has already been removed. If a worker is
+  // removing the path, the future will be false once it is done, so
+  // that the caller can safely recreate the path.
   // Note that you currently cannot discard a returned future.
   process::Future<bool> unschedule(const std::string& path);
 
@@ -82,25 +94,66 @@ private:
 };
 
 
+// Limits the rate at which bytes get deleted, across all of the
+// threads deleting paths, so that deleting large sandboxes does not
+// starve the executors of disk bandwidth.
+class RemovalThrottle
+{
+public:
+  explicit RemovalThrottle(const Bytes& rate);
+  ~RemovalThrottle();
+
+  // Blocks the calling thread until 'size' more bytes may be deleted.
+  void acquire(const Bytes& size);
+
+private:
+  RemovalThrottle(const RemovalThrottle&);
+  RemovalThrottle& operator = (const RemovalThrottle&);
+
+  const Bytes rate;
+
+  pthread_mutex_t mutex;
+
+  // The (wall clock) time, in seconds since the epoch, before which
+  // no more bytes may be deleted.
+  double next;
+};
+
+
 class GarbageCollectorProcess :
     public process::Process<GarbageCollectorProcess>
 {
 public:
+  explicit GarbageCollectorProcess(const Option<Bytes>& rateLimit = None());
+
   virtual ~GarbageCollectorProcess();
 
   process::Future<Nothing> schedule(
       const Duration& d,
       const std::string& path);
 
-  bool unschedule(const std::string& path);
+  process::Future<bool> unschedule(const std::string& path);
 
   void prune(const Duration& d);
 
 private:
+  // Removes the path from 'paths' or 'queued'. Returns false if the
+  // path is neither scheduled nor waiting for a worker.
+  bool cancel(const std::string& path);
+
   void reset();
 
+  // Queues the paths due at 'removalTime' for removal.
   void remove(const process::Timeout& removalTime);
 
+  // Hands the queued paths to workers, as long as there are free
+  // workers. A path that is still being removed (it was rescheduled
+  // in the meantime) waits for that removal to finish.
+  void dequeue();
+
+  // Invoked once a worker has removed (or failed to remove) a path.
+  void removed(const std::string& path, const process::Future<Bytes>& future);
+
   struct PathInfo
   {
     PathInfo(const std::string& _path,
@@ -125,6 +178,27 @@ private:
   // it exists in our paths mapping.
   hashmap<std::string, process::Timeout> timeouts;
 
+  // The paths that are due, waiting for a worker to remove them.
+  // These can still be unscheduled.
+  std::list<PathInfo> queued;
+
+  struct Removal
+  {
+    process::Owned<process::Promise<Nothing> > promise;
+
+    // The unschedules waiting for the removal to finish.
+    std::list<process::Owned<process::Promise<bool> > > unschedules;
+  };
+
+  // The paths being removed by workers.
+  hashmap<std::string, Removal> removing;
+
+  // Shared with the workers, which may outlive this process.
+  memory::shared_ptr<RemovalThrottle> throttle;
+
+  // Total bytes reclaimed so far.
+  Bytes reclaimed;
+
   process::Timer timer;
 };
 
@@ -0,0 +1,761 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/none.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/protobuf.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "slave/journal.hpp"
+
+using std::list;
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// The journal is compacted once it is this many times the size of
+// the live checkpoints (but no sooner than it reaches the minimum).
+static const double COMPACTION_FACTOR = 2.0;
+static const Bytes MIN_COMPACTION_SIZE = Megabytes(1);
+
+
+// Holds the mutex for the duration of a scope.
+struct Lock
+{
+  explicit Lock(pthread_mutex_t* _mutex) : mutex(_mutex)
+  {
+    pthread_mutex_lock(mutex);
+  }
+
+  ~Lock()
+  {
+    pthread_mutex_unlock(mutex);
+  }
+
+  pthread_mutex_t* mutex;
+};
+
+
+// Returns the size of a record in the journal.
+static Bytes recordSize(const CheckpointRecord& record)
+{
+  return Bytes(sizeof(uint32_t) + record.ByteSize());
+}
+
+
+// Returns the size of the record of a checkpoint (with 'size' bytes
+// of data) in a compacted journal, give or take a few bytes of
+// protobuf encoding.
+static Bytes recordSize(const string& path, size_t size)
+{
+  return Bytes(sizeof(uint32_t) + 16 + path.size() + size);
+}
+
+
+Try<CheckpointJournal*> CheckpointJournal::open(const string& rootDir)
+{
+  Try<Nothing> mkdir = os::mkdir(rootDir);
+  if (mkdir.isError()) {
+    return Error("Failed to create '" + rootDir + "': " + mkdir.error());
+  }
+
+  CheckpointJournal* journal = new CheckpointJournal(rootDir);
+
+  if (os::exists(path(rootDir))) {
+    Try<Nothing> replay = journal->replay();
+    if (replay.isSome()) {
+      LOG(INFO) << "Replayed checkpoint journal '" << path(rootDir) << "' ("
+                << journal->size << ") with " << journal->live
+                << " of checkpoints";
+      return journal;
+    }
+
+    LOG(WARNING) << "Failed to replay checkpoint journal '" << path(rootDir)
+                 << "', recreating it from the checkpointed files: "
+                 << replay.error();
+
+    delete journal;
+    journal = new CheckpointJournal(rootDir);
+  }
+
+  Try<Nothing> create = journal->create();
+  if (create.isError()) {
+    delete journal;
+    return Error("Failed to create the checkpoint journal: " + create.error());
+  }
+
+  LOG(INFO) << "Created checkpoint journal '" << path(rootDir) << "' with "
+            << journal->live << " of checkpoints";
+
+  return journal;
+}
+
+
+string CheckpointJournal::path(const string& rootDir)
+{
+  return path::join(rootDir, "journal");
+}
+
+
+CheckpointJournal::CheckpointJournal(const string& _rootDir)
+  : rootDir(strings::remove(_rootDir, "/", strings::SUFFIX))
+{
+  pthread_mutex_init(&mutex, NULL);
+  directories[""];
+}
+
+
+CheckpointJournal::~CheckpointJournal()
+{
+  if (fd.isSome()) {
+    os::close(fd.get());
+  }
+
+  pthread_mutex_destroy(&mutex);
+}
+
+
+Try<Nothing> CheckpointJournal::write(const string& path, const string& data)
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return Error("'" + path + "' is not under '" + rootDir + "'");
+  }
+
+  CheckpointRecord record_;
+  record_.set_type(CheckpointRecord::WRITE);
+  record_.set_path(relative_.get());
+  record_.set_data(data);
+
+  return record(record_);
+}
+
+
+Try<Nothing> CheckpointJournal::append(const string& path, const string& data)
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return Error("'" + path + "' is not under '" + rootDir + "'");
+  }
+
+  CheckpointRecord record_;
+  record_.set_type(CheckpointRecord::APPEND);
+  record_.set_path(relative_.get());
+  record_.set_data(data);
+
+  return record(record_);
+}
+
+
+Try<Nothing> CheckpointJournal::symlink(
+    const string& path,
+    const string& target)
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return Error("'" + path + "' is not under '" + rootDir + "'");
+  }
+
+  CheckpointRecord record_;
+  record_.set_type(CheckpointRecord::SYMLINK);
+  record_.set_path(relative_.get());
+  record_.set_data(target);
+
+  return record(record_);
+}
+
+
+Try<Nothing> CheckpointJournal::mkdir(const string& path)
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return Error("'" + path + "' is not under '" + rootDir + "'");
+  }
+
+  CheckpointRecord record_;
+  record_.set_type(CheckpointRecord::MKDIR);
+  record_.set_path(relative_.get());
+
+  return record(record_);
+}
+
+
+Try<Nothing> CheckpointJournal::remove(const string& path)
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return Error("'" + path + "' is not under '" + rootDir + "'");
+  }
+
+  // Nothing to journal if we do not know the path.
+  if (!files.contains(relative_.get()) &&
+      !links.contains(relative_.get()) &&
+      !directories.contains(relative_.get())) {
+    return Nothing();
+  }
+
+  CheckpointRecord record_;
+  record_.set_type(CheckpointRecord::REMOVE);
+  record_.set_path(relative_.get());
+
+  return record(record_);
+}
+
+
+bool CheckpointJournal::exists(const string& path) const
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+
+  return relative_.isSome() &&
+    (files.contains(relative_.get()) ||
+     links.contains(relative_.get()) ||
+     directories.contains(relative_.get()));
+}
+
+
+Try<string> CheckpointJournal::read(const string& path) const
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone() || !files.contains(relative_.get())) {
+    return Error("No such file '" + path + "'");
+  }
+
+  return contents(files.find(relative_.get())->second);
+}
+
+
+Try<list<string> > CheckpointJournal::ls(const string& directory) const
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(directory);
+  if (relative_.isNone() || !directories.contains(relative_.get())) {
+    return Error("No such directory '" + directory + "'");
+  }
+
+  list<string> entries;
+  foreach (const string& entry, directories.find(relative_.get())->second) {
+    entries.push_back(entry);
+  }
+
+  return entries;
+}
+
+
+Option<string> CheckpointJournal::readlink(const string& path) const
+{
+  Lock lock(&mutex);
+
+  Option<string> relative_ = relative(path);
+  if (relative_.isNone()) {
+    return None();
+  }
+
+  return links.get(relative_.get());
+}
+
+
+Try<Nothing> CheckpointJournal::replay()
+{
+  // Read the whole journal at once rather than record by record, as
+  // '::protobuf::read()' would, since it gets replayed in full anyway.
+  Try<string> contents = os::read(path(rootDir));
+  if (contents.isError()) {
+    return Error("Failed to read: " + contents.error());
+  }
+
+  const string& data = contents.get();
+
+  CheckpointRecord record;
+  size_t offset = 0;
+  uint32_t length;
+
+  // Stop at a partially written record, if the slave died while
+  // appending it.
+  while (data.size() - offset >= sizeof(length)) {
+    memcpy((void*) &length, (void*) (data.data() + offset), sizeof(length));
+
+    if (data.size() - offset - sizeof(length) < length) {
+      break;
+    }
+
+    if (!record.ParseFromArray(data.data() + offset + sizeof(length), length)) {
+      return Error("Failed to deserialize record at offset " +
+                   stringify(offset));
+    }
+
+    apply(record, offset);
+    offset += sizeof(length) + length;
+  }
+
+  Try<int> open = os::open(path(rootDir), O_RDWR | O_CLOEXEC);
+  if (open.isError()) {
+    return Error("Failed to open: " + open.error());
+  }
+
+  fd = open.get();
+  size = Bytes(offset);
+
+  // Truncate a partially written record, so that we append after the
+  // last complete one.
+  if (ftruncate(fd.get(), offset) != 0 ||
+      lseek(fd.get(), offset, SEEK_SET) < 0) {
+    return ErrnoError("Failed to truncate");
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> CheckpointJournal::create()
+{
+  // Write the journal to a temporary file first, so that a journal
+  // that was only partially created never gets replayed.
+  const string temporary = path(rootDir) + ".create";
+
+  Try<int> open = os::open(
+      temporary,
+      O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (open.isError()) {
+    return Error("Failed to open '" + temporary + "': " + open.error());
+  }
+
+  fd = open.get();
+
+  Try<Nothing> scan = this->scan("");
+  if (scan.isError()) {
+    return Error("Failed to journal the checkpointed files: " + scan.error());
+  }
+
+  if (fsync(fd.get()) != 0) {
+    return ErrnoError("Failed to sync '" + temporary + "'");
+  }
+
+  if (::rename(temporary.c_str(), path(rootDir).c_str()) != 0) {
+    return ErrnoError("Failed to rename '" + temporary + "'");
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> CheckpointJournal::scan(const string& relative_)
+{
+  const string path_ = path::join(rootDir, relative_);
+
+  struct stat s;
+  if (::lstat(path_.c_str(), &s) < 0) {
+    return ErrnoError("Failed to stat '" + path_ + "'");
+  }
+
+  CheckpointRecord record;
+  record.set_path(relative_);
+
+  if (S_ISDIR(s.st_mode)) {
+    if (!relative_.empty()) {
+      record.set_type(CheckpointRecord::MKDIR);
+
+      Try<Nothing> persist = this->persist(record);
+      if (persist.isError()) {
+        return persist;
+      }
+    }
+
+    foreach (const string& entry, os::ls(path_)) {
+      // Skip the journal itself.
+      if (relative_.empty() && strings::startsWith(entry, "journal")) {
+        continue;
+      }
+
+      Try<Nothing> scan = this->scan(
+          relative_.empty() ? entry : path::join(relative_, entry));
+
+      if (scan.isError()) {
+        return scan;
+      }
+    }
+  } else if (S_ISLNK(s.st_mode)) {
+    char buffer[PATH_MAX];
+    ssize_t length = ::readlink(path_.c_str(), buffer, sizeof(buffer));
+    if (length < 0) {
+      return ErrnoError("Failed to read link '" + path_ + "'");
+    }
+
+    record.set_type(CheckpointRecord::SYMLINK);
+    record.set_data(string(buffer, length));
+    return persist(record);
+  } else if (S_ISREG(s.st_mode)) {
+    Try<string> read = os::read(path_);
+    if (read.isError()) {
+      return Error("Failed to read '" + path_ + "': " + read.error());
+    }
+
+    record.set_type(CheckpointRecord::WRITE);
+    record.set_data(read.get());
+    return persist(record);
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> CheckpointJournal::record(const CheckpointRecord& record)
+{
+  Try<Nothing> persist = this->persist(record);
+  if (persist.isError()) {
+    return persist;
+  }
+
+  if (size > MIN_COMPACTION_SIZE &&
+      size.bytes() > live.bytes() * COMPACTION_FACTOR) {
+    // The record is in the journal either way, so we can continue
+    // with the journal as it is if compacting fails.
+    Try<Nothing> compact = this->compact();
+    if (compact.isError()) {
+      LOG(WARNING) << "Failed to compact checkpoint journal '"
+                   << path(rootDir) << "': " << compact.error();
+    }
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> CheckpointJournal::persist(const CheckpointRecord& record)
+{
+  CHECK_SOME(fd);
+
+  Try<Nothing> write = ::protobuf::write(fd.get(), record);
+  if (write.isError()) {
+    // Drop any part of the record that got written, since the files
+    // refer to the records that follow by their offset.
+    if (ftruncate(fd.get(), size.bytes()) != 0 ||
+        lseek(fd.get(), size.bytes(), SEEK_SET) < 0) {
+      PLOG(WARNING) << "Failed to truncate checkpoint journal '"
+                    << path(rootDir) << "'";
+    }
+
+    return Error("Failed to journal checkpoint of '" + record.path() +
+                 "': " + write.error());
+  }
+
+  apply(record, size.bytes());
+  size += recordSize(record);
+
+  return Nothing();
+}
+
+
+void CheckpointJournal::apply(const CheckpointRecord& record, off_t offset)
+{
+  const string& path = record.path();
+
+  switch (record.type()) {
+    case CheckpointRecord::WRITE:
+    case CheckpointRecord::APPEND: {
+      if (files.contains(path)) {
+        live -= recordSize(path, files[path].size);
+      }
+
+      File& file = files[path];
+      if (record.type() == CheckpointRecord::WRITE) {
+        file.records.clear();
+        file.size = 0;
+      }
+
+      file.records.push_back(std::make_pair(
+          offset + (off_t) sizeof(uint32_t), (uint32_t) record.ByteSize()));
+      file.size += record.data().size();
+
+      live += recordSize(path, file.size);
+      add(path);
+      break;
+    }
+    case CheckpointRecord::SYMLINK:
+      if (links.contains(path)) {
+        live -= recordSize(path, links[path].size());
+      }
+      links[path] = record.data();
+      live += recordSize(path, record.data().size());
+      add(path);
+      break;
+    case CheckpointRecord::MKDIR:
+      add(path);
+      if (!directories.contains(path)) {
+        directories[path];
+        live += recordSize(path, 0);
+      }
+      break;
+    case CheckpointRecord::REMOVE:
+      erase(path);
+      break;
+  }
+}
+
+
+Try<Nothing> CheckpointJournal::compact()
+{
+  const string temporary = path(rootDir) + ".compact";
+
+  Try<int> open = os::open(
+      temporary,
+      O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (open.isError()) {
+    return Error("Failed to open '" + temporary + "': " + open.error());
+  }
+
+  Bytes compacted;
+
+  // The records of the files in the compacted journal.
+  hashmap<string, File> files_;
+
+  // Write out the live checkpoints, directories first so that empty
+  // directories are kept.
+  CheckpointRecord record;
+  Try<Nothing> write = Nothing();
+
+  foreachkey (const string& directory, directories) {
+    if (write.isError()) {
+      break;
+    } else if (directory.empty()) {
+      continue;
+    }
+
+    record.set_type(CheckpointRecord::MKDIR);
+    record.set_path(directory);
+    record.clear_data();
+    write = ::protobuf::write(open.get(), record);
+    compacted += recordSize(record);
+  }
+
+  foreachpair (const string& link, const string& target, links) {
+    if (write.isError()) {
+      break;
+    }
+
+    record.set_type(CheckpointRecord::SYMLINK);
+    record.set_path(link);
+    record.set_data(target);
+    write = ::protobuf::write(open.get(), record);
+    compacted += recordSize(record);
+  }
+
+  foreachpair (const string& name, const File& file, files) {
+    if (write.isError()) {
+      break;
+    }
+
+    Try<string> data = contents(file);
+    if (data.isError()) {
+      write = Error("Failed to read '" + name + "': " + data.error());
+      break;
+    }
+
+    record.set_type(CheckpointRecord::WRITE);
+    record.set_path(name);
+    record.set_data(data.get());
+    write = ::protobuf::write(open.get(), record);
+
+    files_[name].records.push_back(std::make_pair(
+        (off_t) (compacted.bytes() + sizeof(uint32_t)),
+        (uint32_t) record.ByteSize()));
+    files_[name].size = data.get().size();
+
+    compacted += recordSize(record);
+  }
+
+  if (write.isError()) {
+    os::close(open.get());
+    return Error("Failed to write '" + temporary + "': " + write.error());
+  }
+
+  // Make sure the compacted journal is on disk before it replaces
+  // the current one.
+  if (fsync(open.get()) != 0) {
+    ErrnoError error("Failed to sync '" + temporary + "'");
+    os::close(open.get());
+    return error;
+  }
+
+  if (::rename(temporary.c_str(), path(rootDir).c_str()) != 0) {
+    ErrnoError error("Failed to rename '" + temporary + "'");
+    os::close(open.get());
+    return error;
+  }
+
+  if (fd.isSome()) {
+    os::close(fd.get());
+  }
+
+  VLOG(1) << "Compacted checkpoint journal '" << path(rootDir) << "' from "
+          << size << " to " << compacted;
+
+  fd = open.get();
+  size = compacted;
+  files = files_;
+
+  return Nothing();
+}
+
+
+Try<string> CheckpointJournal::contents(const File& file) const
+{
+  CHECK_SOME(fd);
+
+  string contents;
+  contents.reserve(file.size);
+
+  CheckpointRecord record;
+  string buffer;
+
+  for (size_t i = 0; i < file.records.size(); i++) {
+    const off_t offset = file.records[i].first;
+    const uint32_t length = file.records[i].second;
+
+    buffer.resize(length);
+
+    ssize_t read = ::pread(fd.get(), (void*) buffer.data(), length, offset);
+    if (read < 0) {
+      return ErrnoError("Failed to read record at offset " + stringify(offset));
+    } else if ((size_t) read != length) {
+      return Error("Failed to read record at offset " + stringify(offset) +
+                   ": Journal is truncated");
+    }
+
+    if (!record.ParseFromString(buffer)) {
+      return Error("Failed to deserialize record at offset " +
+                   stringify(offset));
+    }
+
+    contents += record.data();
+  }
+
+  return contents;
+}
+
+
+Option<string> CheckpointJournal::relative(const string& path) const
+{
+  if (path == rootDir) {
+    return string();
+  } else if (strings::startsWith(path, rootDir + "/")) {
+    return strings::remove(
+        path.substr(rootDir.size() + 1), "/", strings::SUFFIX);
+  }
+
+  return None();
+}
+
+
+void CheckpointJournal::add(const string& path)
+{
+  string child = path;
+  while (!child.empty()) {
+    size_t slash = child.rfind('/');
+    const string parent = slash == string::npos ? "" : child.substr(0, slash);
+    const string name = child.substr(slash == string::npos ? 0 : slash + 1);
+
+    // The ancestors of a known directory are known as well.
+    const bool known = directories.contains(parent);
+    directories[parent].insert(name);
+
+    if (known) {
+      break;
+    }
+
+    live += recordSize(parent, 0);
+
+    child = parent;
+  }
+}
+
+
+void CheckpointJournal::erase(const string& path)
+{
+  if (directories.contains(path)) {
+    // Copy the entries, since erasing them modifies the directory.
+    const hashset<string> entries = directories[path];
+    foreach (const string& entry, entries) {
+      erase(path.empty() ? entry : path + "/" + entry);
+    }
+
+    if (!path.empty()) {
+      directories.erase(path);
+      live -= recordSize(path, 0);
+    }
+  }
+
+  if (files.contains(path)) {
+    live -= recordSize(path, files[path].size);
+    files.erase(path);
+  }
+
+  if (links.contains(path)) {
+    live -= recordSize(path, links[path].size());
+    links.erase(path);
+  }
+
+  if (!path.empty()) {
+    size_t slash = path.rfind('/');
+    const string parent = slash == string::npos ? "" : path.substr(0, slash);
+    if (directories.contains(parent)) {
+      directories[parent].erase(
+          path.substr(slash == string::npos ? 0 : slash + 1));
+    }
+  }
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,162 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SLAVE_JOURNAL_HPP__
+#define __SLAVE_JOURNAL_HPP__
+
+#include <pthread.h>
+
+#include <sys/types.h>
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stout/bytes.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "messages/messages.hpp"
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// An append-only journal of the checkpoints written under a slave's
+// meta directory (see slave/state.hpp). It holds the same state as
+// the many small files that the checkpoints are written to, so that
+// recovery can replay a single file rather than walk the directory
+// tree and read each of them.
+//
+// The directory tree and symbolic links are kept in memory, but the
+// contents of the files are not: for each file, only the records of
+// the journal that make up its contents are, and the contents are
+// read back from the journal when needed. Every checkpoint updates
+// them, so that the journal can be compacted down to the live
+// checkpoints once it has grown to several times their size:
+// removing a directory (e.g., when an executor's meta directory gets
+// garbage collected) drops everything under it from the journal.
+//
+// The journal is safe to use from multiple threads.
+class CheckpointJournal
+{
+public:
+  // Opens the journal of the checkpoints under 'rootDir' and replays
+  // it. If there is no journal yet, or it cannot be replayed, it is
+  // created from the checkpointed files instead.
+  static Try<CheckpointJournal*> open(const std::string& rootDir);
+
+  // Returns the path of the journal of 'rootDir'.
+  static std::string path(const std::string& rootDir);
+
+  ~CheckpointJournal();
+
+  // Each of the following journals the corresponding operation on
+  // the (absolute) path, which must be under 'rootDir'.
+  Try<Nothing> write(const std::string& path, const std::string& data);
+  Try<Nothing> append(const std::string& path, const std::string& data);
+  Try<Nothing> symlink(const std::string& path, const std::string& target);
+  Try<Nothing> mkdir(const std::string& path);
+  Try<Nothing> remove(const std::string& path);
+
+  // Accessors for the checkpoints, mirroring their os:: counterparts.
+  bool exists(const std::string& path) const;
+  Try<std::string> read(const std::string& path) const;
+  Try<std::list<std::string> > ls(const std::string& directory) const;
+  Option<std::string> readlink(const std::string& path) const;
+
+  const std::string rootDir;
+
+private:
+  explicit CheckpointJournal(const std::string& rootDir);
+
+  CheckpointJournal(const CheckpointJournal&);
+  CheckpointJournal& operator = (const CheckpointJournal&);
+
+  // A checkpointed file: the offset and length of each serialized
+  // record of the journal that makes up its contents, and the size
+  // of the contents.
+  struct File
+  {
+    File() : size(0) {}
+
+    std::vector<std::pair<off_t, uint32_t> > records;
+    size_t size;
+  };
+
+  // Replays the journal into memory.
+  Try<Nothing> replay();
+
+  // Creates the journal from the checkpointed files.
+  Try<Nothing> create();
+
+  // Journals the checkpointed files.
+  Try<Nothing> scan(const std::string& path);
+
+  // Appends the record to the journal and applies it, compacting the
+  // journal if it has grown too large. Expects the mutex to be held.
+  Try<Nothing> record(const CheckpointRecord& record);
+
+  // Appends the record to the journal and applies it.
+  Try<Nothing> persist(const CheckpointRecord& record);
+
+  // Applies the record, which is at 'offset' in the journal, to the
+  // checkpoints in memory.
+  void apply(const CheckpointRecord& record, off_t offset);
+
+  // Reads the contents of the file back from the journal.
+  Try<std::string> contents(const File& file) const;
+
+  // Rewrites the journal with just the live checkpoints.
+  Try<Nothing> compact();
+
+  // Returns the path relative to 'rootDir', if it is under it.
+  Option<std::string> relative(const std::string& path) const;
+
+  // Adds 'path' and its parent directories to the tree.
+  void add(const std::string& path);
+
+  // Removes 'path' and everything under it.
+  void erase(const std::string& path);
+
+  mutable pthread_mutex_t mutex;
+
+  // The checkpoints, by path relative to 'rootDir': the records of
+  // each file, the target of each symbolic link and the entries of
+  // each directory (the root directory being "").
+  hashmap<std::string, File> files;
+  hashmap<std::string, std::string> links;
+  hashmap<std::string, hashset<std::string> > directories;
+
+  Option<int> fd;
+
+  // The size of the journal and (approximately) the size that it
+  // would be compacted down to.
+  Bytes size;
+  Bytes live;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __SLAVE_JOURNAL_HPP__
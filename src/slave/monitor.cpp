@@ -16,6 +16,9 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
+
+#include <algorithm>
 #include <list>
 #include <map>
 #include <string>
@@ -31,10 +34,14 @@
 #include <process/http.hpp>
 #include <process/process.hpp>
 #include <process/statistics.hpp>
+#include <process/time.hpp>
+#include <process/timer.hpp>
 
 #include <stout/json.hpp>
 #include <stout/lambda.hpp>
+#include <stout/numify.hpp>
 #include <stout/protobuf.hpp>
+#include <stout/strings.hpp>
 
 #include "slave/containerizer/containerizer.hpp"
 #include "slave/monitor.hpp"
@@ -44,7 +51,9 @@ using namespace process;
 using std::list;
 using std::make_pair;
 using std::map;
+using std::pair;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
@@ -55,9 +64,37 @@ using process::wait; // Necessary on some OS's to disambiguate.
 
 // TODO(bmahler): Consider exposing these as flags should the
 // need arise. These are conservative for the initial version.
-const Duration MONITORING_TIME_SERIES_WINDOW = Weeks(2);
-const size_t MONITORING_TIME_SERIES_CAPACITY = 1000;
+const size_t MONITORING_TIME_SERIES_CAPACITY = 300;
+const size_t MONITORING_MINUTE_ROLLUPS = 120;
+const size_t MONITORING_HOUR_ROLLUPS = 48;
+const size_t MONITORING_DAY_ROLLUPS = 14;
 const size_t MONITORING_ARCHIVED_TIME_SERIES = 25;
+const double MONITORING_BUSY_THRESHOLD = 0.9;
+const double MONITORING_IDLE_THRESHOLD = 0.01;
+const size_t MONITORING_IDLE_SAMPLES = 10;
+const size_t MONITORING_ADAPTIVE_FACTOR = 4;
+
+
+// Returns the rollups kept for each container.
+static map<Duration, size_t> rollups()
+{
+  map<Duration, size_t> rollups;
+  rollups[Minutes(1)] = MONITORING_MINUTE_ROLLUPS;
+  rollups[Hours(1)] = MONITORING_HOUR_ROLLUPS;
+  rollups[Days(1)] = MONITORING_DAY_ROLLUPS;
+  return rollups;
+}
+
+
+// Returns the first multiple of 'interval' (since the Epoch) after
+// 'time', so that the containers with the same interval (or a
+// multiple of it) are due together.
+static Time align(const Time& time, const Duration& interval)
+{
+  int64_t step = std::max<int64_t>(1, interval.ns());
+
+  return Time::epoch() + Nanoseconds((time.duration().ns() / step + 1) * step);
+}
 
 
 Future<Nothing> ResourceMonitorProcess::start(
@@ -71,11 +108,15 @@ Future<Nothing> ResourceMonitorProcess::start(
 
   monitored[containerId] =
       MonitoringInfo(executorInfo,
-                     MONITORING_TIME_SERIES_WINDOW,
-                     MONITORING_TIME_SERIES_CAPACITY);
+                     interval,
+                     MONITORING_TIME_SERIES_CAPACITY,
+                     rollups());
 
   // Schedule the resource collection.
-  delay(interval, self(), &Self::collect, containerId, interval);
+  monitored[containerId].next = align(Clock::now(), interval);
+  schedule();
+
+  watch(containerId);
 
   return Nothing();
 }
@@ -96,38 +137,85 @@ Future<Nothing> ResourceMonitorProcess::stop(
 }
 
 
-void ResourceMonitorProcess::collect(
-    const ContainerID& containerId,
-    const Duration& interval)
+void ResourceMonitorProcess::tick()
 {
-  // Has monitoring stopped?
-  if (!monitored.contains(containerId)) {
+  timer = None();
+
+  list<ContainerID> containerIds;
+  foreachpair (const ContainerID& containerId,
+               const MonitoringInfo& info,
+               monitored) {
+    if (!info.collecting && info.next <= Clock::now()) {
+      containerIds.push_back(containerId);
+    }
+  }
+
+  collect(containerIds);
+
+  schedule();
+}
+
+
+void ResourceMonitorProcess::schedule()
+{
+  Option<Time> next;
+  foreachvalue (const MonitoringInfo& info, monitored) {
+    if (!info.collecting && (next.isNone() || info.next < next.get())) {
+      next = info.next;
+    }
+  }
+
+  // Keep the timer if it fires early enough.
+  if (timer.isSome()) {
+    if (next.isSome() && timer.get().timeout().time() <= next.get()) {
+      return;
+    }
+
+    Timer::cancel(timer.get());
+    timer = None();
+  }
+
+  if (next.isSome()) {
+    timer = delay(
+        std::max(Duration::zero(), next.get() - Clock::now()),
+        self(),
+        &Self::tick);
+  }
+}
+
+
+void ResourceMonitorProcess::collect(const list<ContainerID>& containerIds)
+{
+  if (containerIds.empty()) {
     return;
   }
 
-  containerizer->usage(containerId)
-    .onAny(defer(self(),
-                 &Self::_collect,
-                 lambda::_1,
-                 containerId,
-                 interval));
+  // TODO(bmahler): Consider a batch usage API on the Containerizer.
+  foreach (const ContainerID& containerId, containerIds) {
+    CHECK(monitored.contains(containerId));
+
+    monitored[containerId].collecting = true;
+    monitored[containerId].sampled = Clock::now();
+
+    containerizer->usage(containerId)
+      .onAny(defer(self(), &Self::_collect, containerId, lambda::_1));
+  }
 }
 
 
 void ResourceMonitorProcess::_collect(
-    const Future<ResourceStatistics>& statistics,
     const ContainerID& containerId,
-    const Duration& interval)
+    const Future<ResourceStatistics>& statistics)
 {
   // Has monitoring been stopped?
   if (!monitored.contains(containerId)) {
     return;
   }
 
-  const ExecutorID& executorId =
-    monitored[containerId].executorInfo.executor_id();
-  const FrameworkID& frameworkId =
-    monitored[containerId].executorInfo.framework_id();
+  MonitoringInfo& info = monitored[containerId];
+
+  const ExecutorID& executorId = info.executorInfo.executor_id();
+  const FrameworkID& frameworkId = info.executorInfo.framework_id();
 
   if (statistics.isDiscarded()) {
     VLOG(1) << "Ignoring discarded future collecting resource usage for"
@@ -141,7 +229,8 @@ void ResourceMonitorProcess::_collect(
       << "Failed to collect resource usage for"
       << " container '" << containerId
       << "' for executor '" << executorId
-      << "' of framework '" << frameworkId << "': " << statistics.failure();
+      << "' of framework '" << frameworkId << "': "
+      << statistics.failure();
   } else {
     Try<Time> time = Time::create(statistics.get().timestamp());
 
@@ -149,16 +238,118 @@ void ResourceMonitorProcess::_collect(
       LOG(ERROR) << "Invalid timestamp " << statistics.get().timestamp()
                  << " for container '" << containerId
                  << "' for executor '" << executorId
-                 << "' of framework '" << frameworkId << ": " << time.error();
+                 << "' of framework '" << frameworkId << ": "
+                 << time.error();
     } else {
       // Add the statistics to the time series.
-      monitored[containerId].statistics.set(
-          statistics.get(), time.get());
+      info.history.add(statistics.get());
+
+      info.adapt(statistics.get());
     }
   }
 
-  // Schedule the next collection.
-  delay(interval, self(), &Self::collect, containerId, interval);
+  // Schedule the next collection. We only look at the other
+  // containers (see schedule) if the timer would fire too late.
+  info.collecting = false;
+  info.next = align(Clock::now(), info.current);
+
+  if (timer.isNone() || info.next < timer.get().timeout().time()) {
+    schedule();
+  }
+}
+
+
+void ResourceMonitorProcess::watch(const ContainerID& containerId)
+{
+  containerizer->pressure(containerId)
+    .onAny(defer(self(), &Self::pressured, containerId, lambda::_1));
+}
+
+
+void ResourceMonitorProcess::pressured(
+    const ContainerID& containerId,
+    const Future<Nothing>& pressure)
+{
+  // Has monitoring been stopped?
+  if (!monitored.contains(containerId)) {
+    return;
+  }
+
+  if (!pressure.isReady()) {
+    VLOG(1) << "Not sampling container '" << containerId
+            << "' on resource pressure: "
+            << (pressure.isFailed() ? pressure.failure() : "discarded");
+    return;
+  }
+
+  MonitoringInfo& info = monitored[containerId];
+
+  if (!info.collecting) {
+    // A container under pressure is sampled as often as a busy one
+    // at the most: if it was sampled recently it is due once the
+    // adapted interval has elapsed.
+    const Time earliest =
+      info.sampled + info.interval / MONITORING_ADAPTIVE_FACTOR;
+
+    if (earliest <= Clock::now()) {
+      VLOG(1) << "Sampling container '" << containerId
+              << "' under resource pressure";
+
+      collect(list<ContainerID>(1, containerId));
+      schedule();
+    } else if (earliest < info.next) {
+      info.next = earliest;
+      schedule();
+    }
+  }
+
+  watch(containerId);
+}
+
+
+void ResourceMonitorProcess::MonitoringInfo::adapt(
+    const ResourceStatistics& statistics)
+{
+  bool busy = false;
+  bool idle = false;
+
+  if (statistics.has_mem_rss_bytes() &&
+      statistics.has_mem_limit_bytes() &&
+      statistics.mem_limit_bytes() > 0 &&
+      statistics.mem_rss_bytes() >=
+        MONITORING_BUSY_THRESHOLD * statistics.mem_limit_bytes()) {
+    busy = true;
+  }
+
+  // Determine the CPU usage since the previous sample.
+  if (previous.isSome() && statistics.cpus_limit() > 0) {
+    double elapsed = statistics.timestamp() - previous.get().timestamp();
+
+    if (elapsed > 0) {
+      double used =
+        (statistics.cpus_user_time_secs() +
+         statistics.cpus_system_time_secs() -
+         previous.get().cpus_user_time_secs() -
+         previous.get().cpus_system_time_secs()) / elapsed;
+
+      if (used >= MONITORING_BUSY_THRESHOLD * statistics.cpus_limit()) {
+        busy = true;
+      } else if (used < MONITORING_IDLE_THRESHOLD * statistics.cpus_limit()) {
+        idle = true;
+      }
+    }
+  }
+
+  previous = statistics;
+  this->idle = (idle && !busy) ? this->idle + 1 : 0;
+
+  if (busy) {
+    current = interval / MONITORING_ADAPTIVE_FACTOR;
+  } else if (this->idle >= MONITORING_IDLE_SAMPLES) {
+    current = interval * MONITORING_ADAPTIVE_FACTOR;
+  } else {
+    current = interval;
+  }
 }
 
 
@@ -234,6 +425,116 @@ Future<http::Response> ResourceMonitorProcess::__statistics(
 }
 
 
+Future<http::Response> ResourceMonitorProcess::history(
+    const http::Request& request)
+{
+  vector<string> metrics = UsageHistory::metrics();
+  if (request.query.contains("metric")) {
+    metrics = strings::split(request.query.get("metric").get(), ",");
+  }
+
+  Duration resolution = Duration::zero();
+  if (request.query.contains("resolution")) {
+    Try<Duration> duration =
+      Duration::parse(request.query.get("resolution").get());
+
+    if (duration.isError()) {
+      return http::BadRequest(
+          "Failed to parse 'resolution': " + duration.error() + ".\n");
+    }
+
+    resolution = duration.get();
+  }
+
+  UsageHistory::Aggregation aggregation = UsageHistory::AVERAGE;
+  if (request.query.contains("aggregation")) {
+    Try<UsageHistory::Aggregation> parse =
+      UsageHistory::parse(request.query.get("aggregation").get());
+
+    if (parse.isError()) {
+      return http::BadRequest(
+          "Failed to parse 'aggregation': " + parse.error() + ".\n");
+    }
+
+    aggregation = parse.get();
+  }
+
+  Option<double> start;
+  Option<double> end;
+  foreach (const string& name, strings::split("start,end", ",")) {
+    if (request.query.contains(name)) {
+      Try<double> time = numify<double>(request.query.get(name).get());
+
+      if (time.isError()) {
+        return http::BadRequest(
+            "Failed to parse '" + name + "': " + time.error() + ".\n");
+      }
+
+      (name == "start" ? start : end) = time.get();
+    }
+  }
+
+  Option<string> frameworkId = request.query.get("framework_id");
+  Option<string> executorId = request.query.get("executor_id");
+
+  // The monitored containers followed by the archived ones.
+  list<pair<const MonitoringInfo*, bool> > infos;
+  foreachvalue (const MonitoringInfo& info, monitored) {
+    infos.push_back(make_pair(&info, false));
+  }
+  foreach (const MonitoringInfo& info, archive) {
+    infos.push_back(make_pair(&info, true));
+  }
+
+  JSON::Array result;
+
+  typedef pair<const MonitoringInfo*, bool> Info;
+  foreach (const Info& info, infos) {
+    const ExecutorInfo& executorInfo = info.first->executorInfo;
+
+    if ((frameworkId.isSome() &&
+         frameworkId.get() != executorInfo.framework_id().value()) ||
+        (executorId.isSome() &&
+         executorId.get() != executorInfo.executor_id().value())) {
+      continue;
+    }
+
+    JSON::Object history;
+    foreach (const string& metric, metrics) {
+      Try<vector<pair<double, double> > > values = info.first->history.query(
+          metric, resolution, aggregation, start, end);
+
+      if (values.isError()) {
+        return http::BadRequest(values.error() + ".\n");
+      }
+
+      JSON::Array array;
+      typedef pair<double, double> Value;
+      foreach (const Value& value, values.get()) {
+        JSON::Array point;
+        point.values.push_back(value.first);
+        point.values.push_back(value.second);
+        array.values.push_back(point);
+      }
+
+      history.values[metric] = array;
+    }
+
+    JSON::Object entry;
+    entry.values["framework_id"] = executorInfo.framework_id().value();
+    entry.values["executor_id"] = executorInfo.executor_id().value();
+    entry.values["executor_name"] = executorInfo.name();
+    entry.values["source"] = executorInfo.source();
+    entry.values["completed"] = JSON::Boolean(info.second);
+    entry.values["history"] = history;
+
+    result.values.push_back(entry);
+  }
+
+  return http::OK(result, request.query.get("jsonp"));
+}
+
+
 const string ResourceMonitorProcess::STATISTICS_HELP = HELP(
     TLDR(
         "Retrieve resource monitoring information."),
@@ -259,6 +560,8 @@ const string ResourceMonitorProcess::STATISTICS_HELP = HELP(
         "        \"cpus_system_time_secs\":34501.45,",
         "        \"cpus_throttled_time_secs\":352.597023453,",
         "        \"cpus_user_time_secs\":96348.84,",
+        "        \"disk_limit_bytes\":10737418240,",
+        "        \"disk_used_bytes\":1503297536,",
         "        \"mem_anon_bytes\":4845449216,",
         "        \"mem_file_bytes\":260165632,",
         "        \"mem_limit_bytes\":7650410496,",
@@ -270,6 +573,48 @@ const string ResourceMonitorProcess::STATISTICS_HELP = HELP(
         "```"));
 
 
+const string ResourceMonitorProcess::HISTORY_HELP = HELP(
+    TLDR(
+        "Retrieve the resource usage history of containers."),
+    USAGE(
+        "/history.json"),
+    DESCRIPTION(
+        "Returns the resource usage history of the containers running",
+        "under this slave, and of the last completed ones. The last",
+        "samples are kept as collected, older ones as rollups over",
+        "1 minute, 1 hour and 1 day intervals.",
+        "",
+        "Query parameters:",
+        "",
+        ">        framework_id=VALUE   Only the containers of this framework.",
+        ">        executor_id=VALUE    Only the containers of this executor.",
+        ">        metric=VALUE[,...]   The metrics (statistics) to return,",
+        ">                             all by default.",
+        ">        resolution=VALUE     One of '1mins', '1hrs' and '1days' to",
+        ">                             return rollups, rather than samples.",
+        ">        aggregation=VALUE    One of 'min', 'max', 'avg' (default)",
+        ">                             and 'last', for rollups.",
+        ">        start=SECONDS        Since this time (since the Epoch).",
+        ">        end=SECONDS          Until this time (since the Epoch).",
+        "",
+        "Example:",
+        "",
+        "```",
+        "[{",
+        "    \"completed\":false,",
+        "    \"executor_id\":\"executor\",",
+        "    \"executor_name\":\"name\",",
+        "    \"framework_id\":\"framework\",",
+        "    \"history\":",
+        "    {",
+        "        \"mem_rss_bytes\":[[1388534400.0,5105614848],",
+        "                           [1388534460.0,5105876992]]",
+        "    },",
+        "    \"source\":\"source\"",
+        "}]",
+        "```"));
+
+
 ResourceMonitor::ResourceMonitor(Containerizer* containerizer)
 {
   process = new ResourceMonitorProcess(containerizer);
@@ -19,6 +19,7 @@
 #ifndef __SLAVE_MONITOR_HPP__
 #define __SLAVE_MONITOR_HPP__
 
+#include <list>
 #include <map>
 #include <string>
 
@@ -28,7 +29,8 @@
 
 #include <process/future.hpp>
 #include <process/limiter.hpp>
-#include <process/statistics.hpp>
+#include <process/time.hpp>
+#include <process/timer.hpp>
 
 #include <stout/cache.hpp>
 #include <stout/duration.hpp>
@@ -39,6 +41,8 @@
 
 #include "common/type_utils.hpp"
 
+#include "slave/usage_history.hpp"
+
 namespace mesos {
 namespace internal {
 namespace slave {
@@ -48,16 +52,38 @@ class Containerizer;
 class ResourceMonitorProcess;
 
 
-const extern Duration MONITORING_TIME_SERIES_WINDOW;
+// Number of samples to keep for each container as collected, and
+// number of their 1 minute, 1 hour and 1 day rollups to keep.
 const extern size_t MONITORING_TIME_SERIES_CAPACITY;
+const extern size_t MONITORING_MINUTE_ROLLUPS;
+const extern size_t MONITORING_HOUR_ROLLUPS;
+const extern size_t MONITORING_DAY_ROLLUPS;
 
 // Number of time series to maintain for completed executors.
 const extern size_t MONITORING_ARCHIVED_TIME_SERIES;
 
+// Containers using more than MONITORING_BUSY_THRESHOLD of their
+// memory or CPU limit are sampled MONITORING_ADAPTIVE_FACTOR times as
+// often as requested. Containers that used less than
+// MONITORING_IDLE_THRESHOLD of their CPU limit for the last
+// MONITORING_IDLE_SAMPLES samples are sampled that many times less
+// often.
+const extern double MONITORING_BUSY_THRESHOLD;
+const extern double MONITORING_IDLE_THRESHOLD;
+const extern size_t MONITORING_IDLE_SAMPLES;
+const extern size_t MONITORING_ADAPTIVE_FACTOR;
+
 
 // Provides resource monitoring for containers. Resource usage time
-// series are stored using the Statistics module. Usage information
-// is also exported via a JSON endpoint.
+// series are stored in a UsageHistory for each container. Usage
+// information is also exported via JSON endpoints.
+//
+// The containers are sampled together, on a single timer: each
+// container is sampled at the multiples (since the Epoch) of its
+// interval, which is adapted to how busy the container is, so that
+// the containers due at the same time are collected in one batch.
+// A container is also sampled as soon as the containerizer reports
+// it under resource pressure.
 // TODO(bmahler): Forward usage information to the master.
 // TODO(bmahler): Consider pulling out the resource collection into
 // a Collector abstraction. The monitor can then become a true
@@ -115,19 +141,32 @@ protected:
           STATISTICS_HELP,
           &ResourceMonitorProcess::statistics);
 
-    // TODO(bmahler): Add a archive.json endpoint that exposes
-    // historical information, once we have path parameters for
-    // routes.
+    route("/history.json",
+          HISTORY_HELP,
+          &ResourceMonitorProcess::history);
   }
 
 private:
-  void collect(
-      const ContainerID& containerId,
-      const Duration& interval);
+  // Collects the usage of the containers that are due.
+  void tick();
+
+  // (Re)schedules tick() for when the next container is due.
+  void schedule();
+
+  // Each container is handled as soon as its usage is collected, so
+  // that a container whose usage takes long (or never arrives) does
+  // not hold up the others.
+  void collect(const std::list<ContainerID>& containerIds);
   void _collect(
-      const process::Future<ResourceStatistics>& statistics,
       const ContainerID& containerId,
-      const Duration& interval);
+      const process::Future<ResourceStatistics>& statistics);
+
+  // Samples the container as soon as it comes under pressure, but no
+  // more than once every 'interval / MONITORING_ADAPTIVE_FACTOR'.
+  void watch(const ContainerID& containerId);
+  void pressured(
+      const ContainerID& containerId,
+      const process::Future<Nothing>& pressure);
 
   // This is a convenience struct for bundling usage information.
   struct Usage
@@ -152,7 +191,13 @@ private:
       const std::list<Usage>& usages,
       const process::http::Request& request);
 
+  // Returns the usage history of the monitored and archived
+  // containers. See HISTORY_HELP for the parameters.
+  process::Future<process::http::Response> history(
+      const process::http::Request& request);
+
   static const std::string STATISTICS_HELP;
+  static const std::string HISTORY_HELP;
 
   Containerizer* containerizer;
 
@@ -162,15 +207,41 @@ private:
   // Monitoring information for an executor.
   struct MonitoringInfo {
     // boost::circular_buffer needs a default constructor.
-    MonitoringInfo() {}
+    MonitoringInfo()
+      : history(0, std::map<Duration, size_t>()),
+        collecting(false),
+        idle(0) {}
 
     MonitoringInfo(const ExecutorInfo& _executorInfo,
-                   const Duration& window,
-                   size_t capacity)
-      : executorInfo(_executorInfo), statistics(window, capacity) {}
+                   const Duration& _interval,
+                   size_t capacity,
+                   const std::map<Duration, size_t>& rollups)
+      : executorInfo(_executorInfo),
+        history(capacity, rollups),
+        interval(_interval),
+        current(_interval),
+        collecting(false),
+        idle(0) {}
+
+    // Adapts the sampling interval to the latest sample.
+    void adapt(const ResourceStatistics& statistics);
 
     ExecutorInfo executorInfo;   // Non-const for assignability.
-    process::TimeSeries<ResourceStatistics> statistics;
+    UsageHistory history;
+
+    // The requested sampling interval, and the adapted one.
+    Duration interval;
+    Duration current;
+
+    // When the container is due to be sampled, and when it was last
+    // sampled.
+    process::Time next;
+    process::Time sampled;
+    bool collecting;
+
+    // The previous sample, and the number of idle samples in a row.
+    Option<ResourceStatistics> previous;
+    size_t idle;
   };
 
   // The monitoring info is stored for each monitored container.
@@ -178,6 +249,9 @@ private:
 
   // Fixed-size history of monitoring information.
   boost::circular_buffer<MonitoringInfo> archive;
+
+  // Fires when the next container is due, if any.
+  Option<process::Timer> timer;
 };
 
 } // namespace slave {
@@ -101,6 +101,12 @@ inline std::string getMetaRootDir(const std::string rootDir)
 }
 
 
+inline std::string getFetcherCacheDir(const std::string& rootDir)
+{
+  return path::join(rootDir, "fetch");
+}
+
+
 inline std::string getArchiveDir(const std::string rootDir)
 {
   return path::join(rootDir, "archive");
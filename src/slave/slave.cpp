@@ -94,6 +94,7 @@ Slave::Slave(const slave::Flags& _flags,
     detector(_detector),
     containerizer(_containerizer),
     files(_files),
+    gc(flags.gc_rate_limit),
     monitor(containerizer),
     statusUpdateManager(new StatusUpdateManager()),
     metaDir(paths::getMetaRootDir(flags.work_dir)),
@@ -231,6 +232,10 @@ void Slave::initialize()
       &StatusUpdateAcknowledgementMessage::task_id,
       &StatusUpdateAcknowledgementMessage::uuid);
 
+  install<StatusUpdateAcknowledgementsMessage>(
+      &Slave::statusUpdateAcknowledgements,
+      &StatusUpdateAcknowledgementsMessage::acknowledgements);
+
   install<RegisterExecutorMessage>(
       &Slave::registerExecutor,
       &RegisterExecutorMessage::framework_id,
@@ -283,7 +288,10 @@ void Slave::initialize()
   }
 
   // Do recovery.
-  async(&state::recover, metaDir, flags.strict)
+  async(&state::recover,
+        metaDir,
+        flags.strict,
+        flags.checkpoint && flags.checkpoint_journal)
     .then(defer(self(), &Slave::recover, lambda::_1))
     .then(defer(self(), &Slave::_recover))
     .onAny(defer(self(), &Slave::__recover, lambda::_1));
@@ -319,8 +327,13 @@ void Slave::finalize()
     // as a new slave with the master.
     if (os::exists(paths::getLatestSlavePath(metaDir))) {
       CHECK_SOME(os::rm(paths::getLatestSlavePath(metaDir)));
+      CHECK_SOME(state::removed(paths::getLatestSlavePath(metaDir)));
     }
   }
+
+  // The checkpoint journal lives as long as the slave that recovered
+  // it, since no more checkpoints get written once it terminates.
+  state::release(metaDir);
 }
 
 
@@ -454,6 +467,8 @@ void Slave::registered(const UPID& from, const SlaveID& slaveId)
       if (flags.checkpoint) {
         // Create the slave meta directory.
         paths::createSlaveDirectory(metaDir, slaveId);
+        CHECK_SOME(state::journal(paths::getSlavePath(metaDir, slaveId)));
+        CHECK_SOME(state::journal(paths::getLatestSlavePath(metaDir)));
 
         // Checkpoint slave info.
         const string& path = paths::getSlaveInfoPath(metaDir, slaveId);
@@ -1279,6 +1294,20 @@ void Slave::statusUpdateAcknowledgement(
 }
 
 
+void Slave::statusUpdateAcknowledgements(
+    const vector<StatusUpdateAcknowledgementMessage>& acknowledgements)
+{
+  foreach (const StatusUpdateAcknowledgementMessage& acknowledgement,
+           acknowledgements) {
+    statusUpdateAcknowledgement(
+        acknowledgement.slave_id(),
+        acknowledgement.framework_id(),
+        acknowledgement.task_id(),
+        acknowledgement.uuid());
+  }
+}
+
+
 void Slave::_statusUpdateAcknowledgement(
     const Future<bool>& future,
     const TaskID& taskId,
@@ -2240,7 +2269,7 @@ void Slave::removeExecutor(Framework* framework, Executor* executor)
   if (executor->checkpoint) {
     const string& path = paths::getExecutorSentinelPath(
         metaDir, info.id(), framework->id, executor->id, executor->containerId);
-    CHECK_SOME(os::touch(path));
+    CHECK_SOME(state::checkpoint(path, ""));
   }
 
   // TODO(vinod): Move the responsibility of gc'ing to the
@@ -2810,6 +2839,13 @@ Future<Nothing> Slave::garbageCollect(const string& path)
   if (mtime.isError()) {
     LOG(ERROR) << "Failed to find the mtime of '" << path
                << "': " << mtime.error();
+
+    // A meta directory that is already gone may still be journaled,
+    // if the slave died after removing it but before journaling that.
+    if (!os::exists(path)) {
+      state::removed(path);
+    }
+
     return Failure(mtime.error());
   }
 
@@ -2822,7 +2858,10 @@ Future<Nothing> Slave::garbageCollect(const string& path)
   // GC based on the modification time.
   Duration delay = flags.gc_delay - (Clock::now() - time.get());
 
-  return gc.schedule(delay, path);
+  // Journal the removal once the path is garbage collected, in case
+  // it is a meta directory.
+  return gc.schedule(delay, path)
+    .onReady(lambda::bind(&state::removed, path));
 }
 
 
@@ -3135,8 +3174,12 @@ Executor::Executor(
 
     // Create the meta executor directory.
     // NOTE: This creates the 'latest' symlink in the meta directory.
-    paths::createExecutorDirectory(
+    const string& directory = paths::createExecutorDirectory(
         slave->metaDir, slave->info.id(), frameworkId, id, containerId);
+
+    CHECK_SOME(state::journal(directory));
+    CHECK_SOME(state::journal(paths::getExecutorLatestRunPath(
+        slave->metaDir, slave->info.id(), frameworkId, id)));
   }
 }
 
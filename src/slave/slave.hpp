@@ -171,6 +171,11 @@ public:
       const TaskID& taskId,
       const std::string& uuid);
 
+  // Handles each of the acknowledgements (from the same scheduler)
+  // as if it were sent on its own.
+  void statusUpdateAcknowledgements(
+      const std::vector<StatusUpdateAcknowledgementMessage>& acknowledgements);
+
   void _statusUpdateAcknowledgement(
       const process::Future<bool>& future,
       const TaskID& taskId,
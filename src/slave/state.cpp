@@ -1,5 +1,10 @@
+#include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
 #include <glog/logging.h>
 
 #include <iostream>
@@ -9,12 +14,18 @@
 #include <stout/error.hpp>
 #include <stout/foreach.hpp>
 #include <stout/format.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/memory.hpp>
 #include <stout/none.hpp>
 #include <stout/numify.hpp>
 #include <stout/os.hpp>
+#include <stout/path.hpp>
 #include <stout/protobuf.hpp>
+#include <stout/stringify.hpp>
 #include <stout/try.hpp>
 
+#include "slave/journal.hpp"
 #include "slave/paths.hpp"
 #include "slave/state.hpp"
 
@@ -28,20 +39,244 @@ using std::string;
 using std::max;
 
 
-Result<SlaveState> recover(const string& rootDir, bool strict)
+// Parses the next protobuf written by '::protobuf::write()' out of
+// 'data', starting at 'offset', the way '::protobuf::read()' reads it
+// out of a file: 'offset' is only advanced past a valid protobuf.
+template <typename T>
+static Result<T> parse(const string& data, size_t* offset, bool ignorePartial)
+{
+  uint32_t size;
+  if (data.size() - *offset < sizeof(size)) {
+    return None(); // No more protobufs to read.
+  }
+
+  memcpy((void*) &size, (void*) (data.data() + *offset), sizeof(size));
+
+  if (data.size() - *offset - sizeof(size) < size) {
+    // Hit EOF unexpectedly.
+    if (ignorePartial) {
+      return None();
+    }
+    return Error("Failed to read message of size " + stringify(size) +
+                 " bytes: hit EOF unexpectedly, possible corruption");
+  }
+
+  T message;
+  if (!message.ParseFromArray(data.data() + *offset + sizeof(size), size)) {
+    return Error("Failed to deserialize message");
+  }
+
+  *offset += sizeof(size) + size;
+
+  return message;
+}
+
+
+// Returns the protobuf the way '::protobuf::write()' writes it.
+static string serialize(const google::protobuf::Message& message)
+{
+  uint32_t size = message.ByteSize();
+  return string((const char*) &size, sizeof(size)) +
+    message.SerializeAsString();
+}
+
+
+class Checkpoints
+{
+public:
+  explicit Checkpoints(const memory::shared_ptr<CheckpointJournal>& _journal)
+    : journal(_journal) {}
+
+  bool exists(const string& path) const
+  {
+    return journal ? journal->exists(path) : os::exists(path);
+  }
+
+  Try<string> read(const string& path) const
+  {
+    return journal ? journal->read(path) : os::read(path);
+  }
+
+  template <typename T>
+  Result<T> read(const string& path) const
+  {
+    Try<string> data = read(path);
+    if (data.isError()) {
+      return Error(data.error());
+    }
+
+    size_t offset = 0;
+    return parse<T>(data.get(), &offset, false);
+  }
+
+  // NOTE: Only patterns matching all the entries of a directory
+  // (i.e., "<directory>/*") are supported, which is all that the
+  // recovery needs.
+  Try<list<string> > glob(const string& pattern) const
+  {
+    if (!journal) {
+      return os::glob(pattern);
+    }
+
+    CHECK(strings::endsWith(pattern, "/*")) << pattern;
+
+    const string directory = pattern.substr(0, pattern.size() - 2);
+    if (!journal->exists(directory)) {
+      return list<string>();
+    }
+
+    Try<list<string> > entries = journal->ls(directory);
+    if (entries.isError()) {
+      return Error(entries.error());
+    }
+
+    list<string> paths;
+    foreach (const string& entry, entries.get()) {
+      paths.push_back(path::join(directory, entry));
+    }
+
+    return paths;
+  }
+
+  // NOTE: The symbolic links under the meta directory are all to
+  // absolute paths, so their targets are their real paths.
+  Result<string> realpath(const string& path) const
+  {
+    if (journal) {
+      return journal->readlink(path);
+    }
+
+    return os::realpath(path);
+  }
+
+  Try<Nothing> truncate(const string& path, size_t length) const
+  {
+    if (journal) {
+      Try<string> data = journal->read(path);
+      if (data.isError()) {
+        return Error(data.error());
+      }
+
+      Try<Nothing> write = journal->write(path, data.get().substr(0, length));
+      if (write.isError()) {
+        return write;
+      }
+
+      // The file may be shorter than its journaled contents, since
+      // it is appended to after the journal.
+      struct stat s;
+      if (::stat(path.c_str(), &s) < 0 || (size_t) s.st_size <= length) {
+        return Nothing();
+      }
+    }
+
+    if (::truncate(path.c_str(), length) != 0) {
+      return ErrnoError();
+    }
+
+    return Nothing();
+  }
+
+private:
+  const memory::shared_ptr<CheckpointJournal> journal;
+};
+
+
+// The journals that checkpoints get journaled to, by the meta
+// directory that they are for (see 'recover()'), and the meta
+// directories whose journals were released (see 'release()').
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static hashmap<string, memory::shared_ptr<CheckpointJournal> >* journals =
+  new hashmap<string, memory::shared_ptr<CheckpointJournal> >();
+static hashset<string>* released = new hashset<string>();
+
+
+// Returns the journal for the checkpoint at 'path', if any.
+static memory::shared_ptr<CheckpointJournal> journaling(const string& path)
+{
+  memory::shared_ptr<CheckpointJournal> journal;
+
+  pthread_mutex_lock(&mutex);
+  foreachpair (const string& rootDir,
+               const memory::shared_ptr<CheckpointJournal>& journal_,
+               *journals) {
+    if (strings::startsWith(path, rootDir + "/")) {
+      journal = journal_;
+      break;
+    }
+  }
+
+  // A released journal would miss this checkpoint (e.g., one written
+  // by an executor launch that was still in progress when the slave
+  // terminated), so that it must not be replayed by a later recovery.
+  if (!journal) {
+    foreach (const string& rootDir, *released) {
+      if (strings::startsWith(path, rootDir + "/")) {
+        LOG(WARNING) << "Removing the released checkpoint journal of '"
+                     << rootDir << "' since it misses the checkpoint of '"
+                     << path << "'";
+        os::rm(CheckpointJournal::path(rootDir));
+        released->erase(rootDir);
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return journal;
+}
+
+
+Result<SlaveState> recover(const string& rootDir, bool strict, bool journal)
 {
   LOG(INFO) << "Recovering state from '" << rootDir << "'";
 
+  const bool exists = os::exists(rootDir);
+
+  memory::shared_ptr<CheckpointJournal> journal_;
+  if (journal) {
+    Try<CheckpointJournal*> open = CheckpointJournal::open(rootDir);
+    if (open.isError()) {
+      LOG(WARNING) << "Failed to open the checkpoint journal, recovering "
+                   << "from the checkpointed files instead: " << open.error();
+    } else {
+      journal_.reset(open.get());
+    }
+  }
+
+  // Journal the checkpoints written from now on, replacing the
+  // journal of any previous recovery.
+  pthread_mutex_lock(&mutex);
+  journals->erase(strings::remove(rootDir, "/", strings::SUFFIX));
+  released->erase(strings::remove(rootDir, "/", strings::SUFFIX));
+  if (journal_) {
+    (*journals)[journal_->rootDir] = journal_;
+  }
+  pthread_mutex_unlock(&mutex);
+
+  // A journal that is left behind would miss the checkpoints written
+  // from now on, so that it must not be replayed by a later recovery.
+  const string path = CheckpointJournal::path(rootDir);
+  if (!journal_ && os::exists(path)) {
+    Try<Nothing> rm = os::rm(path);
+    if (rm.isError()) {
+      return Error("Failed to remove stale checkpoint journal '" + path +
+                   "': " + rm.error());
+    }
+  }
+
+  Checkpoints checkpoints(journal_);
+
   // We consider the absence of 'rootDir' to mean that this is either
   // the first time this slave was started with checkpointing enabled
   // or this slave was started after an upgrade (--recover=cleanup).
-  if (!os::exists(rootDir)) {
+  if (!exists) {
     return None();
   }
 
   // Did the machine reboot?
-  if (os::exists(paths::getBootIdPath(rootDir))) {
-    Try<string> read = os::read(paths::getBootIdPath(rootDir));
+  if (checkpoints.exists(paths::getBootIdPath(rootDir))) {
+    Try<string> read = checkpoints.read(paths::getBootIdPath(rootDir));
     if (read.isSome()) {
       Try<string> id = os::bootId();
       CHECK_SOME(id);
@@ -56,7 +291,7 @@ Result<SlaveState> recover(const string& rootDir, bool strict)
   const std::string& latest = paths::getLatestSlavePath(rootDir);
 
   // Check if the "latest" symlink to a slave directory exists.
-  if (!os::exists(latest)) {
+  if (!checkpoints.exists(latest)) {
     // The slave was asked to shutdown or died before it registered
     // and had a chance to create the "latest" symlink.
     LOG(INFO) << "Failed to find the latest slave from '" << rootDir << "'";
@@ -64,7 +299,7 @@ Result<SlaveState> recover(const string& rootDir, bool strict)
   }
 
   // Get the latest slave id.
-  Result<string> directory = os::realpath(latest);
+  Result<string> directory = checkpoints.realpath(latest);
   if (!directory.isSome()) {
     return Error("Failed to find latest slave: " +
                  (directory.isError()
@@ -75,7 +310,8 @@ Result<SlaveState> recover(const string& rootDir, bool strict)
   SlaveID slaveId;
   slaveId.set_value(os::basename(directory.get()).get());
 
-  Try<SlaveState> state = SlaveState::recover(rootDir, slaveId, strict);
+  Try<SlaveState> state =
+    SlaveState::recover(rootDir, slaveId, strict, checkpoints);
   if (state.isError()) {
     return Error(state.error());
   }
@@ -87,21 +323,22 @@ Result<SlaveState> recover(const string& rootDir, bool strict)
 Try<SlaveState> SlaveState::recover(
     const string& rootDir,
     const SlaveID& slaveId,
-    bool strict)
+    bool strict,
+    const Checkpoints& checkpoints)
 {
   SlaveState state;
   state.id = slaveId;
 
   // Read the slave info.
   const string& path = paths::getSlaveInfoPath(rootDir, slaveId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died before it registered
     // with the master.
     LOG(WARNING) << "Failed to find slave info file '" << path << "'";
     return state;
   }
 
-  const Result<SlaveInfo>& slaveInfo = ::protobuf::read<SlaveInfo>(path);
+  const Result<SlaveInfo>& slaveInfo = checkpoints.read<SlaveInfo>(path);
 
   if (slaveInfo.isError()) {
     const string& message = "Failed to read slave info from '" + path + "': " +
@@ -125,7 +362,7 @@ Try<SlaveState> SlaveState::recover(
   state.info = slaveInfo.get();
 
   // Find the frameworks.
-  Try<list<string> > frameworks = os::glob(
+  Try<list<string> > frameworks = checkpoints.glob(
       strings::format(paths::FRAMEWORK_PATH, rootDir, slaveId, "*").get());
 
   if (frameworks.isError()) {
@@ -138,8 +375,8 @@ Try<SlaveState> SlaveState::recover(
     FrameworkID frameworkId;
     frameworkId.set_value(os::basename(path).get());
 
-    Try<FrameworkState> framework =
-      FrameworkState::recover(rootDir, slaveId, frameworkId, strict);
+    Try<FrameworkState> framework = FrameworkState::recover(
+        rootDir, slaveId, frameworkId, strict, checkpoints);
 
     if (framework.isError()) {
       return Error("Failed to recover framework " + frameworkId.value() +
@@ -158,7 +395,8 @@ Try<FrameworkState> FrameworkState::recover(
     const string& rootDir,
     const SlaveID& slaveId,
     const FrameworkID& frameworkId,
-    bool strict)
+    bool strict,
+    const Checkpoints& checkpoints)
 {
   FrameworkState state;
   state.id = frameworkId;
@@ -166,7 +404,7 @@ Try<FrameworkState> FrameworkState::recover(
 
   // Read the framework info.
   string path = paths::getFrameworkInfoPath(rootDir, slaveId, frameworkId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died after creating the
     // framework directory but before it checkpointed the
     // framework info.
@@ -175,7 +413,7 @@ Try<FrameworkState> FrameworkState::recover(
   }
 
   const Result<FrameworkInfo>& frameworkInfo =
-    ::protobuf::read<FrameworkInfo>(path);
+    checkpoints.read<FrameworkInfo>(path);
 
   if (frameworkInfo.isError()) {
     message = "Failed to read framework info from '" + path + "': " +
@@ -201,14 +439,14 @@ Try<FrameworkState> FrameworkState::recover(
 
   // Read the framework pid.
   path = paths::getFrameworkPidPath(rootDir, slaveId, frameworkId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died after creating the
     // framework info but before it checkpointed the framework pid.
     LOG(WARNING) << "Failed to framework pid file '" << path << "'";
     return state;
   }
 
-  Try<string> pid = os::read(path);
+  Try<string> pid = checkpoints.read(path);
 
   if (pid.isError()) {
     message =
@@ -233,7 +471,7 @@ Try<FrameworkState> FrameworkState::recover(
   state.pid = process::UPID(pid.get());
 
   // Find the executors.
-  Try<list<string> > executors = os::glob(strings::format(
+  Try<list<string> > executors = checkpoints.glob(strings::format(
       paths::EXECUTOR_PATH, rootDir, slaveId, frameworkId, "*").get());
 
   if (executors.isError()) {
@@ -247,8 +485,8 @@ Try<FrameworkState> FrameworkState::recover(
     ExecutorID executorId;
     executorId.set_value(os::basename(path).get());
 
-    Try<ExecutorState> executor =
-      ExecutorState::recover(rootDir, slaveId, frameworkId, executorId, strict);
+    Try<ExecutorState> executor = ExecutorState::recover(
+        rootDir, slaveId, frameworkId, executorId, strict, checkpoints);
 
     if (executor.isError()) {
       return Error("Failed to recover executor " + executorId.value() +
@@ -268,7 +506,8 @@ Try<ExecutorState> ExecutorState::recover(
     const SlaveID& slaveId,
     const FrameworkID& frameworkId,
     const ExecutorID& executorId,
-    bool strict)
+    bool strict,
+    const Checkpoints& checkpoints)
 {
   ExecutorState state;
   state.id = executorId;
@@ -277,7 +516,7 @@ Try<ExecutorState> ExecutorState::recover(
   // Read the executor info.
   const string& path =
     paths::getExecutorInfoPath(rootDir, slaveId, frameworkId, executorId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died after creating the executor
     // directory but before it checkpointed the executor info.
     LOG(WARNING) << "Failed to find executor info file '" << path << "'";
@@ -285,7 +524,7 @@ Try<ExecutorState> ExecutorState::recover(
   }
 
   const Result<ExecutorInfo>& executorInfo =
-    ::protobuf::read<ExecutorInfo>(path);
+    checkpoints.read<ExecutorInfo>(path);
 
   if (executorInfo.isError()) {
     message = "Failed to read executor info from '" + path + "': " +
@@ -310,7 +549,7 @@ Try<ExecutorState> ExecutorState::recover(
   state.info = executorInfo.get();
 
   // Find the runs.
-  Try<list<string> > runs = os::glob(strings::format(
+  Try<list<string> > runs = checkpoints.glob(strings::format(
       paths::EXECUTOR_RUN_PATH,
       rootDir,
       slaveId,
@@ -326,7 +565,7 @@ Try<ExecutorState> ExecutorState::recover(
   // Recover the runs.
   foreach (const string& path, runs.get()) {
     if (os::basename(path).get() == paths::LATEST_SYMLINK) {
-      const Result<string>& latest = os::realpath(path);
+      const Result<string>& latest = checkpoints.realpath(path);
       if (!latest.isSome()) {
         return Error(
             "Failed to find latest run of executor '" +
@@ -345,7 +584,13 @@ Try<ExecutorState> ExecutorState::recover(
       containerId.set_value(os::basename(path).get());
 
       Try<RunState> run = RunState::recover(
-          rootDir, slaveId, frameworkId, executorId, containerId, strict);
+          rootDir,
+          slaveId,
+          frameworkId,
+          executorId,
+          containerId,
+          strict,
+          checkpoints);
 
       if (run.isError()) {
         return Error(
@@ -378,14 +623,15 @@ Try<RunState> RunState::recover(
     const FrameworkID& frameworkId,
     const ExecutorID& executorId,
     const ContainerID& containerId,
-    bool strict)
+    bool strict,
+    const Checkpoints& checkpoints)
 {
   RunState state;
   state.id = containerId;
   string message;
 
   // Find the tasks.
-  Try<list<string> > tasks = os::glob(strings::format(
+  Try<list<string> > tasks = checkpoints.glob(strings::format(
       paths::TASK_PATH,
       rootDir,
       slaveId,
@@ -406,7 +652,14 @@ Try<RunState> RunState::recover(
     taskId.set_value(os::basename(path).get());
 
     Try<TaskState> task = TaskState::recover(
-        rootDir, slaveId, frameworkId, executorId, containerId, taskId, strict);
+        rootDir,
+        slaveId,
+        frameworkId,
+        executorId,
+        containerId,
+        taskId,
+        strict,
+        checkpoints);
 
     if (task.isError()) {
       return Error(
@@ -420,14 +673,14 @@ Try<RunState> RunState::recover(
   // Read the forked pid.
   string path = paths::getForkedPidPath(
       rootDir, slaveId, frameworkId, executorId, containerId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died before the isolator
     // checkpointed the forked pid.
     LOG(WARNING) << "Failed to find executor forked pid file '" << path << "'";
     return state;
   }
 
-  Try<string> pid = os::read(path);
+  Try<string> pid = checkpoints.read(path);
 
   if (pid.isError()) {
     message = "Failed to read executor forked pid from '" + path +
@@ -461,7 +714,7 @@ Try<RunState> RunState::recover(
   path = paths::getLibprocessPidPath(
       rootDir, slaveId, frameworkId, executorId, containerId);
 
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died before the executor
     // registered with the slave.
     LOG(WARNING)
@@ -469,7 +722,7 @@ Try<RunState> RunState::recover(
     return state;
   }
 
-  pid = os::read(path);
+  pid = checkpoints.read(path);
 
   if (pid.isError()) {
     message = "Failed to read executor libprocess pid from '" + path +
@@ -497,7 +750,7 @@ Try<RunState> RunState::recover(
   path = paths::getExecutorSentinelPath(
       rootDir, slaveId, frameworkId, executorId, containerId);
 
-  state.completed = os::exists(path);
+  state.completed = checkpoints.exists(path);
 
   return state;
 }
@@ -510,7 +763,8 @@ Try<TaskState> TaskState::recover(
     const ExecutorID& executorId,
     const ContainerID& containerId,
     const TaskID& taskId,
-    bool strict)
+    bool strict,
+    const Checkpoints& checkpoints)
 {
   TaskState state;
   state.id = taskId;
@@ -519,14 +773,14 @@ Try<TaskState> TaskState::recover(
   // Read the task info.
   string path = paths::getTaskInfoPath(
       rootDir, slaveId, frameworkId, executorId, containerId, taskId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died after creating the task
     // directory but before it checkpointed the task info.
     LOG(WARNING) << "Failed to find task info file '" << path << "'";
     return state;
   }
 
-  const Result<Task>& task = ::protobuf::read<Task>(path);
+  const Result<Task>& task = checkpoints.read<Task>(path);
 
   if (task.isError()) {
     message = "Failed to read task info from '" + path + "': " + task.error();
@@ -552,19 +806,18 @@ Try<TaskState> TaskState::recover(
   // Read the status updates.
   path = paths::getTaskUpdatesPath(
       rootDir, slaveId, frameworkId, executorId, containerId, taskId);
-  if (!os::exists(path)) {
+  if (!checkpoints.exists(path)) {
     // This could happen if the slave died before it checkpointed
     // any status updates for this task.
     LOG(WARNING) << "Failed to find status updates file '" << path << "'";
     return state;
   }
 
-  // Open the status updates file for reading and writing (for truncating).
-  Try<int> fd = os::open(path, O_RDWR);
+  Try<string> updates = checkpoints.read(path);
 
-  if (fd.isError()) {
-    message = "Failed to open status updates file '" + path +
-              "': " + fd.error();
+  if (updates.isError()) {
+    message = "Failed to read status updates file '" + path +
+              "': " + updates.error();
 
     if (strict) {
       return Error(message);
@@ -575,11 +828,12 @@ Try<TaskState> TaskState::recover(
     }
   }
 
-  // Now, read the updates.
+  // Now, parse the updates.
+  size_t offset = 0;
   Result<StatusUpdateRecord> record = None();
   while (true) {
     // Ignore errors due to partial protobuf read.
-    record = ::protobuf::read<StatusUpdateRecord>(fd.get(), true);
+    record = parse<StatusUpdateRecord>(updates.get(), &offset, true);
 
     if (!record.isSome()) {
       break;
@@ -594,11 +848,14 @@ Try<TaskState> TaskState::recover(
 
   // Always truncate the file to contain only valid updates.
   // NOTE: This is safe even though we ignore partial protobuf
-  // read errors above, because the 'fd' is properly set to the
-  // end of the last valid update by 'protobuf::read()'.
-  if (ftruncate(fd.get(), lseek(fd.get(), 0, SEEK_CUR)) != 0) {
-    return ErrnoError(
-        "Failed to truncate status updates file '" + path + "'");
+  // read errors above, because 'offset' is properly set to the
+  // end of the last valid update by 'parse()'.
+  if (offset < updates.get().size()) {
+    Try<Nothing> truncate = checkpoints.truncate(path, offset);
+    if (truncate.isError()) {
+      return Error("Failed to truncate status updates file '" + path +
+                   "': " + truncate.error());
+    }
   }
 
   // After reading a non-corrupted updates file, 'record' should be 'none'.
@@ -615,32 +872,27 @@ Try<TaskState> TaskState::recover(
     }
   }
 
-  // Close the updates file.
-  Try<Nothing> close = os::close(fd.get());
-
-  if (close.isError()) {
-    message = "Failed to close status updates file '" + path +
-              "': " + close.error();
-
-    if (strict) {
-      return Error(message);
-    } else {
-      LOG(WARNING) << message;
-      state.errors++;
-      return state;
-    }
-  }
-
   return state;
 }
 
 
 // Helpers to checkpoint string/protobuf to disk, with necessary error checking.
+// The checkpoints get journaled first (if journaling), since it is the
+// journal that they are recovered from.
 
 Try<Nothing> checkpoint(
     const string& path,
     const google::protobuf::Message& message)
 {
+  memory::shared_ptr<CheckpointJournal> journal = journaling(path);
+  if (journal) {
+    Try<Nothing> write = journal->write(path, serialize(message));
+    if (write.isError()) {
+      return Error("Failed to journal checkpoint to '" + path + "': " +
+                   write.error());
+    }
+  }
+
   // Create the base directory.
   Try<Nothing> result = os::mkdir(os::dirname(path).get());
   if (result.isError()) {
@@ -661,6 +913,15 @@ Try<Nothing> checkpoint(
 
 Try<Nothing> checkpoint(const std::string& path, const std::string& message)
 {
+  memory::shared_ptr<CheckpointJournal> journal = journaling(path);
+  if (journal) {
+    Try<Nothing> write = journal->write(path, message);
+    if (write.isError()) {
+      return Error("Failed to journal checkpoint to '" + path + "': " +
+                   write.error());
+    }
+  }
+
   // Create the base directory.
   Try<Nothing> result = os::mkdir(os::dirname(path).get());
   if (result.isError()) {
@@ -678,6 +939,82 @@ Try<Nothing> checkpoint(const std::string& path, const std::string& message)
   return Nothing();
 }
 
+
+Try<Nothing> checkpoint(
+    int fd,
+    const string& path,
+    const google::protobuf::Message& message)
+{
+  memory::shared_ptr<CheckpointJournal> journal = journaling(path);
+  if (journal) {
+    Try<Nothing> append = journal->append(path, serialize(message));
+    if (append.isError()) {
+      return Error("Failed to journal checkpoint to '" + path + "': " +
+                   append.error());
+    }
+  }
+
+  Try<Nothing> result = ::protobuf::write(fd, message);
+  if (result.isError()) {
+    return Error("Failed to checkpoint \n" + message.DebugString() +
+                 "\n to '" + path + "': " + result.error());
+  }
+
+  return Nothing();
+}
+
+
+Try<Nothing> journal(const string& path)
+{
+  memory::shared_ptr<CheckpointJournal> journal_ = journaling(path);
+  if (!journal_) {
+    return Nothing();
+  }
+
+  struct stat s;
+  if (::lstat(path.c_str(), &s) < 0) {
+    return ErrnoError("Failed to stat '" + path + "'");
+  }
+
+  if (S_ISDIR(s.st_mode)) {
+    return journal_->mkdir(path);
+  } else if (S_ISLNK(s.st_mode)) {
+    char buffer[PATH_MAX];
+    ssize_t length = ::readlink(path.c_str(), buffer, sizeof(buffer));
+    if (length < 0) {
+      return ErrnoError("Failed to read link '" + path + "'");
+    }
+
+    return journal_->symlink(path, string(buffer, length));
+  }
+
+  return Error("'" + path + "' is neither a directory nor a symbolic link");
+}
+
+
+Try<Nothing> removed(const string& path)
+{
+  memory::shared_ptr<CheckpointJournal> journal = journaling(path);
+  if (!journal) {
+    return Nothing();
+  }
+
+  return journal->remove(path);
+}
+
+
+void release(const string& rootDir)
+{
+  const string rootDir_ = strings::remove(rootDir, "/", strings::SUFFIX);
+
+  pthread_mutex_lock(&mutex);
+  if (journals->contains(rootDir_)) {
+    journals->erase(rootDir_);
+    released->insert(rootDir_);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
 } // namespace state {
 } // namespace slave {
 } // namespace internal {
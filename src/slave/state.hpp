@@ -51,6 +51,10 @@ struct ExecutorState;
 struct RunState;
 struct TaskState;
 
+// A view of the checkpoints being recovered, either of the files or
+// of the checkpoint journal (see slave/journal.hpp).
+class Checkpoints;
+
 // This function performs recovery from the state stored at 'rootDir'.
 // If the 'strict' flag is set, any errors encountered while
 // recovering a state are considered fatal and hence the recovery is
@@ -63,7 +67,15 @@ struct TaskState;
 // 'SlaveState.errors' is the sum total of all recovery errors.
 // If the machine has rebooted since the last slave run,
 // None is returned.
-Result<SlaveState> recover(const std::string& rootDir, bool strict);
+// If the 'journal' flag is set, the state is recovered from the
+// checkpoint journal of 'rootDir' (which gets created from the
+// checkpointed files if it does not exist yet) and all subsequent
+// checkpoints under 'rootDir' are journaled as well as written to
+// their files. Otherwise, any journal left behind is removed.
+Result<SlaveState> recover(
+    const std::string& rootDir,
+    bool strict,
+    bool journal = false);
 
 // Thin wrappers to checkpoint data to disk and perform the
 // necessary error checking.
@@ -77,6 +89,32 @@ Try<Nothing> checkpoint(
 // Checkpoints a string at the given path.
 Try<Nothing> checkpoint(const std::string& path, const std::string& message);
 
+
+// Checkpoints a protobuf by appending it to the file at the given
+// path, which is open at 'fd' (e.g., a status updates file).
+Try<Nothing> checkpoint(
+    int fd,
+    const std::string& path,
+    const google::protobuf::Message& message);
+
+
+// Journals a directory or symbolic link that was created under a
+// meta directory without going through the checkpoint functions
+// above (e.g., by paths::createExecutorDirectory).
+Try<Nothing> journal(const std::string& path);
+
+
+// Journals the removal of a directory (e.g., a garbage collected
+// executor meta directory) along with everything under it.
+Try<Nothing> removed(const std::string& path);
+
+
+// Stops journaling the checkpoints under 'rootDir' and releases its
+// journal (e.g., once the slave that recovered it terminates). The
+// journal gets removed if a checkpoint is written under 'rootDir'
+// before it is recovered again, since it would miss that checkpoint.
+void release(const std::string& rootDir);
+
 // Each of the structs below (recursively) recover the checkpointed
 // state.
 struct SlaveState
@@ -86,7 +124,8 @@ struct SlaveState
   static Try<SlaveState> recover(
       const std::string& rootDir,
       const SlaveID& slaveId,
-      bool strict);
+      bool strict,
+      const Checkpoints& checkpoints);
 
   SlaveID id;
   Option<SlaveInfo> info;
@@ -103,7 +142,8 @@ struct FrameworkState
       const std::string& rootDir,
       const SlaveID& slaveId,
       const FrameworkID& frameworkId,
-      bool strict);
+      bool strict,
+      const Checkpoints& checkpoints);
 
   FrameworkID id;
   Option<FrameworkInfo> info;
@@ -122,7 +162,8 @@ struct ExecutorState
       const SlaveID& slaveId,
       const FrameworkID& frameworkId,
       const ExecutorID& executorId,
-      bool strict);
+      bool strict,
+      const Checkpoints& checkpoints);
 
   ExecutorID id;
   Option<ExecutorInfo> info;
@@ -142,7 +183,8 @@ struct RunState
       const FrameworkID& frameworkId,
       const ExecutorID& executorId,
       const ContainerID& containerId,
-      bool strict);
+      bool strict,
+      const Checkpoints& checkpoints);
 
   Option<ContainerID> id;
   hashmap<TaskID, TaskState> tasks;
@@ -150,6 +192,10 @@ struct RunState
   Option<process::UPID> libprocessPid;
   bool completed; // Executor terminated and all its updates acknowledged.
   unsigned int errors;
+
+  // The sandbox of the run. This is not checkpointed, it is set by
+  // the containerizer before recovering the run's container.
+  Option<std::string> directory;
 };
 
 
@@ -164,7 +210,8 @@ struct TaskState
       const ExecutorID& executorId,
       const ContainerID& containerId,
       const TaskID& taskId,
-      bool strict);
+      bool strict,
+      const Checkpoints& checkpoints);
 
   TaskID id;
   Option<Task> info;
@@ -61,7 +61,7 @@ class StatusUpdateManagerProcess
   : public ProtobufProcess<StatusUpdateManagerProcess>
 {
 public:
-  StatusUpdateManagerProcess() {}
+  StatusUpdateManagerProcess() : batches(0) {}
   virtual ~StatusUpdateManagerProcess();
 
   // Explicitely use 'initialize' since we're overloading below.
@@ -115,6 +115,13 @@ private:
   // ACK (e.g updates from the executor).
   Timeout forward(const StatusUpdate& update, const Duration& duration);
 
+  // Sends the batched status updates, if any, to the master.
+  void _forward();
+
+  // Sends the batch once its interval elapsed, unless it was already
+  // sent because it was full.
+  void __forward(uint64_t batch);
+
   // Helper functions.
 
   // Creates a new status update stream (opening the updates file, if path is
@@ -139,6 +146,14 @@ private:
   Flags flags;
   PID<Slave> slave;
   hashmap<FrameworkID, hashmap<TaskID, StatusUpdateStream*> > streams;
+
+  // Status updates waiting to be sent to the master as a batch
+  // (only used if 'flags.status_update_batch_interval' is set).
+  StatusUpdatesMessage batch;
+
+  // Number of batches sent, used to tell whether the batch a timer
+  // was started for is the current one.
+  uint64_t batches;
 };
 
 
@@ -369,7 +384,25 @@ Timeout StatusUpdateManagerProcess::forward(
     const StatusUpdate& update,
     const Duration& duration)
 {
-  if (master) {
+  if (master && flags.status_update_batch_interval.isSome()) {
+    LOG(INFO) << "Batching status update " << update << " for " << master;
+
+    // Start a new batch if necessary, which gets sent when the batch
+    // interval elapses or once the batch is full, whichever is first.
+    if (batch.updates_size() == 0) {
+      delay(flags.status_update_batch_interval.get(),
+            self(),
+            &StatusUpdateManagerProcess::__forward,
+            batches);
+    }
+
+    batch.add_updates()->MergeFrom(update);
+    batch.add_pids(slave); // The ACK will be first received by the slave.
+
+    if (batch.updates_size() >= (int) MAX_STATUS_UPDATES_PER_BATCH) {
+      _forward();
+    }
+  } else if (master) {
     LOG(INFO) << "Forwarding status update " << update << " to " << master;
 
     StatusUpdateMessage message;
@@ -390,6 +423,39 @@ Timeout StatusUpdateManagerProcess::forward(
 }
 
 
+void StatusUpdateManagerProcess::_forward()
+{
+  if (batch.updates_size() == 0) {
+    return;
+  }
+
+  // NOTE: Any updates that don't make it to the master (e.g., because
+  // no master is elected anymore) get retried like individual ones.
+  if (master) {
+    LOG(INFO) << "Forwarding " << batch.updates_size()
+              << " status updates to " << master;
+
+    send(master, batch);
+  } else {
+    LOG(WARNING) << "Not forwarding " << batch.updates_size()
+                 << " status updates because no master is elected yet";
+  }
+
+  batch.Clear();
+  batches++;
+}
+
+
+void StatusUpdateManagerProcess::__forward(uint64_t _batch)
+{
+  if (_batch != batches) {
+    return; // The batch was already sent because it was full.
+  }
+
+  _forward();
+}
+
+
 Future<bool> StatusUpdateManagerProcess::acknowledgement(
     const TaskID& taskId,
     const FrameworkID& frameworkId,
@@ -47,6 +47,7 @@
 #include "messages/messages.hpp"
 
 #include "slave/flags.hpp"
+#include "slave/state.hpp"
 
 namespace mesos {
 namespace internal {
@@ -352,7 +353,7 @@ private:
         record.set_uuid(update.uuid());
       }
 
-      Try<Nothing> write = ::protobuf::write(fd.get(), record);
+      Try<Nothing> write = state::checkpoint(fd.get(), path.get(), record);
       if (write.isError()) {
         error = "Failed to write status update " + stringify(update) +
                 " to '" + path.get() + "': " + write.error();
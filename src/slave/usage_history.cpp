@@ -0,0 +1,580 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/stringify.hpp>
+
+#include "slave/usage_history.hpp"
+
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Reflection;
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// The number of rows of a chunk (unless fewer rows are kept).
+static const size_t CHUNK_ROWS = 64;
+
+
+// A metric missing from a sample is stored as NaN.
+static bool missing(double value)
+{
+  return value != value;
+}
+
+
+// Returns the numeric fields of ResourceStatistics, but the timestamp.
+static const vector<const FieldDescriptor*>& fields()
+{
+  static vector<const FieldDescriptor*>* fields = NULL;
+
+  if (fields == NULL) {
+    fields = new vector<const FieldDescriptor*>();
+
+    const google::protobuf::Descriptor* descriptor =
+      ResourceStatistics::descriptor();
+
+    for (int i = 0; i < descriptor->field_count(); i++) {
+      const FieldDescriptor* field = descriptor->field(i);
+
+      if (field->name() == "timestamp" || field->is_repeated()) {
+        continue;
+      }
+
+      switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+        case FieldDescriptor::CPPTYPE_FLOAT:
+        case FieldDescriptor::CPPTYPE_INT32:
+        case FieldDescriptor::CPPTYPE_INT64:
+        case FieldDescriptor::CPPTYPE_UINT32:
+        case FieldDescriptor::CPPTYPE_UINT64:
+          fields->push_back(field);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  return *fields;
+}
+
+
+// Returns the value of each metric of the statistics.
+static vector<double> values(const ResourceStatistics& statistics)
+{
+  const Reflection* reflection = statistics.GetReflection();
+
+  vector<double> values;
+  values.reserve(fields().size());
+
+  foreach (const FieldDescriptor* field, fields()) {
+    if (!reflection->HasField(statistics, field)) {
+      values.push_back(std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        values.push_back(reflection->GetDouble(statistics, field));
+        break;
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        values.push_back(reflection->GetFloat(statistics, field));
+        break;
+      case FieldDescriptor::CPPTYPE_INT32:
+        values.push_back(reflection->GetInt32(statistics, field));
+        break;
+      case FieldDescriptor::CPPTYPE_INT64:
+        values.push_back(reflection->GetInt64(statistics, field));
+        break;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        values.push_back(reflection->GetUInt32(statistics, field));
+        break;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        values.push_back(reflection->GetUInt64(statistics, field));
+        break;
+      default:
+        values.push_back(std::numeric_limits<double>::quiet_NaN());
+        break;
+    }
+  }
+
+  return values;
+}
+
+
+Try<UsageHistory::Aggregation> UsageHistory::parse(const string& aggregation)
+{
+  if (aggregation == "min") {
+    return MIN;
+  } else if (aggregation == "max") {
+    return MAX;
+  } else if (aggregation == "avg") {
+    return AVERAGE;
+  } else if (aggregation == "last") {
+    return LAST;
+  }
+
+  return Error("Unknown aggregation '" + aggregation + "'");
+}
+
+
+vector<string> UsageHistory::metrics()
+{
+  vector<string> metrics;
+  foreach (const FieldDescriptor* field, fields()) {
+    metrics.push_back(field->name());
+  }
+  return metrics;
+}
+
+
+UsageHistory::UsageHistory(
+    size_t capacity,
+    const map<Duration, size_t>& _rollups)
+  : samples(capacity, fields().size())
+{
+  foreachpair (const Duration& resolution, size_t count, _rollups) {
+    rollups.push_back(Rollup(resolution, count, fields().size()));
+  }
+}
+
+
+void UsageHistory::add(const ResourceStatistics& statistics)
+{
+  const vector<double>& values = slave::values(statistics);
+
+  samples.append(statistics.timestamp(), values);
+
+  foreach (Rollup& rollup, rollups) {
+    rollup.add(statistics.timestamp(), values);
+  }
+}
+
+
+Try<vector<pair<double, double> > > UsageHistory::query(
+    const string& metric,
+    const Duration& resolution,
+    Aggregation aggregation,
+    const Option<double>& start,
+    const Option<double>& end) const
+{
+  const vector<string>& metrics = UsageHistory::metrics();
+
+  vector<string>::const_iterator iterator =
+    std::find(metrics.begin(), metrics.end(), metric);
+
+  if (iterator == metrics.end()) {
+    return Error("Unknown metric '" + metric + "'");
+  }
+
+  size_t index = iterator - metrics.begin();
+
+  // Determine the series and column to read from.
+  const Series* series = NULL;
+  const Rollup* current = NULL;
+  size_t column = index;
+
+  if (resolution == Duration::zero()) {
+    series = &samples;
+  } else {
+    foreach (const Rollup& rollup, rollups) {
+      if (rollup.resolution == resolution) {
+        series = &rollup.series;
+        current = &rollup;
+        column = index * 4 + aggregation;
+        break;
+      }
+    }
+
+    if (series == NULL) {
+      return Error("Unknown resolution '" + stringify(resolution) + "'");
+    }
+  }
+
+  vector<pair<double, double> > result;
+
+  foreach (const Chunk& chunk, series->chunks) {
+    const vector<double>& times = chunk.times();
+    const vector<double>& values = chunk.values(column);
+
+    for (size_t i = 0; i < chunk.count; i++) {
+      if ((start.isSome() && times[i] < start.get()) ||
+          (end.isSome() && times[i] > end.get()) ||
+          missing(values[i])) {
+        continue;
+      }
+
+      result.push_back(std::make_pair(times[i], values[i]));
+    }
+  }
+
+  // Include the interval that is not over yet.
+  if (current != NULL && current->start.isSome()) {
+    double time = current->start.get();
+    double value = current->values()[column];
+
+    if ((start.isNone() || time >= start.get()) &&
+        (end.isNone() || time <= end.get()) &&
+        !missing(value)) {
+      result.push_back(std::make_pair(time, value));
+    }
+  }
+
+  return result;
+}
+
+
+// Returns the memory a string allocated, if any: short strings are
+// stored within the string itself by some implementations.
+static size_t allocated(const string& s)
+{
+  const char* data = s.data();
+
+  if (data >= (const char*) &s && data < (const char*) (&s + 1)) {
+    return 0;
+  }
+
+  return s.capacity();
+}
+
+
+size_t UsageHistory::bytes() const
+{
+  vector<const Series*> series;
+  series.push_back(&samples);
+
+  size_t bytes = sizeof(*this);
+
+  foreach (const Rollup& rollup, rollups) {
+    series.push_back(&rollup.series);
+
+    // The aggregated samples of the current interval.
+    bytes += sizeof(rollup) + rollup.counts.size() *
+      (sizeof(size_t) + 4 * sizeof(double));
+  }
+
+  foreach (const Series* s, series) {
+    foreach (const Chunk& chunk, s->chunks) {
+      bytes += sizeof(chunk) +
+        allocated(chunk.timestamps) +
+        allocated(chunk.data) +
+        chunk.ends.capacity() * sizeof(uint32_t) +
+        chunk.encoders.capacity() * sizeof(Encoder);
+
+      foreach (const string& column, chunk.columns) {
+        bytes += sizeof(column) + allocated(column);
+      }
+    }
+  }
+
+  return bytes;
+}
+
+
+// Returns the bits of a value.
+static uint64_t bits(double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+
+void UsageHistory::Encoder::append(double value, string* data)
+{
+  uint64_t delta = bits(value) ^ bits(previous + difference);
+
+  advance(value);
+
+  // Values that were predicted are counted in a run, up to 128 of
+  // them per header byte.
+  if (delta == 0) {
+    if (run != string::npos && (uint8_t) (*data)[run] < 0xFF) {
+      (*data)[run]++;
+    } else {
+      run = data->size();
+      data->push_back((char) 0x80);
+    }
+    return;
+  }
+
+  run = string::npos;
+
+  // Count the zero bytes on each side, out of 8.
+  int leading = 0;
+  while (leading < 7 && ((delta >> (56 - 8 * leading)) & 0xFF) == 0) {
+    leading++;
+  }
+
+  int trailing = 0;
+  while (trailing < 7 - leading && ((delta >> (8 * trailing)) & 0xFF) == 0) {
+    trailing++;
+  }
+
+  data->push_back((char) ((leading << 4) | trailing));
+
+  for (int i = 7 - leading; i >= trailing; i--) {
+    data->push_back((char) ((delta >> (8 * i)) & 0xFF));
+  }
+}
+
+
+void UsageHistory::Encoder::advance(double value)
+{
+  difference = value - previous;
+
+  // Missing (or infinite) values are predicted to stay as they are.
+  if (missing(difference)) {
+    difference = 0;
+  }
+
+  previous = value;
+}
+
+
+vector<double> UsageHistory::decode(const char* data, size_t size)
+{
+  vector<double> values;
+
+  // Replay the predictions made while encoding.
+  Encoder encoder;
+  size_t offset = 0;
+
+  while (offset < size) {
+    uint8_t header = data[offset++];
+
+    double value;
+
+    if (header & 0x80) {
+      for (int i = 0; i <= (header & 0x7F); i++) {
+        value = encoder.previous + encoder.difference;
+        encoder.advance(value);
+        values.push_back(value);
+      }
+      continue;
+    }
+
+    int leading = header >> 4;
+    int trailing = header & 0x0F;
+
+    uint64_t delta = 0;
+    for (int i = 7 - leading; i >= trailing; i--) {
+      delta |= (uint64_t) (uint8_t) data[offset++] << (8 * i);
+    }
+
+    delta ^= bits(encoder.previous + encoder.difference);
+    memcpy(&value, &delta, sizeof(value));
+
+    encoder.advance(value);
+    values.push_back(value);
+  }
+
+  return values;
+}
+
+
+void UsageHistory::Chunk::append(double time, const vector<double>& values)
+{
+  CHECK_EQ(columns.size(), values.size());
+
+  // Store the change of interval, zigzag encoded (so that small
+  // negative numbers take few bytes too) in 7 bits per byte.
+  int64_t milliseconds = llround(time * 1000);
+  int64_t interval = milliseconds - this->time;
+  int64_t change = interval - this->interval;
+
+  this->time = milliseconds;
+  this->interval = interval;
+
+  uint64_t encoded = (change << 1) ^ (change >> 63);
+  while (encoded >= 0x80) {
+    timestamps.push_back((char) (encoded | 0x80));
+    encoded >>= 7;
+  }
+  timestamps.push_back((char) encoded);
+
+  for (size_t i = 0; i < values.size(); i++) {
+    encoders[i].append(values[i], &columns[i]);
+  }
+
+  count++;
+}
+
+
+vector<double> UsageHistory::Chunk::times() const
+{
+  vector<double> times;
+  times.reserve(count);
+
+  int64_t time = 0;
+  int64_t interval = 0;
+  size_t offset = 0;
+
+  while (offset < timestamps.size()) {
+    uint64_t encoded = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+      byte = timestamps[offset++];
+      encoded |= (uint64_t) (byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    int64_t change = (int64_t) (encoded >> 1) ^ -(int64_t) (encoded & 1);
+
+    interval += change;
+    time += interval;
+
+    times.push_back(time / 1000.0);
+  }
+
+  return times;
+}
+
+
+void UsageHistory::Chunk::seal()
+{
+  // Strings grow by doubling their capacity, trim it.
+  string(timestamps).swap(timestamps);
+
+  // A string per column takes more memory than the values of a
+  // column often do, hence the columns are packed together.
+  ends.reserve(columns.size());
+  foreach (const string& column, columns) {
+    data.append(column);
+    ends.push_back(data.size());
+  }
+
+  string(data).swap(data);
+
+  // No more rows get appended.
+  vector<string>().swap(columns);
+  vector<Encoder>().swap(encoders);
+}
+
+
+vector<double> UsageHistory::Chunk::values(size_t column) const
+{
+  if (!columns.empty()) {
+    return decode(columns[column].data(), columns[column].size());
+  }
+
+  size_t start = column == 0 ? 0 : ends[column - 1];
+
+  return decode(data.data() + start, ends[column] - start);
+}
+
+
+void UsageHistory::Series::append(double time, const vector<double>& values)
+{
+  const size_t rows = std::max<size_t>(1, std::min(capacity, CHUNK_ROWS));
+
+  if (chunks.empty() || chunks.back().count >= rows) {
+    if (!chunks.empty()) {
+      chunks.back().seal();
+    }
+    chunks.push_back(Chunk(width));
+  }
+
+  chunks.back().append(time, values);
+  count++;
+
+  // Drop the oldest chunk once the others hold enough rows.
+  while (!chunks.empty() && count - chunks.front().count >= capacity) {
+    count -= chunks.front().count;
+    chunks.pop_front();
+  }
+}
+
+
+void UsageHistory::Rollup::add(double time, const vector<double>& values)
+{
+  double interval = resolution.secs();
+  double start = floor(time / interval) * interval;
+
+  // Store the rollup of the previous interval once it is over.
+  if (this->start.isSome() && this->start.get() != start) {
+    series.append(this->start.get(), this->values());
+    std::fill(counts.begin(), counts.end(), 0);
+  }
+
+  this->start = start;
+
+  for (size_t i = 0; i < values.size(); i++) {
+    if (missing(values[i])) {
+      continue;
+    }
+
+    if (counts[i] == 0) {
+      mins[i] = maxs[i] = sums[i] = values[i];
+    } else {
+      mins[i] = std::min(mins[i], values[i]);
+      maxs[i] = std::max(maxs[i], values[i]);
+      sums[i] += values[i];
+    }
+
+    lasts[i] = values[i];
+    counts[i]++;
+  }
+}
+
+
+vector<double> UsageHistory::Rollup::values() const
+{
+  vector<double> values(counts.size() * 4);
+
+  for (size_t i = 0; i < counts.size(); i++) {
+    if (counts[i] == 0) {
+      std::fill(
+          values.begin() + i * 4,
+          values.begin() + (i + 1) * 4,
+          std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+
+    values[i * 4 + MIN] = mins[i];
+    values[i * 4 + MAX] = maxs[i];
+    values[i * 4 + AVERAGE] = sums[i] / counts[i];
+    values[i * 4 + LAST] = lasts[i];
+  }
+
+  return values;
+}
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
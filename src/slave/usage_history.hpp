@@ -0,0 +1,209 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SLAVE_USAGE_HISTORY_HPP__
+#define __SLAVE_USAGE_HISTORY_HPP__
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace slave {
+
+// Stores the resource usage (ResourceStatistics) of a container
+// over time, compactly: each numeric field of the statistics (a
+// "metric") is stored in a column of its own, each value encoded
+// as its difference (XOR) from a prediction based on the previous
+// values, which takes few bytes for the steadily changing values of
+// a container. The last samples are kept as collected, older usage
+// only as rollups (minimum, maximum, average and last value) over
+// longer intervals, e.g., 1 minute, 1 hour and 1 day.
+class UsageHistory
+{
+public:
+  enum Aggregation
+  {
+    MIN,
+    MAX,
+    AVERAGE,
+    LAST
+  };
+
+  static Try<Aggregation> parse(const std::string& aggregation);
+
+  // Returns the names of the metrics.
+  static std::vector<std::string> metrics();
+
+  // Keeps (at least) the last 'capacity' samples and, for each of
+  // the 'rollups' intervals, the rollups of (at least) that many of
+  // the last intervals.
+  UsageHistory(
+      size_t capacity,
+      const std::map<Duration, size_t>& rollups);
+
+  // Adds a sample, which must be more recent than the previous ones.
+  void add(const ResourceStatistics& statistics);
+
+  // Returns the (timestamp, value) pairs of the metric between
+  // 'start' and 'end' (inclusive, in seconds since the Epoch), as
+  // sampled if 'resolution' is zero or else aggregated over the
+  // rollup intervals of that length, the last of which may not be
+  // over yet. The timestamp of a rollup is the start of its interval.
+  Try<std::vector<std::pair<double, double> > > query(
+      const std::string& metric,
+      const Duration& resolution,
+      Aggregation aggregation,
+      const Option<double>& start = None(),
+      const Option<double>& end = None()) const;
+
+  // Returns (roughly) the memory used by the history, in bytes.
+  size_t bytes() const;
+
+private:
+  // Encodes the values of a column one after the other. Each value
+  // is predicted to change as much as the previous one did, which
+  // holds (almost) exactly for steadily growing counters and
+  // constants, and is stored as the XOR of its bits with those of
+  // the prediction, less the leading and trailing zero bytes,
+  // preceded by a byte holding the number of zero bytes left out. A
+  // run of values that match their predictions is stored as a single
+  // byte holding the length of the run.
+  struct Encoder
+  {
+    Encoder() : previous(0), difference(0), run(std::string::npos) {}
+
+    void append(double value, std::string* data);
+
+    // Updates the prediction once a value has been appended.
+    void advance(double value);
+
+    double previous;
+    double difference;
+
+    // The offset of the header of the current run, if any.
+    size_t run;
+  };
+
+  // Decodes the values of a column.
+  static std::vector<double> decode(const char* data, size_t size);
+
+  // A fixed number of rows, each a timestamp and a value per column.
+  // The timestamps are stored (in milliseconds) as the difference
+  // between consecutive intervals, in as few bytes as needed, which
+  // for periodic samples is a single byte.
+  struct Chunk
+  {
+    explicit Chunk(size_t width)
+      : count(0), columns(width), encoders(width), time(0), interval(0) {}
+
+    void append(double time, const std::vector<double>& values);
+
+    // Decodes the timestamps.
+    std::vector<double> times() const;
+
+    // Decodes the values of a column.
+    std::vector<double> values(size_t column) const;
+
+    // Releases the memory held for appending rows, and packs the
+    // columns into 'data'.
+    void seal();
+
+    size_t count;
+    std::string timestamps;
+
+    // The columns while rows get appended.
+    std::vector<std::string> columns;
+    std::vector<Encoder> encoders;
+
+    // The columns once sealed, one after the other, and the offset
+    // of the end of each.
+    std::string data;
+    std::vector<uint32_t> ends;
+
+    int64_t time;
+    int64_t interval;
+  };
+
+  // The rows kept at a given resolution, in chunks that are dropped
+  // once they are no longer needed to keep 'capacity' rows.
+  struct Series
+  {
+    Series(size_t _capacity, size_t _width)
+      : capacity(_capacity), width(_width), count(0) {}
+
+    void append(double time, const std::vector<double>& values);
+
+    size_t capacity;
+    size_t width;
+    size_t count;
+    std::deque<Chunk> chunks;
+  };
+
+  // The rollups over intervals of a given length, along with the
+  // aggregated samples of the current interval.
+  struct Rollup
+  {
+    Rollup(const Duration& _resolution, size_t capacity, size_t metrics)
+      : resolution(_resolution),
+        series(capacity, metrics * 4),
+        start(None()),
+        counts(metrics, 0),
+        mins(metrics),
+        maxs(metrics),
+        sums(metrics),
+        lasts(metrics) {}
+
+    void add(double time, const std::vector<double>& values);
+
+    // Returns the aggregated values of the current interval, i.e.,
+    // the minimum, maximum, average and last value of each metric.
+    std::vector<double> values() const;
+
+    Duration resolution;
+    Series series;
+
+    // The start of the current interval, if any.
+    Option<double> start;
+    std::vector<size_t> counts;
+    std::vector<double> mins;
+    std::vector<double> maxs;
+    std::vector<double> sums;
+    std::vector<double> lasts;
+  };
+
+  Series samples;
+  std::vector<Rollup> rollups;
+};
+
+} // namespace slave {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __SLAVE_USAGE_HISTORY_HPP__
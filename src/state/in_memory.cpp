@@ -1,10 +1,12 @@
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/process.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/option.hpp>
 #include <stout/uuid.hpp>
@@ -16,6 +18,7 @@
 
 using namespace process;
 
+using std::pair;
 using std::string;
 using std::vector;
 
@@ -44,6 +47,26 @@ public:
     return true;
   }
 
+  bool batch(const vector<pair<Entry, UUID> >& _entries)
+  {
+    typedef pair<Entry, UUID> Swap;
+
+    foreach (const Swap& swap, _entries) {
+      const Option<Entry>& option = entries.get(swap.first.name());
+
+      if (option.isSome() &&
+          UUID::fromBytes(option.get().uuid()) != swap.second) {
+        return false;
+      }
+    }
+
+    foreach (const Swap& swap, _entries) {
+      entries.put(swap.first.name(), swap.first);
+    }
+
+    return true;
+  }
+
   bool expunge(const Entry& entry)
   {
     const Option<Entry>& option = entries.get(entry.name());
@@ -99,6 +122,12 @@ Future<bool> InMemoryStorage::set(const Entry& entry, const UUID& uuid)
 }
 
 
+Future<bool> InMemoryStorage::batch(const vector<pair<Entry, UUID> >& entries)
+{
+  return dispatch(process, &InMemoryStorageProcess::batch, entries);
+}
+
+
 Future<bool> InMemoryStorage::expunge(const Entry& entry)
 {
   return dispatch(process, &InMemoryStorageProcess::expunge, entry);
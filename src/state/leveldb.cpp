@@ -1,10 +1,12 @@
 #include <leveldb/db.h>
+#include <leveldb/write_batch.h>
 
 #include <google/protobuf/message.h>
 
 #include <google/protobuf/io/zero_copy_stream_impl.h> // For ArrayInputStream.
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/dispatch.hpp>
@@ -12,6 +14,7 @@
 #include <process/process.hpp>
 
 #include <stout/error.hpp>
+#include <stout/foreach.hpp>
 #include <stout/none.hpp>
 #include <stout/option.hpp>
 #include <stout/some.hpp>
@@ -27,6 +30,7 @@
 
 using namespace process;
 
+using std::pair;
 using std::string;
 using std::vector;
 
@@ -46,6 +50,7 @@ public:
   // Storage implementation.
   Future<Option<Entry> > get(const string& name);
   Future<bool> set(const Entry& entry, const UUID& uuid);
+  Future<bool> batch(const vector<pair<Entry, UUID> >& entries);
   Future<bool> expunge(const Entry& entry);
   Future<vector<string> > names();
 
@@ -162,6 +167,55 @@ Future<bool> LevelDBStorageProcess::set(const Entry& entry, const UUID& uuid)
 }
 
 
+Future<bool> LevelDBStorageProcess::batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  if (error.isSome()) {
+    return Failure(error.get());
+  }
+
+  leveldb::WriteBatch batch;
+
+  typedef pair<Entry, UUID> Swap;
+
+  foreach (const Swap& swap, entries) {
+    // See comment in 'set' about doing a read first.
+    Try<Option<Entry> > option = read(swap.first.name());
+
+    if (option.isError()) {
+      return Failure(option.error());
+    }
+
+    if (option.get().isSome()) {
+      if (UUID::fromBytes(option.get().get().uuid()) != swap.second) {
+        return false;
+      }
+    }
+
+    string value;
+
+    if (!swap.first.SerializeToString(&value)) {
+      return Failure("Failed to serialize Entry");
+    }
+
+    batch.Put(swap.first.name(), value);
+  }
+
+  // All of the entries get written (and synced) at once, see comment
+  // in 'set' about atomicity with respect to the reads.
+  leveldb::WriteOptions options;
+  options.sync = true;
+
+  leveldb::Status status = db->Write(options, &batch);
+
+  if (!status.ok()) {
+    return Failure(status.ToString());
+  }
+
+  return true;
+}
+
+
 Future<bool> LevelDBStorageProcess::expunge(const Entry& entry)
 {
   if (error.isSome()) {
@@ -281,6 +335,12 @@ Future<bool> LevelDBStorage::set(const Entry& entry, const UUID& uuid)
 }
 
 
+Future<bool> LevelDBStorage::batch(const vector<pair<Entry, UUID> >& entries)
+{
+  return dispatch(process, &LevelDBStorageProcess::batch, entries);
+}
+
+
 Future<bool> LevelDBStorage::expunge(const Entry& entry)
 {
   return dispatch(process, &LevelDBStorageProcess::expunge, entry);
@@ -2,6 +2,7 @@
 #define __STATE_LEVELDB_HPP__
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/future.hpp>
@@ -31,6 +32,8 @@ public:
   // Storage implementation.
   virtual process::Future<Option<Entry> > get(const std::string& name);
   virtual process::Future<bool> set(const Entry& entry, const UUID& uuid);
+  virtual process::Future<bool> batch(
+      const std::vector<std::pair<Entry, UUID> >& entries);
   virtual process::Future<bool> expunge(const Entry& entry);
   virtual process::Future<std::vector<std::string> > names();
 
@@ -0,0 +1,594 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <process/defer.hpp>
+#include <process/delay.hpp>
+#include <process/dispatch.hpp>
+#include <process/future.hpp>
+#include <process/owned.hpp>
+#include <process/process.hpp>
+#include <process/sequence.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+#include <stout/none.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/some.hpp>
+#include <stout/stringify.hpp>
+#include <stout/try.hpp>
+#include <stout/uuid.hpp>
+
+#include "log/log.hpp"
+
+#include "logging/logging.hpp"
+
+#include "messages/messages.hpp"
+#include "messages/state.hpp"
+
+#include "state/log.hpp"
+#include "state/storage.hpp"
+
+using namespace mesos::internal::log;
+using namespace process;
+
+using std::list;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace state {
+
+// The bounds of the delay before trying to start the writer again
+// while another writer holds the promise (see '_start').
+static const Duration MIN_START_BACKOFF = Milliseconds(100);
+static const Duration MAX_START_BACKOFF = Seconds(10);
+
+
+class LogStorageProcess : public Process<LogStorageProcess>
+{
+public:
+  LogStorageProcess(Log* log, size_t interval);
+  virtual ~LogStorageProcess() {}
+
+  // Storage implementation.
+  Future<Option<Entry> > get(const string& name);
+  Future<bool> set(const Entry& entry, const UUID& uuid);
+  Future<bool> batch(const vector<pair<Entry, UUID> >& entries);
+  Future<bool> expunge(const Entry& entry);
+  Future<vector<string> > names();
+
+private:
+  // Continuations, invoked in order (via 'sequence').
+  Future<Option<Entry> > _get(const string& name);
+  Future<Option<Entry> > __get(const string& name);
+
+  Future<bool> _set(const Entry& entry, const UUID& uuid);
+  Future<bool> __set(const Entry& entry, const UUID& uuid);
+  Future<bool> ___set(
+      const Entry& entry,
+      const Option<Log::Position>& position);
+
+  Future<bool> _batch(const vector<pair<Entry, UUID> >& entries);
+  Future<bool> __batch(const vector<pair<Entry, UUID> >& entries);
+  Future<bool> ___batch(
+      const vector<pair<Entry, UUID> >& entries,
+      const Option<Log::Position>& position);
+
+  Future<bool> _expunge(const Entry& entry);
+  Future<bool> __expunge(const Entry& entry);
+  Future<bool> ___expunge(
+      const Entry& entry,
+      const Option<Log::Position>& position);
+
+  Future<vector<string> > _names();
+  Future<vector<string> > __names();
+
+  // Acquires exclusive write access to the log (if not already held)
+  // and catches up the index on everything appended so far.
+  Future<Nothing> start();
+  Future<Nothing> _start(const Option<Log::Position>& ending);
+  void restart(const Owned<Promise<Nothing> >& promise);
+
+  // Helpers for catching up the index.
+  Future<Nothing> catchup(const Log::Position& ending);
+  Future<Nothing> _catchup(
+      const Log::Position& ending,
+      const Log::Position& beginning);
+  Future<Nothing> __catchup(
+      const Log::Position& ending,
+      const list<Log::Entry>& entries);
+
+  // Helpers for truncating the log.
+  Future<Nothing> truncate();
+  Nothing _truncate(const Option<Log::Position>& position);
+
+  // Invoked after appending an operation at 'position'.
+  void appended(const Log::Position& position);
+
+  // Invoked when the writer fails (or loses exclusive write access).
+  void failed(const string& message);
+
+  Log::Writer writer;
+  Log::Reader reader;
+
+  // Serializes all operations.
+  Sequence sequence;
+
+  const size_t interval;
+
+  // Number of appends since the last truncation.
+  size_t appends;
+
+  Option<Future<Nothing> > starting;
+
+  // The delay before the next attempt to start the writer.
+  Duration backoff;
+
+  // The latest version of each entry along with the position in the
+  // log that holds it.
+  struct Snapshot
+  {
+    Snapshot(const Log::Position& _position, const Entry& _entry)
+      : position(_position), entry(_entry) {}
+
+    Log::Position position;
+    Entry entry;
+  };
+
+  hashmap<string, Snapshot> snapshots;
+
+  // The last position of the log reflected in 'snapshots'.
+  Option<Log::Position> index;
+};
+
+
+LogStorageProcess::LogStorageProcess(Log* log, size_t _interval)
+  : writer(log),
+    reader(log),
+    interval(_interval),
+    appends(0),
+    backoff(MIN_START_BACKOFF) {}
+
+
+Future<Option<Entry> > LogStorageProcess::get(const string& name)
+{
+  return sequence.add<Option<Entry> >(defer(self(), &Self::_get, name));
+}
+
+
+Future<Option<Entry> > LogStorageProcess::_get(const string& name)
+{
+  return start()
+    .then(defer(self(), &Self::__get, name));
+}
+
+
+Future<Option<Entry> > LogStorageProcess::__get(const string& name)
+{
+  Option<Snapshot> snapshot = snapshots.get(name);
+
+  if (snapshot.isNone()) {
+    return None();
+  }
+
+  return Some(snapshot.get().entry);
+}
+
+
+Future<bool> LogStorageProcess::set(const Entry& entry, const UUID& uuid)
+{
+  return sequence.add<bool>(defer(self(), &Self::_set, entry, uuid));
+}
+
+
+Future<bool> LogStorageProcess::_set(const Entry& entry, const UUID& uuid)
+{
+  return start()
+    .then(defer(self(), &Self::__set, entry, uuid));
+}
+
+
+Future<bool> LogStorageProcess::__set(const Entry& entry, const UUID& uuid)
+{
+  Option<Snapshot> snapshot = snapshots.get(entry.name());
+
+  // Like the other storage implementations we allow setting an entry
+  // that doesn't exist yet regardless of the UUID.
+  if (snapshot.isSome() &&
+      UUID::fromBytes(snapshot.get().entry.uuid()) != uuid) {
+    return false;
+  }
+
+  Operation operation;
+  operation.set_type(Operation::SNAPSHOT);
+  operation.mutable_entry()->CopyFrom(entry);
+
+  Try<string> value = messages::serialize(operation);
+  if (value.isError()) {
+    return Failure("Failed to serialize operation: " + value.error());
+  }
+
+  return writer.append(value.get())
+    .onFailed(defer(self(), &Self::failed, lambda::_1))
+    .then(defer(self(), &Self::___set, entry, lambda::_1));
+}
+
+
+Future<bool> LogStorageProcess::___set(
+    const Entry& entry,
+    const Option<Log::Position>& position)
+{
+  if (position.isNone()) {
+    failed("Lost exclusive write access to the log");
+    return Failure("Lost exclusive write access to the log");
+  }
+
+  snapshots.put(entry.name(), Snapshot(position.get(), entry));
+
+  appended(position.get());
+
+  return true;
+}
+
+
+Future<bool> LogStorageProcess::batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  return sequence.add<bool>(defer(self(), &Self::_batch, entries));
+}
+
+
+Future<bool> LogStorageProcess::_batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  return start()
+    .then(defer(self(), &Self::__batch, entries));
+}
+
+
+Future<bool> LogStorageProcess::__batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  Operation operation;
+  operation.set_type(Operation::BATCH);
+
+  typedef pair<Entry, UUID> Swap;
+
+  foreach (const Swap& swap, entries) {
+    Option<Snapshot> snapshot = snapshots.get(swap.first.name());
+
+    // See comment in '__set' about entries that don't exist yet.
+    if (snapshot.isSome() &&
+        UUID::fromBytes(snapshot.get().entry.uuid()) != swap.second) {
+      return false;
+    }
+
+    operation.add_entries()->CopyFrom(swap.first);
+  }
+
+  Try<string> value = messages::serialize(operation);
+  if (value.isError()) {
+    return Failure("Failed to serialize operation: " + value.error());
+  }
+
+  return writer.append(value.get())
+    .onFailed(defer(self(), &Self::failed, lambda::_1))
+    .then(defer(self(), &Self::___batch, entries, lambda::_1));
+}
+
+
+Future<bool> LogStorageProcess::___batch(
+    const vector<pair<Entry, UUID> >& entries,
+    const Option<Log::Position>& position)
+{
+  if (position.isNone()) {
+    failed("Lost exclusive write access to the log");
+    return Failure("Lost exclusive write access to the log");
+  }
+
+  typedef pair<Entry, UUID> Swap;
+
+  foreach (const Swap& swap, entries) {
+    snapshots.put(swap.first.name(), Snapshot(position.get(), swap.first));
+  }
+
+  appended(position.get());
+
+  return true;
+}
+
+
+Future<bool> LogStorageProcess::expunge(const Entry& entry)
+{
+  return sequence.add<bool>(defer(self(), &Self::_expunge, entry));
+}
+
+
+Future<bool> LogStorageProcess::_expunge(const Entry& entry)
+{
+  return start()
+    .then(defer(self(), &Self::__expunge, entry));
+}
+
+
+Future<bool> LogStorageProcess::__expunge(const Entry& entry)
+{
+  Option<Snapshot> snapshot = snapshots.get(entry.name());
+
+  if (snapshot.isNone()) {
+    return false;
+  }
+
+  if (UUID::fromBytes(snapshot.get().entry.uuid()) !=
+      UUID::fromBytes(entry.uuid())) {
+    return false;
+  }
+
+  Operation operation;
+  operation.set_type(Operation::EXPUNGE);
+  operation.set_name(entry.name());
+
+  Try<string> value = messages::serialize(operation);
+  if (value.isError()) {
+    return Failure("Failed to serialize operation: " + value.error());
+  }
+
+  return writer.append(value.get())
+    .onFailed(defer(self(), &Self::failed, lambda::_1))
+    .then(defer(self(), &Self::___expunge, entry, lambda::_1));
+}
+
+
+Future<bool> LogStorageProcess::___expunge(
+    const Entry& entry,
+    const Option<Log::Position>& position)
+{
+  if (position.isNone()) {
+    failed("Lost exclusive write access to the log");
+    return Failure("Lost exclusive write access to the log");
+  }
+
+  snapshots.erase(entry.name());
+
+  appended(position.get());
+
+  return true;
+}
+
+
+Future<vector<string> > LogStorageProcess::names()
+{
+  return sequence.add<vector<string> >(defer(self(), &Self::_names));
+}
+
+
+Future<vector<string> > LogStorageProcess::_names()
+{
+  return start()
+    .then(defer(self(), &Self::__names));
+}
+
+
+Future<vector<string> > LogStorageProcess::__names()
+{
+  const hashset<string>& keys = snapshots.keys();
+  return vector<string>(keys.begin(), keys.end());
+}
+
+
+Future<Nothing> LogStorageProcess::start()
+{
+  // (Re)start the writer unless it's started or being started.
+  if (starting.isNone() || starting.get().isFailed()) {
+    starting = writer.start()
+      .then(defer(self(), &Self::_start, lambda::_1));
+  }
+
+  return starting.get();
+}
+
+
+Future<Nothing> LogStorageProcess::_start(
+    const Option<Log::Position>& ending)
+{
+  if (ending.isNone()) {
+    // Another writer holds the promise, so we retry after a random
+    // delay in [backoff, 2 * backoff), doubling the backoff each time,
+    // rather than right away which would keep preempting that writer
+    // (and flooding the replicas).
+    Duration d = backoff * (1.0 + (double) ::random() / RAND_MAX);
+    backoff = std::min(backoff * 2, MAX_START_BACKOFF);
+
+    Owned<Promise<Nothing> > promise(new Promise<Nothing>());
+    delay(d, self(), &Self::restart, promise);
+    return promise->future();
+  }
+
+  backoff = MIN_START_BACKOFF;
+
+  return catchup(ending.get());
+}
+
+
+void LogStorageProcess::restart(const Owned<Promise<Nothing> >& promise)
+{
+  promise->associate(writer.start()
+    .then(defer(self(), &Self::_start, lambda::_1)));
+}
+
+
+Future<Nothing> LogStorageProcess::catchup(const Log::Position& ending)
+{
+  return reader.beginning()
+    .then(defer(self(), &Self::_catchup, ending, lambda::_1));
+}
+
+
+Future<Nothing> LogStorageProcess::_catchup(
+    const Log::Position& ending,
+    const Log::Position& beginning)
+{
+  // If the log has been truncated beyond our index (by another
+  // writer) we can no longer tell which entries have been expunged,
+  // so we rebuild the index from the beginning of the log.
+  if (index.isNone() || index.get() < beginning) {
+    snapshots.clear();
+    index = beginning;
+  }
+
+  return reader.read(index.get(), ending)
+    .then(defer(self(), &Self::__catchup, ending, lambda::_1));
+}
+
+
+Future<Nothing> LogStorageProcess::__catchup(
+    const Log::Position& ending,
+    const list<Log::Entry>& entries)
+{
+  foreach (const Log::Entry& entry, entries) {
+    Try<Operation> operation = messages::deserialize<Operation>(entry.data);
+
+    if (operation.isError()) {
+      return Failure("Failed to deserialize operation: " + operation.error());
+    }
+
+    switch (operation.get().type()) {
+      case Operation::SNAPSHOT: {
+        CHECK(operation.get().has_entry());
+        const Entry& snapshot = operation.get().entry();
+        snapshots.put(snapshot.name(), Snapshot(entry.position, snapshot));
+        break;
+      }
+      case Operation::BATCH: {
+        foreach (const Entry& snapshot, operation.get().entries()) {
+          snapshots.put(snapshot.name(), Snapshot(entry.position, snapshot));
+        }
+        break;
+      }
+      case Operation::EXPUNGE: {
+        CHECK(operation.get().has_name());
+        snapshots.erase(operation.get().name());
+        break;
+      }
+      default:
+        return Failure(
+            "Unknown operation type " + stringify(operation.get().type()));
+    }
+  }
+
+  index = ending;
+
+  return Nothing();
+}
+
+
+void LogStorageProcess::appended(const Log::Position& position)
+{
+  index = position;
+
+  if (++appends >= interval) {
+    appends = 0;
+    sequence.add<Nothing>(defer(self(), &Self::truncate));
+  }
+}
+
+
+Future<Nothing> LogStorageProcess::truncate()
+{
+  if (index.isNone()) {
+    return Nothing();
+  }
+
+  // Everything before the oldest position still holding the latest
+  // version of some entry is no longer needed.
+  Log::Position position = index.get();
+
+  foreachvalue (const Snapshot& snapshot, snapshots) {
+    if (snapshot.position < position) {
+      position = snapshot.position;
+    }
+  }
+
+  return writer.truncate(position)
+    .onFailed(defer(self(), &Self::failed, lambda::_1))
+    .then(defer(self(), &Self::_truncate, lambda::_1));
+}
+
+
+Nothing LogStorageProcess::_truncate(const Option<Log::Position>& position)
+{
+  if (position.isNone()) {
+    failed("Lost exclusive write access to the log");
+  }
+
+  return Nothing();
+}
+
+
+void LogStorageProcess::failed(const string& message)
+{
+  LOG(WARNING) << "Log storage failed to write: " << message;
+
+  // Reacquire exclusive write access (and catch up) before the next
+  // operation.
+  starting = None();
+}
+
+
+LogStorage::LogStorage(Log* log, size_t interval)
+{
+  process = new LogStorageProcess(log, interval);
+  spawn(process);
+}
+
+
+LogStorage::~LogStorage()
+{
+  terminate(process);
+  wait(process);
+  delete process;
+}
+
+
+Future<Option<Entry> > LogStorage::get(const string& name)
+{
+  return dispatch(process, &LogStorageProcess::get, name);
+}
+
+
+Future<bool> LogStorage::set(const Entry& entry, const UUID& uuid)
+{
+  return dispatch(process, &LogStorageProcess::set, entry, uuid);
+}
+
+
+Future<bool> LogStorage::batch(const vector<pair<Entry, UUID> >& entries)
+{
+  return dispatch(process, &LogStorageProcess::batch, entries);
+}
+
+
+Future<bool> LogStorage::expunge(const Entry& entry)
+{
+  return dispatch(process, &LogStorageProcess::expunge, entry);
+}
+
+
+Future<vector<string> > LogStorage::names()
+{
+  return dispatch(process, &LogStorageProcess::names);
+}
+
+} // namespace state {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,57 @@
+#ifndef __STATE_LOG_HPP__
+#define __STATE_LOG_HPP__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <process/future.hpp>
+
+#include <stout/option.hpp>
+#include <stout/uuid.hpp>
+
+#include "log/log.hpp"
+
+#include "messages/state.hpp"
+
+#include "state/storage.hpp"
+
+namespace mesos {
+namespace internal {
+namespace state {
+
+// Forward declarations.
+class LogStorageProcess;
+
+
+// A storage implementation backed by the replicated log. Every set
+// (or expunge) appends the new version of the entry to the log while
+// an in-memory index of the latest version of each entry serves the
+// reads. Note that the index is only guaranteed to be up to date
+// while this storage holds exclusive write access to the log (which
+// it (re)acquires, catching up on the log, before any operation).
+class LogStorage : public Storage
+{
+public:
+  // Every 'interval' appends the log gets truncated up to the oldest
+  // position that still holds the latest version of some entry.
+  explicit LogStorage(log::Log* log, size_t interval = 100);
+  virtual ~LogStorage();
+
+  // Storage implementation.
+  virtual process::Future<Option<Entry> > get(const std::string& name);
+  virtual process::Future<bool> set(const Entry& entry, const UUID& uuid);
+  virtual process::Future<bool> batch(
+      const std::vector<std::pair<Entry, UUID> >& entries);
+  virtual process::Future<bool> expunge(const Entry& entry);
+  virtual process::Future<std::vector<std::string> > names();
+
+private:
+  LogStorageProcess* process;
+};
+
+} // namespace state {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __STATE_LOG_HPP__
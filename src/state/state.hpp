@@ -20,11 +20,14 @@
 #define __STATE_STATE_HPP__
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/deferred.hpp> // TODO(benh): This is required by Clang.
 #include <process/future.hpp>
 
+#include <stout/foreach.hpp>
+#include <stout/hashset.hpp>
 #include <stout/lambda.hpp>
 #include <stout/none.hpp>
 #include <stout/option.hpp>
@@ -107,6 +110,15 @@ public:
   // was no longer valid, or an error if one occurs.
   process::Future<Option<Variable> > store(const Variable& variable);
 
+  // Stores all of the variables as a single transaction, returning
+  // the variables specified if they were all successfully stored,
+  // otherwise none if the version of any one of them was no longer
+  // valid (in which case none of them were stored), or an error if
+  // one occurs. Use this rather than storing each variable in turn
+  // to pay for a single round trip to the storage.
+  process::Future<Option<std::vector<Variable> > > store(
+      const std::vector<Variable>& variables);
+
   // Returns true if successfully expunged the variable from the state.
   process::Future<bool> expunge(const Variable& variable);
 
@@ -125,6 +137,10 @@ private:
       const Entry& entry,
       const bool& b); // TODO(benh): Remove 'const &' after fixing libprocess.
 
+  static process::Future<Option<std::vector<Variable> > > _batch(
+      const std::vector<Entry>& entries,
+      const bool& b); // TODO(benh): Remove 'const &' after fixing libprocess.
+
   Storage* storage;
 };
 
@@ -183,6 +199,53 @@ inline process::Future<Option<Variable > > State::_store(
 }
 
 
+inline process::Future<Option<std::vector<Variable> > > State::store(
+    const std::vector<Variable>& variables)
+{
+  std::vector<std::pair<Entry, UUID> > swaps;
+  std::vector<Entry> entries;
+  hashset<std::string> names;
+
+  foreach (const Variable& variable, variables) {
+    if (names.contains(variable.entry.name())) {
+      return process::Failure(
+          "Variable '" + variable.entry.name() + "' is stored more than once");
+    }
+
+    names.insert(variable.entry.name());
+
+    // Like above, create a new entry to replace each existing entry.
+    Entry entry;
+    entry.set_name(variable.entry.name());
+    entry.set_uuid(UUID::random().toBytes());
+    entry.set_value(variable.entry.value());
+
+    swaps.push_back(
+        std::make_pair(entry, UUID::fromBytes(variable.entry.uuid())));
+    entries.push_back(entry);
+  }
+
+  return storage->batch(swaps)
+    .then(lambda::bind(&State::_batch, entries, lambda::_1));
+}
+
+
+inline process::Future<Option<std::vector<Variable> > > State::_batch(
+    const std::vector<Entry>& entries,
+    const bool& b) // TODO(benh): Remove 'const &' after fixing libprocess.
+{
+  if (b) {
+    std::vector<Variable> variables;
+    foreach (const Entry& entry, entries) {
+      variables.push_back(Variable(entry));
+    }
+    return Some(variables);
+  }
+
+  return None();
+}
+
+
 inline process::Future<bool> State::expunge(const Variable& variable)
 {
   return storage->expunge(variable.entry);
@@ -20,6 +20,7 @@
 #define __STATE_STORAGE_HPP__
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/future.hpp>
@@ -46,6 +47,13 @@ public:
   virtual process::Future<Option<Entry> > get(const std::string& name) = 0;
   virtual process::Future<bool> set(const Entry& entry, const UUID& uuid) = 0;
 
+  // Sets all of the entries as a single transaction, i.e., either
+  // every entry gets set (each requiring the existing entry to have
+  // the paired UUID, like 'set') or none of them do. Note that the
+  // names of the entries are expected to be unique.
+  virtual process::Future<bool> batch(
+      const std::vector<std::pair<Entry, UUID> >& entries) = 0;
+
   // Returns true if successfully expunged the variable from the state.
   virtual process::Future<bool> expunge(const Entry& entry) = 0;
 
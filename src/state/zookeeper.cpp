@@ -1,23 +1,31 @@
 #include <google/protobuf/message.h>
 
-#include <google/protobuf/io/zero_copy_stream_impl.h> // For ArrayInputStream.
-
+#include <list>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <process/collect.hpp>
+#include <process/defer.hpp>
+#include <process/delay.hpp>
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
+#include <process/owned.hpp>
 #include <process/process.hpp>
 
+#include <stout/check.hpp>
 #include <stout/duration.hpp>
-#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
 #include <stout/none.hpp>
+#include <stout/nothing.hpp>
 #include <stout/option.hpp>
-#include <stout/result.hpp>
 #include <stout/some.hpp>
+#include <stout/stringify.hpp>
 #include <stout/strings.hpp>
-#include <stout/try.hpp>
 #include <stout/uuid.hpp>
 
 #include "logging/logging.hpp"
@@ -33,6 +41,8 @@
 
 using namespace process;
 
+using std::list;
+using std::pair;
 using std::queue;
 using std::string;
 using std::vector;
@@ -43,6 +53,19 @@ namespace mesos {
 namespace internal {
 namespace state {
 
+// The maximum size of the data we store in a single znode. ZooKeeper
+// rejects requests bigger than 'jute.maxbuffer' (1 MB by default) so
+// this leaves some room for the rest of the request.
+static const size_t MAX_ZNODE_SIZE = 1000 * 1024;
+
+// Number of times an entry is fetched again when its chunks turn out to
+// have been removed (by a concurrent swap) before giving up.
+static const size_t MAX_GET_ATTEMPTS = 10;
+
+// Name of the znode (within the storage's znode) holding the chunks
+// of the entries that don't fit in a single znode (see ChunkedEntry).
+static const string CHUNKS = ".chunks";
+
 
 class ZooKeeperStorageProcess : public Process<ZooKeeperStorageProcess>
 {
@@ -59,6 +82,7 @@ public:
   // Storage implementation.
   Future<Option<Entry> > get(const string& name);
   Future<bool> set(const Entry& entry, const UUID& uuid);
+  Future<bool> batch(const vector<pair<Entry, UUID> >& entries);
   virtual Future<bool> expunge(const Entry& entry);
   Future<vector<string> > names();
 
@@ -71,11 +95,173 @@ public:
   void deleted(const string& path);
 
 private:
-  // Helpers for getting the names, fetching, and swapping.
-  Result<vector<string> > doNames();
-  Result<Option<Entry> > doGet(const string& name);
-  Result<bool> doSet(const Entry& entry, const UUID& uuid);
-  Result<bool> doExpunge(const Entry& entry);
+  // Interval after which we retry the pending operations when a
+  // request failed while we still thought we were connected.
+  static const Duration RETRY_INTERVAL;
+
+  // The latest version of an entry we know about along with the
+  // version of its znode (and its chunks, if any).
+  struct Snapshot
+  {
+    Snapshot(const Entry& _entry,
+             int _version,
+             const Option<ChunkedEntry>& _chunked,
+             bool _watched)
+      : entry(_entry),
+        version(_version),
+        chunked(_chunked),
+        watched(_watched) {}
+
+    Entry entry;
+    int version;
+    Option<ChunkedEntry> chunked;
+
+    // Whether a watch is set on the znode of the entry, i.e., whether
+    // we'll learn about this snapshot getting stale (and can thus use
+    // it to serve reads). Otherwise we can only use it to attempt a
+    // compare-and-swap as ZooKeeper checks the version for us.
+    bool watched;
+  };
+
+  // The data (and stat) of a znode, which must remain valid until the
+  // (asynchronous) request that fills it in completes.
+  struct Node
+  {
+    string data;
+    Stat stat;
+  };
+
+  // A multi-op transaction, which must likewise remain valid until
+  // it completes.
+  struct Transaction
+  {
+    string data;
+    vector<string> paths;
+    vector<zoo_op_t> ops;
+    vector<zoo_op_result_t> results;
+    Stat stat;
+  };
+
+  // The swaps of a batch, which are done as a single multi-op
+  // transaction (and must likewise remain valid until it completes).
+  struct Swaps
+  {
+    vector<pair<Entry, UUID> > entries;
+
+    // For each entry, the snapshot being swapped (if any), the data
+    // stored in the entry's znode and the chunks of the new version
+    // (if it didn't fit in the transaction).
+    vector<Option<Snapshot> > snapshots;
+    vector<string> data;
+    vector<Option<ChunkedEntry> > chunked;
+
+    // For each entry, the index of the operation on its znode (which
+    // is followed by the removal of the chunks of the snapshot).
+    vector<size_t> indexes;
+
+    vector<string> paths;
+    vector<zoo_op_t> ops;
+    vector<zoo_op_result_t> results;
+    vector<Stat> stats;
+  };
+
+  // Helpers for getting the names, fetching, and swapping, each of
+  // which issues its requests without waiting for the previous ones.
+  Future<vector<string> > doNames();
+  Future<vector<string> > _names(
+      const Owned<vector<string> >& results,
+      int code);
+
+  Future<Option<Entry> > doGet(const string& name, size_t attempts = 0);
+  Future<Option<Entry> > _get(
+      const string& name,
+      size_t attempts,
+      const Owned<Node>& node,
+      int code);
+  Future<Option<Entry> > __get(
+      const string& name,
+      size_t attempts,
+      const ChunkedEntry& chunked,
+      int version,
+      uint64_t generation,
+      const Owned<vector<string> >& chunks,
+      const list<int>& codes);
+
+  Future<bool> doSet(const Entry& entry, const UUID& uuid);
+  Future<bool> _set(
+      const Entry& entry,
+      const UUID& uuid,
+      const Option<Entry>& current);
+  Future<bool> __set(
+      const Entry& entry,
+      const UUID& uuid,
+      const Option<Snapshot>& snapshot,
+      const string& data,
+      const Option<ChunkedEntry>& chunked,
+      const list<int>& codes);
+  Future<bool> ___set(
+      const Entry& entry,
+      const UUID& uuid,
+      const Option<Snapshot>& snapshot,
+      const Option<ChunkedEntry>& chunked,
+      int code);
+
+  // Determines whether a swap whose outcome is unknown (e.g., because
+  // the connection was lost) was applied, given the current entry,
+  // and otherwise tries again.
+  Future<bool> settled(
+      const Entry& entry,
+      const UUID& uuid,
+      const Option<ChunkedEntry>& chunked,
+      const Option<Entry>& current);
+
+  Future<bool> doBatch(const vector<pair<Entry, UUID> >& entries);
+  Future<bool> _batch(
+      const vector<pair<Entry, UUID> >& entries,
+      const list<Option<Entry> >& currents);
+  Future<bool> __batch(const Owned<Swaps>& swaps, const list<int>& codes);
+  Future<bool> ___batch(const Owned<Swaps>& swaps, int code);
+
+  // See 'settled'.
+  Future<bool> batched(
+      const Owned<Swaps>& swaps,
+      const list<Option<Entry> >& currents);
+
+  Future<bool> doExpunge(const Entry& entry);
+  Future<bool> _expunge(const Entry& entry, const Option<Entry>& current);
+  Future<bool> __expunge(const Entry& entry, int code);
+
+  // Replaces the data of the znode of an entry with 'data' (or
+  // removes the znode if 'data' is none) provided it's still at the
+  // version of 'snapshot', atomically removing the chunks of that
+  // version (if any).
+  Future<int> replace(
+      const Snapshot& snapshot,
+      const Option<string>& data);
+  Future<int> _replace(const Owned<Transaction>& transaction, int code);
+
+  // Creates the storage's znode (including any missing parents) and
+  // the znode holding the chunks.
+  Future<Nothing> create();
+  Future<Nothing> _create(const list<int>& codes);
+
+  // Removes the chunks of a version of an entry that never made it
+  // into the entry's znode (ignoring any failures).
+  void discard(const ChunkedEntry& chunked);
+
+  // Returns the path of the znode holding the chunk at 'index'.
+  string chunk(const ChunkedEntry& chunked, size_t index);
+
+  // Returns true if a request failed but can be retried as is (once
+  // we're reconnected).
+  bool retryable(int code);
+
+  // Queues an operation until we're (re)connected.
+  template <typename T>
+  void pend(queue<T*>* queue, T* t);
+
+  // (Re)issues the pending operations.
+  void retry();
 
   const string servers;
 
@@ -97,6 +283,17 @@ private:
     CONNECTED,
   } state;
 
+  hashmap<string, Snapshot> snapshots;
+
+  // The names of the entries, while a watch is set on the children
+  // of 'znode'.
+  Option<hashset<string> > children;
+
+  // Incremented on every notification (from ZooKeeper) that might
+  // render a snapshot stale, so that a snapshot fetched over multiple
+  // requests is only considered watched if there were none meanwhile.
+  uint64_t generation;
+
   struct Names
   {
     Promise<vector<string> > promise;
@@ -119,6 +316,14 @@ private:
     Promise<bool> promise;
   };
 
+  struct Batch
+  {
+    Batch(const vector<pair<Entry, UUID> >& _entries) : entries(_entries) {}
+
+    vector<pair<Entry, UUID> > entries;
+    Promise<bool> promise;
+  };
+
   struct Expunge
   {
     Expunge(const Entry& _entry) : entry(_entry) {}
@@ -133,13 +338,20 @@ private:
     queue<Names*> names;
     queue<Get*> gets;
     queue<Set*> sets;
+    queue<Batch*> batches;
     queue<Expunge*> expunges;
   } pending;
 
+  // Indicates there is a pending delayed retry.
+  bool retrying;
+
   Option<string> error;
 };
 
 
+const Duration ZooKeeperStorageProcess::RETRY_INTERVAL = Seconds(2);
+
+
 // Helper for failing a queue of promises.
 template <typename T>
 void fail(queue<T*>* queue, const string& message)
@@ -167,7 +379,9 @@ ZooKeeperStorageProcess::ZooKeeperStorageProcess(
         : ZOO_OPEN_ACL_UNSAFE),
     watcher(NULL),
     zk(NULL),
-    state(DISCONNECTED)
+    state(DISCONNECTED),
+    generation(0),
+    retrying(false)
 {}
 
 
@@ -176,6 +390,8 @@ ZooKeeperStorageProcess::~ZooKeeperStorageProcess()
   fail(&pending.names, "No longer managing storage");
   fail(&pending.gets, "No longer managing storage");
   fail(&pending.sets, "No longer managing storage");
+  fail(&pending.batches, "No longer managing storage");
+  fail(&pending.expunges, "No longer managing storage");
 
   delete zk;
   delete watcher;
@@ -195,23 +411,12 @@ Future<vector<string> > ZooKeeperStorageProcess::names()
 {
   if (error.isSome()) {
     return Failure(error.get());
-  } else if (state != CONNECTED) {
-    Names* names = new Names();
-    pending.names.push(names);
-    return names->promise.future();
+  } else if (children.isSome()) {
+    // We'll be notified when the children change.
+    return vector<string>(children.get().begin(), children.get().end());
   }
 
-  Result<vector<string> > result = doNames();
-
-  if (result.isNone()) { // Try again later.
-    Names* names = new Names();
-    pending.names.push(names);
-    return names->promise.future();
-  } else if (result.isError()) {
-    return Failure(result.error());
-  }
-
-  return result.get();
+  return doNames();
 }
 
 
@@ -219,71 +424,37 @@ Future<Option<Entry> > ZooKeeperStorageProcess::get(const string& name)
 {
   if (error.isSome()) {
     return Failure(error.get());
-  } else if (state != CONNECTED) {
-    Get* get = new Get(name);
-    pending.gets.push(get);
-    return get->promise.future();
   }
 
-  Result<Option<Entry> > result = doGet(name);
+  Option<Snapshot> snapshot = snapshots.get(name);
 
-  if (result.isNone()) { // Try again later.
-    Get* get = new Get(name);
-    pending.gets.push(get);
-    return get->promise.future();
-  } else if (result.isError()) {
-    return Failure(result.error());
+  if (snapshot.isSome() && snapshot.get().watched) {
+    // We'll be notified when the entry changes.
+    return Some(snapshot.get().entry);
+  } else if (children.isSome() && !children.get().contains(name)) {
+    return None();
   }
 
-  return result.get();
+  return doGet(name);
 }
 
 
 Future<bool> ZooKeeperStorageProcess::set(const Entry& entry, const UUID& uuid)
 {
-  if (error.isSome()) {
-    return Failure(error.get());
-  } else if (state != CONNECTED) {
-    Set* set = new Set(entry, uuid);
-    pending.sets.push(set);
-    return set->promise.future();
-  }
-
-  Result<bool> result = doSet(entry, uuid);
+  return doSet(entry, uuid);
+}
 
-  if (result.isNone()) { // Try again later.
-    Set* set = new Set(entry, uuid);
-    pending.sets.push(set);
-    return set->promise.future();
-  } else if (result.isError()) {
-    return Failure(result.error());
-  }
 
-  return result.get();
+Future<bool> ZooKeeperStorageProcess::batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  return doBatch(entries);
 }
 
 
 Future<bool> ZooKeeperStorageProcess::expunge(const Entry& entry)
 {
-  if (error.isSome()) {
-    return Failure(error.get());
-  } else if (state != CONNECTED) {
-    Expunge* expunge = new Expunge(entry);
-    pending.expunges.push(expunge);
-    return expunge->promise.future();
-  }
-
-  Result<bool> result = doExpunge(entry);
-
-  if (result.isNone()) { // Try again later.
-    Expunge* expunge = new Expunge(entry);
-    pending.expunges.push(expunge);
-    return expunge->promise.future();
-  } else if (result.isError()) {
-    return Failure(result.error());
-  }
-
-  return result.get();
+  return doExpunge(entry);
 }
 
 
@@ -299,6 +470,11 @@ void ZooKeeperStorageProcess::connected(bool reconnect)
 
       if (code != ZOK) { // TODO(benh): Authentication retries?
         error = "Failed to authenticate with ZooKeeper: " + zk->message(code);
+        fail(&pending.names, error.get());
+        fail(&pending.gets, error.get());
+        fail(&pending.sets, error.get());
+        fail(&pending.batches, error.get());
+        fail(&pending.expunges, error.get());
         return;
       }
     }
@@ -306,53 +482,18 @@ void ZooKeeperStorageProcess::connected(bool reconnect)
 
   state = CONNECTED;
 
-  while (!pending.names.empty()) {
-    Names* names = pending.names.front();
-    Result<vector<string> > result = doNames();
-    if (result.isNone()) {
-      return; // Try again later.
-    } else if (result.isError()) {
-      names->promise.fail(result.error());
-    } else {
-      names->promise.set(result.get());
-    }
-    pending.names.pop();
-    delete names;
-  }
-
-  while (!pending.gets.empty()) {
-    Get* get = pending.gets.front();
-    Result<Option<Entry> > result = doGet(get->name);
-    if (result.isNone()) {
-      return; // Try again later.
-    } else if (result.isError()) {
-      get->promise.fail(result.error());
-    } else {
-      get->promise.set(result.get());
-    }
-    pending.gets.pop();
-    delete get;
-  }
-
-  while (!pending.sets.empty()) {
-    Set* set = pending.sets.front();
-    Result<bool> result = doSet(set->entry, set->uuid);
-    if (result.isNone()) {
-      return; // Try again later.
-    } else if (result.isError()) {
-      set->promise.fail(result.error());
-    } else {
-      set->promise.set(result.get());
-    }
-    pending.sets.pop();
-    delete set;
-  }
+  retry();
 }
 
 
 void ZooKeeperStorageProcess::reconnecting()
 {
   state = CONNECTING;
+
+  // We can't tell what changed while we're disconnected.
+  snapshots.clear();
+  children = None();
+  generation++;
 }
 
 
@@ -360,6 +501,11 @@ void ZooKeeperStorageProcess::expired()
 {
   state = DISCONNECTED;
 
+  // Our watches are gone along with the session.
+  snapshots.clear();
+  children = None();
+  generation++;
+
   delete zk;
   zk = new ZooKeeper(servers, timeout, watcher);
 
@@ -369,7 +515,13 @@ void ZooKeeperStorageProcess::expired()
 
 void ZooKeeperStorageProcess::updated(const string& path)
 {
-  LOG(FATAL) << "Unexpected ZooKeeper event";
+  generation++;
+
+  if (path == znode) {
+    children = None();
+  } else if (strings::startsWith(path, znode + "/")) {
+    snapshots.erase(path.substr(znode.size() + 1));
+  }
 }
 
 
@@ -381,22 +533,45 @@ void ZooKeeperStorageProcess::created(const string& path)
 
 void ZooKeeperStorageProcess::deleted(const string& path)
 {
-  LOG(FATAL) << "Unexpected ZooKeeper event";
+  generation++;
+
+  if (path == znode) {
+    children = None();
+  } else if (strings::startsWith(path, znode + "/")) {
+    snapshots.erase(path.substr(znode.size() + 1));
+  }
 }
 
 
-Result<vector<string> > ZooKeeperStorageProcess::doNames()
+Future<vector<string> > ZooKeeperStorageProcess::doNames()
 {
-  // Get all children to determine current memberships.
-  vector<string> results;
+  if (error.isSome()) {
+    return Failure(error.get());
+  } else if (state != CONNECTED) {
+    Names* names = new Names();
+    pend(&pending.names, names);
+    return names->promise.future();
+  }
 
-  int code = zk->getChildren(znode, false, &results);
+  Owned<vector<string> > results(new vector<string>());
 
-  if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-    CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
+  // Get all children to determine current memberships, setting a
+  // watch so we can serve subsequent calls until they change.
+  return zk->agetChildren(znode, true, results.get())
+    .then(defer(self(), &Self::_names, results, lambda::_1));
+}
+
+
+Future<vector<string> > ZooKeeperStorageProcess::_names(
+    const Owned<vector<string> >& results,
+    int code)
+{
+  if (retryable(code)) {
+    Names* names = new Names();
+    pend(&pending.names, names);
+    return names->promise.future();
   } else if (code != ZOK) {
-    return Error(
+    return Failure(
         "Failed to get children of '" + znode +
         "' in ZooKeeper: " + zk->message(code));
   }
@@ -404,189 +579,940 @@ Result<vector<string> > ZooKeeperStorageProcess::doNames()
   // TODO(benh): It might make sense to "mangle" the names so that we
   // can determine when a znode has incorrectly been added that
   // actually doesn't store an Entry.
-  return results;
+  hashset<string> names;
+  foreach (const string& name, *results) {
+    if (name != CHUNKS) {
+      names.insert(name);
+    }
+  }
+
+  children = names;
+
+  return vector<string>(names.begin(), names.end());
 }
 
 
-Result<Option<Entry> > ZooKeeperStorageProcess::doGet(const string& name)
+Future<Option<Entry> > ZooKeeperStorageProcess::doGet(
+    const string& name,
+    size_t attempts)
 {
-  CHECK(error.isNone()) << ": " << error.get();
-  CHECK(state == CONNECTED);
+  if (error.isSome()) {
+    return Failure(error.get());
+  } else if (state != CONNECTED) {
+    Get* get = new Get(name);
+    pend(&pending.gets, get);
+    return get->promise.future();
+  }
 
-  string result;
-  Stat stat;
+  Owned<Node> node(new Node());
+
+  // Set a watch so we can serve subsequent gets until it changes.
+  return zk->aget(znode + "/" + name, true, &node->data, &node->stat)
+    .then(defer(self(), &Self::_get, name, attempts, node, lambda::_1));
+}
 
-  int code = zk->get(znode + "/" + name, false, &result, &stat);
 
+Future<Option<Entry> > ZooKeeperStorageProcess::_get(
+    const string& name,
+    size_t attempts,
+    const Owned<Node>& node,
+    int code)
+{
   if (code == ZNONODE) {
-    return Option<Entry>::none();
-  } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-    CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
+    return None();
+  } else if (retryable(code)) {
+    Get* get = new Get(name);
+    pend(&pending.gets, get);
+    return get->promise.future();
   } else if (code != ZOK) {
-    return Error(
+    return Failure(
         "Failed to get '" + znode + "/" + name +
         "' in ZooKeeper: " + zk->message(code));
   }
 
-  google::protobuf::io::ArrayInputStream stream(result.data(), result.size());
+  // The znode holds either the entry itself or a ChunkedEntry.
+  Entry entry;
+
+  if (entry.ParsePartialFromString(node->data) && entry.IsInitialized()) {
+    snapshots.put(name, Snapshot(entry, node->stat.version, None(), true));
+    return Some(entry);
+  }
+
+  ChunkedEntry chunked;
+
+  if (!chunked.ParseFromString(node->data)) {
+    return Failure("Failed to deserialize Entry");
+  }
+
+  // Fetch all the chunks at once.
+  Owned<vector<string> > chunks(new vector<string>(chunked.count()));
+
+  list<Future<int> > futures;
+  for (size_t i = 0; i < chunked.count(); i++) {
+    futures.push_back(zk->aget(chunk(chunked, i), false, &(*chunks)[i], NULL));
+  }
+
+  return collect(futures)
+    .then(defer(self(),
+                &Self::__get,
+                name,
+                attempts,
+                chunked,
+                node->stat.version,
+                generation,
+                chunks,
+                lambda::_1));
+}
+
+
+Future<Option<Entry> > ZooKeeperStorageProcess::__get(
+    const string& name,
+    size_t attempts,
+    const ChunkedEntry& chunked,
+    int version,
+    uint64_t _generation,
+    const Owned<vector<string> >& chunks,
+    const list<int>& codes)
+{
+  foreach (int code, codes) {
+    if (code == ZNONODE) {
+      // The entry has been swapped (removing these chunks) since we
+      // got its znode, try again (unless it keeps getting swapped).
+      if (attempts + 1 >= MAX_GET_ATTEMPTS) {
+        return Failure(
+            "Failed to get '" + znode + "/" + name + "' in ZooKeeper: "
+            "Its chunks were removed " + stringify(MAX_GET_ATTEMPTS) +
+            " times while getting it");
+      }
+      return doGet(name, attempts + 1);
+    } else if (retryable(code)) {
+      Get* get = new Get(name);
+      pend(&pending.gets, get);
+      return get->promise.future();
+    } else if (code != ZOK) {
+      return Failure(
+          "Failed to get the chunks of '" + znode + "/" + name +
+          "' in ZooKeeper: " + zk->message(code));
+    }
+  }
 
   Entry entry;
 
-  if (!entry.ParseFromZeroCopyStream(&stream)) {
-    return Error("Failed to deserialize Entry");
+  if (!entry.ParseFromString(strings::join("", *chunks))) {
+    return Failure("Failed to deserialize Entry");
   }
 
+  snapshots.put(
+      name,
+      Snapshot(entry, version, chunked, _generation == generation));
+
   return Some(entry);
 }
 
 
-Result<bool> ZooKeeperStorageProcess::doSet(const Entry& entry, const UUID& uuid)
+Future<bool> ZooKeeperStorageProcess::doSet(
+    const Entry& entry,
+    const UUID& uuid)
 {
-  CHECK(error.isNone()) << ": " << error.get();
-  CHECK(state == CONNECTED);
+  if (error.isSome()) {
+    return Failure(error.get());
+  } else if (state != CONNECTED) {
+    Set* set = new Set(entry, uuid);
+    pend(&pending.sets, set);
+    return set->promise.future();
+  }
+
+  Option<Snapshot> snapshot = snapshots.get(entry.name());
+
+  // Unless we know the UUIDs don't match we can go ahead and swap
+  // using the version of the snapshot (it's only if the snapshot
+  // turns out to be stale that we need to fetch the entry first).
+  if (snapshot.isSome() &&
+      (snapshot.get().watched ||
+       UUID::fromBytes(snapshot.get().entry.uuid()) == uuid)) {
+    return _set(entry, uuid, snapshot.get().entry);
+  }
+
+  return doGet(entry.name())
+    .then(defer(self(), &Self::_set, entry, uuid, lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::_set(
+    const Entry& entry,
+    const UUID& uuid,
+    const Option<Entry>& current)
+{
+  Option<Snapshot> snapshot = None();
+
+  if (current.isSome()) {
+    if (UUID::fromBytes(current.get().uuid()) != uuid) {
+      return false;
+    }
+
+    snapshot = snapshots.get(entry.name());
+
+    if (snapshot.isNone()) {
+      // The entry has changed since we got it, try again.
+      return doSet(entry, uuid);
+    }
+  }
 
-  // Serialize to make sure we're under the 1 MB limit.
   string data;
 
   if (!entry.SerializeToString(&data)) {
-    return Error("Failed to serialize Entry");
+    return Failure("Failed to serialize Entry");
   }
 
-  if (data.size() > 1024 * 1024) { // 1 MB
-    // TODO(benh): Use stout/gzip.hpp for compression.
-    return Error("Serialized data is too big (> 1 MB)");
+  if (data.size() <= MAX_ZNODE_SIZE) {
+    return __set(entry, uuid, snapshot, data, None(), list<int>());
   }
 
-  string result;
-  Stat stat;
+  // Store the entry in chunks (in their own znodes) before swapping
+  // the entry's znode to refer to them. The chunks of each version
+  // get a unique id so they never get in the way of other versions.
+  ChunkedEntry chunked;
+  chunked.set_name(entry.name());
+  chunked.set_uuid(entry.uuid());
+  chunked.set_id(UUID::random().toBytes());
+  chunked.set_count((data.size() + MAX_ZNODE_SIZE - 1) / MAX_ZNODE_SIZE);
+
+  list<Future<int> > futures;
+  for (size_t i = 0; i < chunked.count(); i++) {
+    futures.push_back(zk->acreate(
+        chunk(chunked, i),
+        data.substr(i * MAX_ZNODE_SIZE, MAX_ZNODE_SIZE),
+        acl,
+        0,
+        NULL));
+  }
 
-  int code = zk->get(znode + "/" + entry.name(), false, &result, &stat);
+  if (!chunked.SerializeToString(&data)) {
+    return Failure("Failed to serialize ChunkedEntry");
+  }
 
-  if (code == ZNONODE) {
-    // Create directory path znodes as necessary.
-    CHECK(znode.size() == 0 || znode.at(znode.size() - 1) != '/');
-    size_t index = znode.find("/", 0);
-
-    while (index < string::npos) {
-      // Get out the prefix to create.
-      index = znode.find("/", index + 1);
-      string prefix = znode.substr(0, index);
-
-      // Create the znode (even if it already exists).
-      code = zk->create(prefix, "", acl, 0, NULL);
-
-      if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-        CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-        return None(); // Try again later.
-      } else if (code != ZOK && code != ZNODEEXISTS) {
-        return Error(
-            "Failed to create '" + prefix +
-            "' in ZooKeeper: " + zk->message(code));
-      }
+  return collect(futures)
+    .then(defer(self(),
+                &Self::__set,
+                entry,
+                uuid,
+                snapshot,
+                data,
+                chunked,
+                lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::__set(
+    const Entry& entry,
+    const UUID& uuid,
+    const Option<Snapshot>& snapshot,
+    const string& data,
+    const Option<ChunkedEntry>& chunked,
+    const list<int>& codes)
+{
+  foreach (int code, codes) {
+    if (code == ZOK) {
+      continue;
     }
 
-    code = zk->create(znode + "/" + entry.name(), data, acl, 0, NULL);
+    CHECK_SOME(chunked);
+    discard(chunked.get());
 
-    if (code == ZNODEEXISTS) {
-      return false; // Lost a race with someone else.
-    } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-      CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-      return None(); // Try again later.
-    } else if (code != ZOK) {
-      return Error(
-          "Failed to create '" + znode + "/" + entry.name() +
+    if (code == ZNONODE) {
+      return create()
+        .then(defer(self(), &Self::doSet, entry, uuid));
+    } else if (retryable(code)) {
+      Set* set = new Set(entry, uuid);
+      pend(&pending.sets, set);
+      return set->promise.future();
+    } else {
+      return Failure(
+          "Failed to create the chunks of '" + znode + "/" + entry.name() +
           "' in ZooKeeper: " + zk->message(code));
     }
+  }
+
+  // Okay, do the swap, we get atomicity by requiring the version of
+  // the snapshot (or by creating the znode if there is none).
+  Future<int> future = snapshot.isSome()
+    ? replace(snapshot.get(), data)
+    : zk->acreate(znode + "/" + entry.name(), data, acl, 0, NULL);
+
+  return future
+    .then(defer(self(),
+                &Self::___set,
+                entry,
+                uuid,
+                snapshot,
+                chunked,
+                lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::___set(
+    const Entry& entry,
+    const UUID& uuid,
+    const Option<Snapshot>& snapshot,
+    const Option<ChunkedEntry>& chunked,
+    int code)
+{
+  if (code == ZOK) {
+    // A set always increments the version of a znode by one (and a
+    // created znode starts out at version zero). Note that we don't
+    // have a watch on the znode anymore (if we did it just fired).
+    snapshots.put(
+        entry.name(),
+        Snapshot(entry,
+                 snapshot.isSome() ? snapshot.get().version + 1 : 0,
+                 chunked,
+                 false));
 
     return true;
-  } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-    CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
-  } else if (code != ZOK) {
-    return Error(
-        "Failed to get '" + znode + "/" + entry.name() +
-        "' in ZooKeeper: " + zk->message(code));
   }
 
-  google::protobuf::io::ArrayInputStream stream(result.data(), result.size());
+  if (retryable(code)) {
+    // The swap might have been applied nonetheless, in which case the
+    // chunks are in use (and the swap must not be done again), so get
+    // the entry (once we're reconnected) to find out.
+    snapshots.erase(entry.name());
+    return doGet(entry.name())
+      .then(defer(self(), &Self::settled, entry, uuid, chunked, lambda::_1));
+  }
+
+  // The swap was definitely not applied, so the chunks (if any) are
+  // not referred to by anything.
+  if (chunked.isSome() &&
+      (code == ZNODEEXISTS || code == ZBADVERSION || code == ZNONODE)) {
+    discard(chunked.get());
+  }
+
+  if (snapshot.isNone() && code == ZNODEEXISTS) {
+    return false; // Lost a race with someone else.
+  } else if (snapshot.isNone() && code == ZNONODE) {
+    return create()
+      .then(defer(self(), &Self::doSet, entry, uuid));
+  } else if (code == ZBADVERSION || code == ZNONODE) {
+    // The entry has changed since the snapshot, so get its latest
+    // version and try again (the UUIDs might not match anymore).
+    snapshots.erase(entry.name());
+    return doGet(entry.name())
+      .then(defer(self(), &Self::_set, entry, uuid, lambda::_1));
+  }
+
+  return Failure(
+      "Failed to set '" + znode + "/" + entry.name() +
+      "' in ZooKeeper: " + zk->message(code));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::settled(
+    const Entry& entry,
+    const UUID& uuid,
+    const Option<ChunkedEntry>& chunked,
+    const Option<Entry>& current)
+{
+  // Every version of an entry gets a new (random) UUID, so finding
+  // ours means the swap was applied.
+  if (current.isSome() && current.get().uuid() == entry.uuid()) {
+    return true;
+  }
+
+  if (chunked.isSome()) {
+    discard(chunked.get());
+  }
+
+  return doSet(entry, uuid);
+}
+
+
+Future<bool> ZooKeeperStorageProcess::doBatch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  if (error.isSome()) {
+    return Failure(error.get());
+  } else if (state != CONNECTED) {
+    Batch* batch = new Batch(entries);
+    pend(&pending.batches, batch);
+    return batch->promise.future();
+  }
+
+  // Fetch (all at once) the entries we don't have a usable snapshot
+  // of, see comment in 'doSet'.
+  list<Future<Option<Entry> > > futures;
 
-  Entry current;
+  typedef pair<Entry, UUID> Swap;
 
-  if (!current.ParseFromZeroCopyStream(&stream)) {
-    return Error("Failed to deserialize Entry");
+  foreach (const Swap& swap, entries) {
+    Option<Snapshot> snapshot = snapshots.get(swap.first.name());
+
+    if (snapshot.isSome() &&
+        (snapshot.get().watched ||
+         UUID::fromBytes(snapshot.get().entry.uuid()) == swap.second)) {
+      futures.push_back(Option<Entry>(snapshot.get().entry));
+    } else {
+      futures.push_back(doGet(swap.first.name()));
+    }
+  }
+
+  return collect(futures)
+    .then(defer(self(), &Self::_batch, entries, lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::_batch(
+    const vector<pair<Entry, UUID> >& entries,
+    const list<Option<Entry> >& currents)
+{
+  CHECK_EQ(entries.size(), currents.size());
+
+  Owned<Swaps> swaps(new Swaps());
+  swaps->entries = entries;
+
+  list<Option<Entry> >::const_iterator current = currents.begin();
+
+  typedef pair<Entry, UUID> Swap;
+
+  foreach (const Swap& swap, entries) {
+    Option<Snapshot> snapshot = None();
+
+    if (current->isSome()) {
+      if (UUID::fromBytes(current->get().uuid()) != swap.second) {
+        return false;
+      }
+
+      snapshot = snapshots.get(swap.first.name());
+
+      if (snapshot.isNone()) {
+        // The entry has changed since we got it, try again.
+        return doBatch(entries);
+      }
+    }
+
+    swaps->snapshots.push_back(snapshot);
+    ++current;
+  }
+
+  // The whole transaction has to fit in a single request so we store
+  // the entries that don't fit in chunks (see comment in '_set').
+  size_t size = 0;
+
+  list<Future<int> > futures;
+
+  foreach (const Swap& swap, entries) {
+    string data;
+
+    if (!swap.first.SerializeToString(&data)) {
+      return Failure("Failed to serialize Entry");
+    }
+
+    if (size + data.size() <= MAX_ZNODE_SIZE) {
+      size += data.size();
+      swaps->data.push_back(data);
+      swaps->chunked.push_back(None());
+      continue;
+    }
+
+    ChunkedEntry chunked;
+    chunked.set_name(swap.first.name());
+    chunked.set_uuid(swap.first.uuid());
+    chunked.set_id(UUID::random().toBytes());
+    chunked.set_count((data.size() + MAX_ZNODE_SIZE - 1) / MAX_ZNODE_SIZE);
+
+    for (size_t i = 0; i < chunked.count(); i++) {
+      futures.push_back(zk->acreate(
+          chunk(chunked, i),
+          data.substr(i * MAX_ZNODE_SIZE, MAX_ZNODE_SIZE),
+          acl,
+          0,
+          NULL));
+    }
+
+    if (!chunked.SerializeToString(&data)) {
+      return Failure("Failed to serialize ChunkedEntry");
+    }
+
+    size += data.size();
+    swaps->data.push_back(data);
+    swaps->chunked.push_back(chunked);
+  }
+
+  return collect(futures)
+    .then(defer(self(), &Self::__batch, swaps, lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::__batch(
+    const Owned<Swaps>& swaps,
+    const list<int>& codes)
+{
+  foreach (int code, codes) {
+    if (code == ZOK) {
+      continue;
+    }
+
+    foreach (const Option<ChunkedEntry>& chunked, swaps->chunked) {
+      if (chunked.isSome()) {
+        discard(chunked.get());
+      }
+    }
+
+    if (code == ZNONODE) {
+      return create()
+        .then(defer(self(), &Self::doBatch, swaps->entries));
+    } else if (retryable(code)) {
+      Batch* batch = new Batch(swaps->entries);
+      pend(&pending.batches, batch);
+      return batch->promise.future();
+    } else {
+      return Failure(
+          "Failed to create the chunks of a batch in ZooKeeper: " +
+          zk->message(code));
+    }
+  }
+
+  // Collect the paths first, the operations refer to them.
+  for (size_t i = 0; i < swaps->entries.size(); i++) {
+    swaps->indexes.push_back(swaps->paths.size());
+    swaps->paths.push_back(znode + "/" + swaps->entries[i].first.name());
+
+    const Option<Snapshot>& snapshot = swaps->snapshots[i];
+
+    if (snapshot.isSome() && snapshot.get().chunked.isSome()) {
+      const ChunkedEntry& chunked = snapshot.get().chunked.get();
+      for (size_t j = 0; j < chunked.count(); j++) {
+        swaps->paths.push_back(chunk(chunked, j));
+      }
+    }
+  }
+
+  swaps->ops.resize(swaps->paths.size());
+  swaps->stats.resize(swaps->entries.size());
+
+  // Like for a single swap we get atomicity by requiring the version
+  // of each snapshot (or by creating the znode if there is none), see
+  // 'replace'.
+  for (size_t i = 0; i < swaps->entries.size(); i++) {
+    const size_t index = swaps->indexes[i];
+    const Option<Snapshot>& snapshot = swaps->snapshots[i];
+
+    if (snapshot.isNone()) {
+      zoo_create_op_init(
+          &swaps->ops[index],
+          swaps->paths[index].c_str(),
+          swaps->data[i].data(),
+          swaps->data[i].size(),
+          &acl,
+          0,
+          NULL,
+          0);
+      continue;
+    }
+
+    zoo_set_op_init(
+        &swaps->ops[index],
+        swaps->paths[index].c_str(),
+        swaps->data[i].data(),
+        swaps->data[i].size(),
+        snapshot.get().version,
+        &swaps->stats[i]);
+
+    if (snapshot.get().chunked.isSome()) {
+      for (size_t j = 0; j < snapshot.get().chunked.get().count(); j++) {
+        zoo_delete_op_init(
+            &swaps->ops[index + 1 + j],
+            swaps->paths[index + 1 + j].c_str(),
+            -1);
+      }
+    }
+  }
+
+  return zk->amulti(swaps->ops, &swaps->results)
+    .then(defer(self(), &Self::___batch, swaps, lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::___batch(
+    const Owned<Swaps>& swaps,
+    int code)
+{
+  if (code == ZOK) {
+    // See comment in '___set'.
+    for (size_t i = 0; i < swaps->entries.size(); i++) {
+      const Option<Snapshot>& snapshot = swaps->snapshots[i];
+      snapshots.put(
+          swaps->entries[i].first.name(),
+          Snapshot(swaps->entries[i].first,
+                   snapshot.isSome() ? snapshot.get().version + 1 : 0,
+                   swaps->chunked[i],
+                   false));
+    }
+
+    return true;
   }
 
-  if (UUID::fromBytes(current.uuid()) != uuid) {
+  if (retryable(code)) {
+    // See comment in '___set'.
+    list<Future<Option<Entry> > > futures;
+    for (size_t i = 0; i < swaps->entries.size(); i++) {
+      snapshots.erase(swaps->entries[i].first.name());
+      futures.push_back(doGet(swaps->entries[i].first.name()));
+    }
+
+    return collect(futures)
+      .then(defer(self(), &Self::batched, swaps, lambda::_1));
+  }
+
+  // The transaction was definitely not applied (it's all or nothing),
+  // so the chunks are not referred to by anything.
+  foreach (const Option<ChunkedEntry>& chunked, swaps->chunked) {
+    if (chunked.isSome()) {
+      discard(chunked.get());
+    }
+  }
+
+  // Determine which entry the failed operation belongs to (the ones
+  // after it fail with ZRUNTIMEINCONSISTENCY).
+  for (size_t i = 0; i < swaps->entries.size(); i++) {
+    const size_t index = swaps->indexes[i];
+    const size_t end = i + 1 < swaps->entries.size()
+      ? swaps->indexes[i + 1]
+      : swaps->ops.size();
+
+    for (size_t j = index; j < end; j++) {
+      const int err = swaps->results[j].err;
+
+      if (err == ZOK) {
+        continue;
+      }
+
+      const Entry& entry = swaps->entries[i].first;
+
+      if (j != index) {
+        // See comment in '_replace'.
+        return Failure(
+            "Failed to remove the chunks of '" + swaps->paths[index] +
+            "' in ZooKeeper: " + zk->message(err));
+      } else if (swaps->snapshots[i].isNone() && err == ZNODEEXISTS) {
+        return false; // Lost a race with someone else.
+      } else if (swaps->snapshots[i].isNone() && err == ZNONODE) {
+        return create()
+          .then(defer(self(), &Self::doBatch, swaps->entries));
+      } else if (err == ZBADVERSION || err == ZNONODE) {
+        // The entry has changed since the snapshot, see comment in
+        // '___set' (we'll fetch it again).
+        snapshots.erase(entry.name());
+        return doBatch(swaps->entries);
+      }
+
+      return Failure(
+          "Failed to set '" + swaps->paths[index] +
+          "' in ZooKeeper: " + zk->message(err));
+    }
+  }
+
+  return Failure("Failed to do a batch in ZooKeeper: " + zk->message(code));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::batched(
+    const Owned<Swaps>& swaps,
+    const list<Option<Entry> >& currents)
+{
+  CHECK_EQ(swaps->entries.size(), currents.size());
+
+  // The transaction is all or nothing, so finding any one of our
+  // entries means it was applied (see comment in 'settled').
+  size_t i = 0;
+  foreach (const Option<Entry>& current, currents) {
+    if (current.isSome() &&
+        current.get().uuid() == swaps->entries[i].first.uuid()) {
+      return true;
+    }
+    i++;
+  }
+
+  foreach (const Option<ChunkedEntry>& chunked, swaps->chunked) {
+    if (chunked.isSome()) {
+      discard(chunked.get());
+    }
+  }
+
+  return doBatch(swaps->entries);
+}
+
+
+Future<bool> ZooKeeperStorageProcess::doExpunge(const Entry& entry)
+{
+  if (error.isSome()) {
+    return Failure(error.get());
+  } else if (state != CONNECTED) {
+    Expunge* expunge = new Expunge(entry);
+    pend(&pending.expunges, expunge);
+    return expunge->promise.future();
+  }
+
+  UUID uuid = UUID::fromBytes(entry.uuid());
+
+  Option<Snapshot> snapshot = snapshots.get(entry.name());
+
+  // See comment in 'doSet'.
+  if (snapshot.isSome() &&
+      (snapshot.get().watched ||
+       UUID::fromBytes(snapshot.get().entry.uuid()) == uuid)) {
+    return _expunge(entry, snapshot.get().entry);
+  }
+
+  return doGet(entry.name())
+    .then(defer(self(), &Self::_expunge, entry, lambda::_1));
+}
+
+
+Future<bool> ZooKeeperStorageProcess::_expunge(
+    const Entry& entry,
+    const Option<Entry>& current)
+{
+  if (current.isNone()) {
+    return false;
+  }
+
+  if (UUID::fromBytes(current.get().uuid()) != UUID::fromBytes(entry.uuid())) {
     return false;
   }
 
-  // Okay, do the set, we get atomicity by requiring 'stat.version'.
-  code = zk->set(znode + "/" + entry.name(), data, stat.version);
+  Option<Snapshot> snapshot = snapshots.get(entry.name());
+
+  if (snapshot.isNone()) {
+    // The entry has changed since we got it, try again.
+    return doExpunge(entry);
+  }
+
+  // Okay, do the remove, we get atomicity by requiring the version.
+  return replace(snapshot.get(), None())
+    .then(defer(self(), &Self::__expunge, entry, lambda::_1));
+}
+
 
-  if (code == ZBADVERSION) {
+Future<bool> ZooKeeperStorageProcess::__expunge(const Entry& entry, int code)
+{
+  if (code == ZOK) {
+    snapshots.erase(entry.name());
+    return true;
+  } else if (code == ZNONODE) {
     return false;
-  } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-    CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
-  } else if (code != ZOK) {
-    return Error(
-        "Failed to set '" + znode + "/" + entry.name() +
-        "' in ZooKeeper: " + zk->message(code));
+  } else if (code == ZBADVERSION) {
+    // The entry has changed since the snapshot, see comment in
+    // '___set'.
+    snapshots.erase(entry.name());
+    return doGet(entry.name())
+      .then(defer(self(), &Self::_expunge, entry, lambda::_1));
+  } else if (retryable(code)) {
+    Expunge* expunge = new Expunge(entry);
+    pend(&pending.expunges, expunge);
+    return expunge->promise.future();
   }
 
-  return true;
+  return Failure(
+      "Failed to remove '" + znode + "/" + entry.name() +
+      "' in ZooKeeper: " + zk->message(code));
 }
 
 
-Result<bool> ZooKeeperStorageProcess::doExpunge(const Entry& entry)
+Future<int> ZooKeeperStorageProcess::replace(
+    const Snapshot& snapshot,
+    const Option<string>& data)
 {
-  CHECK(error.isNone()) << ": " << error.get();
-  CHECK(state == CONNECTED);
+  const string path = znode + "/" + snapshot.entry.name();
 
-  string result;
-  Stat stat;
+  if (snapshot.chunked.isNone()) {
+    return data.isSome()
+      ? zk->aset(path, data.get(), snapshot.version)
+      : zk->aremove(path, snapshot.version);
+  }
 
-  int code = zk->get(znode + "/" + entry.name(), false, &result, &stat);
+  const ChunkedEntry& chunked = snapshot.chunked.get();
 
-  if (code == ZNONODE) {
-    return false;
-  } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
-    CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
-  } else if (code != ZOK) {
-    return Error(
-        "Failed to get '" + znode + "/" + entry.name() +
+  Owned<Transaction> transaction(new Transaction());
+
+  transaction->paths.push_back(path);
+  for (size_t i = 0; i < chunked.count(); i++) {
+    transaction->paths.push_back(chunk(chunked, i));
+  }
+
+  transaction->ops.resize(transaction->paths.size());
+
+  if (data.isSome()) {
+    transaction->data = data.get();
+    zoo_set_op_init(
+        &transaction->ops[0],
+        transaction->paths[0].c_str(),
+        transaction->data.data(),
+        transaction->data.size(),
+        snapshot.version,
+        &transaction->stat);
+  } else {
+    zoo_delete_op_init(
+        &transaction->ops[0],
+        transaction->paths[0].c_str(),
+        snapshot.version);
+  }
+
+  for (size_t i = 1; i < transaction->paths.size(); i++) {
+    zoo_delete_op_init(
+        &transaction->ops[i],
+        transaction->paths[i].c_str(),
+        -1);
+  }
+
+  return zk->amulti(transaction->ops, &transaction->results)
+    .then(defer(self(), &Self::_replace, transaction, lambda::_1));
+}
+
+
+Future<int> ZooKeeperStorageProcess::_replace(
+    const Owned<Transaction>& transaction,
+    int code)
+{
+  // We only remove chunks along with the version of the entry that
+  // refers to them, so if the version check passed but removing the
+  // chunks failed something other than a storage messed with them.
+  if (code != ZOK && !retryable(code) && transaction->results[0].err == ZOK) {
+    return Failure(
+        "Failed to remove the chunks of '" + transaction->paths[0] +
         "' in ZooKeeper: " + zk->message(code));
   }
 
-  google::protobuf::io::ArrayInputStream stream(result.data(), result.size());
+  return code;
+}
+
+
+Future<Nothing> ZooKeeperStorageProcess::create()
+{
+  list<Future<int> > futures;
+
+  // Create directory path znodes as necessary. Note that we don't
+  // need to wait for a parent before creating its child since the
+  // requests get processed in order.
+  CHECK(znode.size() == 0 || znode.at(znode.size() - 1) != '/');
+  size_t index = znode.find("/", 0);
 
-  Entry current;
+  while (index < string::npos) {
+    // Get out the prefix to create.
+    index = znode.find("/", index + 1);
+    string prefix = znode.substr(0, index);
 
-  if (!current.ParseFromZeroCopyStream(&stream)) {
-    return Error("Failed to deserialize Entry");
+    // Create the znode (even if it already exists).
+    futures.push_back(zk->acreate(prefix, "", acl, 0, NULL));
   }
 
-  if (UUID::fromBytes(current.uuid()) != UUID::fromBytes(entry.uuid())) {
-    return false;
+  futures.push_back(zk->acreate(znode + "/" + CHUNKS, "", acl, 0, NULL));
+
+  return collect(futures)
+    .then(defer(self(), &Self::_create, lambda::_1));
+}
+
+
+Future<Nothing> ZooKeeperStorageProcess::_create(const list<int>& codes)
+{
+  foreach (int code, codes) {
+    // Retryable failures get retried along with the operation.
+    if (code != ZOK && code != ZNODEEXISTS && !retryable(code)) {
+      return Failure(
+          "Failed to create '" + znode +
+          "' in ZooKeeper: " + zk->message(code));
+    }
   }
 
-  // Okay, do the remove, we get atomicity by requiring 'stat.version'.
-  code = zk->remove(znode + "/" + entry.name(), stat.version);
+  return Nothing();
+}
 
-  if (code == ZBADVERSION) {
-    return false;
-  } else if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
+
+void ZooKeeperStorageProcess::discard(const ChunkedEntry& chunked)
+{
+  for (size_t i = 0; i < chunked.count(); i++) {
+    zk->aremove(chunk(chunked, i), -1);
+  }
+}
+
+
+string ZooKeeperStorageProcess::chunk(
+    const ChunkedEntry& chunked,
+    size_t index)
+{
+  return znode + "/" + CHUNKS + "/" +
+    UUID::fromBytes(chunked.id()).toString() + "-" + stringify(index);
+}
+
+
+bool ZooKeeperStorageProcess::retryable(int code)
+{
+  if (code == ZINVALIDSTATE || (code != ZOK && zk->retryable(code))) {
     CHECK(zk->getState() != ZOO_AUTH_FAILED_STATE);
-    return None(); // Try again later.
-  } else if (code != ZOK) {
-    return Error(
-        "Failed to remove '" + znode + "/" + entry.name() +
-        "' in ZooKeeper: " + zk->message(code));
+    return true;
+  }
+
+  return false;
+}
+
+
+template <typename T>
+void ZooKeeperStorageProcess::pend(queue<T*>* queue, T* t)
+{
+  queue->push(t);
+
+  // A request can fail before we learn that we're disconnected (or
+  // that the session expired), in which case 'connected' might never
+  // get invoked to retry it.
+  if (state == CONNECTED && !retrying) {
+    retrying = true;
+    delay(RETRY_INTERVAL, self(), &Self::retry);
+  }
+}
+
+
+void ZooKeeperStorageProcess::retry()
+{
+  retrying = false;
+
+  if (error.isSome() || state != CONNECTED) {
+    return; // We'll retry once we're connected.
+  }
+
+  // Reissue everything at once, the requests get pipelined.
+  while (!pending.names.empty()) {
+    Names* names = pending.names.front();
+    pending.names.pop();
+    names->promise.associate(doNames());
+    delete names;
+  }
+
+  while (!pending.gets.empty()) {
+    Get* get = pending.gets.front();
+    pending.gets.pop();
+    get->promise.associate(doGet(get->name));
+    delete get;
   }
 
-  return true;
+  while (!pending.sets.empty()) {
+    Set* set = pending.sets.front();
+    pending.sets.pop();
+    set->promise.associate(doSet(set->entry, set->uuid));
+    delete set;
+  }
+
+  while (!pending.batches.empty()) {
+    Batch* batch = pending.batches.front();
+    pending.batches.pop();
+    batch->promise.associate(doBatch(batch->entries));
+    delete batch;
+  }
+
+  while (!pending.expunges.empty()) {
+    Expunge* expunge = pending.expunges.front();
+    pending.expunges.pop();
+    expunge->promise.associate(doExpunge(expunge->entry));
+    delete expunge;
+  }
 }
 
 
@@ -621,6 +1547,13 @@ Future<bool> ZooKeeperStorage::set(const Entry& entry, const UUID& uuid)
 }
 
 
+Future<bool> ZooKeeperStorage::batch(
+    const vector<pair<Entry, UUID> >& entries)
+{
+  return dispatch(process, &ZooKeeperStorageProcess::batch, entries);
+}
+
+
 Future<bool> ZooKeeperStorage::expunge(const Entry& entry)
 {
   return dispatch(process, &ZooKeeperStorageProcess::expunge, entry);
@@ -2,6 +2,7 @@
 #define __STATE_ZOOKEEPER_HPP__
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/future.hpp>
@@ -24,6 +25,11 @@ namespace state {
 class ZooKeeperStorageProcess;
 
 
+// A storage implementation that keeps each entry in a znode (under
+// 'znode'). Requests are issued asynchronously so that operations get
+// pipelined, and reads (and the names) are served from a cache for as
+// long as a watch tells us it's up to date. Entries too big for a
+// single znode are stored in chunks (see ChunkedEntry).
 class ZooKeeperStorage : public Storage
 {
 public:
@@ -38,6 +44,8 @@ public:
   // Storage implementation.
   virtual process::Future<Option<Entry> > get(const std::string& name);
   virtual process::Future<bool> set(const Entry& entry, const UUID& uuid);
+  virtual process::Future<bool> batch(
+      const std::vector<std::pair<Entry, UUID> >& entries);
   virtual process::Future<bool> expunge(const Entry& entry);
   virtual process::Future<std::vector<std::string> > names();
 
@@ -29,8 +29,14 @@
 #include <process/future.hpp>
 #include <process/gmock.hpp>
 #include <process/pid.hpp>
+#include <process/statistics.hpp>
+#include <process/timeseries.hpp>
+
+#include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
 
 #include "master/allocator.hpp"
+#include "master/constants.hpp"
 #include "master/detector.hpp"
 #include "master/hierarchical_allocator_process.hpp"
 #include "master/master.hpp"
@@ -54,6 +60,7 @@ using process::Future;
 using process::PID;
 
 using std::map;
+using std::pair;
 using std::string;
 using std::vector;
 
@@ -1639,6 +1646,91 @@ TYPED_TEST(AllocatorTest, WhitelistSlave)
 }
 
 
+// Checks that declined resources are filtered until the filter
+// expires, after which they get reoffered.
+TYPED_TEST(AllocatorTest, FilterExpired)
+{
+  EXPECT_CALL(this->allocator, initialize(_, _, _));
+
+  Try<PID<Master> > master = this->StartMaster(&this->allocator);
+  ASSERT_SOME(master);
+
+  EXPECT_CALL(this->allocator, slaveAdded(_, _, _));
+
+  slave::Flags flags = this->CreateSlaveFlags();
+  flags.resources = Option<string>("cpus:2;mem:1024");
+
+  Try<PID<Slave> > slave = this->StartSlave(flags);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+      &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(this->allocator, frameworkAdded(_, _, _));
+
+  EXPECT_CALL(sched, registered(_, _, _));
+
+  Future<vector<Offer> > offers1;
+  Future<vector<Offer> > offers2;
+  EXPECT_CALL(sched, resourceOffers(_, OfferEq(2, 1024)))
+    .WillOnce(FutureArg<1>(&offers1))
+    .WillOnce(FutureArg<1>(&offers2));
+
+  Future<Nothing> resourcesUnused;
+  EXPECT_CALL(this->allocator, resourcesUnused(_, _, _, _))
+    .WillOnce(DoAll(InvokeResourcesUnused(&this->allocator),
+                    FutureSatisfy(&resourcesUnused)));
+
+  driver.start();
+
+  AWAIT_READY(offers1);
+  EXPECT_NE(0u, offers1.get().size());
+
+  Clock::pause();
+
+  Filters filters;
+  filters.set_refuse_seconds(5);
+
+  driver.declineOffer(offers1.get()[0].id(), filters);
+
+  AWAIT_READY(resourcesUnused);
+
+  // The resources should not get reoffered while being filtered.
+  Clock::advance(Seconds(1));
+  Clock::settle();
+
+  EXPECT_TRUE(offers2.isPending());
+
+  // Once the filter has expired the resources should get reoffered
+  // in the next allocation.
+  Clock::advance(Seconds(5));
+  Clock::settle();
+
+  AWAIT_READY(offers2);
+
+  Clock::resume();
+
+  // Shut everything down.
+  EXPECT_CALL(this->allocator, resourcesRecovered(_, _, _))
+    .WillRepeatedly(DoDefault());
+
+  EXPECT_CALL(this->allocator, frameworkDeactivated(_))
+    .Times(AtMost(1));
+
+  EXPECT_CALL(this->allocator, frameworkRemoved(_))
+    .Times(AtMost(1));
+
+  driver.stop();
+  driver.join();
+
+  EXPECT_CALL(this->allocator, slaveRemoved(_))
+    .Times(AtMost(1));
+
+  this->Shutdown();
+}
+
+
 // Checks that a framework attempting to register with an invalid role
 // will receive an error message and that roles can be added through the
 // master's command line flags.
@@ -1714,3 +1806,404 @@ TYPED_TEST(AllocatorTest, RoleTest)
 
   this->Shutdown();
 }
+
+
+// Records the offers of the allocator instead of sending them to the
+// master.
+class OfferRecordingAllocatorProcess : public HierarchicalDRFAllocatorProcess
+{
+public:
+  // The offers, in the order in which they were made.
+  vector<pair<FrameworkID, hashmap<SlaveID, Resources> > > offers;
+
+protected:
+  virtual void offer(
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& offerable)
+  {
+    offers.push_back(std::make_pair(frameworkId, offerable));
+  }
+};
+
+
+// Returns the roles of a master without any roles configured.
+static hashmap<string, RoleInfo> defaultRoles()
+{
+  RoleInfo roleInfo;
+  roleInfo.set_name("*");
+
+  hashmap<string, RoleInfo> roles;
+  roles["*"] = roleInfo;
+
+  return roles;
+}
+
+
+// Returns the latest value of the allocator statistic, or 0 if it
+// was never set.
+static double statistic(const string& name)
+{
+  Future<process::TimeSeries<double> > timeseries =
+    process::statistics->timeseries("allocator", name);
+
+  if (!timeseries.await(Seconds(5)) ||
+      !timeseries.isReady() ||
+      timeseries.get().empty()) {
+    return 0.0;
+  }
+
+  return timeseries.get().latest().get().data;
+}
+
+
+// Adds a slave with 2 cpus and 1GB of memory.
+static SlaveID addSlave(Allocator* allocator, const string& id)
+{
+  SlaveInfo slaveInfo;
+  slaveInfo.set_hostname("localhost");
+  slaveInfo.mutable_resources()->MergeFrom(
+      Resources::parse("cpus:2;mem:1024").get());
+
+  SlaveID slaveId;
+  slaveId.set_value(id);
+
+  allocator->slaveAdded(slaveId, slaveInfo, hashmap<FrameworkID, Resources>());
+
+  return slaveId;
+}
+
+
+// Checks that the slaves that got resources back since they were
+// last allocated are the only ones that get allocated in a batch.
+TEST(HierarchicalAllocatorTest, DirtySlaves)
+{
+  Clock::pause();
+
+  master::Flags flags;
+  flags.allocation_latency = Milliseconds(10);
+
+  OfferRecordingAllocatorProcess process;
+  Allocator allocator(&process);
+
+  allocator.initialize(flags, PID<Master>(), defaultRoles());
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+  allocator.frameworkAdded(frameworkId, DEFAULT_FRAMEWORK_INFO, Resources());
+
+  vector<SlaveID> slaveIds;
+  for (size_t i = 0; i < 3; i++) {
+    slaveIds.push_back(addSlave(&allocator, "slave" + stringify(i)));
+  }
+
+  Clock::settle();
+  Clock::advance(flags.allocation_latency);
+  Clock::settle();
+
+  ASSERT_EQ(1u, process.offers.size());
+  EXPECT_EQ(3u, process.offers[0].second.size());
+  EXPECT_EQ(3.0, statistic("allocated_slaves"));
+
+  // Recovered resources are allocated in the next batch, which only
+  // considers the slave they were recovered on.
+  const Resources resources = Resources::parse("cpus:1;mem:512").get();
+  allocator.resourcesRecovered(frameworkId, slaveIds[1], resources);
+
+  Clock::settle();
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  ASSERT_EQ(2u, process.offers.size());
+  EXPECT_EQ(frameworkId, process.offers[1].first);
+  ASSERT_EQ(1u, process.offers[1].second.size());
+  ASSERT_TRUE(process.offers[1].second.contains(slaveIds[1]));
+  EXPECT_EQ(resources, process.offers[1].second[slaveIds[1]]);
+  EXPECT_EQ(1.0, statistic("allocated_slaves"));
+
+  // Nothing is left to allocate in the following batch.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  EXPECT_EQ(2u, process.offers.size());
+  EXPECT_EQ(0.0, statistic("allocated_slaves"));
+
+  Clock::resume();
+}
+
+
+// Checks that a burst of events that each warrant an allocation
+// results in a single allocation, after the allocation latency.
+TEST(HierarchicalAllocatorTest, CoalesceAllocations)
+{
+  Clock::pause();
+
+  master::Flags flags;
+  flags.allocation_latency = Milliseconds(10);
+
+  OfferRecordingAllocatorProcess process;
+  Allocator allocator(&process);
+
+  allocator.initialize(flags, PID<Master>(), defaultRoles());
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+  allocator.frameworkAdded(frameworkId, DEFAULT_FRAMEWORK_INFO, Resources());
+
+  Clock::settle();
+  Clock::advance(flags.allocation_latency);
+  Clock::settle();
+
+  EXPECT_TRUE(process.offers.empty());
+
+  for (size_t i = 0; i < 5; i++) {
+    addSlave(&allocator, "slave" + stringify(i));
+  }
+
+  // No allocation happens before the latency has passed.
+  Clock::settle();
+  Clock::advance(flags.allocation_latency / 2);
+  Clock::settle();
+
+  EXPECT_TRUE(process.offers.empty());
+
+  Clock::advance(flags.allocation_latency / 2);
+  Clock::settle();
+
+  ASSERT_EQ(1u, process.offers.size());
+  EXPECT_EQ(5u, process.offers[0].second.size());
+  EXPECT_EQ(5.0, statistic("allocated_slaves"));
+
+  // The next burst only allocates the slaves added since.
+  for (size_t i = 5; i < 7; i++) {
+    addSlave(&allocator, "slave" + stringify(i));
+  }
+
+  Clock::settle();
+  Clock::advance(flags.allocation_latency);
+  Clock::settle();
+
+  ASSERT_EQ(2u, process.offers.size());
+  EXPECT_EQ(2u, process.offers[1].second.size());
+  EXPECT_EQ(2.0, statistic("allocated_slaves"));
+
+  Clock::resume();
+}
+
+
+// Checks that every MAX_INCREMENTAL_ALLOCATIONS-th batch allocates
+// all slaves rather than only the dirty ones.
+TEST(HierarchicalAllocatorTest, PeriodicFullAllocation)
+{
+  Clock::pause();
+
+  master::Flags flags;
+  flags.allocation_latency = Milliseconds(10);
+
+  OfferRecordingAllocatorProcess process;
+  Allocator allocator(&process);
+
+  allocator.initialize(flags, PID<Master>(), defaultRoles());
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+  allocator.frameworkAdded(frameworkId, DEFAULT_FRAMEWORK_INFO, Resources());
+
+  for (size_t i = 0; i < 3; i++) {
+    addSlave(&allocator, "slave" + stringify(i));
+  }
+
+  Clock::settle();
+  Clock::advance(flags.allocation_latency);
+  Clock::settle();
+
+  ASSERT_EQ(1u, process.offers.size());
+
+  const double full = statistic("full_allocations");
+
+  for (uint32_t i = 1; i < master::MAX_INCREMENTAL_ALLOCATIONS; i++) {
+    Clock::advance(flags.allocation_interval);
+    Clock::settle();
+
+    EXPECT_EQ(full, statistic("full_allocations"));
+    EXPECT_EQ(0.0, statistic("allocated_slaves"));
+  }
+
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  EXPECT_EQ(full + 1, statistic("full_allocations"));
+  EXPECT_EQ(3.0, statistic("allocated_slaves"));
+
+  // Everything had been offered already.
+  EXPECT_EQ(1u, process.offers.size());
+
+  // The count starts over after a full allocation.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  EXPECT_EQ(full + 1, statistic("full_allocations"));
+  EXPECT_EQ(0.0, statistic("allocated_slaves"));
+
+  Clock::resume();
+}
+
+
+// Allocates slaves (half of them checkpointing) to frameworks with
+// different shares and returns the offers.
+static vector<pair<FrameworkID, hashmap<SlaveID, Resources> > > allocateSlaves(
+    size_t parallelism)
+{
+  master::Flags flags;
+  flags.allocation_latency = Milliseconds(10);
+  flags.allocation_parallelism = parallelism;
+
+  OfferRecordingAllocatorProcess process;
+  Allocator allocator(&process);
+
+  allocator.initialize(flags, PID<Master>(), defaultRoles());
+
+  // Framework 'a' has the largest share and framework 'c' (the only
+  // checkpointing framework) has none.
+  FrameworkInfo frameworkInfo = DEFAULT_FRAMEWORK_INFO;
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("a");
+  allocator.frameworkAdded(
+      frameworkId,
+      frameworkInfo,
+      Resources::parse("cpus:8;mem:4096").get());
+
+  frameworkId.set_value("b");
+  allocator.frameworkAdded(
+      frameworkId,
+      frameworkInfo,
+      Resources::parse("cpus:4;mem:2048").get());
+
+  frameworkInfo.set_checkpoint(true);
+
+  frameworkId.set_value("c");
+  allocator.frameworkAdded(frameworkId, frameworkInfo, Resources());
+
+  SlaveInfo slaveInfo;
+  slaveInfo.set_hostname("localhost");
+  slaveInfo.mutable_resources()->MergeFrom(
+      Resources::parse("cpus:2;mem:1024").get());
+
+  for (size_t i = 0; i < 16; i++) {
+    slaveInfo.set_checkpoint(i % 2 == 0);
+
+    SlaveID slaveId;
+    slaveId.set_value("slave" + stringify(i));
+
+    allocator.slaveAdded(
+        slaveId, slaveInfo, hashmap<FrameworkID, Resources>());
+  }
+
+  Clock::settle();
+  Clock::advance(flags.allocation_latency);
+  Clock::settle();
+
+  return process.offers;
+}
+
+
+// Checks that allocating the slaves in parallel results in the same
+// offers, made in the same (DRF) order, as allocating them serially.
+TEST(HierarchicalAllocatorTest, ParallelAllocation)
+{
+  Clock::pause();
+
+  const vector<pair<FrameworkID, hashmap<SlaveID, Resources> > > serial =
+    allocateSlaves(1);
+
+  // The checkpointing slaves go to 'c' (which has the smallest
+  // share) and the others to 'b' (which has the next smallest).
+  ASSERT_EQ(2u, serial.size());
+
+  EXPECT_EQ("c", serial[0].first.value());
+  EXPECT_EQ(8u, serial[0].second.size());
+
+  EXPECT_EQ("b", serial[1].first.value());
+  EXPECT_EQ(8u, serial[1].second.size());
+
+  for (size_t parallelism = 2; parallelism <= 8; parallelism *= 2) {
+    const vector<pair<FrameworkID, hashmap<SlaveID, Resources> > > parallel =
+      allocateSlaves(parallelism);
+
+    ASSERT_EQ(serial.size(), parallel.size());
+
+    for (size_t i = 0; i < serial.size(); i++) {
+      EXPECT_EQ(serial[i].first, parallel[i].first);
+      EXPECT_TRUE(serial[i].second == parallel[i].second)
+        << "Offers to framework " << serial[i].first
+        << " differ with " << parallelism << " partitions";
+    }
+  }
+
+  Clock::resume();
+}
+
+
+// Measures how long it takes to allocate a large cluster with
+// different numbers of partitions allocated in parallel.
+TEST(HierarchicalAllocatorTest, BENCHMARK_ParallelAllocationTime)
+{
+  const size_t slaves = 2000;
+  const size_t frameworks = 200;
+
+  Try<long> cpus = os::cpus();
+  ASSERT_SOME(cpus);
+
+  Clock::pause();
+
+  for (size_t parallelism = 1;
+       parallelism <= (size_t) cpus.get();
+       parallelism *= 2) {
+    master::Flags flags;
+    flags.allocation_parallelism = parallelism;
+
+    HierarchicalDRFAllocatorProcess process;
+    Allocator allocator(&process);
+
+    allocator.initialize(flags, PID<Master>(), defaultRoles());
+
+    // No slave gets offered to any framework, so that every
+    // framework gets considered for every slave.
+    FrameworkInfo frameworkInfo = DEFAULT_FRAMEWORK_INFO;
+    frameworkInfo.set_checkpoint(true);
+
+    FrameworkID frameworkId;
+    for (size_t i = 0; i < frameworks; i++) {
+      frameworkId.set_value("framework" + stringify(i));
+      allocator.frameworkAdded(frameworkId, frameworkInfo, Resources());
+    }
+
+    SlaveInfo slaveInfo;
+    slaveInfo.set_hostname("localhost");
+    slaveInfo.mutable_resources()->MergeFrom(
+        Resources::parse("cpus:16;mem:65536;disk:1048576").get());
+
+    for (size_t i = 0; i < slaves; i++) {
+      SlaveID slaveId;
+      slaveId.set_value("slave" + stringify(i));
+      allocator.slaveAdded(
+          slaveId, slaveInfo, hashmap<FrameworkID, Resources>());
+    }
+
+    Clock::settle();
+
+    // Reviving offers results in an allocation of all slaves.
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    allocator.offersRevived(frameworkId);
+
+    Clock::settle();
+
+    std::cout << "Allocated " << slaves << " slaves for " << frameworks
+              << " frameworks with " << parallelism << " partitions in "
+              << stopwatch.elapsed() << std::endl;
+  }
+
+  Clock::resume();
+}
@@ -774,3 +774,32 @@ TEST_F(CgroupsAnyHierarchyWithCpuMemoryFreezerTest, ROOT_CGROUPS_Destroy)
     abort();
   }
 }
+
+
+TEST_F(CgroupsAnyHierarchyWithCpuMemoryFreezerTest, ROOT_CGROUPS_DestroyMany)
+{
+  std::string hierarchy = path::join(baseHierarchy, "freezer");
+  ASSERT_SOME(cgroups::create(hierarchy, TEST_CGROUPS_ROOT));
+
+  std::vector<std::string> cgroups;
+  for (int i = 0; i < 10; i++) {
+    const std::string cgroup = path::join(TEST_CGROUPS_ROOT, stringify(i));
+    ASSERT_SOME(cgroups::create(hierarchy, cgroup));
+    cgroups.push_back(cgroup);
+  }
+
+  // Destroy the cgroups a few at a time.
+  Future<Nothing> future = cgroups::destroy(hierarchy, cgroups, 3);
+  AWAIT_READY(future);
+
+  foreach (const std::string& cgroup, cgroups) {
+    Try<bool> exists = cgroups::exists(hierarchy, cgroup);
+    ASSERT_SOME(exists);
+    EXPECT_FALSE(exists.get());
+  }
+
+  // Destroying cgroups that no longer exist fails, once all of them
+  // have been attempted.
+  future = cgroups::destroy(hierarchy, cgroups, 3);
+  AWAIT_FAILED(future);
+}
@@ -188,6 +188,9 @@ void TestContainerizer::setup()
 
   EXPECT_CALL(*this, update(testing::_, testing::_))
     .WillRepeatedly(testing::Return(Nothing()));
+
+  EXPECT_CALL(*this, pressure(testing::_))
+    .WillRepeatedly(testing::Return(process::Failure("Not supported")));
 }
 
 } // namespace tests {
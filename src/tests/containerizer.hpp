@@ -94,6 +94,10 @@ public:
       usage,
       process::Future<ResourceStatistics>(const ContainerID&));
 
+  MOCK_METHOD1(
+      pressure,
+      process::Future<Nothing>(const ContainerID&));
+
 private:
   void setup();
 
@@ -62,6 +62,7 @@ Environment* environment;
 //   'CGROUPS_' : Disable test if cgroups support isn't present.
 //   'NOHIERARCHY_' : Disable test if there is already a cgroups
 //       hierarchy mounted.
+//   'BENCHMARK_' : Disable test unless --benchmark is set.
 //
 // These flags can be composed in any order, but must come after
 // 'DISABLED_'. In addition, we disable tests that attempt to use the
@@ -85,6 +86,10 @@ static bool enable(const ::testing::TestInfo& test)
       return false;
     }
 
+    if (strings::contains(name, "BENCHMARK_") && !tests::flags.benchmark) {
+      return false;
+    }
+
 #ifdef __linux__
     if (strings::contains(name, "NOHIERARCHY_")) {
       Try<std::set<std::string> > hierarchies = cgroups::hierarchies();
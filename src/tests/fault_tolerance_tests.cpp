@@ -37,6 +37,9 @@
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
 
+#include <stout/foreach.hpp>
+#include <stout/json.hpp>
+#include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
 
 #include "common/protobuf_utils.hpp"
@@ -658,6 +661,95 @@ TEST_F(FaultToleranceTest, MasterFailover)
 }
 
 
+// Measures how long it takes a failed over master to handle the
+// re-registrations of many slaves that all re-register at once.
+TEST_F(FaultToleranceTest, BENCHMARK_ReregisterSlavesThroughput)
+{
+  const size_t slaves = 1000;
+  const size_t tasks = 10; // Per slave.
+
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  // Each slave re-registers from a process of its own, which, unlike
+  // a pid without a process, does not make the master see the slave
+  // exit right away. The master handles the messages of one slave in
+  // order, hence a process per slave.
+  vector<process::ProcessBase*> processes;
+  for (size_t i = 0; i < slaves; i++) {
+    processes.push_back(new process::ProcessBase());
+    process::spawn(processes.back());
+  }
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+
+  vector<ReregisterSlaveMessage> messages;
+  for (size_t i = 0; i < slaves; i++) {
+    ReregisterSlaveMessage message;
+    message.mutable_slave_id()->set_value("slave-" + stringify(i));
+
+    SlaveInfo* slaveInfo = message.mutable_slave();
+    slaveInfo->set_hostname("host-" + stringify(i));
+    slaveInfo->set_checkpoint(true);
+    slaveInfo->mutable_id()->MergeFrom(message.slave_id());
+    slaveInfo->mutable_resources()->MergeFrom(
+        Resources::parse("cpus:" + stringify(tasks) +
+                         ";mem:" + stringify(tasks * 32)).get());
+
+    for (size_t j = 0; j < tasks; j++) {
+      Task* task = message.add_tasks();
+      task->set_name("");
+      task->mutable_task_id()->set_value(
+          stringify(i) + "-" + stringify(j));
+      task->mutable_framework_id()->MergeFrom(frameworkId);
+      task->mutable_slave_id()->MergeFrom(message.slave_id());
+      task->set_state(TASK_RUNNING);
+      task->mutable_resources()->MergeFrom(
+          Resources::parse("cpus:1;mem:32").get());
+    }
+
+    messages.push_back(message);
+  }
+
+  Clock::pause();
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  for (size_t i = 0; i < slaves; i++) {
+    process::post(processes[i]->self(), master.get(), messages[i]);
+  }
+
+  Clock::settle();
+
+  std::cout << "Re-registered " << slaves << " slaves with " << tasks
+            << " tasks each in " << stopwatch.elapsed() << std::endl;
+
+  // Make sure that all the slaves were actually re-registered.
+  Future<Response> response = process::http::get(master.get(), "stats.json");
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  Try<JSON::Object> stats = JSON::parse<JSON::Object>(response.get().body);
+  ASSERT_SOME(stats);
+  ASSERT_EQ(1u, stats.get().values.count("activated_slaves"));
+
+  JSON::Value activated = stats.get().values.find("activated_slaves")->second;
+  ASSERT_TRUE(activated.is<JSON::Number>());
+  EXPECT_EQ(slaves, (size_t) activated.as<JSON::Number>().value);
+
+  Clock::resume();
+
+  foreach (process::ProcessBase* process, processes) {
+    process::terminate(process);
+    process::wait(process);
+    delete process;
+  }
+
+  Shutdown();
+}
+
+
 // TODO(adam-mesos): Use real JSON parser (see stout/json.hpp TODOs).
 bool isJsonValueEmpty(const string& text, const string& key)
 {
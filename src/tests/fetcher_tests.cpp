@@ -0,0 +1,267 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <process/future.hpp>
+#include <process/http.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+#include <stout/none.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "slave/extractor.hpp"
+#include "slave/fetcher_cache.hpp"
+
+#include "tests/utils.hpp"
+
+using namespace mesos::internal;
+using namespace mesos::internal::tests;
+
+using mesos::internal::slave::Extractor;
+using mesos::internal::slave::FetcherCache;
+
+using process::Future;
+using process::Process;
+
+using process::http::Request;
+using process::http::Response;
+
+using std::string;
+
+
+class ExtractorTest : public TemporaryDirectoryTest {};
+
+
+class FetcherCacheTest : public TemporaryDirectoryTest {};
+
+
+// Stands in for an HTTP server with a single file, which it only
+// sends when the client's copy is out of date (per its ETag).
+class HttpProcess : public Process<HttpProcess>
+{
+public:
+  HttpProcess() : ProcessBase("server") {}
+
+  string url() const
+  {
+    const string pid = stringify(self());
+    return "http://" + pid.substr(pid.find('@') + 1) + "/server/file";
+  }
+
+protected:
+  virtual void initialize()
+  {
+    route("/file", None(), &HttpProcess::file);
+  }
+
+private:
+  Future<Response> file(const Request& request)
+  {
+    if (request.headers.get("If-None-Match") == Option<string>("\"1\"")) {
+      Response response("");
+      response.status = "304 Not Modified";
+      return response;
+    }
+
+    Response response("content");
+    response.status = "200 OK";
+    response.headers["ETag"] = "\"1\"";
+    return response;
+  }
+};
+
+
+TEST_F(FetcherCacheTest, Http)
+{
+  HttpProcess server;
+  process::spawn(server);
+
+  FetcherCache cache(path::join(os::getcwd(), "cache"), Megabytes(1));
+
+  ASSERT_SOME(os::mkdir("sandbox1"));
+  ASSERT_SOME(cache.fetch(server.url(), "sandbox1/file"));
+
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_SOME_EQ("content", os::read("sandbox1/file"));
+
+  // The server confirms that the cached copy is current, so the file
+  // does not get sent again.
+  ASSERT_SOME(os::mkdir("sandbox2"));
+  ASSERT_SOME(cache.fetch(server.url(), "sandbox2/file"));
+
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_SOME_EQ("content", os::read("sandbox2/file"));
+
+  process::terminate(server);
+  process::wait(server);
+}
+
+
+TEST_F(FetcherCacheTest, LocalFile)
+{
+  const string file = path::join(os::getcwd(), "file");
+  ASSERT_SOME(os::write(file, "content"));
+
+  FetcherCache cache(path::join(os::getcwd(), "cache"), Megabytes(1));
+
+  ASSERT_SOME(os::mkdir("sandbox1"));
+  ASSERT_SOME(cache.fetch(file, "sandbox1/file"));
+
+  ASSERT_SOME(os::mkdir("sandbox2"));
+  ASSERT_SOME(cache.fetch(file, "sandbox2/file"));
+
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_SOME_EQ("content", os::read("sandbox2/file"));
+
+  // Changing a fetched copy does not change the cached copy.
+  ASSERT_SOME(os::write("sandbox2/file", "changed"));
+
+  ASSERT_SOME(os::mkdir("sandbox3"));
+  ASSERT_SOME(cache.fetch(file, "sandbox3/file"));
+
+  EXPECT_EQ(2u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_SOME_EQ("content", os::read("sandbox3/file"));
+
+  // A file of a different size is fetched again.
+  ASSERT_SOME(os::write(file, "new content"));
+
+  ASSERT_SOME(os::mkdir("sandbox4"));
+  ASSERT_SOME(cache.fetch(file, "sandbox4/file"));
+
+  EXPECT_EQ(2u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+  EXPECT_SOME_EQ("new content", os::read("sandbox4/file"));
+
+  // The sandboxes that were fetched before keep their copy.
+  EXPECT_SOME_EQ("content", os::read("sandbox1/file"));
+}
+
+
+TEST_F(FetcherCacheTest, Evict)
+{
+  const string file1 = path::join(os::getcwd(), "file1");
+  const string file2 = path::join(os::getcwd(), "file2");
+  ASSERT_SOME(os::write(file1, "content1"));
+  ASSERT_SOME(os::write(file2, "content2"));
+
+  // The cache only fits one of the files.
+  FetcherCache cache(path::join(os::getcwd(), "cache"), Bytes(10));
+
+  ASSERT_SOME(os::mkdir("sandbox"));
+  ASSERT_SOME(cache.fetch(file1, "sandbox/file1"));
+  ASSERT_SOME(cache.fetch(file2, "sandbox/file2"));
+
+  EXPECT_EQ(2u, cache.misses());
+
+  // The least recently used file got evicted.
+  ASSERT_SOME(os::rm("sandbox/file1"));
+  ASSERT_SOME(cache.fetch(file1, "sandbox/file1"));
+
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(3u, cache.misses());
+
+  // The file that was still cached got evicted in turn.
+  ASSERT_SOME(os::rm("sandbox/file2"));
+  ASSERT_SOME(cache.fetch(file2, "sandbox/file2"));
+
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(4u, cache.misses());
+
+  // Only the entry still cached has a lock file (besides the lock
+  // file for evicting).
+  size_t locks = 0;
+  foreach (const string& name, os::ls("cache")) {
+    if (strings::endsWith(name, ".lock")) {
+      locks++;
+    }
+  }
+
+  EXPECT_EQ(2u, locks);
+}
+
+
+// Extracts an archive fed in small pieces, as it would be while
+// being downloaded.
+TEST_F(ExtractorTest, Stream)
+{
+  ASSERT_SOME(os::mkdir("archive/dir"));
+  ASSERT_SOME(os::write("archive/dir/file", "content"));
+  ASSERT_TRUE(os::chmod("archive/dir/file", S_IRWXU));
+  ASSERT_SOME(os::write("archive/" + string(150, 'x'), "long name"));
+  ASSERT_EQ(0, os::system("ln -s dir/file archive/link"));
+  ASSERT_EQ(0, os::system("tar -C archive -czf archive.tar.gz ."));
+
+  bool compressed;
+  ASSERT_TRUE(Extractor::extractable("archive.tar.gz", &compressed));
+  EXPECT_TRUE(compressed);
+
+  // Plain tarballs are left as they are, like before.
+  EXPECT_FALSE(Extractor::extractable("archive.tar", &compressed));
+
+  Try<string> archive = os::read("archive.tar.gz");
+  ASSERT_SOME(archive);
+
+  ASSERT_SOME(os::mkdir("sandbox"));
+  Extractor extractor("sandbox", compressed);
+
+  for (size_t i = 0; i < archive.get().size(); i += 100) {
+    const string piece = archive.get().substr(i, 100);
+    ASSERT_SOME(extractor.write(piece.data(), piece.size()));
+  }
+
+  ASSERT_SOME(extractor.finish());
+
+  EXPECT_SOME_EQ("content", os::read("sandbox/dir/file"));
+  EXPECT_SOME_EQ("content", os::read("sandbox/link"));
+  EXPECT_SOME_EQ("long name", os::read("sandbox/" + string(150, 'x')));
+
+  struct stat s;
+  ASSERT_EQ(0, ::stat("sandbox/dir/file", &s));
+  EXPECT_EQ(S_IRWXU, s.st_mode & 0777);
+}
+
+
+TEST_F(ExtractorTest, Truncated)
+{
+  ASSERT_SOME(os::mkdir("archive"));
+  ASSERT_SOME(os::write("archive/file", string(10000, 'x')));
+  ASSERT_EQ(0, os::system("tar -C archive -cf archive.tar ."));
+
+  Try<string> archive = os::read("archive.tar");
+  ASSERT_SOME(archive);
+
+  ASSERT_SOME(os::mkdir("sandbox"));
+  Extractor extractor("sandbox", false);
+
+  ASSERT_SOME(extractor.write(archive.get().data(), 5000));
+  EXPECT_ERROR(extractor.finish());
+}
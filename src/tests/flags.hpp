@@ -60,11 +60,17 @@ public:
         "build_dir",
         "Where to find the build directory",
         path.get());
+
+    add(&Flags::benchmark,
+        "benchmark",
+        "Run the benchmark tests (prefixed with 'BENCHMARK_')",
+        false);
   }
 
   bool verbose;
   std::string source_dir;
   std::string build_dir;
+  bool benchmark;
 };
 
 // Global flags for running the tests.
@@ -34,10 +34,15 @@
 #include <process/pid.hpp>
 #include <process/process.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/duration.hpp>
+#include <stout/foreach.hpp>
 #include <stout/gtest.hpp>
 #include <stout/nothing.hpp>
 #include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
 
 #include "logging/logging.hpp"
 
@@ -64,6 +69,8 @@ using mesos::internal::master::Master;
 
 using mesos::internal::slave::GarbageCollector;
 using mesos::internal::slave::GarbageCollectorProcess;
+using mesos::internal::slave::GC_WORKERS;
+using mesos::internal::slave::RemovalThrottle;
 using mesos::internal::slave::Slave;
 
 using process::Clock;
@@ -246,6 +253,116 @@ TEST_F(GarbageCollectorTest, Prune)
 }
 
 
+// Removes a directory tree, without following symbolic links out of
+// it.
+TEST_F(GarbageCollectorTest, RemoveTree)
+{
+  GarbageCollector gc;
+
+  ASSERT_SOME(os::mkdir("sandbox/a/b"));
+  ASSERT_SOME(os::write("sandbox/a/b/file", "content"));
+  ASSERT_SOME(os::write("sandbox/file", "content"));
+  ASSERT_SOME(os::write("outside", "content"));
+  ASSERT_EQ(0, os::system("ln -s ../outside sandbox/a/link"));
+  ASSERT_EQ(0, os::system("ln -s .. sandbox/a/b/parent"));
+
+  Clock::pause();
+
+  Future<Nothing> schedule = gc.schedule(Seconds(10), "sandbox");
+
+  Clock::advance(Seconds(10));
+  Clock::settle();
+
+  AWAIT_READY(schedule);
+
+  EXPECT_FALSE(os::exists("sandbox"));
+  EXPECT_SOME_EQ("content", os::read("outside"));
+
+  Clock::resume();
+}
+
+
+// The throttle holds back each caller until the bytes acquired
+// before it could have been deleted at the rate.
+TEST_F(GarbageCollectorTest, Throttle)
+{
+  RemovalThrottle throttle(Kilobytes(100));
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // The first acquire goes through right away.
+  throttle.acquire(Kilobytes(10));
+  EXPECT_GT(Milliseconds(50), stopwatch.elapsed());
+
+  throttle.acquire(Kilobytes(10));
+  throttle.acquire(Kilobytes(10));
+
+  // NOTE: We allow some slack for the difference between the clock
+  // of the throttle and the one of the stopwatch.
+  EXPECT_LE(Milliseconds(190), stopwatch.elapsed());
+}
+
+
+// A path that is due but waiting for a worker can be unscheduled,
+// while unscheduling a path that is being removed waits for the
+// removal.
+TEST_F(GarbageCollectorTest, UnscheduleQueued)
+{
+  // Each sandbox holds two files, which the (shared) throttle lets
+  // through one every ~50ms, so that all the workers are still busy
+  // when we unschedule the last sandbox.
+  GarbageCollector gc(Megabytes(10));
+
+  const string content(512 * 1024, 'x');
+
+  vector<string> sandboxes;
+  for (uint32_t i = 0; i <= GC_WORKERS; i++) {
+    const string sandbox = "sandbox" + stringify(i);
+    ASSERT_SOME(os::mkdir(sandbox));
+    ASSERT_SOME(os::write(path::join(sandbox, "file1"), content));
+    ASSERT_SOME(os::write(path::join(sandbox, "file2"), content));
+    sandboxes.push_back(sandbox);
+  }
+
+  Clock::pause();
+
+  vector<Future<Nothing> > schedules;
+  foreach (const string& sandbox, sandboxes) {
+    schedules.push_back(gc.schedule(Seconds(10), sandbox));
+  }
+
+  Clock::advance(Seconds(10));
+  Clock::settle();
+
+  // The last sandbox is queued behind the busy workers.
+  AWAIT_ASSERT_EQ(true, gc.unschedule(sandboxes.back()));
+  AWAIT_DISCARDED(schedules.back());
+
+  // Rescheduling a sandbox that is being removed waits for that
+  // removal, after which the sandbox is gone.
+  Future<Nothing> reschedule = gc.schedule(Seconds(10), sandboxes[1]);
+
+  Clock::advance(Seconds(10));
+  Clock::settle();
+
+  // The unschedule only completes once the sandbox is removed.
+  AWAIT_ASSERT_EQ(false, gc.unschedule(sandboxes.front()));
+  EXPECT_FALSE(os::exists(sandboxes.front()));
+
+  for (uint32_t i = 0; i < GC_WORKERS; i++) {
+    AWAIT_READY(schedules[i]);
+    EXPECT_FALSE(os::exists(sandboxes[i]));
+  }
+
+  AWAIT_FAILED(reschedule);
+
+  EXPECT_TRUE(os::exists(sandboxes.back()));
+
+  Clock::resume();
+}
+
+
 class GarbageCollectorIntegrationTest : public MesosTest {};
 
 
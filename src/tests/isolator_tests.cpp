@@ -29,8 +29,10 @@
 #include <process/owned.hpp>
 #include <process/reap.hpp>
 
+#include <stout/bytes.hpp>
 #include <stout/os.hpp>
 #include <stout/path.hpp>
+#include <stout/stringify.hpp>
 
 #include "master/master.hpp"
 #include "master/detector.hpp"
@@ -44,6 +46,7 @@
 #include "slave/containerizer/isolator.hpp"
 #include "slave/containerizer/launcher.hpp"
 
+#include "slave/containerizer/isolators/disk.hpp"
 #include "slave/containerizer/isolators/posix.hpp"
 #ifdef __linux__
 #include "slave/containerizer/isolators/cgroups/cpushare.hpp"
@@ -64,12 +67,16 @@ using mesos::internal::master::Master;
 using mesos::internal::slave::CgroupsCpushareIsolatorProcess;
 using mesos::internal::slave::CgroupsLauncher;
 using mesos::internal::slave::CgroupsMemIsolatorProcess;
+using mesos::internal::slave::DiskUsageScanner;
+using mesos::internal::slave::DiskUsageWatcher;
 #endif // __linux__
 using mesos::internal::slave::Isolator;
 using mesos::internal::slave::IsolatorProcess;
 using mesos::internal::slave::Launcher;
+using mesos::internal::slave::Limitation;
 using mesos::internal::slave::PosixLauncher;
 using mesos::internal::slave::PosixCpuIsolatorProcess;
+using mesos::internal::slave::PosixDiskIsolatorProcess;
 using mesos::internal::slave::PosixMemIsolatorProcess;
 using mesos::internal::slave::Flags;
 
@@ -131,7 +138,10 @@ TYPED_TEST(CpuIsolatorTest, UserCpuUsage)
   ContainerID containerId;
   containerId.set_value("user_cpu_usage");
 
-  AWAIT_READY(isolator.get()->prepare(containerId, executorInfo));
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      os::getcwd()));
 
   Try<string> dir = os::mkdtemp();
   ASSERT_SOME(dir);
@@ -221,7 +231,10 @@ TYPED_TEST(CpuIsolatorTest, SystemCpuUsage)
   ContainerID containerId;
   containerId.set_value("system_cpu_usage");
 
-  AWAIT_READY(isolator.get()->prepare(containerId, executorInfo));
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      os::getcwd()));
 
   Try<string> dir = os::mkdtemp();
   ASSERT_SOME(dir);
@@ -319,7 +332,10 @@ TEST_F(LimitedCpuIsolatorTest, ROOT_CGROUPS_Cfs)
   ContainerID containerId;
   containerId.set_value("mesos_test_cfs_cpu_limit");
 
-  AWAIT_READY(isolator.get()->prepare(containerId, executorInfo));
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      os::getcwd()));
 
   // Generate random numbers to max out a single core. We'll run this for 0.5
   // seconds of wall time so it should consume approximately 250 ms of total
@@ -406,7 +422,10 @@ TEST_F(LimitedCpuIsolatorTest, ROOT_CGROUPS_Cfs_Big_Quota)
   ContainerID containerId;
   containerId.set_value("mesos_test_cfs_big_cpu_limit");
 
-  AWAIT_READY(isolator.get()->prepare(containerId, executorInfo));
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      os::getcwd()));
 
   int pipes[2];
   ASSERT_NE(-1, ::pipe(pipes));
@@ -515,7 +534,10 @@ TYPED_TEST(MemIsolatorTest, MemUsage)
   ContainerID containerId;
   containerId.set_value("memory_usage");
 
-  AWAIT_READY(isolator.get()->prepare(containerId, executorInfo));
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      os::getcwd()));
 
   int pipes[2];
   ASSERT_NE(-1, ::pipe(pipes));
@@ -576,3 +598,176 @@ TYPED_TEST(MemIsolatorTest, MemUsage)
   delete isolator.get();
   delete launcher.get();
 }
+
+
+class DiskIsolatorTest : public MesosTest {};
+
+
+TEST_F(DiskIsolatorTest, DiskUsage)
+{
+  Flags flags;
+  flags.container_disk_watch_interval = Milliseconds(10);
+  flags.enforce_container_disk_quota = true;
+
+  Try<Isolator*> isolator = PosixDiskIsolatorProcess::create(flags);
+  CHECK_SOME(isolator);
+
+  Try<string> directory = os::mkdtemp();
+  ASSERT_SOME(directory);
+
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_resources()->CopyFrom(
+      Resources::parse("disk:1").get());
+
+  ContainerID containerId;
+  containerId.set_value("disk_usage");
+
+  AWAIT_READY(isolator.get()->prepare(
+      containerId,
+      executorInfo,
+      directory.get()));
+
+  AWAIT_READY(isolator.get()->update(containerId, executorInfo.resources()));
+
+  Future<Limitation> limitation = isolator.get()->watch(containerId);
+
+  // Use more than the 1MB of disk allocated, in a nested directory.
+  ASSERT_SOME(os::mkdir(path::join(directory.get(), "nested")));
+  ASSERT_SOME(os::write(
+      path::join(directory.get(), "nested", "file"),
+      string(Megabytes(2).bytes(), 'x')));
+
+  AWAIT_READY(limitation);
+  EXPECT_EQ("disk", limitation.get().resource.name());
+
+  Future<ResourceStatistics> usage = isolator.get()->usage(containerId);
+  AWAIT_READY(usage);
+
+  EXPECT_LE(Megabytes(2).bytes(), usage.get().disk_used_bytes());
+
+  // Let the isolator clean up.
+  AWAIT_READY(isolator.get()->cleanup(containerId));
+
+  delete isolator.get();
+
+  CHECK_SOME(os::rmdir(directory.get()));
+}
+
+
+class DiskUsageScannerTest : public TemporaryDirectoryTest
+{
+protected:
+  // Scans until the scan completes, returning the usage.
+  static Bytes scan(DiskUsageScanner* scanner)
+  {
+    size_t budget = 1000000;
+    while (!scanner->scan(&budget)) {
+      budget = 1000000;
+    }
+    return scanner->usage();
+  }
+
+  // Checks that the scanner follows files and directories as they
+  // grow, shrink and get removed.
+  static void rescan(DiskUsageScanner* scanner)
+  {
+    const string& root = scanner->root;
+
+    ASSERT_SOME(os::mkdir(path::join(root, "nested")));
+    ASSERT_SOME(os::write(
+        path::join(root, "file"), string(Megabytes(1).bytes(), 'x')));
+    ASSERT_SOME(os::write(
+        path::join(root, "nested", "file"),
+        string(Megabytes(2).bytes(), 'x')));
+
+    Bytes usage = scan(scanner);
+    EXPECT_LE(Megabytes(3), usage);
+    EXPECT_GT(Megabytes(4), usage);
+
+    // Shrink a file.
+    ASSERT_SOME(os::write(path::join(root, "file"), "x"));
+
+    usage = scan(scanner);
+    EXPECT_LE(Megabytes(2), usage);
+    EXPECT_GT(Megabytes(3), usage);
+
+    // Delete a file.
+    ASSERT_SOME(os::rm(path::join(root, "nested", "file")));
+
+    usage = scan(scanner);
+    EXPECT_GT(Megabytes(1), usage);
+
+    // Grow and then delete a whole directory.
+    ASSERT_SOME(os::write(
+        path::join(root, "nested", "file"),
+        string(Megabytes(2).bytes(), 'x')));
+
+    EXPECT_LE(Megabytes(2), scan(scanner));
+
+    ASSERT_SOME(os::rmdir(path::join(root, "nested")));
+
+    EXPECT_GT(Megabytes(1), scan(scanner));
+  }
+};
+
+
+TEST_F(DiskUsageScannerTest, Rescan)
+{
+  DiskUsageWatcher watcher;
+  DiskUsageScanner scanner(os::getcwd(), &watcher);
+
+  rescan(&scanner);
+}
+
+
+// Without inotify, every scan lists and stats all the entries.
+TEST_F(DiskUsageScannerTest, RescanWithoutWatcher)
+{
+  DiskUsageScanner scanner(os::getcwd());
+
+  rescan(&scanner);
+}
+
+
+// The budget holds even within a directory with many entries.
+TEST_F(DiskUsageScannerTest, Budget)
+{
+  for (int i = 0; i < 100; i++) {
+    ASSERT_SOME(os::write("file" + stringify(i), string(4096, 'x')));
+  }
+
+  DiskUsageWatcher watcher;
+  DiskUsageScanner scanner(os::getcwd(), &watcher);
+
+  // The 100 files (and the directory) take over 10 batches of 10.
+  size_t batches = 0;
+  bool done = false;
+  while (!done) {
+    size_t budget = 10;
+    done = scanner.scan(&budget);
+    batches++;
+
+    ASSERT_GT(20u, batches);
+  }
+
+  EXPECT_LE(10u, batches);
+  EXPECT_LE(Bytes(100 * 4096), scanner.usage());
+
+  // The same goes for rescanning the files that were written to.
+  for (int i = 0; i < 100; i++) {
+    ASSERT_SOME(os::write("file" + stringify(i), string(8192, 'x')));
+  }
+
+  batches = 0;
+  done = false;
+  while (!done) {
+    size_t budget = 10;
+    done = scanner.scan(&budget);
+    batches++;
+
+    ASSERT_GT(20u, batches);
+  }
+
+  EXPECT_LE(10u, batches);
+  EXPECT_LE(Bytes(100 * 8192), scanner.usage());
+}
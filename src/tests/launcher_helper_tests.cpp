@@ -0,0 +1,343 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+#include <gmock/gmock.h>
+
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <process/collect.hpp>
+#include <process/future.hpp>
+#include <process/gtest.hpp>
+#include <process/reap.hpp>
+
+#include <stout/abort.hpp>
+#include <stout/bytes.hpp>
+#include <stout/gtest.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "slave/flags.hpp"
+
+#include "slave/containerizer/containerizer.hpp"
+#include "slave/containerizer/launcher.hpp"
+#include "slave/containerizer/launcher_helper.hpp"
+#include "slave/containerizer/mesos_containerizer.hpp"
+
+#include "tests/mesos.hpp"
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::tests;
+
+using namespace process;
+
+using mesos::internal::slave::Containerizer;
+using mesos::internal::slave::Launcher;
+using mesos::internal::slave::LauncherHelper;
+using mesos::internal::slave::MesosContainerizer;
+using mesos::internal::slave::PosixLauncher;
+using mesos::internal::slave::Slave;
+
+using std::list;
+using std::string;
+using std::vector;
+
+
+class LauncherHelperTest : public MesosTest {};
+
+
+TEST_F(LauncherHelperTest, ForkExec)
+{
+  Try<LauncherHelper*> helper = LauncherHelper::create(CreateSlaveFlags());
+  ASSERT_SOME(helper);
+
+  Try<string> directory = os::mkdtemp();
+  ASSERT_SOME(directory);
+
+  LauncherHelperRequest request;
+  request.set_type(LauncherHelperRequest::FORK);
+  request.set_command("echo $VARIABLE > file; exit 3");
+  request.set_directory(directory.get());
+  request.set_wait(true);
+
+  Environment::Variable* variable =
+    request.mutable_environment()->add_variables();
+  variable->set_name("VARIABLE");
+  variable->set_value("value");
+
+  Future<pid_t> pid = helper.get()->fork(request);
+  AWAIT_READY(pid);
+
+  // The process is in a session of its own.
+  EXPECT_EQ(pid.get(), ::getsid(pid.get()));
+
+  Future<Option<int> > status = helper.get()->status(pid.get());
+
+  // The process waits to be let run its command.
+  os::sleep(Milliseconds(50));
+  EXPECT_TRUE(status.isPending());
+  EXPECT_FALSE(os::exists(path::join(directory.get(), "file")));
+
+  AWAIT_READY(helper.get()->exec(pid.get()));
+
+  AWAIT_READY(status);
+  ASSERT_SOME(status.get());
+  EXPECT_TRUE(WIFEXITED(status.get().get()));
+  EXPECT_EQ(3, WEXITSTATUS(status.get().get()));
+
+  EXPECT_SOME_EQ("value\n", os::read(path::join(directory.get(), "file")));
+
+  delete helper.get();
+
+  CHECK_SOME(os::rmdir(directory.get()));
+}
+
+
+// The processes waiting to run their command exit along with the
+// helper.
+TEST_F(LauncherHelperTest, Stop)
+{
+  Try<LauncherHelper*> helper = LauncherHelper::create(CreateSlaveFlags());
+  ASSERT_SOME(helper);
+
+  LauncherHelperRequest request;
+  request.set_type(LauncherHelperRequest::FORK);
+  request.set_command("sleep 1000");
+  request.set_wait(true);
+
+  Future<pid_t> pid = helper.get()->fork(request);
+  AWAIT_READY(pid);
+
+  delete helper.get();
+
+  Duration waited = Duration::zero();
+  do {
+    if (os::process(pid.get()).isNone()) {
+      break;
+    }
+    os::sleep(Milliseconds(10));
+    waited += Milliseconds(10);
+  } while (waited < Seconds(5));
+
+  EXPECT_NONE(os::process(pid.get()));
+}
+
+
+class LauncherHelperContainerizerTest
+  : public ContainerizerTest<MesosContainerizer> {};
+
+
+// Launches an executor through a MesosContainerizer that uses the
+// launcher helper: the URIs are fetched with the fetcher's output in
+// the sandbox, the executor runs once it is isolated, and its exit
+// status is reported back through the helper.
+TEST_F(LauncherHelperContainerizerTest, Launch)
+{
+  slave::Flags flags = CreateSlaveFlags();
+  flags.launcher_helper = true;
+
+  Try<Containerizer*> containerizer = Containerizer::create(flags, false);
+  ASSERT_SOME(containerizer);
+
+  Try<string> directory = os::mkdtemp(path::join(flags.work_dir, "XXXXXX"));
+  ASSERT_SOME(directory);
+
+  const string uri = path::join(flags.work_dir, "uri");
+  ASSERT_SOME(os::write(uri, "fetched"));
+
+  ExecutorInfo executorInfo = CREATE_EXECUTOR_INFO(
+      "executor", "cat uri > copy; echo executed; exit 3");
+  executorInfo.mutable_resources()->MergeFrom(
+      Resources::parse("cpus:1;mem:64").get());
+  executorInfo.mutable_command()->add_uris()->set_value(uri);
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  Future<Nothing> launch = containerizer.get()->launch(
+      containerId,
+      executorInfo,
+      directory.get(),
+      None(),
+      SlaveID(),
+      PID<Slave>(),
+      false);
+
+  // Wait before the executor can exit, after which the container is
+  // no longer known.
+  Future<Containerizer::Termination> termination =
+    containerizer.get()->wait(containerId);
+
+  AWAIT_READY(launch);
+
+  AWAIT_READY(termination);
+  ASSERT_SOME(termination.get().status);
+  EXPECT_TRUE(WIFEXITED(termination.get().status.get()));
+  EXPECT_EQ(3, WEXITSTATUS(termination.get().status.get()));
+
+  EXPECT_SOME_EQ("fetched", os::read(path::join(directory.get(), "copy")));
+
+  // The fetcher logged to the sandbox before the executor appended
+  // its own output.
+  Try<string> read = os::read(path::join(directory.get(), "stderr"));
+  ASSERT_SOME(read);
+  EXPECT_TRUE(strings::contains(read.get(), "Fetching URI"));
+
+  read = os::read(path::join(directory.get(), "stdout"));
+  ASSERT_SOME(read);
+  EXPECT_TRUE(strings::contains(read.get(), "executed"));
+
+  delete containerizer.get();
+}
+
+
+// The executors forked by the launcher helper are adopted by the
+// launcher and isolated, so that their usage is known and destroying
+// their container kills them.
+TEST_F(LauncherHelperContainerizerTest, Destroy)
+{
+  slave::Flags flags = CreateSlaveFlags();
+  flags.launcher_helper = true;
+
+  Try<Containerizer*> containerizer = Containerizer::create(flags, false);
+  ASSERT_SOME(containerizer);
+
+  Try<string> directory = os::mkdtemp(path::join(flags.work_dir, "XXXXXX"));
+  ASSERT_SOME(directory);
+
+  ExecutorInfo executorInfo = CREATE_EXECUTOR_INFO("executor", "sleep 1000");
+  executorInfo.mutable_resources()->MergeFrom(
+      Resources::parse("cpus:1;mem:64").get());
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  AWAIT_READY(containerizer.get()->launch(
+      containerId,
+      executorInfo,
+      directory.get(),
+      None(),
+      SlaveID(),
+      PID<Slave>(),
+      false));
+
+  Future<ResourceStatistics> usage = containerizer.get()->usage(containerId);
+  AWAIT_READY(usage);
+  EXPECT_EQ(1.0, usage.get().cpus_limit());
+
+  Future<Containerizer::Termination> termination =
+    containerizer.get()->wait(containerId);
+
+  containerizer.get()->destroy(containerId);
+
+  AWAIT_READY(termination);
+  ASSERT_SOME(termination.get().status);
+  EXPECT_TRUE(WIFSIGNALED(termination.get().status.get()));
+
+  delete containerizer.get();
+}
+
+
+static int execute()
+{
+  execl("/bin/sh", "sh", "-c", "exit 0", (char*) NULL);
+
+  ABORT("Failed to execute command");
+
+  return -1;
+}
+
+
+// Compares how fast processes get launched by forking the slave (as
+// the launcher does) and by the launcher helper, once the slave uses
+// quite some memory.
+TEST_F(LauncherHelperTest, BENCHMARK_LaunchThroughput)
+{
+  const size_t launches = 500;
+
+  // Touch every page so that they all need to be copied on fork.
+  string heap(Megabytes(512).bytes(), 'x');
+
+  slave::Flags flags = CreateSlaveFlags();
+
+  Try<Launcher*> launcher = PosixLauncher::create(flags);
+  ASSERT_SOME(launcher);
+
+  list<Future<Option<int> > > statuses;
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t i = 0; i < launches; i++) {
+    ContainerID containerId;
+    containerId.set_value("fork-" + stringify(i));
+
+    Try<pid_t> pid = launcher.get()->fork(containerId, &execute);
+    ASSERT_SOME(pid);
+
+    statuses.push_back(process::reap(pid.get()));
+  }
+
+  AWAIT_READY_FOR(collect(statuses), Seconds(60));
+
+  std::cout << "Forking the slave: "
+            << launches / watch.elapsed().secs() << " launches/second"
+            << std::endl;
+
+  delete launcher.get();
+
+  Try<LauncherHelper*> helper = LauncherHelper::create(flags);
+  ASSERT_SOME(helper);
+
+  LauncherHelperRequest request;
+  request.set_type(LauncherHelperRequest::FORK);
+  request.set_command("exit 0");
+
+  list<Future<pid_t> > pids;
+
+  watch.start();
+
+  for (size_t i = 0; i < launches; i++) {
+    pids.push_back(helper.get()->fork(request));
+  }
+
+  AWAIT_READY_FOR(collect(pids), Seconds(60));
+
+  statuses.clear();
+  foreach (const Future<pid_t>& pid, pids) {
+    statuses.push_back(helper.get()->status(pid.get()));
+  }
+
+  AWAIT_READY_FOR(collect(statuses), Seconds(60));
+
+  std::cout << "Forking the launcher helper: "
+            << launches / watch.elapsed().secs() << " launches/second"
+            << std::endl;
+
+  delete helper.get();
+}
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 
+#include <iostream>
 #include <list>
 #include <set>
 #include <string>
@@ -34,7 +35,9 @@
 #include <process/protobuf.hpp>
 #include <process/shared.hpp>
 
+#include <stout/duration.hpp>
 #include <stout/gtest.hpp>
+#include <stout/interval.hpp>
 #include <stout/none.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
@@ -315,6 +318,153 @@ TYPED_TEST(LogStorageTest, TruncateWithManyHoles)
 }
 
 
+// Verifies that the restored state reflects the actions persisted
+// out of order, both with and without a checkpoint.
+TYPED_TEST(LogStorageTest, Restore)
+{
+  const string path = os::getcwd() + "/.log";
+
+  {
+    TypeParam storage;
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    // Write enough actions for a checkpoint to be taken, leaving a
+    // hole at position 100 and position 1400 unlearned.
+    for (uint64_t i = 0; i < 1500; i++) {
+      if (i == 100) {
+        continue;
+      }
+
+      Action action;
+      action.set_position(i);
+      action.set_promised(1);
+      action.set_performed(1);
+      action.set_learned(i != 1400);
+      action.set_type(Action::NOP);
+      action.mutable_nop();
+
+      ASSERT_SOME(storage.persist(action));
+    }
+
+    // Truncate to position 10 (at position 1500).
+    Action truncate;
+    truncate.set_position(1500);
+    truncate.set_promised(1);
+    truncate.set_performed(1);
+    truncate.set_learned(true);
+    truncate.set_type(Action::TRUNCATE);
+    truncate.mutable_truncate()->set_to(10);
+
+    ASSERT_SOME(storage.persist(truncate));
+  }
+
+  {
+    TypeParam storage;
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    EXPECT_EQ(10u, state.get().begin);
+    EXPECT_EQ(1500u, state.get().end);
+    EXPECT_FALSE(state.get().learned.contains(9));
+    EXPECT_TRUE(state.get().learned.contains(10));
+    EXPECT_FALSE(state.get().learned.contains(100));
+    EXPECT_FALSE(state.get().learned.contains(1400));
+    EXPECT_TRUE(state.get().learned.contains(1500));
+    EXPECT_EQ(1u, state.get().unlearned.size());
+    EXPECT_TRUE(state.get().unlearned.contains(1400));
+
+    // Fill the hole and learn the unlearned position.
+    Action action;
+    action.set_promised(1);
+    action.set_performed(1);
+    action.set_learned(true);
+    action.set_type(Action::NOP);
+    action.mutable_nop();
+
+    action.set_position(100);
+    ASSERT_SOME(storage.persist(action));
+
+    action.set_position(1400);
+    ASSERT_SOME(storage.persist(action));
+  }
+
+  // Restore twice, the first time around (possibly) without and the
+  // second time around with a checkpoint.
+  for (int i = 0; i < 2; i++) {
+    TypeParam storage;
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    EXPECT_EQ(10u, state.get().begin);
+    EXPECT_EQ(1500u, state.get().end);
+    EXPECT_EQ(1u, state.get().learned.intervalCount());
+    EXPECT_EQ(1491u, state.get().learned.size());
+    EXPECT_TRUE(state.get().learned.contains(10));
+    EXPECT_TRUE(state.get().unlearned.empty());
+
+    ASSERT_SOME(storage.read(100));
+    ASSERT_ERROR(storage.read(9));
+  }
+}
+
+
+// Reports the time it takes to restore a large log, both by reading
+// every action and by using a checkpoint.
+TYPED_TEST(LogStorageTest, BENCHMARK_RestoreTime)
+{
+  const string path = os::getcwd() + "/.log";
+  const uint64_t count = 5000;
+
+  {
+    TypeParam storage;
+    ASSERT_SOME(storage.restore(path));
+
+    Action action;
+    action.set_promised(1);
+    action.set_performed(1);
+    action.set_learned(true);
+    action.set_type(Action::APPEND);
+    action.mutable_append()->set_bytes(string(1024, 'a'));
+
+    for (uint64_t i = 1; i <= count; i++) {
+      action.set_position(i);
+      ASSERT_SOME(storage.persist(action));
+    }
+
+    // Writing position 0 last (out of order) means that the next
+    // restore can't rely on the latest checkpoint.
+    action.set_position(0);
+    ASSERT_SOME(storage.persist(action));
+  }
+
+  Duration durations[2];
+
+  for (int i = 0; i < 2; i++) {
+    TypeParam storage;
+
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    Try<Storage::State> state = storage.restore(path);
+    ASSERT_SOME(state);
+
+    durations[i] = stopwatch.elapsed();
+
+    EXPECT_EQ(count, state.get().end);
+    EXPECT_EQ(1u, state.get().learned.intervalCount());
+    EXPECT_EQ(count + 1, state.get().learned.size());
+  }
+
+  std::cout << "Restored " << count + 1 << " positions in " << durations[0]
+            << " without a checkpoint and in " << durations[1]
+            << " with a checkpoint" << std::endl;
+}
+
+
 class ReplicaTest : public TemporaryDirectoryTest
 {
 protected:
@@ -30,13 +30,20 @@
 #include <process/clock.hpp>
 #include <process/future.hpp>
 #include <process/gmock.hpp>
+#include <process/http.hpp>
 #include <process/owned.hpp>
 #include <process/pid.hpp>
 
+#include <stout/bytes.hpp>
+#include <stout/json.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
 #include <stout/try.hpp>
+#include <stout/uuid.hpp>
 
+#include "master/constants.hpp"
 #include "master/flags.hpp"
 #include "master/master.hpp"
 
@@ -57,6 +64,7 @@ using namespace mesos;
 using namespace mesos::internal;
 using namespace mesos::internal::tests;
 
+using mesos::internal::master::CompletedTasks;
 using mesos::internal::master::Master;
 
 using mesos::internal::slave::GarbageCollectorProcess;
@@ -68,6 +76,10 @@ using process::Clock;
 using process::Future;
 using process::Owned;
 using process::PID;
+using process::UPID;
+
+using process::http::OK;
+using process::http::Response;
 
 using std::map;
 using std::string;
@@ -1114,6 +1126,299 @@ TEST_F(MasterTest, ReconcileTaskTest)
 }
 
 
+// Returns the value of the master's stat 'name', or -1 if it cannot
+// be determined.
+static double stat(const PID<Master>& master, const string& name)
+{
+  Future<Response> response = process::http::get(master, "stats.json");
+  if (!response.await(Seconds(10)) || !response.isReady()) {
+    return -1;
+  }
+
+  Try<JSON::Object> stats = JSON::parse<JSON::Object>(response.get().body);
+  if (stats.isError() || stats.get().values.count(name) == 0) {
+    return -1;
+  }
+
+  const JSON::Value& value = stats.get().values.find(name)->second;
+  if (!value.is<JSON::Number>()) {
+    return -1;
+  }
+
+  return value.as<JSON::Number>().value;
+}
+
+
+// Reconciliation handles the statuses in batches of at most
+// MAX_RECONCILIATIONS_PER_BATCH; the ones past the first batch must
+// still be reconciled.
+TEST_F(MasterTest, ReconcileTasksInBatches)
+{
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  MockExecutor exec(DEFAULT_EXECUTOR_ID);
+
+  TestContainerizer containerizer(&exec);
+
+  Try<PID<Slave> > slave = StartSlave(&containerizer);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(LaunchTasks(DEFAULT_EXECUTOR_INFO, 1, 1, 512, "*"))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  EXPECT_CALL(exec, registered(_, _, _, _));
+
+  EXPECT_CALL(exec, launchTask(_, _))
+    .WillOnce(SendStatusUpdateFromTask(TASK_RUNNING));
+
+  Future<TaskStatus> status;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status));
+
+  driver.start();
+
+  AWAIT_READY(status);
+  EXPECT_EQ(TASK_RUNNING, status.get().state());
+
+  // Only the (last) status of the task the master knows about results
+  // in an update; the unknown tasks are ignored.
+  Future<TaskStatus> status2;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status2));
+
+  vector<TaskStatus> statuses;
+
+  for (uint32_t i = 0; i < 2 * master::MAX_RECONCILIATIONS_PER_BATCH; i++) {
+    TaskStatus unknownStatus;
+    unknownStatus.mutable_task_id()->set_value("unknown-" + stringify(i));
+    unknownStatus.mutable_slave_id()->CopyFrom(status.get().slave_id());
+    unknownStatus.set_state(TASK_RUNNING);
+
+    statuses.push_back(unknownStatus);
+  }
+
+  TaskStatus differentStatus;
+  differentStatus.mutable_task_id()->CopyFrom(status.get().task_id());
+  differentStatus.mutable_slave_id()->CopyFrom(status.get().slave_id());
+  differentStatus.set_state(TASK_KILLED);
+
+  statuses.push_back(differentStatus);
+
+  driver.reconcileTasks(statuses);
+
+  AWAIT_READY(status2);
+  EXPECT_EQ(status.get().task_id(), status2.get().task_id());
+  EXPECT_EQ(TASK_RUNNING, status2.get().state());
+
+  EXPECT_CALL(exec, shutdown(_))
+    .Times(AtMost(1));
+
+  driver.stop();
+  driver.join();
+
+  Shutdown(); // Must shutdown before 'containerizer' gets deallocated.
+}
+
+
+// The master counts the tasks in each state as they are launched,
+// updated and removed.
+TEST_F(MasterTest, ActiveTasks)
+{
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  MockExecutor exec(DEFAULT_EXECUTOR_ID);
+
+  TestContainerizer containerizer(&exec);
+
+  Try<PID<Slave> > slave = StartSlave(&containerizer);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(LaunchTasks(DEFAULT_EXECUTOR_INFO, 1, 1, 512, "*"))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  Future<ExecutorDriver*> execDriver;
+  EXPECT_CALL(exec, registered(_, _, _, _))
+    .WillOnce(FutureArg<0>(&execDriver));
+
+  EXPECT_CALL(exec, launchTask(_, _))
+    .WillOnce(SendStatusUpdateFromTask(TASK_RUNNING));
+
+  Future<TaskStatus> status;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status));
+
+  EXPECT_EQ(0, stat(master.get(), "active_tasks"));
+
+  driver.start();
+
+  AWAIT_READY(status);
+  EXPECT_EQ(TASK_RUNNING, status.get().state());
+
+  EXPECT_EQ(1, stat(master.get(), "active_tasks"));
+  EXPECT_EQ(1, stat(master.get(), "active_tasks_gauge"));
+
+  Future<TaskStatus> status2;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status2));
+
+  AWAIT_READY(execDriver);
+
+  TaskStatus finished;
+  finished.mutable_task_id()->CopyFrom(status.get().task_id());
+  finished.set_state(TASK_FINISHED);
+
+  execDriver.get()->sendStatusUpdate(finished);
+
+  AWAIT_READY(status2);
+  EXPECT_EQ(TASK_FINISHED, status2.get().state());
+
+  EXPECT_EQ(0, stat(master.get(), "active_tasks"));
+  EXPECT_EQ(0, stat(master.get(), "active_tasks_gauge"));
+  EXPECT_EQ(1, stat(master.get(), "finished_tasks"));
+
+  EXPECT_CALL(exec, shutdown(_))
+    .Times(AtMost(1));
+
+  driver.stop();
+  driver.join();
+
+  Shutdown(); // Must shutdown before 'containerizer' gets deallocated.
+}
+
+
+// A framework that re-registers before its slaves can reuse the ID
+// of a task on a slave that has yet to re-register. The master keeps
+// the task it knows about rather than aborting on the duplicate.
+TEST_F(MasterTest, ReregisterSlaveWithDuplicateTask)
+{
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  Future<FrameworkID> frameworkId;
+  EXPECT_CALL(sched, registered(&driver, _, _))
+    .WillOnce(FutureArg<1>(&frameworkId));
+
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillRepeatedly(Return());
+
+  driver.start();
+
+  AWAIT_READY(frameworkId);
+
+  // The slaves re-register from a process of their own, which keeps
+  // the master from seeing them exit.
+  process::ProcessBase process;
+  UPID pid = process::spawn(&process);
+
+  for (int i = 0; i < 2; i++) {
+    ReregisterSlaveMessage message;
+    message.mutable_slave_id()->set_value("slave-" + stringify(i));
+
+    SlaveInfo* slaveInfo = message.mutable_slave();
+    slaveInfo->set_hostname("host-" + stringify(i));
+    slaveInfo->mutable_id()->MergeFrom(message.slave_id());
+    slaveInfo->mutable_resources()->MergeFrom(
+        Resources::parse("cpus:2;mem:1024").get());
+
+    Task* task = message.add_tasks();
+    task->set_name("");
+    task->mutable_task_id()->set_value("task");
+    task->mutable_framework_id()->MergeFrom(frameworkId.get());
+    task->mutable_slave_id()->MergeFrom(message.slave_id());
+    task->set_state(TASK_RUNNING);
+    task->mutable_resources()->MergeFrom(
+        Resources::parse("cpus:1;mem:512").get());
+
+    Future<SlaveReregisteredMessage> reregistered =
+      FUTURE_PROTOBUF(SlaveReregisteredMessage(), master.get(), pid);
+
+    process::post(pid, master.get(), message);
+
+    AWAIT_READY(reregistered);
+  }
+
+  EXPECT_EQ(2, stat(master.get(), "activated_slaves"));
+  EXPECT_EQ(1, stat(master.get(), "active_tasks"));
+  EXPECT_EQ(1, stat(master.get(), "active_tasks_gauge"));
+
+  driver.stop();
+  driver.join();
+
+  process::terminate(pid);
+  process::wait(pid);
+
+  Shutdown();
+}
+
+
+// The re-registrations of slaves are parsed concurrently, but the
+// messages a slave sends after re-registering must still be handled
+// after its re-registration.
+TEST_F(MasterTest, ReregisterSlaveMessageOrdering)
+{
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  process::ProcessBase process;
+  UPID pid = process::spawn(&process);
+
+  ReregisterSlaveMessage reregister;
+  reregister.mutable_slave_id()->set_value("slave");
+
+  SlaveInfo* slaveInfo = reregister.mutable_slave();
+  slaveInfo->set_hostname("host");
+  slaveInfo->mutable_id()->MergeFrom(reregister.slave_id());
+  slaveInfo->mutable_resources()->MergeFrom(
+      Resources::parse("cpus:2;mem:1024").get());
+
+  UnregisterSlaveMessage unregister;
+  unregister.mutable_slave_id()->MergeFrom(reregister.slave_id());
+
+  Future<SlaveReregisteredMessage> reregistered =
+    FUTURE_PROTOBUF(SlaveReregisteredMessage(), master.get(), pid);
+
+  Clock::pause();
+
+  process::post(pid, master.get(), reregister);
+  process::post(pid, master.get(), unregister);
+
+  AWAIT_READY(reregistered);
+
+  Clock::settle();
+
+  // Had the unregistration been handled first, it would have been
+  // ignored and the slave would still be registered.
+  EXPECT_EQ(0, stat(master.get(), "activated_slaves"));
+
+  Clock::resume();
+
+  process::terminate(pid);
+  process::wait(pid);
+
+  Shutdown();
+}
+
+
 // Test ensures two offers from same slave can be used for single task.
 // This is done by first launching single task which utilize half of the
 // available resources. A subsequent offer for the rest of the available
@@ -1413,6 +1718,459 @@ TEST_F(MasterTest, LaunchDuplicateOfferTest)
 }
 
 
+// This test verifies that the master doesn't let a framework have
+// more outstanding offers than 'max_offers_per_framework', returning
+// the resources of other slaves to the allocator instead.
+TEST_F(MasterTest, MaxOffersPerFramework)
+{
+  master::Flags masterFlags = CreateMasterFlags();
+  masterFlags.max_offers_per_framework = 1;
+
+  Try<PID<Master> > master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  Future<SlaveRegisteredMessage> slaveRegisteredMessage1 =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), _, _);
+
+  Try<PID<Slave> > slave1 = StartSlave();
+  ASSERT_SOME(slave1);
+
+  AWAIT_READY(slaveRegisteredMessage1);
+
+  Future<SlaveRegisteredMessage> slaveRegisteredMessage2 =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), _, _);
+
+  Try<PID<Slave> > slave2 = StartSlave();
+  ASSERT_SOME(slave2);
+
+  AWAIT_READY(slaveRegisteredMessage2);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  Future<vector<Offer> > offers1;
+  Future<vector<Offer> > offers2;
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(FutureArg<1>(&offers1))
+    .WillOnce(FutureArg<1>(&offers2))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  driver.start();
+
+  // Only one of the slaves gets offered at first.
+  AWAIT_READY(offers1);
+  ASSERT_EQ(1u, offers1.get().size());
+
+  // Once the framework declines the offer, it gets offered one of
+  // the slaves again.
+  Filters filters;
+  filters.set_refuse_seconds(0);
+  driver.declineOffer(offers1.get()[0].id(), filters);
+
+  AWAIT_READY(offers2);
+  EXPECT_EQ(1u, offers2.get().size());
+
+  driver.stop();
+  driver.join();
+
+  Shutdown();
+}
+
+
+// Counts the offers messages a scheduler receives and the bytes of
+// the offers in them.
+ACTION_P3(CountOffers, messages, bytes, offers)
+{
+  (*messages)++;
+  foreach (const Offer& offer, arg1) {
+    *bytes += offer.ByteSize();
+    offers->push_back(offer);
+  }
+}
+
+
+// Measures how many offers messages (and bytes) the master sends to
+// a framework per allocation cycle when it gets offered the resources
+// of many slaves.
+TEST_F(MasterTest, BENCHMARK_OffersPerAllocation)
+{
+  const size_t count = 5000;
+
+  master::Flags masterFlags = CreateMasterFlags();
+
+  Try<PID<Master> > master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+      &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  Future<Nothing> registered;
+  EXPECT_CALL(sched, registered(&driver, _, _))
+    .WillOnce(FutureSatisfy(&registered));
+
+  size_t messages = 0;
+  size_t bytes = 0;
+  vector<Offer> offers;
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillRepeatedly(CountOffers(&messages, &bytes, &offers));
+
+  driver.start();
+
+  AWAIT_READY(registered);
+
+  Clock::pause();
+
+  // Each slave needs a process of its own, since the master tells
+  // the slaves apart by their pids (and sees a slave without a
+  // process exit right away).
+  vector<process::ProcessBase*> processes;
+  for (size_t i = 0; i < count; i++) {
+    process::ProcessBase* process = new process::ProcessBase();
+    UPID pid = process::spawn(process);
+
+    RegisterSlaveMessage message;
+    message.mutable_slave()->set_hostname("host-" + stringify(i));
+    message.mutable_slave()->mutable_resources()->MergeFrom(
+        Resources::parse("cpus:2;mem:1024").get());
+
+    process::post(pid, master.get(), message);
+
+    processes.push_back(process);
+  }
+
+  Clock::settle();
+  Clock::advance(masterFlags.allocation_interval);
+  Clock::settle();
+
+  std::cout << "Offered " << offers.size() << " slaves in " << messages
+            << " messages of " << Bytes(bytes) << std::endl;
+
+  // Decline all the offers so that the next allocation cycle offers
+  // all the slaves again.
+  Filters filters;
+  filters.set_refuse_seconds(0);
+
+  foreach (const Offer& offer, offers) {
+    driver.declineOffer(offer.id(), filters);
+  }
+
+  Clock::settle();
+
+  messages = 0;
+  bytes = 0;
+  offers.clear();
+
+  Clock::advance(masterFlags.allocation_interval);
+  Clock::settle();
+
+  std::cout << "Re-offered " << offers.size() << " slaves in " << messages
+            << " messages of " << Bytes(bytes) << std::endl;
+
+  Clock::resume();
+
+  driver.stop();
+  driver.join();
+
+  foreach (process::ProcessBase* process, processes) {
+    process::terminate(process);
+    process::wait(process);
+    delete process;
+  }
+
+  Shutdown();
+}
+
+
+// This test ensures that the messages of a scheduler are held back
+// once the scheduler exceeds '--framework_message_rate', and that
+// killing a task doesn't overtake the messages held back.
+TEST_F(MasterTest, FrameworkMessageRate)
+{
+  master::Flags masterFlags = CreateMasterFlags();
+  masterFlags.framework_message_rate = 0.1; // One message every 10 secs.
+
+  Try<PID<Master> > master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  MockExecutor exec(DEFAULT_EXECUTOR_ID);
+
+  TestContainerizer containerizer(&exec);
+
+  Try<PID<Slave> > slave = StartSlave(&containerizer);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+    &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  // Launching tasks is not subject to the rate.
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(LaunchTasks(DEFAULT_EXECUTOR_INFO, 1, 1, 512, "*"))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  EXPECT_CALL(exec, registered(_, _, _, _));
+
+  EXPECT_CALL(exec, launchTask(_, _))
+    .WillOnce(SendStatusUpdateFromTask(TASK_RUNNING));
+
+  Future<TaskStatus> status;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status));
+
+  driver.start();
+
+  AWAIT_READY(status);
+  EXPECT_EQ(TASK_RUNNING, status.get().state());
+
+  // Registering the framework used up the permit of the scheduler, so
+  // the reconciliation below waits for the next permit.
+  Clock::pause();
+
+  Future<TaskStatus> status2;
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .WillOnce(FutureArg<1>(&status2));
+
+  Future<ReconcileTasksMessage> reconcileTasksMessage =
+    FUTURE_PROTOBUF(ReconcileTasksMessage(), _, _);
+
+  vector<TaskStatus> statuses;
+
+  TaskStatus differentStatus;
+  differentStatus.mutable_task_id()->CopyFrom(status.get().task_id());
+  differentStatus.mutable_slave_id()->CopyFrom(status.get().slave_id());
+  differentStatus.set_state(TASK_KILLED);
+
+  statuses.push_back(differentStatus);
+
+  driver.reconcileTasks(statuses);
+
+  AWAIT_READY(reconcileTasksMessage);
+
+  // Killing a task skips the rate but stays behind the queued
+  // reconciliation.
+  Future<Nothing> killTask;
+  EXPECT_CALL(exec, killTask(_, _))
+    .WillOnce(FutureSatisfy(&killTask));
+
+  Future<KillTaskMessage> killTaskMessage =
+    FUTURE_PROTOBUF(KillTaskMessage(), _, master.get());
+
+  driver.killTask(status.get().task_id());
+
+  AWAIT_READY(killTaskMessage);
+
+  Clock::settle();
+
+  EXPECT_TRUE(status2.isPending());
+  EXPECT_TRUE(killTask.isPending());
+
+  Clock::advance(Seconds(10));
+
+  AWAIT_READY(status2);
+  EXPECT_EQ(TASK_RUNNING, status2.get().state());
+
+  AWAIT_READY(killTask);
+
+  Clock::resume();
+
+  EXPECT_CALL(exec, shutdown(_))
+    .Times(AtMost(1));
+
+  driver.stop();
+  driver.join();
+
+  Shutdown(); // Must shutdown before 'containerizer' gets deallocated.
+}
+
+
+// This test ensures that /master/state.json requests beyond
+// '--state_request_rate' are held back.
+TEST_F(MasterTest, StateRequestRate)
+{
+  master::Flags masterFlags = CreateMasterFlags();
+  masterFlags.state_request_rate = 0.1; // One request every 10 secs.
+
+  Try<PID<Master> > master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  Clock::pause();
+
+  Future<Response> response1 = process::http::get(master.get(), "state.json");
+  Future<Response> response2 = process::http::get(master.get(), "state.json");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response1);
+
+  Clock::settle();
+
+  EXPECT_TRUE(response2.isPending());
+
+  Clock::advance(Seconds(10));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response2);
+
+  Clock::resume();
+
+  Shutdown();
+}
+
+
+// Measures how long it takes the master to validate and launch many
+// tasks from a single offer.
+TEST_F(MasterTest, BENCHMARK_LaunchTasksThroughput)
+{
+  const size_t count = 1000;
+
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  slave::Flags flags = CreateSlaveFlags();
+  flags.resources =
+    "cpus:" + stringify(count) + ";mem:" + stringify(count * 32);
+
+  Try<PID<Slave> > slave = StartSlave(flags);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+      &sched, DEFAULT_FRAMEWORK_INFO, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(&driver, _, _));
+
+  Future<vector<Offer> > offers;
+  EXPECT_CALL(sched, resourceOffers(&driver, _))
+    .WillOnce(FutureArg<1>(&offers))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  driver.start();
+
+  AWAIT_READY(offers);
+  EXPECT_NE(0u, offers.get().size());
+
+  vector<TaskInfo> tasks;
+  for (size_t i = 0; i < count; i++) {
+    TaskInfo task;
+    task.set_name("");
+    task.mutable_task_id()->set_value(stringify(i));
+    task.mutable_slave_id()->MergeFrom(offers.get()[0].slave_id());
+    task.mutable_resources()->MergeFrom(
+        Resources::parse("cpus:1;mem:32").get());
+    task.mutable_executor()->MergeFrom(DEFAULT_EXECUTOR_INFO);
+    tasks.push_back(task);
+  }
+
+  // We only measure the master, so the slave doesn't launch anything.
+  DROP_PROTOBUFS(RunTaskMessage(), _, _);
+
+  EXPECT_CALL(sched, statusUpdate(&driver, _))
+    .Times(0);
+
+  Clock::pause();
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  driver.launchTasks(offers.get()[0].id(), tasks);
+
+  Clock::settle();
+
+  std::cout << "Launched " << count << " tasks in "
+            << stopwatch.elapsed() << std::endl;
+
+  Clock::resume();
+
+  driver.stop();
+  driver.join();
+
+  Shutdown();
+}
+
+
+// Returns a typical completed task for the CompletedTasks tests.
+static Task createCompletedTask(int id)
+{
+  Task task;
+  task.set_name("task-" + stringify(id));
+  task.mutable_task_id()->set_value(UUID::random().toString());
+  task.mutable_framework_id()->set_value("framework");
+  task.mutable_slave_id()->set_value("slave");
+  task.mutable_executor_id()->set_value("default");
+  task.set_state(TASK_FINISHED);
+  task.mutable_resources()->MergeFrom(
+      Resources::parse("cpus:1;mem:128;ports:[31000-31001]").get());
+
+  TaskState states[] = { TASK_STAGING, TASK_RUNNING, TASK_FINISHED };
+  foreach (const TaskState& state, states) {
+    TaskStatus* status = task.add_statuses();
+    status->mutable_task_id()->CopyFrom(task.task_id());
+    status->mutable_slave_id()->CopyFrom(task.slave_id());
+    status->set_state(state);
+    status->set_message("Task " + stringify(id) + " is in state " +
+                        TaskState_Name(state));
+    status->set_data(string(128, 'x'));
+    status->set_timestamp(id);
+  }
+
+  return task;
+}
+
+
+TEST(CompletedTasksTest, Evict)
+{
+  CompletedTasks completedTasks(10, Kilobytes(2));
+
+  for (int i = 0; i < 20; i++) {
+    completedTasks.add(createCompletedTask(i));
+
+    EXPECT_LE(completedTasks.size(), 10u);
+    EXPECT_LE(completedTasks.bytes(), Kilobytes(2));
+  }
+
+  // The oldest tasks get evicted first.
+  vector<Task> tasks = completedTasks.tasks();
+  ASSERT_EQ(completedTasks.size(), tasks.size());
+  ASSERT_FALSE(tasks.empty());
+
+  EXPECT_EQ("task-19", tasks.back().name());
+  EXPECT_EQ(TASK_FINISHED, tasks.back().state());
+  EXPECT_EQ(3, tasks.back().statuses_size());
+  EXPECT_EQ(19, tasks.back().statuses(0).timestamp());
+
+  for (size_t i = 1; i < tasks.size(); i++) {
+    EXPECT_LT(tasks[i - 1].statuses(0).timestamp(),
+              tasks[i].statuses(0).timestamp());
+  }
+}
+
+
+// This test ensures that a completed task stored in CompletedTasks
+// takes a fraction of the memory of the Task itself.
+TEST(CompletedTasksTest, BytesPerTask)
+{
+  const size_t count = master::MAX_COMPLETED_TASKS_PER_FRAMEWORK;
+
+  CompletedTasks completedTasks(count, Megabytes(64));
+
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    const Task& task = createCompletedTask(i);
+    total += task.SpaceUsed();
+    completedTasks.add(task);
+  }
+
+  ASSERT_EQ(count, completedTasks.size());
+
+  // The status update messages and data are dropped and the rest is
+  // serialized, which takes about an eighth of the memory.
+  EXPECT_LT(completedTasks.bytes().bytes() * 4, total);
+}
+
+
 #ifdef MESOS_HAS_JAVA
 class MasterZooKeeperTest : public MesosTest
 {
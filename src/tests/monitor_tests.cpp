@@ -18,6 +18,8 @@
 
 #include <limits>
 #include <map>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 
@@ -30,11 +32,15 @@
 #include <process/http.hpp>
 #include <process/pid.hpp>
 #include <process/process.hpp>
+#include <process/time.hpp>
 
+#include <stout/bytes.hpp>
+#include <stout/gtest.hpp>
 #include <stout/nothing.hpp>
 
 #include "slave/constants.hpp"
 #include "slave/monitor.hpp"
+#include "slave/usage_history.hpp"
 
 #include "tests/containerizer.hpp"
 
@@ -44,17 +50,22 @@ using namespace mesos::internal::tests;
 
 using process::Clock;
 using process::Future;
+using process::Promise;
 
 using process::http::BadRequest;
 using process::http::NotFound;
 using process::http::OK;
 using process::http::Response;
 
+using std::map;
 using std::numeric_limits;
+using std::pair;
 using std::string;
+using std::vector;
 
 using testing::_;
 using testing::DoAll;
+using testing::Invoke;
 using testing::Return;
 
 
@@ -167,6 +178,320 @@ TEST(MonitorTest, Collection)
 }
 
 
+// Containers near their limits are sampled more often.
+TEST(MonitorTest, AdaptiveInterval)
+{
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_executor_id()->set_value("executor");
+  executorInfo.mutable_framework_id()->set_value("framework");
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(1.0);
+  statistics.set_mem_rss_bytes(2000);
+  statistics.set_mem_limit_bytes(2048);
+  statistics.set_timestamp(0);
+
+  TestContainerizer containerizer;
+
+  Future<Nothing> usage1, usage2;
+  EXPECT_CALL(containerizer, usage(containerId))
+    .WillOnce(DoAll(FutureSatisfy(&usage1),
+                    Return(statistics)))
+    .WillOnce(DoAll(FutureSatisfy(&usage2),
+                    Return(statistics)));
+
+  slave::ResourceMonitor monitor(&containerizer);
+
+  process::Clock::pause();
+
+  monitor.start(
+      containerId,
+      executorInfo,
+      slave::RESOURCE_MONITORING_INTERVAL);
+
+  process::Clock::settle();
+
+  process::Clock::advance(slave::RESOURCE_MONITORING_INTERVAL);
+  process::Clock::settle();
+
+  AWAIT_READY(usage1);
+
+  // Wait until the containerizer has finished returning the statistics.
+  process::Clock::settle();
+
+  // The memory usage is near the limit, so the next collection is
+  // due sooner than the requested interval.
+  process::Clock::advance(
+      slave::RESOURCE_MONITORING_INTERVAL /
+      slave::MONITORING_ADAPTIVE_FACTOR);
+  process::Clock::settle();
+
+  AWAIT_READY(usage2);
+
+  process::Clock::settle();
+
+  monitor.stop(containerId);
+
+  process::Clock::settle();
+}
+
+
+// A container whose usage never arrives does not hold up the
+// collection of the others.
+TEST(MonitorTest, PendingUsage)
+{
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_executor_id()->set_value("executor");
+  executorInfo.mutable_framework_id()->set_value("framework");
+
+  ContainerID containerId1;
+  containerId1.set_value("container1");
+
+  ContainerID containerId2;
+  containerId2.set_value("container2");
+
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(1.0);
+  statistics.set_timestamp(0);
+
+  TestContainerizer containerizer;
+
+  Promise<ResourceStatistics> pending;
+
+  Future<Nothing> usage1, usage2;
+  EXPECT_CALL(containerizer, usage(containerId1))
+    .WillOnce(Return(pending.future()));
+  EXPECT_CALL(containerizer, usage(containerId2))
+    .WillOnce(DoAll(FutureSatisfy(&usage1),
+                    Return(statistics)))
+    .WillOnce(DoAll(FutureSatisfy(&usage2),
+                    Return(statistics)));
+
+  slave::ResourceMonitor monitor(&containerizer);
+
+  process::Clock::pause();
+
+  monitor.start(
+      containerId1,
+      executorInfo,
+      slave::RESOURCE_MONITORING_INTERVAL);
+
+  monitor.start(
+      containerId2,
+      executorInfo,
+      slave::RESOURCE_MONITORING_INTERVAL);
+
+  process::Clock::settle();
+
+  process::Clock::advance(slave::RESOURCE_MONITORING_INTERVAL);
+  process::Clock::settle();
+
+  AWAIT_READY(usage1);
+
+  process::Clock::settle();
+
+  // The first container is still being collected, so only the
+  // second one gets collected again.
+  process::Clock::advance(slave::RESOURCE_MONITORING_INTERVAL);
+  process::Clock::settle();
+
+  AWAIT_READY(usage2);
+
+  process::Clock::settle();
+
+  monitor.stop(containerId1);
+  monitor.stop(containerId2);
+
+  process::Clock::settle();
+
+  pending.discard();
+}
+
+
+// A container under resource pressure is sampled right away, but no
+// more often than a busy container is.
+TEST(MonitorTest, Pressure)
+{
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_executor_id()->set_value("executor");
+  executorInfo.mutable_framework_id()->set_value("framework");
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(1.0);
+  statistics.set_timestamp(0);
+
+  TestContainerizer containerizer;
+
+  Promise<Nothing> pressure1, pressure2, pending;
+  EXPECT_CALL(containerizer, pressure(containerId))
+    .WillOnce(Return(pressure1.future()))
+    .WillOnce(Return(pressure2.future()))
+    .WillRepeatedly(Return(pending.future()));
+
+  Future<Nothing> usage1, usage2;
+  EXPECT_CALL(containerizer, usage(containerId))
+    .WillOnce(DoAll(FutureSatisfy(&usage1),
+                    Return(statistics)))
+    .WillOnce(DoAll(FutureSatisfy(&usage2),
+                    Return(statistics)));
+
+  slave::ResourceMonitor monitor(&containerizer);
+
+  process::Clock::pause();
+
+  // Align the clock with the collections, so that the first one is
+  // due a whole interval after the container got started.
+  process::Clock::advance(
+      slave::RESOURCE_MONITORING_INTERVAL -
+      Nanoseconds(process::Clock::now().duration().ns() %
+                  slave::RESOURCE_MONITORING_INTERVAL.ns()));
+
+  monitor.start(
+      containerId,
+      executorInfo,
+      slave::RESOURCE_MONITORING_INTERVAL);
+
+  process::Clock::settle();
+
+  // The container has not been sampled yet, so it is sampled as soon
+  // as it comes under pressure.
+  pressure1.set(Nothing());
+
+  process::Clock::settle();
+
+  AWAIT_READY(usage1);
+
+  process::Clock::settle();
+
+  // The container was just sampled, so the next sample waits for the
+  // interval of a busy container.
+  pressure2.set(Nothing());
+
+  process::Clock::settle();
+
+  EXPECT_TRUE(usage2.isPending());
+
+  process::Clock::advance(
+      slave::RESOURCE_MONITORING_INTERVAL /
+      slave::MONITORING_ADAPTIVE_FACTOR);
+  process::Clock::settle();
+
+  AWAIT_READY(usage2);
+
+  process::Clock::settle();
+
+  monitor.stop(containerId);
+
+  process::Clock::settle();
+
+  pending.discard();
+}
+
+
+// Returns the usage of a container that uses no CPU at all.
+static Future<ResourceStatistics> idle(const ContainerID& containerId)
+{
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(1.0);
+  statistics.set_cpus_user_time_secs(0);
+  statistics.set_cpus_system_time_secs(0);
+  statistics.set_timestamp(process::Clock::now().secs());
+
+  return statistics;
+}
+
+
+// Containers that have been idle for a while are sampled less often.
+TEST(MonitorTest, IdleInterval)
+{
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_executor_id()->set_value("executor");
+  executorInfo.mutable_framework_id()->set_value("framework");
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  const Duration interval = slave::RESOURCE_MONITORING_INTERVAL;
+  const Duration slowed = interval * slave::MONITORING_ADAPTIVE_FACTOR;
+
+  TestContainerizer containerizer;
+
+  // The first sample is not compared with a previous one, hence it
+  // takes one more sample to count enough idle samples.
+  const size_t samples = slave::MONITORING_IDLE_SAMPLES + 1;
+
+  EXPECT_CALL(containerizer, usage(containerId))
+    .Times(samples)
+    .WillRepeatedly(Invoke(idle))
+    .RetiresOnSaturation();
+
+  slave::ResourceMonitor monitor(&containerizer);
+
+  process::Clock::pause();
+
+  // Align the clock with the collections of idle containers too,
+  // which are due at the multiples of the slowed down interval.
+  process::Clock::advance(
+      slowed - Nanoseconds(process::Clock::now().duration().ns() %
+                           slowed.ns()));
+
+  monitor.start(containerId, executorInfo, interval);
+
+  process::Clock::settle();
+
+  for (size_t i = 0; i < samples; i++) {
+    process::Clock::advance(interval);
+    process::Clock::settle();
+  }
+
+  // The container is sampled at the next multiple of the slowed down
+  // interval, and from then on once every slowed down interval.
+  Future<Nothing> usage1, usage2;
+  EXPECT_CALL(containerizer, usage(containerId))
+    .WillOnce(DoAll(FutureSatisfy(&usage1),
+                    Invoke(idle)))
+    .WillOnce(DoAll(FutureSatisfy(&usage2),
+                    Invoke(idle)));
+
+  const size_t factor = slave::MONITORING_ADAPTIVE_FACTOR;
+  const size_t next = (samples / factor + 1) * factor;
+
+  process::Clock::advance(interval * (next - samples - 1));
+  process::Clock::settle();
+
+  EXPECT_TRUE(usage1.isPending());
+
+  process::Clock::advance(interval);
+  process::Clock::settle();
+
+  AWAIT_READY(usage1);
+
+  process::Clock::settle();
+
+  process::Clock::advance(slowed - interval);
+  process::Clock::settle();
+
+  EXPECT_TRUE(usage2.isPending());
+
+  process::Clock::advance(interval);
+  process::Clock::settle();
+
+  AWAIT_READY(usage2);
+
+  process::Clock::settle();
+
+  monitor.stop(containerId);
+
+  process::Clock::settle();
+}
+
+
 TEST(MonitorTest, Statistics)
 {
   FrameworkID frameworkId;
@@ -297,3 +622,216 @@ TEST(MonitorTest, Statistics)
       response);
   AWAIT_EXPECT_RESPONSE_BODY_EQ("[]", response);
 }
+
+
+TEST(MonitorTest, UsageHistory)
+{
+  map<Duration, size_t> rollups;
+  rollups[Minutes(1)] = 10;
+
+  slave::UsageHistory history(100, rollups);
+
+  // Two and a half minutes of samples, every second.
+  for (int i = 0; i < 150; i++) {
+    ResourceStatistics statistics;
+    statistics.set_timestamp(i);
+    statistics.set_cpus_limit(1.0);
+    statistics.set_cpus_user_time_secs(i * 0.25);
+    statistics.set_mem_rss_bytes(1024 * (i % 60));
+
+    history.add(statistics);
+  }
+
+  // At least the last 100 samples are kept, as they were.
+  Try<vector<pair<double, double> > > samples = history.query(
+      "cpus_user_time_secs",
+      Duration::zero(),
+      slave::UsageHistory::LAST);
+
+  ASSERT_SOME(samples);
+  ASSERT_LE(100u, samples.get().size());
+  EXPECT_GE(150u, samples.get().size());
+
+  for (size_t i = 0; i < samples.get().size(); i++) {
+    double time = 150 - samples.get().size() + i;
+    EXPECT_EQ(time, samples.get()[i].first);
+    EXPECT_EQ(time * 0.25, samples.get()[i].second);
+  }
+
+  // The samples of each minute are rolled up, including the minute
+  // that is not over yet.
+  Try<vector<pair<double, double> > > rollup = history.query(
+      "mem_rss_bytes",
+      Minutes(1),
+      slave::UsageHistory::MAX);
+
+  ASSERT_SOME(rollup);
+  ASSERT_EQ(3u, rollup.get().size());
+  EXPECT_EQ(0, rollup.get()[0].first);
+  EXPECT_EQ(1024 * 59, rollup.get()[0].second);
+  EXPECT_EQ(120, rollup.get()[2].first);
+  EXPECT_EQ(1024 * 29, rollup.get()[2].second);
+
+  rollup = history.query(
+      "mem_rss_bytes",
+      Minutes(1),
+      slave::UsageHistory::AVERAGE,
+      60,
+      60);
+
+  ASSERT_SOME(rollup);
+  ASSERT_EQ(1u, rollup.get().size());
+  EXPECT_EQ(1024 * 29.5, rollup.get()[0].second);
+
+  // Metrics missing from the samples have no values.
+  rollup = history.query(
+      "mem_limit_bytes",
+      Minutes(1),
+      slave::UsageHistory::LAST);
+
+  ASSERT_SOME(rollup);
+  EXPECT_TRUE(rollup.get().empty());
+
+  EXPECT_ERROR(history.query(
+      "unknown",
+      Duration::zero(),
+      slave::UsageHistory::LAST));
+
+  EXPECT_ERROR(history.query(
+      "mem_rss_bytes",
+      Hours(1),
+      slave::UsageHistory::LAST));
+}
+
+
+// This test ensures that the history of a container, which covers
+// two weeks, takes a fraction of the memory of the TimeSeries of
+// 1000 samples (about 17 minutes) the monitor used to keep.
+TEST(MonitorTest, UsageHistoryFootprint)
+{
+  map<Duration, size_t> rollups;
+  rollups[Minutes(1)] = slave::MONITORING_MINUTE_ROLLUPS;
+  rollups[Hours(1)] = slave::MONITORING_HOUR_ROLLUPS;
+  rollups[Days(1)] = slave::MONITORING_DAY_ROLLUPS;
+
+  slave::UsageHistory history(
+      slave::MONITORING_TIME_SERIES_CAPACITY, rollups);
+
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(2.5);
+  statistics.set_mem_limit_bytes(Gigabytes(1).bytes());
+  statistics.set_mem_file_bytes(Megabytes(100).bytes());
+  statistics.set_mem_mapped_file_bytes(Megabytes(8).bytes());
+
+  // Fifteen days of samples of a busy container, every 10 seconds.
+  for (int i = 0; i < 15 * 24 * 60 * 6; i++) {
+    statistics.set_timestamp(i * 10);
+    statistics.set_cpus_user_time_secs(i * 3.7);
+    statistics.set_cpus_system_time_secs(i * 0.5);
+    statistics.set_cpus_nr_periods(i * 100);
+    statistics.set_cpus_nr_throttled(i / 10);
+    statistics.set_cpus_throttled_time_secs(i * 0.01);
+    statistics.set_mem_rss_bytes(Megabytes(512).bytes() + (i % 64) * 4096);
+    statistics.set_mem_anon_bytes(Megabytes(400).bytes() + (i % 64) * 4096);
+
+    history.add(statistics);
+  }
+
+  Try<vector<pair<double, double> > > days = history.query(
+      "cpus_user_time_secs",
+      Days(1),
+      slave::UsageHistory::LAST);
+
+  ASSERT_SOME(days);
+  EXPECT_LE(slave::MONITORING_DAY_ROLLUPS, days.get().size());
+
+  // The samples alone, i.e., less than the TimeSeries took along
+  // with the map holding them.
+  size_t samples = 1000 * (statistics.SpaceUsed() + sizeof(process::Time));
+
+  EXPECT_GT(samples / 4, history.bytes());
+}
+
+
+TEST(MonitorTest, History)
+{
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+
+  ExecutorID executorId;
+  executorId.set_value("executor");
+
+  ContainerID containerId;
+  containerId.set_value("container");
+
+  ExecutorInfo executorInfo;
+  executorInfo.mutable_executor_id()->CopyFrom(executorId);
+  executorInfo.mutable_framework_id()->CopyFrom(frameworkId);
+  executorInfo.set_name("name");
+  executorInfo.set_source("source");
+
+  ResourceStatistics statistics;
+  statistics.set_cpus_limit(1.0);
+  statistics.set_mem_rss_bytes(1024);
+  statistics.set_timestamp(0);
+
+  TestContainerizer containerizer;
+
+  Future<Nothing> usage;
+  EXPECT_CALL(containerizer, usage(containerId))
+    .WillOnce(DoAll(FutureSatisfy(&usage),
+                    Return(statistics)));
+
+  slave::ResourceMonitor monitor(&containerizer);
+
+  process::Clock::pause();
+
+  monitor.start(
+      containerId,
+      executorInfo,
+      slave::RESOURCE_MONITORING_INTERVAL);
+
+  process::Clock::settle();
+
+  process::Clock::advance(slave::RESOURCE_MONITORING_INTERVAL);
+  process::Clock::settle();
+
+  AWAIT_READY(usage);
+
+  // Wait until the containerizer has finished returning the statistics.
+  process::Clock::settle();
+
+  // The usage history is kept once the container is done.
+  monitor.stop(containerId);
+
+  process::Clock::settle();
+
+  process::UPID upid("monitor", process::ip(), process::port());
+
+  Future<Response> response = process::http::get(
+      upid,
+      "history.json",
+      "metric=mem_rss_bytes&resolution=1mins&aggregation=max");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+  AWAIT_EXPECT_RESPONSE_BODY_EQ(
+      "[{"
+          "\"completed\":true,"
+          "\"executor_id\":\"executor\","
+          "\"executor_name\":\"name\","
+          "\"framework_id\":\"framework\","
+          "\"history\":{"
+              "\"mem_rss_bytes\":[[0,1024]]"
+          "},"
+          "\"source\":\"source\""
+      "}]",
+      response);
+
+  response = process::http::get(upid, "history.json", "metric=unknown");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(BadRequest().status, response);
+
+  response = process::http::get(upid, "history.json", "aggregation=median");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(BadRequest().status, response);
+}
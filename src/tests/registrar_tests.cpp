@@ -24,6 +24,8 @@
 #include <process/pid.hpp>
 #include <process/process.hpp>
 
+#include <stout/stringify.hpp>
+
 #include "common/protobuf_utils.hpp"
 #include "common/type_utils.hpp"
 
@@ -281,6 +283,89 @@ TEST_P(RegistrarTest, bootstrap)
   }
 }
 
+
+// Verifies that the registry is recovered from the latest snapshot
+// plus the journal entries appended after it.
+TEST_P(RegistrarTest, journal)
+{
+  // Snapshot after every few updates so that recovery needs to
+  // replay journal entries on top of a snapshot.
+  flags.registry_journal_entries = 3;
+
+  SlaveInfo info;
+  info.set_hostname("localhost");
+
+  {
+    Registrar registrar(flags, state);
+    AWAIT_READY(registrar.recover(master));
+
+    for (int i = 1; i <= 5; i++) {
+      SlaveID id;
+      id.set_value(stringify(i));
+      info.mutable_id()->CopyFrom(id);
+
+      AWAIT_EQ(true, registrar.admit(info));
+    }
+
+    // Remove the last slave admitted.
+    AWAIT_EQ(true, registrar.remove(info));
+  }
+
+  {
+    Registrar registrar(flags, state);
+
+    Future<Registry> registry = registrar.recover(master);
+
+    AWAIT_READY(registry);
+    EXPECT_EQ(master, registry.get().master().info());
+
+    ASSERT_EQ(4, registry.get().slaves().slaves().size());
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(stringify(i + 1),
+                registry.get().slaves().slaves(i).info().id().value());
+    }
+  }
+}
+
+
+// Verifies that a registrar cannot append to the journal once another
+// registrar has recovered, even at positions that have since been
+// expunged by a snapshot.
+TEST_P(RegistrarTest, stale)
+{
+  SlaveInfo info;
+  info.set_hostname("localhost");
+
+  SlaveID id;
+  id.set_value("1");
+  info.mutable_id()->CopyFrom(id);
+
+  Registrar registrar1(flags, state);
+  AWAIT_READY(registrar1.recover(master));
+
+  {
+    // Snapshot (and expunge the journal) after every update.
+    flags.registry_journal_entries = 1;
+
+    Registrar registrar2(flags, state);
+    AWAIT_READY(registrar2.recover(master));
+
+    AWAIT_EQ(true, registrar2.admit(info));
+    AWAIT_EQ(true, registrar2.remove(info));
+  }
+
+  AWAIT_EXPECT_FAILED(registrar1.admit(info));
+
+  // The registry does not contain the slave the first registrar
+  // attempted to admit.
+  Registrar registrar3(flags, state);
+
+  Future<Registry> registry = registrar3.recover(master);
+
+  AWAIT_READY(registry);
+  EXPECT_EQ(0, registry.get().slaves().slaves().size());
+}
+
 } // namespace master {
 } // namespace internal {
 } // namespace mesos {
@@ -21,6 +21,7 @@
 
 #include <gtest/gtest.h>
 
+#include <set>
 #include <string>
 
 #include <mesos/executor.hpp>
@@ -31,11 +32,13 @@
 #include <process/gmock.hpp>
 #include <process/owned.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/none.hpp>
 #include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
 #include <stout/path.hpp>
+#include <stout/stringify.hpp>
 #include <stout/uuid.hpp>
 
 #include "common/protobuf_utils.hpp"
@@ -44,6 +47,7 @@
 #include "master/master.hpp"
 
 #include "slave/gc.hpp"
+#include "slave/journal.hpp"
 #include "slave/paths.hpp"
 #include "slave/slave.hpp"
 #include "slave/state.hpp"
@@ -68,6 +72,7 @@ using mesos::internal::slave::GarbageCollectorProcess;
 using mesos::internal::slave::Containerizer;
 
 using std::map;
+using std::set;
 using std::string;
 using std::vector;
 
@@ -107,6 +112,206 @@ TEST_F(SlaveStateTest, CheckpointString)
   ASSERT_SOME_EQ(expected, os::read(file));
 }
 
+
+// Returns a description of each of the tasks in the state, so that
+// states recovered in different ways can be compared.
+static set<string> describe(const slave::state::SlaveState& state)
+{
+  set<string> tasks;
+
+  foreachvalue (const slave::state::FrameworkState& framework,
+                state.frameworks) {
+    foreachvalue (const slave::state::ExecutorState& executor,
+                  framework.executors) {
+      foreachvalue (const slave::state::RunState& run, executor.runs) {
+        foreachvalue (const slave::state::TaskState& task, run.tasks) {
+          tasks.insert(
+              framework.id.value() + "/" + stringify(framework.pid.get()) +
+              "/" + executor.id.value() + "/" + executor.latest.get().value() +
+              "/" + stringify(run.forkedPid.get()) +
+              "/" + stringify(run.libprocessPid.get()) +
+              "/" + stringify(run.completed) +
+              "/" + task.id.value() + "/" + task.info.get().name() +
+              "/" + stringify(task.updates.size()) +
+              "/" + stringify(task.acks.size()));
+        }
+      }
+    }
+  }
+
+  return tasks;
+}
+
+
+// Checkpoints a large synthetic slave state and checks that the
+// state recovered from the checkpoint journal matches the state
+// recovered from the checkpointed files, both when the journal gets
+// created from the files and when it gets replayed.
+TEST_F(SlaveStateTest, CheckpointJournal)
+{
+  const size_t FRAMEWORKS = 10;
+  const size_t EXECUTORS = 20;
+  const size_t TASKS = 5;
+
+  const string rootDir = path::join(os::getcwd(), "meta");
+  const string journal = CheckpointJournal::path(rootDir);
+
+  SlaveID slaveId;
+  slaveId.set_value("slave");
+
+  paths::createSlaveDirectory(rootDir, slaveId);
+
+  SlaveInfo slaveInfo;
+  slaveInfo.set_hostname("localhost");
+
+  ASSERT_SOME(slave::state::checkpoint(
+      paths::getSlaveInfoPath(rootDir, slaveId), slaveInfo));
+
+  for (size_t i = 0; i < FRAMEWORKS; i++) {
+    FrameworkID frameworkId;
+    frameworkId.set_value("framework" + stringify(i));
+
+    ASSERT_SOME(slave::state::checkpoint(
+        paths::getFrameworkInfoPath(rootDir, slaveId, frameworkId),
+        DEFAULT_FRAMEWORK_INFO));
+
+    ASSERT_SOME(slave::state::checkpoint(
+        paths::getFrameworkPidPath(rootDir, slaveId, frameworkId),
+        "scheduler@127.0.0.1:5050"));
+
+    for (size_t j = 0; j < EXECUTORS; j++) {
+      ExecutorInfo executorInfo = DEFAULT_EXECUTOR_INFO;
+      executorInfo.mutable_executor_id()->set_value("executor" + stringify(j));
+
+      const ExecutorID& executorId = executorInfo.executor_id();
+
+      ContainerID containerId;
+      containerId.set_value(UUID::random().toString());
+
+      ASSERT_SOME(slave::state::checkpoint(
+          paths::getExecutorInfoPath(
+              rootDir, slaveId, frameworkId, executorId),
+          executorInfo));
+
+      paths::createExecutorDirectory(
+          rootDir, slaveId, frameworkId, executorId, containerId);
+
+      ASSERT_SOME(slave::state::checkpoint(
+          paths::getForkedPidPath(
+              rootDir, slaveId, frameworkId, executorId, containerId),
+          stringify(1000 + j)));
+
+      ASSERT_SOME(slave::state::checkpoint(
+          paths::getLibprocessPidPath(
+              rootDir, slaveId, frameworkId, executorId, containerId),
+          "executor@127.0.0.1:5051"));
+
+      for (size_t k = 0; k < TASKS; k++) {
+        Task task;
+        task.set_name("task");
+        task.mutable_task_id()->set_value("task" + stringify(k));
+        task.mutable_framework_id()->CopyFrom(frameworkId);
+        task.mutable_slave_id()->CopyFrom(slaveId);
+        task.set_state(TASK_RUNNING);
+
+        ASSERT_SOME(slave::state::checkpoint(
+            paths::getTaskInfoPath(
+                rootDir,
+                slaveId,
+                frameworkId,
+                executorId,
+                containerId,
+                task.task_id()),
+            task));
+
+        const string& path = paths::getTaskUpdatesPath(
+            rootDir,
+            slaveId,
+            frameworkId,
+            executorId,
+            containerId,
+            task.task_id());
+
+        Try<int> fd = os::open(path, O_CREAT | O_WRONLY | O_APPEND);
+        ASSERT_SOME(fd);
+
+        const StatusUpdate& update =
+          mesos::internal::protobuf::createStatusUpdate(
+              frameworkId, slaveId, task.task_id(), TASK_RUNNING);
+
+        StatusUpdateRecord record;
+        record.set_type(StatusUpdateRecord::UPDATE);
+        record.mutable_update()->CopyFrom(update);
+
+        ASSERT_SOME(slave::state::checkpoint(fd.get(), path, record));
+
+        record.set_type(StatusUpdateRecord::ACK);
+        record.set_uuid(update.uuid());
+        record.clear_update();
+
+        ASSERT_SOME(slave::state::checkpoint(fd.get(), path, record));
+
+        ASSERT_SOME(os::close(fd.get()));
+      }
+    }
+  }
+
+  Result<slave::state::SlaveState> files =
+    slave::state::recover(rootDir, true);
+
+  ASSERT_SOME(files);
+  EXPECT_EQ(FRAMEWORKS * EXECUTORS * TASKS, describe(files.get()).size());
+
+  // Recovering with the journal creates it from the files.
+  EXPECT_FALSE(os::exists(journal));
+
+  Result<slave::state::SlaveState> journaled =
+    slave::state::recover(rootDir, true, true);
+
+  ASSERT_SOME(journaled);
+  EXPECT_TRUE(os::exists(journal));
+
+  EXPECT_EQ(slaveId, journaled.get().id);
+  ASSERT_SOME(journaled.get().info);
+  EXPECT_EQ("localhost", journaled.get().info.get().hostname());
+  EXPECT_EQ(describe(files.get()), describe(journaled.get()));
+
+  // The checkpoints from now on get journaled as well, including
+  // the removal of a (garbage collected) framework directory.
+  const string& framework = files.get().frameworks.begin()->first.value();
+
+  FrameworkID frameworkId;
+  frameworkId.set_value(framework);
+
+  const string& directory =
+    paths::getFrameworkPath(rootDir, slaveId, frameworkId);
+
+  ASSERT_SOME(os::rmdir(directory));
+  ASSERT_SOME(slave::state::removed(directory));
+
+  // Partially write a record, as if the slave died while journaling.
+  Try<int> fd = os::open(journal, O_WRONLY | O_APPEND);
+  ASSERT_SOME(fd);
+  ASSERT_SOME(os::write(fd.get(), string("\xff\x00\x00\x00", 4)));
+  ASSERT_SOME(os::close(fd.get()));
+
+  // Recovering with the journal again replays it.
+  journaled = slave::state::recover(rootDir, true, true);
+  ASSERT_SOME(journaled);
+
+  EXPECT_FALSE(journaled.get().frameworks.contains(frameworkId));
+  EXPECT_EQ((FRAMEWORKS - 1) * EXECUTORS * TASKS,
+            describe(journaled.get()).size());
+
+  // Recovering without the journal removes it.
+  files = slave::state::recover(rootDir, true);
+  ASSERT_SOME(files);
+
+  EXPECT_FALSE(os::exists(journal));
+  EXPECT_EQ(describe(files.get()), describe(journaled.get()));
+}
+
+
 template <typename T>
 class SlaveRecoveryTest : public ContainerizerTest<T>
 {
@@ -499,6 +704,103 @@ TYPED_TEST(SlaveRecoveryTest, ReconnectExecutor)
 }
 
 
+// The slave journals its checkpoints and is restarted with a running
+// task. Make sure it recovers the executor and the task from the
+// replayed journal.
+TYPED_TEST(SlaveRecoveryTest, RecoverFromCheckpointJournal)
+{
+  Try<PID<Master> > master = this->StartMaster();
+  ASSERT_SOME(master);
+
+  slave::Flags flags = this->CreateSlaveFlags();
+  flags.checkpoint_journal = true;
+
+  const string journal =
+    CheckpointJournal::path(paths::getMetaRootDir(flags.work_dir));
+
+  Try<Containerizer*> containerizer1 = Containerizer::create(flags, true);
+  ASSERT_SOME(containerizer1);
+
+  Try<PID<Slave> > slave = this->StartSlave(containerizer1.get(), flags);
+  ASSERT_SOME(slave);
+
+  MockScheduler sched;
+
+  // Enable checkpointing for the framework.
+  FrameworkInfo frameworkInfo;
+  frameworkInfo.CopyFrom(DEFAULT_FRAMEWORK_INFO);
+  frameworkInfo.set_checkpoint(true);
+
+  MesosSchedulerDriver driver(
+      &sched, frameworkInfo, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(_, _, _));
+
+  Future<vector<Offer> > offers;
+  EXPECT_CALL(sched, resourceOffers(_, _))
+    .WillOnce(FutureArg<1>(&offers))
+    .WillRepeatedly(Return());      // Ignore subsequent offers.
+
+  driver.start();
+
+  AWAIT_READY(offers);
+  EXPECT_NE(0u, offers.get().size());
+
+  TaskInfo task = createTask(offers.get()[0], "sleep 1000");
+  vector<TaskInfo> tasks;
+  tasks.push_back(task); // Long-running task.
+
+  EXPECT_CALL(sched, statusUpdate(_, _))
+    .WillRepeatedly(Return());
+
+  Future<Nothing> _ack =
+    FUTURE_DISPATCH(_, &Slave::_statusUpdateAcknowledgement);
+
+  driver.launchTasks(offers.get()[0].id(), tasks);
+
+  // Wait for the ACK of the TASK_RUNNING update to be checkpointed.
+  AWAIT_READY(_ack);
+
+  EXPECT_TRUE(os::exists(journal));
+
+  this->Stop(slave.get());
+  delete containerizer1.get();
+
+  Future<Message> reregisterExecutorMessage =
+    FUTURE_MESSAGE(Eq(ReregisterExecutorMessage().GetTypeName()), _, _);
+
+  Future<ReregisterSlaveMessage> reregisterSlave =
+    FUTURE_PROTOBUF(ReregisterSlaveMessage(), _, _);
+
+  // Restart the slave (use same flags) with a new containerizer.
+  Try<Containerizer*> containerizer2 = Containerizer::create(flags, true);
+  ASSERT_SOME(containerizer2);
+
+  slave = this->StartSlave(containerizer2.get(), flags);
+  ASSERT_SOME(slave);
+
+  // Ensure the executor re-registers.
+  AWAIT_READY(reregisterExecutorMessage);
+  UPID executorPid = reregisterExecutorMessage.get().from;
+
+  // The slave re-registers with the recovered task.
+  AWAIT_READY(reregisterSlave);
+  ASSERT_EQ(1, reregisterSlave.get().tasks_size());
+  EXPECT_EQ(task.task_id(), reregisterSlave.get().tasks(0).task_id());
+  EXPECT_EQ(TASK_RUNNING, reregisterSlave.get().tasks(0).state());
+
+  // Shut down the executor manually so that it doesn't hang around
+  // after the test finishes.
+  process::post(executorPid, ShutdownExecutorMessage());
+
+  driver.stop();
+  driver.join();
+
+  this->Shutdown();
+  delete containerizer2.get();
+}
+
+
 // The slave is stopped before the (command) executor is registered.
 // When it comes back up with recovery=reconnect, make sure the
 // executor is killed and the task is transitioned to FAILED.
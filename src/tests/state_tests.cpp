@@ -18,31 +18,45 @@
 
 #include <gmock/gmock.h>
 
+#include <iostream>
+#include <list>
 #include <set>
 #include <string>
 #include <vector>
 
 #include <mesos/mesos.hpp>
 
+#include <process/collect.hpp>
 #include <process/future.hpp>
 #include <process/gtest.hpp>
+#include <process/pid.hpp>
 #include <process/protobuf.hpp>
 
 #include <stout/gtest.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
 #include <stout/try.hpp>
 
 #include "common/type_utils.hpp"
 
+#include "log/log.hpp"
+#include "log/replica.hpp"
+
+#include "log/tool/initialize.hpp"
+
 #include "master/registry.hpp"
 
 #include "state/in_memory.hpp"
 #include "state/leveldb.hpp"
+#include "state/log.hpp"
 #include "state/protobuf.hpp"
 #include "state/storage.hpp"
 #include "state/zookeeper.hpp"
 
+#include "tests/utils.hpp"
+
 #ifdef MESOS_HAS_JAVA
 #include "tests/zookeeper.hpp"
 #endif
@@ -52,7 +66,11 @@ using namespace mesos::internal;
 
 using namespace process;
 
+using log::Log;
+using log::Replica;
+
 using state::LevelDBStorage;
+using state::LogStorage;
 using state::Storage;
 #ifdef MESOS_HAS_JAVA
 using state::ZooKeeperStorage;
@@ -64,6 +82,10 @@ using state::protobuf::Variable;
 typedef mesos::internal::Registry::Slaves Slaves;
 typedef mesos::internal::Registry::Slave Slave;
 
+using std::list;
+using std::set;
+using std::string;
+
 void FetchAndStoreAndFetch(State* state)
 {
   Future<Variable<Slaves> > future1 = state->fetch<Slaves>("slaves");
@@ -304,6 +326,117 @@ void Names(State* state)
 }
 
 
+// Stores two variables in a single batch, then verifies that a batch
+// with a stale variable doesn't store any of its variables.
+void FetchAndStoreBatchAndFetch(State* state)
+{
+  Future<Variable<Slaves> > future1 = state->fetch<Slaves>("slaves1");
+  AWAIT_READY(future1);
+
+  Variable<Slaves> variable1 = future1.get();
+
+  future1 = state->fetch<Slaves>("slaves2");
+  AWAIT_READY(future1);
+
+  Variable<Slaves> variable2 = future1.get();
+
+  Slaves slaves1 = variable1.get();
+  slaves1.add_slaves()->mutable_info()->set_hostname("localhost1");
+
+  Slaves slaves2 = variable2.get();
+  slaves2.add_slaves()->mutable_info()->set_hostname("localhost2");
+
+  std::vector<Variable<Slaves> > variables;
+  variables.push_back(variable1.mutate(slaves1));
+  variables.push_back(variable2.mutate(slaves2));
+
+  Future<Option<std::vector<Variable<Slaves> > > > future2 =
+    state->store(variables);
+  AWAIT_READY(future2);
+  ASSERT_SOME(future2.get());
+  ASSERT_EQ(2u, future2.get().get().size());
+
+  // Now 'variable1' is stale, so neither variable gets stored.
+  Slaves slaves3 = future2.get().get()[1].get();
+  slaves3.add_slaves()->mutable_info()->set_hostname("localhost3");
+
+  variables.clear();
+  variables.push_back(variable1.mutate(slaves1));
+  variables.push_back(future2.get().get()[1].mutate(slaves3));
+
+  future2 = state->store(variables);
+  AWAIT_READY(future2);
+  EXPECT_NONE(future2.get());
+
+  future1 = state->fetch<Slaves>("slaves1");
+  AWAIT_READY(future1);
+
+  ASSERT_EQ(1, future1.get().get().slaves().size());
+  EXPECT_EQ("localhost1", future1.get().get().slaves(0).info().hostname());
+
+  future1 = state->fetch<Slaves>("slaves2");
+  AWAIT_READY(future1);
+
+  ASSERT_EQ(1, future1.get().get().slaves().size());
+  EXPECT_EQ("localhost2", future1.get().get().slaves(0).info().hostname());
+}
+
+
+// Reports the throughput of storing and then fetching a number of
+// variables, all of which are outstanding at the same time.
+void StoreAndFetchThroughput(State* state, const string& storage)
+{
+  const size_t count = 100;
+
+  Slaves slaves;
+  slaves.add_slaves()->mutable_info()->set_hostname("localhost");
+
+  list<Future<Variable<Slaves> > > fetches;
+  for (size_t i = 0; i < count; i++) {
+    fetches.push_back(state->fetch<Slaves>("slaves" + stringify(i)));
+  }
+
+  AWAIT_READY(collect(fetches));
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  list<Future<Option<Variable<Slaves> > > > stores;
+  foreach (const Future<Variable<Slaves> >& fetch, fetches) {
+    stores.push_back(state->store(fetch.get().mutate(slaves)));
+  }
+
+  AWAIT_READY(collect(stores));
+
+  Duration stored = stopwatch.elapsed();
+
+  foreach (const Future<Option<Variable<Slaves> > >& store, stores) {
+    ASSERT_SOME(store.get());
+  }
+
+  stopwatch.start();
+
+  fetches.clear();
+  for (size_t i = 0; i < count; i++) {
+    fetches.push_back(state->fetch<Slaves>("slaves" + stringify(i)));
+  }
+
+  AWAIT_READY(collect(fetches));
+
+  Duration fetched = stopwatch.elapsed();
+
+  foreach (const Future<Variable<Slaves> >& fetch, fetches) {
+    ASSERT_EQ(1, fetch.get().get().slaves().size());
+  }
+
+  std::cout << storage << ": stored " << count << " variables in "
+            << stored << " (" << count / stored.secs() << " per second), "
+            << "fetched " << count << " variables in " << fetched
+            << " (" << count / fetched.secs() << " per second)"
+            << std::endl;
+}
+
+
 class InMemoryStateTest : public ::testing::Test
 {
 public:
@@ -371,6 +504,12 @@ TEST_F(InMemoryStateTest, Names)
 }
 
 
+TEST_F(InMemoryStateTest, FetchAndStoreBatchAndFetch)
+{
+  FetchAndStoreBatchAndFetch(state);
+}
+
+
 class LevelDBStateTest : public ::testing::Test
 {
 public:
@@ -444,6 +583,152 @@ TEST_F(LevelDBStateTest, Names)
 }
 
 
+TEST_F(LevelDBStateTest, FetchAndStoreBatchAndFetch)
+{
+  FetchAndStoreBatchAndFetch(state);
+}
+
+
+class LogStateTest : public tests::TemporaryDirectoryTest
+{
+public:
+  LogStateTest()
+    : storage(NULL),
+      state(NULL),
+      replica2(NULL),
+      log(NULL) {}
+
+protected:
+  virtual void SetUp()
+  {
+    TemporaryDirectoryTest::SetUp();
+
+    // For initializing the replicas.
+    log::tool::Initialize initializer;
+
+    string path1 = os::getcwd() + "/.log1";
+    string path2 = os::getcwd() + "/.log2";
+
+    initializer.flags.path = path1;
+    initializer.execute();
+
+    initializer.flags.path = path2;
+    initializer.execute();
+
+    // Only create the replica for 'path2' (i.e., the second replica)
+    // as the first replica will be created when we create a Log.
+    replica2 = new Replica(path2);
+
+    set<UPID> pids;
+    pids.insert(replica2->pid());
+
+    log = new Log(2, path1, pids);
+    storage = new state::LogStorage(log);
+    state = new State(storage);
+  }
+
+  virtual void TearDown()
+  {
+    delete state;
+    delete storage;
+    delete log;
+    delete replica2;
+
+    TemporaryDirectoryTest::TearDown();
+  }
+
+  state::Storage* storage;
+  State* state;
+
+  Replica* replica2;
+  Log* log;
+};
+
+
+TEST_F(LogStateTest, FetchAndStoreAndFetch)
+{
+  FetchAndStoreAndFetch(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreAndStoreAndFetch)
+{
+  FetchAndStoreAndStoreAndFetch(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreAndStoreFailAndFetch)
+{
+  FetchAndStoreAndStoreFailAndFetch(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreAndExpungeAndFetch)
+{
+  FetchAndStoreAndExpungeAndFetch(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreAndExpungeAndExpunge)
+{
+  FetchAndStoreAndExpungeAndExpunge(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreAndExpungeAndStoreAndFetch)
+{
+  FetchAndStoreAndExpungeAndStoreAndFetch(state);
+}
+
+
+TEST_F(LogStateTest, Names)
+{
+  Names(state);
+}
+
+
+TEST_F(LogStateTest, FetchAndStoreBatchAndFetch)
+{
+  FetchAndStoreBatchAndFetch(state);
+}
+
+
+// Verifies that a new storage on top of the same log recovers the
+// latest version of each variable, including after truncations.
+TEST_F(LogStateTest, Recover)
+{
+  // Truncate after every other append.
+  LogStorage storage1(log, 2);
+  State state1(&storage1);
+
+  for (int i = 0; i < 5; i++) {
+    Future<Variable<Slaves> > future1 = state1.fetch<Slaves>("slaves");
+    AWAIT_READY(future1);
+
+    Slaves slaves = future1.get().get();
+    slaves.add_slaves()->mutable_info()->set_hostname("localhost");
+
+    Future<Option<Variable<Slaves> > > future2 =
+      state1.store(future1.get().mutate(slaves));
+    AWAIT_READY(future2);
+    ASSERT_SOME(future2.get());
+  }
+
+  LogStorage storage2(log);
+  State state2(&storage2);
+
+  Future<Variable<Slaves> > future = state2.fetch<Slaves>("slaves");
+  AWAIT_READY(future);
+  EXPECT_EQ(5, future.get().get().slaves().size());
+}
+
+
+TEST_F(LogStateTest, BENCHMARK_StoreAndFetchThroughput)
+{
+  StoreAndFetchThroughput(state, "LogStorage");
+}
+
+
 #ifdef MESOS_HAS_JAVA
 class ZooKeeperStateTest : public tests::ZooKeeperTest
 {
@@ -515,4 +800,75 @@ TEST_F(ZooKeeperStateTest, Names)
 {
   Names(state);
 }
+
+
+TEST_F(ZooKeeperStateTest, FetchAndStoreBatchAndFetch)
+{
+  FetchAndStoreBatchAndFetch(state);
+}
+
+
+TEST_F(ZooKeeperStateTest, BENCHMARK_StoreAndFetchThroughput)
+{
+  StoreAndFetchThroughput(state, "ZooKeeperStorage");
+}
+
+
+// Values that don't fit in a single znode get stored in chunks.
+TEST_F(ZooKeeperStateTest, LargeValue)
+{
+  Future<Variable<Slaves> > future1 = state->fetch<Slaves>("slaves");
+  AWAIT_READY(future1);
+
+  Variable<Slaves> variable1 = future1.get();
+
+  Slaves slaves1 = variable1.get();
+  for (int i = 0; i < 3000; i++) {
+    Slave* slave = slaves1.add_slaves();
+    slave->mutable_info()->set_hostname(string(1000, 'a' + i % 26));
+  }
+
+  Future<Option<Variable<Slaves> > > future2 =
+    state->store(variable1.mutate(slaves1));
+  AWAIT_READY(future2);
+  ASSERT_SOME(future2.get());
+
+  // Fetch (and swap) the value using another storage.
+  state::ZooKeeperStorage storage2(
+      server->connectString(),
+      NO_TIMEOUT,
+      "/state/");
+
+  State state2(&storage2);
+
+  Future<Variable<Slaves> > future3 = state2.fetch<Slaves>("slaves");
+  AWAIT_READY(future3);
+
+  Slaves slaves2 = future3.get().get();
+  ASSERT_EQ(3000, slaves2.slaves().size());
+  EXPECT_EQ(string(1000, 'z'), slaves2.slaves(25).info().hostname());
+
+  slaves2.mutable_slaves()->RemoveLast();
+
+  Future<Option<Variable<Slaves> > > future4 =
+    state2.store(future3.get().mutate(slaves2));
+  AWAIT_READY(future4);
+  ASSERT_SOME(future4.get());
+
+  // Our version of the variable is stale now.
+  future2 = state->store(future2.get().get().mutate(slaves1));
+  AWAIT_READY(future2);
+  EXPECT_NONE(future2.get());
+
+  future1 = state->fetch<Slaves>("slaves");
+  AWAIT_READY(future1);
+  EXPECT_EQ(2999, future1.get().get().slaves().size());
+
+  Future<bool> expunged = state->expunge(future1.get());
+  AWAIT_EXPECT_EQ(true, expunged);
+
+  Future<std::vector<std::string> > names = state2.names();
+  AWAIT_READY(names);
+  EXPECT_EQ(0u, names.get().size());
+}
 #endif // MESOS_HAS_JAVA
@@ -58,6 +58,7 @@ using mesos::internal::slave::Slave;
 using process::Clock;
 using process::Future;
 using process::PID;
+using process::UPID;
 
 using std::list;
 using std::string;
@@ -780,3 +781,119 @@ TEST_F(StatusUpdateManagerTest, DuplicateUpdateBeforeAck)
 
   Shutdown();
 }
+
+
+// This test verifies that the status update manager sends status
+// updates to the master in batches (if enabled), which the master
+// forwards and the scheduler driver acknowledges in batches, and
+// that batched updates are retried just like individual ones.
+TEST_F(StatusUpdateManagerTest, BatchedStatusUpdate)
+{
+  Try<PID<Master> > master = StartMaster();
+  ASSERT_SOME(master);
+
+  MockExecutor exec(DEFAULT_EXECUTOR_ID);
+
+  slave::Flags flags = CreateSlaveFlags();
+  flags.checkpoint = true;
+  flags.status_update_batch_interval = Milliseconds(10);
+
+  Try<PID<Slave> > slave = StartSlave(&exec, flags);
+  ASSERT_SOME(slave);
+
+  FrameworkInfo frameworkInfo; // Bug in gcc 4.1.*, must assign on next line.
+  frameworkInfo = DEFAULT_FRAMEWORK_INFO;
+  frameworkInfo.set_checkpoint(true); // Enable checkpointing.
+
+  MockScheduler sched;
+  MesosSchedulerDriver driver(
+      &sched, frameworkInfo, master.get(), DEFAULT_CREDENTIAL);
+
+  EXPECT_CALL(sched, registered(_, _, _))
+    .Times(1);
+
+  Future<vector<Offer> > offers;
+  EXPECT_CALL(sched, resourceOffers(_, _))
+    .WillOnce(FutureArg<1>(&offers))
+    .WillRepeatedly(Return()); // Ignore subsequent offers.
+
+  driver.start();
+
+  AWAIT_READY(offers);
+  EXPECT_NE(0u, offers.get().size());
+
+  EXPECT_CALL(exec, registered(_, _, _, _))
+    .Times(1);
+
+  EXPECT_CALL(exec, launchTask(_, _))
+    .WillOnce(SendStatusUpdateFromTask(TASK_RUNNING));
+
+  Future<TaskStatus> status;
+  Future<TaskStatus> retried;
+  EXPECT_CALL(sched, statusUpdate(_, _))
+    .WillOnce(FutureArg<1>(&status))
+    .WillOnce(FutureArg<1>(&retried));
+
+  Future<StatusUpdatesMessage> statusUpdatesMessage =
+    FUTURE_PROTOBUF(StatusUpdatesMessage(), slave.get(), master.get());
+
+  Future<StatusUpdatesMessage> forwardedStatusUpdatesMessage =
+    FUTURE_PROTOBUF(StatusUpdatesMessage(), master.get(), _);
+
+  // Drop the first ACKs from the scheduler to the slave.
+  Future<StatusUpdateAcknowledgementsMessage> acknowledgementsMessage =
+    DROP_PROTOBUF(StatusUpdateAcknowledgementsMessage(), _, slave.get());
+
+  Future<Nothing> _statusUpdate =
+    FUTURE_DISPATCH(slave.get(), &Slave::_statusUpdate);
+
+  Clock::pause();
+
+  driver.launchTasks(offers.get()[0].id(), createTasks(offers.get()[0]));
+
+  // The update is batched until the batch interval elapses.
+  AWAIT_READY(_statusUpdate);
+  EXPECT_TRUE(statusUpdatesMessage.isPending());
+
+  Clock::advance(flags.status_update_batch_interval.get());
+
+  AWAIT_READY(statusUpdatesMessage);
+  ASSERT_EQ(1, statusUpdatesMessage.get().updates_size());
+  ASSERT_EQ(1, statusUpdatesMessage.get().pids_size());
+  EXPECT_EQ(slave.get(), UPID(statusUpdatesMessage.get().pids(0)));
+
+  AWAIT_READY(forwardedStatusUpdatesMessage);
+  EXPECT_EQ(1, forwardedStatusUpdatesMessage.get().updates_size());
+
+  AWAIT_READY(status);
+  EXPECT_EQ(TASK_RUNNING, status.get().state());
+
+  AWAIT_READY(acknowledgementsMessage);
+  ASSERT_EQ(1, acknowledgementsMessage.get().acknowledgements_size());
+  EXPECT_EQ(statusUpdatesMessage.get().updates(0).uuid(),
+            acknowledgementsMessage.get().acknowledgements(0).uuid());
+
+  // Now the status update manager should retry the update (in a new
+  // batch), which this time gets acknowledged.
+  Future<Nothing> _statusUpdateAcknowledgement =
+    FUTURE_DISPATCH(slave.get(), &Slave::_statusUpdateAcknowledgement);
+
+  Clock::advance(slave::STATUS_UPDATE_RETRY_INTERVAL_MIN);
+  Clock::settle();
+  Clock::advance(flags.status_update_batch_interval.get());
+
+  AWAIT_READY(retried);
+  EXPECT_EQ(TASK_RUNNING, retried.get().state());
+
+  AWAIT_READY(_statusUpdateAcknowledgement);
+
+  EXPECT_CALL(exec, shutdown(_))
+    .Times(AtMost(1));
+
+  Clock::resume();
+
+  driver.stop();
+  driver.join();
+
+  Shutdown();
+}
@@ -228,6 +228,26 @@ public:
     return future;
   }
 
+  Future<int> multi(const vector<zoo_op_t>& ops, zoo_op_result_t* results)
+  {
+    Promise<int>* promise = new Promise<int>();
+
+    Future<int> future = promise->future();
+
+    tuple<Promise<int>*>* args = new tuple<Promise<int>*>(promise);
+
+    int ret = zoo_amulti(zh, ops.size(), ops.empty() ? NULL : &ops[0],
+                         results, voidCompletion, args);
+
+    if (ret != ZOK) {
+      delete promise;
+      delete args;
+      return ret;
+    }
+
+    return future;
+  }
+
 private:
   // This method is registered as a watcher callback function and is
   // invoked by a single ZooKeeper event thread.
@@ -479,6 +499,76 @@ int ZooKeeper::set(const string& path, const string& data, int version)
 }
 
 
+int ZooKeeper::multi(
+    const vector<zoo_op_t>& ops,
+    vector<zoo_op_result_t>* results)
+{
+  return amulti(ops, results).get();
+}
+
+
+Future<int> ZooKeeper::acreate(
+    const string& path,
+    const string& data,
+    const ACL_vector& acl,
+    int flags,
+    string* result)
+{
+  return impl->create(path, data, acl, flags, result);
+}
+
+
+Future<int> ZooKeeper::aremove(const string& path, int version)
+{
+  return impl->remove(path, version);
+}
+
+
+Future<int> ZooKeeper::aexists(const string& path, bool watch, Stat* stat)
+{
+  return impl->exists(path, watch, stat);
+}
+
+
+Future<int> ZooKeeper::aget(
+    const string& path,
+    bool watch,
+    string* result,
+    Stat* stat)
+{
+  return impl->get(path, watch, result, stat);
+}
+
+
+Future<int> ZooKeeper::agetChildren(
+    const string& path,
+    bool watch,
+    vector<string>* results)
+{
+  return impl->getChildren(path, watch, results);
+}
+
+
+Future<int> ZooKeeper::aset(const string& path, const string& data, int version)
+{
+  return impl->set(path, data, version);
+}
+
+
+Future<int> ZooKeeper::amulti(
+    const vector<zoo_op_t>& ops,
+    vector<zoo_op_result_t>* results)
+{
+  CHECK_NOTNULL(results);
+
+  // One result per operation, which the ZooKeeper C library fills in
+  // when the operations complete.
+  results->assign(ops.size(), zoo_op_result_t());
+
+  return impl->multi(ops, results->empty() ? NULL : &(*results)[0]);
+}
+
+
 string ZooKeeper::message(int code) const
 {
   return string(zerror(code));
@@ -31,6 +31,8 @@
 #include <string>
 #include <vector>
 
+#include <process/future.hpp>
+
 #include <stout/duration.hpp>
 
 
@@ -302,6 +304,68 @@ public:
    */
   int set(const std::string &path, const std::string &data, int version);
 
+  /**
+   * \brief atomically performs a list of operations synchronously.
+   *
+   * Either all of the operations are applied or none of them are.
+   *
+   * \param ops the operations, initialized using zoo_create_op_init,
+   *   zoo_delete_op_init, zoo_set_op_init and/or zoo_check_op_init.
+   *   Any buffers (and stats) passed to these functions must remain
+   *   valid until this call returns.
+   * \param results the results of the operations, one per operation.
+   * \return the return code of the function call.
+   * ZOK all operations completed succesfully
+   * otherwise the return code of the first operation that failed
+   * (the results of the other operations are set accordingly).
+   * ZBADARGUMENTS - invalid input parameters
+   * ZINVALIDSTATE - state is ZOO_SESSION_EXPIRED_STATE or ZOO_AUTH_FAILED_STATE
+   * ZMARSHALLINGERROR - failed to marshall a request; possibly, out of memory
+   */
+  int multi(
+      const std::vector<zoo_op_t> &ops,
+      std::vector<zoo_op_result_t> *results);
+
+  /**
+   * \brief asynchronous versions of the above.
+   *
+   * These return as soon as the request has been queued, so many
+   * requests can be outstanding (i.e., pipelined) at once; the server
+   * processes the requests of a session in the order they were
+   * issued. The returned future is satisfied with the return code.
+   * Note that any results (and stats) must remain valid until then.
+   */
+  process::Future<int> acreate(
+      const std::string &path,
+      const std::string &data,
+      const ACL_vector &acl,
+      int flags,
+      std::string *result);
+
+  process::Future<int> aremove(const std::string &path, int version);
+
+  process::Future<int> aexists(const std::string &path, bool watch, Stat *stat);
+
+  process::Future<int> aget(
+      const std::string &path,
+      bool watch,
+      std::string *result,
+      Stat *stat);
+
+  process::Future<int> agetChildren(
+      const std::string &path,
+      bool watch,
+      std::vector<std::string> *results);
+
+  process::Future<int> aset(
+      const std::string &path,
+      const std::string &data,
+      int version);
+
+  process::Future<int> amulti(
+      const std::vector<zoo_op_t> &ops,
+      std::vector<zoo_op_result_t> *results);
+
   /**
    * \brief return a message describing the return code.
    *